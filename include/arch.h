@@ -58,8 +58,8 @@
 // Include CPUID defintions.
 #include "arch/cpuid.h"
 
-// Include intrinsics.
-#include <intrin.h>
+// Include CPUID and timestamp intrinsics.
+#include "arch/intrinsics.h"
 
 #if defined(_MSC_VER)
 #pragma warning(push)
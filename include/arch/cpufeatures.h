@@ -169,6 +169,9 @@
 #define X86_FEATURE_AVX5124VNNIW 0x00000004     // AVX-512 4-register neural network instructions supported
 #define X86_FEATURE_AVX5124FMAPS 0x00000008     // AVX-512 4-register multiply accumulation single precision
 #define X86_FEATURE_PCONFIG     0x00000008      // platform configuration (memory encryption technologies instructions)
+#define X86_FEATURE_AMX_BF16    0x00400000      // AMX bfloat16 tile instructions supported
+#define X86_FEATURE_AMX_TILE    0x01000000      // AMX tile architecture supported
+#define X86_FEATURE_AMX_INT8    0x02000000      // AMX 8-bit integer tile instructions supported
 #define X86_FEATURE_IBRS_IBPB   0x04000000      // indirect branch restricted speculation and indirect branch
                                                 // prediction barrier supported
 #define X86_FEATURE_STIBP       0x08000000      // single thread indirect branch predictors supported
@@ -46,6 +46,7 @@
 #define CPUID_MONITOR_MWAIT                         0x05
 
 #define CPUID_THERMAL_POWER_MANAGEMENT              0x06
+#define CPUID_THERMAL_POWER_MANAGEMENT_ECX_HARDWARE_COORDINATION_FEEDBACK 0x00000001 // APERF/MPERF
 
 #define CPUID_STRUCTURED_EXTENDED_FEATURES          0x07
 #define CPUID_STRUCTURED_EXTENDED_FEATURES_SUB_LEAF_INFO 0x00
@@ -58,6 +59,9 @@
 #define CPUID_EXTENDED_TOPOLOGY_LEVEL_TYPE_INVALID  0x00
 #define CPUID_EXTENDED_TOPOLOGY_LEVEL_TYPE_SMT      0x01
 #define CPUID_EXTENDED_TOPOLOGY_LEVEL_TYPE_CORE     0x02
+#define CPUID_EXTENDED_TOPOLOGY_LEVEL_TYPE_MODULE   0x03
+#define CPUID_EXTENDED_TOPOLOGY_LEVEL_TYPE_TILE     0x04
+#define CPUID_EXTENDED_TOPOLOGY_LEVEL_TYPE_DIE      0x05
 
 #define CPUID_EXTENDED_STATE                        0x0D
 #define CPUID_EXTENDED_STATE_MAIN_LEAF              0x00
@@ -92,11 +96,47 @@
 #define CPUID_SOC_VENDOR_BRAND_STRING2              0x02
 #define CPUID_SOC_VENDOR_BRAND_STRING3              0x03
 
+#define CPUID_V2_EXTENDED_TOPOLOGY                  0x1F
+
 #define CPUID_HV_VENDOR_INFO                        0x40000000
 #define CPUID_HV_INTERFACE_INFO                     0x40000001
 #define CPUID_HV_VERSION_INFO                       0x40000002
 #define CPUID_HV_TIMER_INFO                         0x40000010
 
+//
+// Hyper-V: interface signature (leaf 0x40000001 EAX), partition privileges
+// (leaf 0x40000003 EAX) and features (leaf 0x40000003 EDX).
+//
+#define CPUID_HV_FEATURES                           0x40000003
+#define CPUID_HV_INTERFACE_SIGNATURE                0x31237648 // 'Hv#1'
+#define CPUID_HV_FEATURES_EAX_ACCESS_REFERENCE_COUNTER  0x00000002
+#define CPUID_HV_FEATURES_EAX_ACCESS_REFERENCE_TSC      0x00000200
+#define CPUID_HV_FEATURES_EAX_ACCESS_FREQUENCY_MSRS     0x00000800
+#define CPUID_HV_FEATURES_EAX_ACCESS_TSC_INVARIANT      0x00008000
+#define CPUID_HV_FEATURES_EDX_FREQUENCY_MSRS_AVAILABLE  0x00000100
+
+//
+// KVM: paravirtual features (leaf 0x40000001 EAX) and hints (EDX).
+//
+#define CPUID_KVM_FEATURES                          0x40000001
+#define CPUID_KVM_FEATURES_EAX_CLOCKSOURCE          0x00000001
+#define CPUID_KVM_FEATURES_EAX_CLOCKSOURCE2         0x00000008
+#define CPUID_KVM_FEATURES_EAX_ASYNC_PF             0x00000010
+#define CPUID_KVM_FEATURES_EAX_STEAL_TIME           0x00000020
+#define CPUID_KVM_FEATURES_EAX_PV_EOI               0x00000040
+#define CPUID_KVM_FEATURES_EAX_PV_UNHALT            0x00000080
+#define CPUID_KVM_FEATURES_EAX_PV_TLB_FLUSH         0x00000200
+#define CPUID_KVM_FEATURES_EAX_PV_SEND_IPI          0x00000800
+#define CPUID_KVM_FEATURES_EAX_CLOCKSOURCE_STABLE   0x01000000
+#define CPUID_KVM_FEATURES_EDX_HINTS_REALTIME       0x00000001
+
+//
+// Xen: version (leaf 0x40000001 EAX) and time (leaf 0x40000003 sub-leaf 0).
+//
+#define CPUID_XEN_VERSION                           0x40000001
+#define CPUID_XEN_TIME                              0x40000003
+#define CPUID_XEN_TIME_EAX_VTSC                     0x00000001 // TSC reads are emulated
+
 #define CPUID_MAX_EXTENDED_FUNCTION                 0x80000000
 #define CPUID_EXTENDED_FEATURES                     0x80000001
 
@@ -104,35 +144,143 @@
 #define CPUID_BRAND_STRING2                         0x80000003
 #define CPUID_BRAND_STRING3                         0x80000004
 
+#define CPUID_AMD_L1_CACHE_INFO                     0x80000005
+#define CPUID_AMD_L1_CACHE_INFO_ASSOCIATIVITY_FULL  0xFF
+
 #define CPUID_EXTENDED_CACHE_INFO                   0x80000006
 #define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_DISABLED 0x00
 #define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_DIRECT_MAPPED 0x01
 #define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_2_WAY 0x02
+#define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_3_WAY 0x03
 #define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_4_WAY 0x04
+#define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_6_WAY 0x05
 #define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_8_WAY 0x06
 #define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_16_WAY 0x08
+#define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_32_WAY 0x0A
+#define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_48_WAY 0x0B
+#define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_64_WAY 0x0C
+#define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_96_WAY 0x0D
+#define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_128_WAY 0x0E
 #define CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_FULL 0x0F
 
 #define CPUID_EXTENDED_TIME_STAMP_COUNTER           0x80000007
+#define CPUID_EXTENDED_TIME_STAMP_COUNTER_EDX_INVARIANT_TSC 0x00000100
 
 #define CPUID_VIR_PHY_ADDRESS_SIZE                  0x80000008
 #define CPUID_EXTENDED_FEATURES_EXTENSION           0x80000008
 
+#define CPUID_AMD_CACHE_TOPOLOGY                    0x8000001D
+
+#define CPUID_AMD_PROCESSOR_TOPOLOGY                0x8000001E
+
+#define CPUID_CENTAUR_MAX_FUNCTION                  0xC0000000
+#define CPUID_CENTAUR_FEATURES                      0xC0000001
+
 
 /**
  * CPUID Vendor Signatures
  */
 
+//
+// Hypervisor signatures are returned by leaf 0x40000000 in EBX, ECX, EDX
+// order, unlike the processor signatures of leaf 0x00 (EBX, EDX, ECX).
+//
+
 //
 // MS HV:   "Microsoft Hv"
 //
 #define CPUID_SIGNATURE_MS_HV_EBX       0x7263694D // 'Micr'
-#define CPUID_SIGNATURE_MS_HV_EDX       0x666F736F // 'osof'
-#define CPUID_SIGNATURE_MS_HV_ECX       0x76482074 // 't Hv'
-#define CPUID_IS_MS_HV_VENDOR(EBX, ECX, EDX)    \
-    ((((ECX) ^ CPUID_SIGNATURE_MS_HV_ECX) |     \
-      ((EDX) ^ CPUID_SIGNATURE_MS_HV_EDX) |     \
-      ((EBX) ^ CPUID_SIGNATURE_MS_HV_EBX)) == 0)
+#define CPUID_SIGNATURE_MS_HV_ECX       0x666F736F // 'osof'
+#define CPUID_SIGNATURE_MS_HV_EDX       0x76482074 // 't Hv'
+#define CPUID_IS_MS_HV_VENDOR(EBX, ECX, EDX)  \
+    ((((EBX) ^ CPUID_SIGNATURE_MS_HV_EBX) |   \
+      ((ECX) ^ CPUID_SIGNATURE_MS_HV_ECX) |   \
+      ((EDX) ^ CPUID_SIGNATURE_MS_HV_EDX)) == 0)
+//
+// KVM:     "KVMKVMKVM\0\0\0"
+//
+#define CPUID_SIGNATURE_KVM_EBX         0x4B4D564B // 'KVMK'
+#define CPUID_SIGNATURE_KVM_ECX         0x564B4D56 // 'VMKV'
+#define CPUID_SIGNATURE_KVM_EDX         0x0000004D // 'M\0\0\0'
+#define CPUID_IS_KVM_VENDOR(EBX, ECX, EDX)  \
+    ((((EBX) ^ CPUID_SIGNATURE_KVM_EBX) |   \
+      ((ECX) ^ CPUID_SIGNATURE_KVM_ECX) |   \
+      ((EDX) ^ CPUID_SIGNATURE_KVM_EDX)) == 0)
+//
+// XEN:     "XenVMMXenVMM"
+//
+#define CPUID_SIGNATURE_XEN_EBX         0x566E6558 // 'XenV'
+#define CPUID_SIGNATURE_XEN_ECX         0x65584D4D // 'MMXe'
+#define CPUID_SIGNATURE_XEN_EDX         0x4D4D566E // 'nVMM'
+#define CPUID_IS_XEN_VENDOR(EBX, ECX, EDX)  \
+    ((((EBX) ^ CPUID_SIGNATURE_XEN_EBX) |   \
+      ((ECX) ^ CPUID_SIGNATURE_XEN_ECX) |   \
+      ((EDX) ^ CPUID_SIGNATURE_XEN_EDX)) == 0)
+//
+// VMWARE:  "VMwareVMware"
+//
+#define CPUID_SIGNATURE_VMWARE_EBX      0x61774D56 // 'VMwa'
+#define CPUID_SIGNATURE_VMWARE_ECX      0x4D566572 // 'reVM'
+#define CPUID_SIGNATURE_VMWARE_EDX      0x65726177 // 'ware'
+#define CPUID_IS_VMWARE_VENDOR(EBX, ECX, EDX)  \
+    ((((EBX) ^ CPUID_SIGNATURE_VMWARE_EBX) |   \
+      ((ECX) ^ CPUID_SIGNATURE_VMWARE_ECX) |   \
+      ((EDX) ^ CPUID_SIGNATURE_VMWARE_EDX)) == 0)
+//
+// BHYVE:   "bhyve bhyve "
+//
+#define CPUID_SIGNATURE_BHYVE_EBX       0x76796862 // 'bhyv'
+#define CPUID_SIGNATURE_BHYVE_ECX       0x68622065 // 'e bh'
+#define CPUID_SIGNATURE_BHYVE_EDX       0x20657679 // 'yve '
+#define CPUID_IS_BHYVE_VENDOR(EBX, ECX, EDX)  \
+    ((((EBX) ^ CPUID_SIGNATURE_BHYVE_EBX) |   \
+      ((ECX) ^ CPUID_SIGNATURE_BHYVE_ECX) |   \
+      ((EDX) ^ CPUID_SIGNATURE_BHYVE_EDX)) == 0)
+//
+// TCG:     "TCGTCGTCGTCG"
+//
+#define CPUID_SIGNATURE_TCG_EBX         0x54474354 // 'TCGT'
+#define CPUID_SIGNATURE_TCG_ECX         0x43544743 // 'CGTC'
+#define CPUID_SIGNATURE_TCG_EDX         0x47435447 // 'GTCG'
+#define CPUID_IS_TCG_VENDOR(EBX, ECX, EDX)  \
+    ((((EBX) ^ CPUID_SIGNATURE_TCG_EBX) |   \
+      ((ECX) ^ CPUID_SIGNATURE_TCG_ECX) |   \
+      ((EDX) ^ CPUID_SIGNATURE_TCG_EDX)) == 0)
+//
+// VBOX:    "VBoxVBoxVBox"
+//
+#define CPUID_SIGNATURE_VBOX_EBX        0x786F4256 // 'VBox'
+#define CPUID_SIGNATURE_VBOX_ECX        0x786F4256 // 'VBox'
+#define CPUID_SIGNATURE_VBOX_EDX        0x786F4256 // 'VBox'
+#define CPUID_IS_VBOX_VENDOR(EBX, ECX, EDX)  \
+    ((((EBX) ^ CPUID_SIGNATURE_VBOX_EBX) |   \
+      ((ECX) ^ CPUID_SIGNATURE_VBOX_ECX) |   \
+      ((EDX) ^ CPUID_SIGNATURE_VBOX_EDX)) == 0)
+//
+// PARALLELS: "prl hyperv  "
+//
+#define CPUID_SIGNATURE_PARALLELS_EBX   0x206C7270 // 'prl '
+#define CPUID_SIGNATURE_PARALLELS_ECX   0x65707968 // 'hype'
+#define CPUID_SIGNATURE_PARALLELS_EDX   0x20207672 // 'rv  '
+#define CPUID_IS_PARALLELS_VENDOR(EBX, ECX, EDX)  \
+    ((((EBX) ^ CPUID_SIGNATURE_PARALLELS_EBX) |   \
+      ((ECX) ^ CPUID_SIGNATURE_PARALLELS_ECX) |   \
+      ((EDX) ^ CPUID_SIGNATURE_PARALLELS_EDX)) == 0)
+//
+// ACRN:    "ACRNACRNACRN"
+//
+#define CPUID_SIGNATURE_ACRN_EBX        0x4E524341 // 'ACRN'
+#define CPUID_SIGNATURE_ACRN_ECX        0x4E524341 // 'ACRN'
+#define CPUID_SIGNATURE_ACRN_EDX        0x4E524341 // 'ACRN'
+#define CPUID_IS_ACRN_VENDOR(EBX, ECX, EDX)  \
+    ((((EBX) ^ CPUID_SIGNATURE_ACRN_EBX) |   \
+      ((ECX) ^ CPUID_SIGNATURE_ACRN_ECX) |   \
+      ((EDX) ^ CPUID_SIGNATURE_ACRN_EDX)) == 0)
+
+//
+// Processor signatures (leaf 0x00).
+//
+
 //
 // INTEL:   "GenuineIntel"
 //
@@ -154,6 +302,16 @@
       ((EDX) ^ CPUID_SIGNATURE_AMD_EDX) |       \
       ((EBX) ^ CPUID_SIGNATURE_AMD_EBX)) == 0)
 //
+// HYGON:   "HygonGenuine"
+//
+#define CPUID_SIGNATURE_HYGON_EBX       0x6F677948 // 'Hygo'
+#define CPUID_SIGNATURE_HYGON_EDX       0x6E65476E // 'nGen'
+#define CPUID_SIGNATURE_HYGON_ECX       0x656E6975 // 'uine'
+#define CPUID_IS_HYGON_VENDOR(EBX, ECX, EDX)    \
+    ((((ECX) ^ CPUID_SIGNATURE_HYGON_ECX) |     \
+      ((EDX) ^ CPUID_SIGNATURE_HYGON_EDX) |     \
+      ((EBX) ^ CPUID_SIGNATURE_HYGON_EBX)) == 0)
+//
 // CENTAUR: "CentaurHauls"
 //
 #define CPUID_SIGNATURE_CENTAUR_EBX     0x746E6543 // 'Cent'
@@ -164,6 +322,16 @@
       ((EDX) ^ CPUID_SIGNATURE_CENTAUR_EDX) |   \
       ((EBX) ^ CPUID_SIGNATURE_CENTAUR_EBX)) == 0)
 //
+// ZHAOXIN: "  Shanghai  "
+//
+#define CPUID_SIGNATURE_ZHAOXIN_EBX     0x68532020 // '  Sh'
+#define CPUID_SIGNATURE_ZHAOXIN_EDX     0x68676E61 // 'angh'
+#define CPUID_SIGNATURE_ZHAOXIN_ECX     0x20206961 // 'ai  '
+#define CPUID_IS_ZHAOXIN_VENDOR(EBX, ECX, EDX)  \
+    ((((ECX) ^ CPUID_SIGNATURE_ZHAOXIN_ECX) |   \
+      ((EDX) ^ CPUID_SIGNATURE_ZHAOXIN_EDX) |   \
+      ((EBX) ^ CPUID_SIGNATURE_ZHAOXIN_EBX)) == 0)
+//
 // CYRIX:   "CyrixInstead"
 //
 #define CPUID_SIGNATURE_CYRIX_EBX       0x69727943 // 'Cyri'
@@ -0,0 +1,302 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file intrinsics.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#ifndef _ARCH_INTRINSICS_H_
+#define _ARCH_INTRINSICS_H_
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#include "types.h"
+
+//
+// CPUID, XGETBV, timestamp and performance counter backends, selected per compiler:
+//
+//  - MSVC: the compiler intrinsics from <intrin.h>.
+//  - GCC/Clang: inline assembly, so results stay in registers.
+//  - PIF_USE_ASM_INTRINSICS: the out-of-line NASM routines in src/x64 and
+//    src/i386, for toolchains with neither.
+//
+// The Pif* names never collide with <intrin.h>/<x86intrin.h>, which callers
+// are free to include as well.
+//
+#if defined(PIF_USE_ASM_INTRINSICS)
+#define PIF_INTRINSICS_ASM      1
+#elif defined(_MSC_VER) && !defined(__clang__)
+#define PIF_INTRINSICS_MSVC     1
+#elif defined(__GNUC__) || defined(__clang__)
+#define PIF_INTRINSICS_INLINE   1
+#else
+#define PIF_INTRINSICS_ASM      1
+#endif
+
+#if defined(PIF_INTRINSICS_MSVC)
+
+#include <intrin.h>
+
+#define PifCpuid(Info, Leaf)                __cpuid( (int*)(Info), (int)(Leaf) )
+#define PifCpuidEx(Info, Leaf, SubLeaf)     __cpuidex( (int*)(Info), (int)(Leaf), (int)(SubLeaf) )
+#define PifXgetbv(Xcr)                      ((UINT64)_xgetbv( (unsigned int)(Xcr) ))
+#define PifReadTsc()                        ((UINT64)__rdtsc( ))
+#define PifReadTscp(Aux)                    ((UINT64)__rdtscp( (unsigned int*)(Aux) ))
+#define PifReadPmc(Counter)                 ((UINT64)__readpmc( (unsigned long)(Counter) ))
+#define PifLoadFence()                      _mm_lfence( )
+
+#elif defined(PIF_INTRINSICS_INLINE)
+
+FORCEINLINE
+VOID
+PifCpuidEx(
+    OUT VOID *Info,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf
+)
+{
+    UINT32 *Registers = (UINT32 *)Info;
+
+    //
+    // GCC before 5 reserves EBX as the i386 PIC register and refuses it as
+    // an operand, so it is swapped out by hand there.
+    //
+#if defined(__i386__) && defined(__PIC__) && !defined(__clang__) && (__GNUC__ < 5)
+    __asm__ __volatile__( "xchgl %%ebx, %k1\n\t"
+                          "cpuid\n\t"
+                          "xchgl %%ebx, %k1"
+                          : "=a"(Registers[0]), "=&r"(Registers[1]), "=c"(Registers[2]), "=d"(Registers[3])
+                          : "0"(Leaf), "2"(SubLeaf) );
+#else
+    __asm__ __volatile__( "cpuid"
+                          : "=a"(Registers[0]), "=b"(Registers[1]), "=c"(Registers[2]), "=d"(Registers[3])
+                          : "0"(Leaf), "2"(SubLeaf) );
+#endif
+}
+
+FORCEINLINE
+VOID
+PifCpuid(
+    OUT VOID *Info,
+    IN UINT32 Leaf
+)
+{
+    PifCpuidEx( Info, Leaf, 0 );
+}
+
+FORCEINLINE
+UINT64
+PifXgetbv(
+    IN UINT32 Xcr
+)
+{
+    UINT32 Low;
+    UINT32 High;
+
+    __asm__ __volatile__( "xgetbv" : "=a"(Low), "=d"(High) : "c"(Xcr) );
+    return ((UINT64)High << 32) | Low;
+}
+
+FORCEINLINE
+UINT64
+PifReadTsc(
+    VOID
+)
+{
+    UINT32 Low;
+    UINT32 High;
+
+    __asm__ __volatile__( "rdtsc" : "=a"(Low), "=d"(High) );
+    return ((UINT64)High << 32) | Low;
+}
+
+FORCEINLINE
+UINT64
+PifReadTscp(
+    OUT UINT32 *Aux
+)
+{
+    UINT32 Low;
+    UINT32 High;
+
+    __asm__ __volatile__( "rdtscp" : "=a"(Low), "=d"(High), "=c"(*Aux) );
+    return ((UINT64)High << 32) | Low;
+}
+
+FORCEINLINE
+UINT64
+PifReadPmc(
+    IN UINT32 Counter
+)
+{
+    UINT32 Low;
+    UINT32 High;
+
+    __asm__ __volatile__( "rdpmc" : "=a"(Low), "=d"(High) : "c"(Counter) );
+    return ((UINT64)High << 32) | Low;
+}
+
+FORCEINLINE
+VOID
+PifLoadFence(
+    VOID
+)
+{
+    __asm__ __volatile__( "lfence" ::: "memory" );
+}
+
+#else // PIF_INTRINSICS_ASM
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Implemented in src/x64/cpuid.asm and src/i386/cpuid.asm.
+//
+VOID __cpuid( int Info[4], int Leaf );
+VOID __cpuidex( int Info[4], int Leaf, int SubLeaf );
+UINT64 _xgetbv( unsigned int Xcr );
+UINT64 __rdtsc( VOID );
+UINT64 __rdtscp( unsigned int *Aux );
+UINT64 __readpmc( unsigned long Counter );
+VOID _mm_lfence( VOID );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#define PifCpuid(Info, Leaf)                __cpuid( (int*)(Info), (int)(Leaf) )
+#define PifCpuidEx(Info, Leaf, SubLeaf)     __cpuidex( (int*)(Info), (int)(Leaf), (int)(SubLeaf) )
+#define PifXgetbv(Xcr)                      _xgetbv( (unsigned int)(Xcr) )
+#define PifReadTsc()                        __rdtsc( )
+#define PifReadTscp(Aux)                    __rdtscp( (unsigned int*)(Aux) )
+#define PifReadPmc(Counter)                 __readpmc( (unsigned long)(Counter) )
+#define PifLoadFence()                      _mm_lfence( )
+
+#endif
+
+//
+// 32-bit, 64-bit store and pointer atomics with explicit ordering, and the spin-wait hint.
+// These only depend on the compiler, not on the CPUID backend above.
+//
+#if defined(_MSC_VER) && !defined(__clang__)
+
+#include <intrin.h>
+
+FORCEINLINE
+UINT32
+PifLoadAcquire32(
+    IN CONST volatile UINT32 *Target
+)
+{
+    UINT32 Value = *Target;
+
+    //
+    // x86 loads are not reordered with later loads or stores, only the
+    // compiler has to be kept from hoisting them.
+    //
+    _ReadWriteBarrier( );
+    return Value;
+}
+
+FORCEINLINE
+VOID
+PifStoreRelease32(
+    OUT volatile UINT32 *Target,
+    IN UINT32 Value
+)
+{
+    _ReadWriteBarrier( );
+    *Target = Value;
+}
+
+FORCEINLINE
+VOID
+PifStoreRelease64(
+    OUT volatile UINT64 *Target,
+    IN UINT64 Value
+)
+{
+#if defined(_M_IX86)
+    __int64 Comparand;
+
+    //
+    // A 32-bit processor has no plain 64-bit store, so exchange it in.
+    //
+    do
+    {
+        Comparand = *(volatile __int64 *)Target;
+    } while (_InterlockedCompareExchange64( (volatile __int64 *)Target, (__int64)Value, Comparand ) != Comparand);
+#else
+    _ReadWriteBarrier( );
+    *Target = Value;
+#endif
+}
+
+FORCEINLINE
+UINT32
+PifCompareExchange32(
+    IN OUT volatile UINT32 *Target,
+    IN UINT32 Exchange,
+    IN UINT32 Comparand
+)
+{
+    return (UINT32)_InterlockedCompareExchange( (volatile long *)Target, (long)Exchange, (long)Comparand );
+}
+
+FORCEINLINE
+PVOID
+PifLoadAcquirePointer(
+    IN PVOID CONST volatile *Target
+)
+{
+    PVOID Value = *Target;
+
+    _ReadWriteBarrier( );
+    return Value;
+}
+
+#define PifExchangePointer(Target, Value)   _InterlockedExchangePointer( (PVOID volatile *)(Target), (Value) )
+#define PifYieldProcessor()                 _mm_pause( )
+
+#else
+
+#define PifLoadAcquire32(Target)            __atomic_load_n( (Target), __ATOMIC_ACQUIRE )
+#define PifStoreRelease32(Target, Value)    __atomic_store_n( (Target), (Value), __ATOMIC_RELEASE )
+#define PifStoreRelease64(Target, Value)    __atomic_store_n( (Target), (Value), __ATOMIC_RELEASE )
+
+FORCEINLINE
+UINT32
+PifCompareExchange32(
+    IN OUT volatile UINT32 *Target,
+    IN UINT32 Exchange,
+    IN UINT32 Comparand
+)
+{
+    __atomic_compare_exchange_n( Target, &Comparand, Exchange, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE );
+    return Comparand;
+}
+
+#define PifLoadAcquirePointer(Target)       __atomic_load_n( (Target), __ATOMIC_ACQUIRE )
+#define PifExchangePointer(Target, Value)   __atomic_exchange_n( (Target), (Value), __ATOMIC_ACQ_REL )
+#define PifYieldProcessor()                 __builtin_ia32_pause( )
+
+#endif
+
+#endif // _ARCH_INTRINSICS_H_
@@ -40,6 +40,24 @@
 // XCR0 register features.
 //
 #define X64_XCR_XFEATURE_ENABLED_MASK 0
+#define X64_XCR_XFEATURE_IN_USE_MASK 1
+
+#define X64_XCR0_X87            0x00000001      // x87 FPU/MMX state
+#define X64_XCR0_SSE            0x00000002      // XMM registers and MXCSR
+#define X64_XCR0_AVX            0x00000004      // upper halves of YMM0-YMM15
+#define X64_XCR0_BNDREG         0x00000008      // MPX BND0-BND3
+#define X64_XCR0_BNDCSR         0x00000010      // MPX BNDCFGU and BNDSTATUS
+#define X64_XCR0_OPMASK         0x00000020      // AVX-512 opmask registers k0-k7
+#define X64_XCR0_ZMM_HI256      0x00000040      // upper halves of ZMM0-ZMM15
+#define X64_XCR0_HI16_ZMM       0x00000080      // ZMM16-ZMM31
+#define X64_XCR0_PKRU           0x00000200      // protection key rights register
+#define X64_XCR0_TILECFG        0x00020000      // AMX TILECFG register
+#define X64_XCR0_TILEDATA       0x00040000      // AMX TMM0-TMM7 tile registers
+
+#define X64_XCR0_AVX_STATE      (X64_XCR0_SSE | X64_XCR0_AVX)
+#define X64_XCR0_AVX512_STATE   (X64_XCR0_AVX_STATE | X64_XCR0_OPMASK | X64_XCR0_ZMM_HI256 | X64_XCR0_HI16_ZMM)
+#define X64_XCR0_MPX_STATE      (X64_XCR0_BNDREG | X64_XCR0_BNDCSR)
+#define X64_XCR0_AMX_STATE      (X64_XCR0_TILECFG | X64_XCR0_TILEDATA)
 
 
 //
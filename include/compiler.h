@@ -94,8 +94,13 @@
 #endif
 
 /* Optimization barrier */
+#if defined(__GNUC__) || defined(__clang__)
+#define barrier()       \
+    __asm__ __volatile__("": : :"memory")
+#else
 #define barrier()       \
     _ReadWriteBarrier()
+#endif
 
 /**
  * GCC specific compiler macros
@@ -414,6 +419,7 @@
 #error Sorry, your compiler is too old - please upgrade it.
 #endif
 
+#undef __used
 #if GCC_VERSION < 30300
 #define __used              __attribute__((__unused__))
 #else
@@ -556,6 +562,8 @@
  */
 #define __used              // not supported
 #define __maybe_unused      // not supported
+#define likely(x)           (x)
+#define unlikely(x)         (x)
 #define __always_unused     // not supported
 #define __unused            // not supported
 
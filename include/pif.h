@@ -24,22 +24,71 @@
 
 #include "arch.h"
 
+//
+// Symbols exported by libpif. The library itself is compiled with PIF_BUILD,
+// consumers of the static library define PIF_STATIC. Everything else in the
+// library is hidden (-fvisibility=hidden).
+//
+#if defined(PIF_STATIC)
+#define PIF_EXPORT
+#elif defined(_WIN32) || defined(__CYGWIN__)
+#if defined(PIF_BUILD)
+#define PIF_EXPORT __declspec(dllexport)
+#else
+#define PIF_EXPORT __declspec(dllimport)
+#endif
+#elif defined(__GNUC__) || defined(__clang__)
+#define PIF_EXPORT __attribute__((visibility("default")))
+#else
+#define PIF_EXPORT
+#endif
+
 // Processor Identification and Features API calling convention.
-#define PIFAPI BLAPI
+#define PIFAPI PIF_EXPORT BLAPI
+
+/**
+ * Raw register values returned by a CPUID leaf/sub-leaf.
+ */
+typedef struct _CPUID_INFO {
+    UINT32 Eax, Ebx, Ecx, Edx;
+} CPUID_INFO, *PCPUID_INFO;
+
+// Feature bitmap, feature IDs and compile-time baseline.
+#include "pif/features.h"
+
+/**
+ * Features reported by CPUID, captured by PifInitialize.
+ */
+extern PIF_EXPORT PIF_FEATURES PifFeatures;
+
+//
+// Register level names of the feature words.
+//
+#define CpuidFn_00000001h_0_Ecx PifFeatures.Words[PifFeatureWord_00000001h_0_Ecx]
+#define CpuidFn_00000001h_0_Edx PifFeatures.Words[PifFeatureWord_00000001h_0_Edx]
 
-extern UINT32 CpuidFn_00000001h_0_Ecx;
-extern UINT32 CpuidFn_00000001h_0_Edx;
+#define CpuidFn_00000007h_0_Ebx PifFeatures.Words[PifFeatureWord_00000007h_0_Ebx]
+#define CpuidFn_00000007h_0_Ecx PifFeatures.Words[PifFeatureWord_00000007h_0_Ecx]
+#define CpuidFn_00000007h_0_Edx PifFeatures.Words[PifFeatureWord_00000007h_0_Edx]
 
-extern UINT32 CpuidFn_00000007h_0_Ebx;
-extern UINT32 CpuidFn_00000007h_0_Ecx;
-extern UINT32 CpuidFn_00000007h_0_Edx;
+#define CpuidFn_0000000Dh_1_Eax PifFeatures.Words[PifFeatureWord_0000000Dh_1_Eax]
+#define CpuidFn_0000000Dh_1_Ebx CpuidFn_0000000Dh_1_Eax
 
-extern UINT32 CpuidFn_0000000Dh_1_Ebx;
+#define CpuidFn_80000001h_0_Ecx PifFeatures.Words[PifFeatureWord_80000001h_0_Ecx]
+#define CpuidFn_80000001h_0_Edx PifFeatures.Words[PifFeatureWord_80000001h_0_Edx]
 
-extern UINT32 CpuidFn_80000001h_0_Ecx;
-extern UINT32 CpuidFn_80000001h_0_Edx;
+#define CpuidFn_80000008h_0_Ebx PifFeatures.Words[PifFeatureWord_80000008h_0_Ebx]
+
+/**
+ * XCR0 as read by PifInitialize, or 0 when the OS has not set CR4.OSXSAVE.
+ */
+extern PIF_EXPORT UINT64 PifXfeatureEnabledMask;
 
-extern UINT32 CpuidFn_80000008h_0_Ebx;
+/**
+ * PifFeatures with every feature whose register state is not enabled in XCR0
+ * cleared, so each Usable* check is a single AND.
+ */
+extern PIF_EXPORT PIF_FEATURES PifUsableFeatures;
 
 
 STATUS
@@ -54,6 +103,147 @@ PifDestroy(
     VOID
     );
 
+//
+// Values of PifInitState.
+//
+#define PIF_INIT_NONE       0   //!< Not initialized, or destroyed
+#define PIF_INIT_RUNNING    1   //!< PifEnsureInitialized is capturing the snapshot
+#define PIF_INIT_DONE       2   //!< Snapshot published
+#define PIF_INIT_FAILED     3   //!< PifEnsureInitialized failed and returns its status
+
+/**
+ * Initialization state, published with release semantics once the snapshot
+ * and feature words are written.
+ */
+extern PIF_EXPORT volatile UINT32 PifInitState;
+
+/**
+ * Runs PifInitialize once and returns its status. Concurrent first callers
+ * wait for the thread that runs it; later calls only load PifInitState.
+ * A failed initialization is not retried until PifDestroy is called.
+ *
+ * When the library is built with PIF_AUTO_INIT this already ran from a
+ * constructor before main (priority PIF_INIT_PRIORITY on ELF), and every
+ * Has and Usable test falls back to it if used even earlier.
+ */
+STATUS
+PIFAPI
+PifEnsureInitialized(
+    VOID
+    );
+
+/**
+ * Returns TRUE once PifEnsureInitialized or PifInitialize has completed.
+ */
+FORCEINLINE
+BOOLEAN
+PifIsInitialized(
+    VOID
+)
+{
+    return PifLoadAcquire32( &PifInitState ) == PIF_INIT_DONE;
+}
+
+/**
+ * Lazy initialization check used by the feature tests in PIF_AUTO_INIT
+ * builds: one acquire load and a predicted branch once initialized.
+ */
+FORCEINLINE
+VOID
+PifEnsureInitializedFast(
+    VOID
+)
+{
+    if (unlikely( !PifIsInitialized( ) ))
+    {
+        (VOID)PifEnsureInitialized( );
+    }
+}
+
+/**
+ * Looks up a CPUID leaf in the snapshot captured by PifInitialize. The
+ * snapshot covers the basic, hypervisor and extended ranges and is never
+ * modified after initialization, so lookups need no locking and never
+ * execute the CPUID instruction.
+ *
+ * Indexed leaves (0x04, 0x07, 0x0B, 0x0D, 0x0F, 0x10, 0x12, 0x14, 0x17, 0x1F
+ * and 0x8000001D) are enumerated up to and including their terminating sub-leaf;
+ * E_NOTFOUND is returned past that point. Other leaves ignore SubLeaf.
+ */
+STATUS
+PIFAPI
+PifQueryLeaf(
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO CpuInfo
+    );
+
+/**
+ * Returns the highest leaf captured in the range starting at RangeBase
+ * (CPUID_MAX_FUNCTION, CPUID_HV_VENDOR_INFO, CPUID_MAX_EXTENDED_FUNCTION or
+ * CPUID_CENTAUR_MAX_FUNCTION). E_NOTFOUND if the range is not reported.
+ * The hypervisor range may start above CPUID_HV_VENDOR_INFO, see
+ * PIF_HYPERVISOR_INFO::BaseLeaf.
+ */
+STATUS
+PIFAPI
+PifGetMaxLeaf(
+    IN UINT32 RangeBase,
+    OUT UINT32 *MaxLeaf
+    );
+
+/**
+ * Returns the number of sub-leaves captured for a leaf. Leaves that ignore
+ * ECX report a single sub-leaf.
+ */
+STATUS
+PIFAPI
+PifGetSubLeafCount(
+    IN UINT32 Leaf,
+    OUT UINT32 *SubLeafCount
+    );
+
+/**
+ * Initializes PIF and additionally captures the full leaf/sub-leaf snapshot
+ * on every logical processor the process may run on. Collection runs in
+ * parallel on workers pinned to each processor. The per-processor copies
+ * follow the layout enumerated on the calling processor.
+ */
+STATUS
+PIFAPI
+PifInitializeAllCpus(
+    VOID
+    );
+
+/**
+ * Returns the number of per-processor slots (highest CPU number + 1), or 0
+ * when PifInitializeAllCpus has not been called.
+ */
+UINT32
+PIFAPI
+PifGetCpuCount(
+    VOID
+    );
+
+BOOLEAN
+PIFAPI
+PifIsCpuPresent(
+    IN UINT32 Cpu
+    );
+
+/**
+ * Same as PifQueryLeaf, but served from the snapshot of a specific logical
+ * processor captured by PifInitializeAllCpus.
+ */
+STATUS
+PIFAPI
+PifQueryLeafOnCpu(
+    IN UINT32 Cpu,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO CpuInfo
+    );
+
 STATUS
 PIFAPI
 PifGetVendorString(
@@ -68,101 +258,227 @@ PifGetBrandString(
     IN SIZE_T BrandStringMaxSize
     );
 
-#define HasSSE3()           ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_SSE3))
-#define HasPCLMULQDQ()      ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_PCLMULQDQ))
-#define HasMONITOR()        ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_MONITOR))
-#define HasMWAIT()          ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_MONITOR))
-#define HasVMX()            ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_VMX))
-#define HasSMX()            ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_SMX))
-#define HasEIST()           ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_EIST))
-#define HasSSSE3()          ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_SSSE3))
-#define HasFMA()            ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_FMA))
-#define HasCMPXCHG16B()     ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_CMPXCHG16B))
-#define HasSSE41()          ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_SSE41))
-#define HasSSE42()          ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_SSE42))
-#define HasMOVBE()          ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_MOVBE))
-#define HasPOPCNT()         ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_POPCNT))
-#define HasAES()            ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_AES))
-#define HasXSAVE()          ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_XSAVE))
-#define HasOSXSAVE()        ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_OSXSAVE))
-#define HasAVX()            ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_AVX))
-#define HasF16C()           ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_F16C))
-#define HasRDRAND()         ((BOOLEAN)(CpuidFn_00000001h_0_Ecx & X86_FEATURE_RDRND))
-
-#define HasMSR()            ((BOOLEAN)(CpuidFn_00000001h_0_Edx & X86_FEATURE_MSR))
-#define HasCMPXCHG8B()      ((BOOLEAN)(CpuidFn_00000001h_0_Edx & X86_FEATURE_CMPXCHG8B))
-#define HasSEP()            ((BOOLEAN)(CpuidFn_00000001h_0_Edx & X86_FEATURE_SEP))
-#define HasCMOV()           ((BOOLEAN)(CpuidFn_00000001h_0_Edx & X86_FEATURE_CMOV))
-#define HasCLFSH()          ((BOOLEAN)(CpuidFn_00000001h_0_Edx & X86_FEATURE_CLFSH))
-#define HasMMX()            ((BOOLEAN)(CpuidFn_00000001h_0_Edx & X86_FEATURE_MMX))
-#define HasFXSR()           ((BOOLEAN)(CpuidFn_00000001h_0_Edx & X86_FEATURE_FXSR))
-#define HasFXSAVE()         ((BOOLEAN)(CpuidFn_00000001h_0_Edx & X86_FEATURE_FXSAVE))
-#define HasSSE()            ((BOOLEAN)(CpuidFn_00000001h_0_Edx & X86_FEATURE_SSE))
-#define HasSSE2()           ((BOOLEAN)(CpuidFn_00000001h_0_Edx & X86_FEATURE_SSE2))
-
-#define HasFSGSBASE()       ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_FSGSBASE))
-#define HasTSCADJUST()      ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_TSCADJUST))
-#define HasSGX()            ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_SGX))
-#define HasBMI1()           ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_BMI1))
-#define HasBMI()            ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_BMI))
-#define HasHLE()            ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_HLE))
-#define HasAVX2()           ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_AVX2))
-#define HasBMI2()           ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_BMI2))
-#define HasERMS()           ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_ERMS))
-#define HasINVPCID()        ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_INVPCID))
-#define HasRTM()            ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_RTM))
-#define HasMPX()            ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_MPX))
-#define HasAVX512F()        ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_AVX512F))
-#define HasRDSEED()         ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_RDSEED))
-#define HasADX()            ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_ADX))
-#define HasAVX512PF()       ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_AVX512PF))
-#define HasAVX512ER()       ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_AVX512ER))
-#define HasAVX512CD()       ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_AVX512CD))
-#define HasSHA()            ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_SHA))
-#define HasAVX512BW()       ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_AVX512BW))
-#define HasAVX512VL()       ((BOOLEAN)(CpuidFn_00000007h_0_Ebx & X86_FEATURE_AVX512VL))
-
-#define HasPREFETCHWT1()    ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_PREFTCHWT1))
-#define HasAVX512VBMI1()    ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_AVX512VBMI1))
-#define HasAVX512VBMI()     ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_AVX512VBMI))
-#define HasUMIP()           ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_UMIP))
-#define HasPKU()            ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_PKU))
-#define HasAVX512VBMI2()    ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_AVX512VBMI2))
-#define HasGFNI()           ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_GFNI))
-#define HasVAES()           ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_VAES))
-#define HasVPCLMULQDQ()     ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_VPCLMULQDQ))
-#define HasAVX512VNNI()     ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_AVX512VNNI))
-#define HasAVX512BITALG()   ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_AVX512BITALG))
-#define HasAVX512VPOPCNTDQ() ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_AVX512VPOPCNTDQ))
-#define HasRDPID()          ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_RDPID))
-#define HasSGXLC()          ((BOOLEAN)(CpuidFn_00000007h_0_Ecx & X86_FEATURE_SGXLC))
-
-#define HasLAHF_LM()        ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_LAHF_LM))
-#define HasSVM()            ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_SVM))
-#define HasABM()            ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_ABM))
-#define HasLZCNT()          ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_LZCNT))
-#define HasSSE4a()          ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_SSE4A))
-#define HasSSE4A()          ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_SSE4A))
-#define HasMisalignedSSE()  ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_MISALIGNSSE))
-#define HasPRFCHW()         ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_PRFCHW))
-#define HasPREFETCHW()      ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_PRFCHW))
-#define HasXOP()            ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_XOP))
-#define HasSKINIT()         ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_SKINIT))
-#define HasFMA4()           ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_FMA4))
-#define HasTCE()            ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_TCE))
-#define HasTBM()            ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_TBM))
-#define HasDBX()            ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_DBX))
-#define HasMONITORX()       ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_MONITORX))
-#define HasMWAITX()         ((BOOLEAN)(CpuidFn_80000001h_0_Ecx & X86_FEATURE_MONITORX))
-
-#define HasSYSCALL()        ((BOOLEAN)(CpuidFn_80000001h_0_Edx & X86_FEATURE_SEPEXT))
-#define HasMTRR()           ((BOOLEAN)(CpuidFn_80000001h_0_Edx & X86_FEATURE_MTRREXT))
-#define HasNOEXECUTE()      ((BOOLEAN)(CpuidFn_80000001h_0_Edx & X86_FEATURE_NOEXECUTE))
-#define HasMMXEXT()         ((BOOLEAN)(CpuidFn_80000001h_0_Edx & X86_FEATURE_MMXEXT))
-#define HasRDTSCP()         ((BOOLEAN)(CpuidFn_80000001h_0_Edx & X86_FEATURE_RDTSCP))
-#define HasLONGMODE()       ((BOOLEAN)(CpuidFn_80000001h_0_Edx & X86_FEATURE_LONGMODE))
-#define Has3DNOWEXT()       ((BOOLEAN)(CpuidFn_80000001h_0_Edx & X86_FEATURE_3DNOWEXT))
-#define Has3DNOW()          ((BOOLEAN)(CpuidFn_80000001h_0_Edx & X86_FEATURE_3DNOW))
+#define HasSSE3()           PIF_HAS( PifFeatureSSE3 )
+#define HasPCLMULQDQ()      PIF_HAS( PifFeaturePCLMULQDQ )
+#define HasMONITOR()        PIF_HAS( PifFeatureMONITOR )
+#define HasMWAIT()          PIF_HAS( PifFeatureMWAIT )
+#define HasVMX()            PIF_HAS( PifFeatureVMX )
+#define HasSMX()            PIF_HAS( PifFeatureSMX )
+#define HasEIST()           PIF_HAS( PifFeatureEIST )
+#define HasSSSE3()          PIF_HAS( PifFeatureSSSE3 )
+#define HasFMA()            PIF_HAS( PifFeatureFMA )
+#define HasCMPXCHG16B()     PIF_HAS( PifFeatureCMPXCHG16B )
+#define HasSSE41()          PIF_HAS( PifFeatureSSE41 )
+#define HasSSE42()          PIF_HAS( PifFeatureSSE42 )
+#define HasMOVBE()          PIF_HAS( PifFeatureMOVBE )
+#define HasPOPCNT()         PIF_HAS( PifFeaturePOPCNT )
+#define HasAES()            PIF_HAS( PifFeatureAES )
+#define HasXSAVE()          PIF_HAS( PifFeatureXSAVE )
+#define HasOSXSAVE()        PIF_HAS( PifFeatureOSXSAVE )
+#define HasAVX()            PIF_HAS( PifFeatureAVX )
+#define HasF16C()           PIF_HAS( PifFeatureF16C )
+#define HasRDRAND()         PIF_HAS( PifFeatureRDRAND )
+
+#define HasFPU()            PIF_HAS( PifFeatureFPU )
+#define HasMSR()            PIF_HAS( PifFeatureMSR )
+#define HasCMPXCHG8B()      PIF_HAS( PifFeatureCMPXCHG8B )
+#define HasSEP()            PIF_HAS( PifFeatureSEP )
+#define HasCMOV()           PIF_HAS( PifFeatureCMOV )
+#define HasCLFSH()          PIF_HAS( PifFeatureCLFSH )
+#define HasMMX()            PIF_HAS( PifFeatureMMX )
+#define HasFXSR()           PIF_HAS( PifFeatureFXSR )
+#define HasFXSAVE()         PIF_HAS( PifFeatureFXSAVE )
+#define HasSSE()            PIF_HAS( PifFeatureSSE )
+#define HasSSE2()           PIF_HAS( PifFeatureSSE2 )
+
+#define HasFSGSBASE()       PIF_HAS( PifFeatureFSGSBASE )
+#define HasTSCADJUST()      PIF_HAS( PifFeatureTSCADJUST )
+#define HasSGX()            PIF_HAS( PifFeatureSGX )
+#define HasBMI1()           PIF_HAS( PifFeatureBMI1 )
+#define HasBMI()            PIF_HAS( PifFeatureBMI )
+#define HasHLE()            PIF_HAS( PifFeatureHLE )
+#define HasAVX2()           PIF_HAS( PifFeatureAVX2 )
+#define HasBMI2()           PIF_HAS( PifFeatureBMI2 )
+#define HasERMS()           PIF_HAS( PifFeatureERMS )
+#define HasINVPCID()        PIF_HAS( PifFeatureINVPCID )
+#define HasRTM()            PIF_HAS( PifFeatureRTM )
+#define HasMPX()            PIF_HAS( PifFeatureMPX )
+#define HasAVX512F()        PIF_HAS( PifFeatureAVX512F )
+#define HasAVX512DQ()       PIF_HAS( PifFeatureAVX512DQ )
+#define HasRDSEED()         PIF_HAS( PifFeatureRDSEED )
+#define HasADX()            PIF_HAS( PifFeatureADX )
+#define HasAVX512IFMA()     PIF_HAS( PifFeatureAVX512IFMA )
+#define HasCLFLUSHOPT()     PIF_HAS( PifFeatureCLFLUSHOPT )
+#define HasCLWB()           PIF_HAS( PifFeatureCLWB )
+#define HasAVX512PF()       PIF_HAS( PifFeatureAVX512PF )
+#define HasAVX512ER()       PIF_HAS( PifFeatureAVX512ER )
+#define HasAVX512CD()       PIF_HAS( PifFeatureAVX512CD )
+#define HasSHA()            PIF_HAS( PifFeatureSHA )
+#define HasAVX512BW()       PIF_HAS( PifFeatureAVX512BW )
+#define HasAVX512VL()       PIF_HAS( PifFeatureAVX512VL )
+
+#define HasPREFETCHWT1()    PIF_HAS( PifFeaturePREFETCHWT1 )
+#define HasAVX512VBMI1()    PIF_HAS( PifFeatureAVX512VBMI1 )
+#define HasAVX512VBMI()     PIF_HAS( PifFeatureAVX512VBMI )
+#define HasUMIP()           PIF_HAS( PifFeatureUMIP )
+#define HasPKU()            PIF_HAS( PifFeaturePKU )
+#define HasAVX512VBMI2()    PIF_HAS( PifFeatureAVX512VBMI2 )
+#define HasGFNI()           PIF_HAS( PifFeatureGFNI )
+#define HasVAES()           PIF_HAS( PifFeatureVAES )
+#define HasVPCLMULQDQ()     PIF_HAS( PifFeatureVPCLMULQDQ )
+#define HasAVX512VNNI()     PIF_HAS( PifFeatureAVX512VNNI )
+#define HasAVX512BITALG()   PIF_HAS( PifFeatureAVX512BITALG )
+#define HasAVX512VPOPCNTDQ() PIF_HAS( PifFeatureAVX512VPOPCNTDQ )
+#define HasRDPID()          PIF_HAS( PifFeatureRDPID )
+#define HasSGXLC()          PIF_HAS( PifFeatureSGXLC )
+
+#define HasAMXBF16()        PIF_HAS( PifFeatureAMXBF16 )
+#define HasAMXTILE()        PIF_HAS( PifFeatureAMXTILE )
+#define HasAMXINT8()        PIF_HAS( PifFeatureAMXINT8 )
+
+#define HasXSAVEOPT()       PIF_HAS( PifFeatureXSAVEOPT )
+#define HasXSAVEC()         PIF_HAS( PifFeatureXSAVEC )
+#define HasXSAVES()         PIF_HAS( PifFeatureXSAVES )
+
+#define HasLAHF_LM()        PIF_HAS( PifFeatureLAHF_LM )
+#define HasSVM()            PIF_HAS( PifFeatureSVM )
+#define HasABM()            PIF_HAS( PifFeatureABM )
+#define HasLZCNT()          PIF_HAS( PifFeatureLZCNT )
+#define HasSSE4a()          PIF_HAS( PifFeatureSSE4a )
+#define HasSSE4A()          PIF_HAS( PifFeatureSSE4A )
+#define HasMisalignedSSE()  PIF_HAS( PifFeatureMisalignedSSE )
+#define HasPRFCHW()         PIF_HAS( PifFeaturePRFCHW )
+#define HasPREFETCHW()      PIF_HAS( PifFeaturePREFETCHW )
+#define HasXOP()            PIF_HAS( PifFeatureXOP )
+#define HasSKINIT()         PIF_HAS( PifFeatureSKINIT )
+#define HasFMA4()           PIF_HAS( PifFeatureFMA4 )
+#define HasTCE()            PIF_HAS( PifFeatureTCE )
+#define HasTBM()            PIF_HAS( PifFeatureTBM )
+#define HasDBX()            PIF_HAS( PifFeatureDBX )
+#define HasMONITORX()       PIF_HAS( PifFeatureMONITORX )
+#define HasMWAITX()         PIF_HAS( PifFeatureMWAITX )
+
+#define HasSYSCALL()        PIF_HAS( PifFeatureSYSCALL )
+#define HasMTRR()           PIF_HAS( PifFeatureMTRR )
+#define HasNOEXECUTE()      PIF_HAS( PifFeatureNOEXECUTE )
+#define HasMMXEXT()         PIF_HAS( PifFeatureMMXEXT )
+#define HasRDTSCP()         PIF_HAS( PifFeatureRDTSCP )
+#define HasLONGMODE()       PIF_HAS( PifFeatureLONGMODE )
+#define Has3DNOWEXT()       PIF_HAS( PifFeature3DNOWEXT )
+#define Has3DNOW()          PIF_HAS( PifFeature3DNOW )
+
+//
+// OS-enablement-aware checks. A feature is usable when the processor reports
+// it and the OS saves and restores the register state it depends on.
+//
+#define UsableSSE3()        PIF_USABLE( PifFeatureSSE3 )
+#define UsablePCLMULQDQ()   PIF_USABLE( PifFeaturePCLMULQDQ )
+#define UsableMONITOR()     PIF_USABLE( PifFeatureMONITOR )
+#define UsableMWAIT()       PIF_USABLE( PifFeatureMWAIT )
+#define UsableVMX()         PIF_USABLE( PifFeatureVMX )
+#define UsableSMX()         PIF_USABLE( PifFeatureSMX )
+#define UsableEIST()        PIF_USABLE( PifFeatureEIST )
+#define UsableSSSE3()       PIF_USABLE( PifFeatureSSSE3 )
+#define UsableFMA()         PIF_USABLE( PifFeatureFMA )
+#define UsableCMPXCHG16B()  PIF_USABLE( PifFeatureCMPXCHG16B )
+#define UsableSSE41()       PIF_USABLE( PifFeatureSSE41 )
+#define UsableSSE42()       PIF_USABLE( PifFeatureSSE42 )
+#define UsableMOVBE()       PIF_USABLE( PifFeatureMOVBE )
+#define UsablePOPCNT()      PIF_USABLE( PifFeaturePOPCNT )
+#define UsableAES()         PIF_USABLE( PifFeatureAES )
+#define UsableXSAVE()       PIF_USABLE( PifFeatureXSAVE )
+#define UsableOSXSAVE()     PIF_USABLE( PifFeatureOSXSAVE )
+#define UsableAVX()         PIF_USABLE( PifFeatureAVX )
+#define UsableF16C()        PIF_USABLE( PifFeatureF16C )
+#define UsableRDRAND()      PIF_USABLE( PifFeatureRDRAND )
+
+#define UsableFPU()         PIF_USABLE( PifFeatureFPU )
+#define UsableMSR()         PIF_USABLE( PifFeatureMSR )
+#define UsableCMPXCHG8B()   PIF_USABLE( PifFeatureCMPXCHG8B )
+#define UsableSEP()         PIF_USABLE( PifFeatureSEP )
+#define UsableCMOV()        PIF_USABLE( PifFeatureCMOV )
+#define UsableCLFSH()       PIF_USABLE( PifFeatureCLFSH )
+#define UsableMMX()         PIF_USABLE( PifFeatureMMX )
+#define UsableFXSR()        PIF_USABLE( PifFeatureFXSR )
+#define UsableFXSAVE()      PIF_USABLE( PifFeatureFXSAVE )
+#define UsableSSE()         PIF_USABLE( PifFeatureSSE )
+#define UsableSSE2()        PIF_USABLE( PifFeatureSSE2 )
+
+#define UsableFSGSBASE()    PIF_USABLE( PifFeatureFSGSBASE )
+#define UsableTSCADJUST()   PIF_USABLE( PifFeatureTSCADJUST )
+#define UsableSGX()         PIF_USABLE( PifFeatureSGX )
+#define UsableBMI1()        PIF_USABLE( PifFeatureBMI1 )
+#define UsableBMI()         PIF_USABLE( PifFeatureBMI )
+#define UsableHLE()         PIF_USABLE( PifFeatureHLE )
+#define UsableAVX2()        PIF_USABLE( PifFeatureAVX2 )
+#define UsableBMI2()        PIF_USABLE( PifFeatureBMI2 )
+#define UsableERMS()        PIF_USABLE( PifFeatureERMS )
+#define UsableINVPCID()     PIF_USABLE( PifFeatureINVPCID )
+#define UsableRTM()         PIF_USABLE( PifFeatureRTM )
+#define UsableMPX()         PIF_USABLE( PifFeatureMPX )
+#define UsableAVX512F()     PIF_USABLE( PifFeatureAVX512F )
+#define UsableAVX512DQ()    PIF_USABLE( PifFeatureAVX512DQ )
+#define UsableRDSEED()      PIF_USABLE( PifFeatureRDSEED )
+#define UsableADX()         PIF_USABLE( PifFeatureADX )
+#define UsableAVX512IFMA()  PIF_USABLE( PifFeatureAVX512IFMA )
+#define UsableCLFLUSHOPT()  PIF_USABLE( PifFeatureCLFLUSHOPT )
+#define UsableCLWB()        PIF_USABLE( PifFeatureCLWB )
+#define UsableAVX512PF()    PIF_USABLE( PifFeatureAVX512PF )
+#define UsableAVX512ER()    PIF_USABLE( PifFeatureAVX512ER )
+#define UsableAVX512CD()    PIF_USABLE( PifFeatureAVX512CD )
+#define UsableSHA()         PIF_USABLE( PifFeatureSHA )
+#define UsableAVX512BW()    PIF_USABLE( PifFeatureAVX512BW )
+#define UsableAVX512VL()    PIF_USABLE( PifFeatureAVX512VL )
+
+#define UsablePREFETCHWT1() PIF_USABLE( PifFeaturePREFETCHWT1 )
+#define UsableAVX512VBMI1() PIF_USABLE( PifFeatureAVX512VBMI1 )
+#define UsableAVX512VBMI()  PIF_USABLE( PifFeatureAVX512VBMI )
+#define UsableUMIP()        PIF_USABLE( PifFeatureUMIP )
+#define UsablePKU()         PIF_USABLE( PifFeaturePKU )
+#define UsableAVX512VBMI2() PIF_USABLE( PifFeatureAVX512VBMI2 )
+#define UsableGFNI()        PIF_USABLE( PifFeatureGFNI )
+#define UsableVAES()        PIF_USABLE( PifFeatureVAES )
+#define UsableVPCLMULQDQ()  PIF_USABLE( PifFeatureVPCLMULQDQ )
+#define UsableAVX512VNNI()  PIF_USABLE( PifFeatureAVX512VNNI )
+#define UsableAVX512BITALG() PIF_USABLE( PifFeatureAVX512BITALG )
+#define UsableAVX512VPOPCNTDQ() PIF_USABLE( PifFeatureAVX512VPOPCNTDQ )
+#define UsableRDPID()       PIF_USABLE( PifFeatureRDPID )
+#define UsableSGXLC()       PIF_USABLE( PifFeatureSGXLC )
+
+#define UsableAMXBF16()     PIF_USABLE( PifFeatureAMXBF16 )
+#define UsableAMXTILE()     PIF_USABLE( PifFeatureAMXTILE )
+#define UsableAMXINT8()     PIF_USABLE( PifFeatureAMXINT8 )
+
+#define UsableXSAVEOPT()    PIF_USABLE( PifFeatureXSAVEOPT )
+#define UsableXSAVEC()      PIF_USABLE( PifFeatureXSAVEC )
+#define UsableXSAVES()      PIF_USABLE( PifFeatureXSAVES )
+
+#define UsableLAHF_LM()     PIF_USABLE( PifFeatureLAHF_LM )
+#define UsableSVM()         PIF_USABLE( PifFeatureSVM )
+#define UsableABM()         PIF_USABLE( PifFeatureABM )
+#define UsableLZCNT()       PIF_USABLE( PifFeatureLZCNT )
+#define UsableSSE4a()       PIF_USABLE( PifFeatureSSE4a )
+#define UsableSSE4A()       PIF_USABLE( PifFeatureSSE4A )
+#define UsableMisalignedSSE() PIF_USABLE( PifFeatureMisalignedSSE )
+#define UsablePRFCHW()      PIF_USABLE( PifFeaturePRFCHW )
+#define UsablePREFETCHW()   PIF_USABLE( PifFeaturePREFETCHW )
+#define UsableXOP()         PIF_USABLE( PifFeatureXOP )
+#define UsableSKINIT()      PIF_USABLE( PifFeatureSKINIT )
+#define UsableFMA4()        PIF_USABLE( PifFeatureFMA4 )
+#define UsableTCE()         PIF_USABLE( PifFeatureTCE )
+#define UsableTBM()         PIF_USABLE( PifFeatureTBM )
+#define UsableDBX()         PIF_USABLE( PifFeatureDBX )
+#define UsableMONITORX()    PIF_USABLE( PifFeatureMONITORX )
+#define UsableMWAITX()      PIF_USABLE( PifFeatureMWAITX )
+
+#define UsableSYSCALL()     PIF_USABLE( PifFeatureSYSCALL )
+#define UsableMTRR()        PIF_USABLE( PifFeatureMTRR )
+#define UsableNOEXECUTE()   PIF_USABLE( PifFeatureNOEXECUTE )
+#define UsableMMXEXT()      PIF_USABLE( PifFeatureMMXEXT )
+#define UsableRDTSCP()      PIF_USABLE( PifFeatureRDTSCP )
+#define UsableLONGMODE()    PIF_USABLE( PifFeatureLONGMODE )
+#define Usable3DNOWEXT()    PIF_USABLE( PifFeature3DNOWEXT )
+#define Usable3DNOW()       PIF_USABLE( PifFeature3DNOW )
 
 #define IsFeatureSupported(_XX) \
     Has##_XX( )
@@ -170,4 +486,26 @@ PifGetBrandString(
 #define IsFeatureSupportedMessage(_XX) \
     printf( #_XX " is%s\n", (Has##_XX( )) ? " supported" : " not supported" )
 
+#define IsFeatureUsable(_XX) \
+    Usable##_XX( )
+
+#define IsFeatureUsableMessage(_XX) \
+    printf( #_XX " is%s\n", (Usable##_XX( )) ? " usable" : " not usable" )
+
+// Include context, processor topology, snapshot, replay, cache, dispatch, level, fleet, MSR, frequency, PMU and profiler definitions.
+#include "pif/context.h"
+#include "pif/uarch.h"
+#include "pif/hypervisor.h"
+#include "pif/topology.h"
+#include "pif/snapshot.h"
+#include "pif/replay.h"
+#include "pif/cache.h"
+#include "pif/dispatch.h"
+#include "pif/level.h"
+#include "pif/fleet.h"
+#include "pif/msr.h"
+#include "pif/frequency.h"
+#include "pif/pmu.h"
+#include "pif/profiler.h"
+
 #endif // _PIF_H_
@@ -0,0 +1,126 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file cache.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#ifndef _PIF_CACHE_H_
+#define _PIF_CACHE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Maximum number of cache descriptors reported.
+ */
+#define PIF_MAX_CACHES                  16
+
+/**
+ * Cache types, encoded as in CPUID leaf 0x04 EAX[4:0].
+ */
+typedef enum _PIF_CACHE_TYPE {
+    PifCacheTypeNull = 0,
+    PifCacheTypeData = 1,
+    PifCacheTypeInstruction = 2,
+    PifCacheTypeUnified = 3,
+} PIF_CACHE_TYPE;
+
+//
+// Cache descriptor flags.
+//
+#define PIF_CACHE_SELF_INITIALIZING     0x0001  // Does not need software initialization
+#define PIF_CACHE_FULLY_ASSOCIATIVE     0x0002  // Ways == number of lines
+#define PIF_CACHE_INCLUSIVE             0x0004  // Inclusive of lower cache levels
+#define PIF_CACHE_COMPLEX_INDEXING      0x0008  // Hashed set index, not a direct address mapping
+#define PIF_CACHE_WBINVD_NOT_INCLUSIVE  0x0010  // WBINVD does not act on lower levels of sharing threads
+
+/**
+ * Describes one cache of the hierarchy. Size is Ways * Partitions *
+ * LineSize * Sets. The CPUs sharing each instance of the cache are listed by
+ * Instances[FirstInstance..FirstInstance+InstanceCount).
+ */
+typedef struct _PIF_CACHE_DESCRIPTOR {
+    UINT32 Level;               //!< 1 for L1, 2 for L2, ...
+    PIF_CACHE_TYPE Type;
+    UINT32 Flags;               //!< PIF_CACHE_* flags
+    UINT32 Size;                //!< Total size in bytes
+    UINT32 Ways;                //!< Ways of associativity
+    UINT32 LineSize;            //!< System coherency line size in bytes
+    UINT32 Partitions;          //!< Physical line partitions
+    UINT32 Sets;                //!< Number of sets
+    UINT32 MaxSharingCpus;      //!< Maximum logical processors sharing an instance, as reported by CPUID
+    UINT32 FirstInstance;
+    UINT32 InstanceCount;       //!< 0 unless PifInitializeAllCpus was used
+} PIF_CACHE_DESCRIPTOR, *PPIF_CACHE_DESCRIPTOR;
+typedef CONST PIF_CACHE_DESCRIPTOR *PCPIF_CACHE_DESCRIPTOR;
+
+/**
+ * One physical instance of a cache. The CPUs sharing it are
+ * CpuList[FirstCpu..FirstCpu+CpuCount).
+ */
+typedef struct _PIF_CACHE_INSTANCE {
+    UINT32 CacheId;             //!< APIC ID bits above the sharing width
+    UINT32 FirstCpu;
+    UINT32 CpuCount;
+} PIF_CACHE_INSTANCE, *PPIF_CACHE_INSTANCE;
+
+typedef struct _PIF_CACHE_HIERARCHY {
+    UINT32 CacheCount;
+    PIF_CACHE_DESCRIPTOR Caches[PIF_MAX_CACHES];
+    UINT32 InstanceCount;
+    PPIF_CACHE_INSTANCE Instances;
+    PUINT32 CpuList;
+} PIF_CACHE_HIERARCHY, *PPIF_CACHE_HIERARCHY;
+
+/**
+ * Returns the cache hierarchy decoded from leaf 0x04 (Intel), 0x8000001D
+ * (AMD with TOPOEXT) or 0x80000005/0x80000006 (older AMD and others).
+ * Caches are ordered by level, then data, instruction, unified.
+ */
+STATUS
+PIFAPI
+PifGetCacheHierarchy(
+    OUT CONST PIF_CACHE_HIERARCHY **Hierarchy
+    );
+
+/**
+ * Returns the cache hierarchy of a context, decoded when it was created.
+ * Instances are only listed when its processors were all captured.
+ */
+STATUS
+PIFAPI
+PifContextGetCacheHierarchy(
+    IN PCPIF_CONTEXT Context,
+    OUT CONST PIF_CACHE_HIERARCHY **Hierarchy
+    );
+
+/**
+ * Returns the first data or unified cache of the given level, or NULL.
+ */
+PCPIF_CACHE_DESCRIPTOR
+PIFAPI
+PifGetDataCache(
+    IN UINT32 Level
+    );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_CACHE_H_
@@ -0,0 +1,192 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file context.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#ifndef _PIF_CONTEXT_H_
+#define _PIF_CONTEXT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * One complete CPUID snapshot: the leaf tables, vendor and brand strings, the
+ * feature words and XCR0. A context is never modified after it is created, so
+ * any number of threads may query it without locking. The global API
+ * (PifQueryLeaf, PifFeatures, Has* ...) operates on the default context, which
+ * PifInitialize replaces atomically.
+ */
+typedef struct _PIF_CONTEXT PIF_CONTEXT, *PPIF_CONTEXT;
+typedef CONST PIF_CONTEXT *PCPIF_CONTEXT;
+
+/**
+ * Captures a new context from the processor the caller is running on and
+ * decodes its caches. Release it with PifDestroyContext.
+ */
+STATUS
+PIFAPI
+PifCreateContext(
+    OUT PPIF_CONTEXT *Context
+    );
+
+/**
+ * Executes CPUID leaf/sub-leaf as logical processor Cpu of a CPUID source
+ * would. Leaves the source knows nothing about should read as zero. Return
+ * an error for processors the source does not have.
+ */
+typedef STATUS (BLAPI *PPIF_CPUID_ROUTINE)(
+    IN VOID *Parameter,
+    IN UINT32 Cpu,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO CpuInfo
+    );
+
+/**
+ * Alternative CPUID backend, used to capture contexts of processors other
+ * than the host, such as a replayed dump (see replay.h).
+ */
+typedef struct _PIF_CPUID_SOURCE {
+    PPIF_CPUID_ROUTINE Cpuid;
+    VOID *Parameter;                //!< Passed to Cpuid
+    UINT32 CpuCount;                //!< Processors captured individually when above 1
+    UINT64 XfeatureEnabledMask;     //!< XCR0 to assume, 0 for every component leaf 0x0D reports
+} PIF_CPUID_SOURCE, *PPIF_CPUID_SOURCE;
+typedef CONST PIF_CPUID_SOURCE *PCPIF_CPUID_SOURCE;
+
+/**
+ * Captures a new context from a CPUID source instead of the host processor,
+ * and derives its topology (for sources of several processors) and caches.
+ * The source is only used during the call.
+ */
+STATUS
+PIFAPI
+PifCreateContextFromSource(
+    IN PCPIF_CPUID_SOURCE Source,
+    OUT PPIF_CONTEXT *Context
+    );
+
+/**
+ * Makes Context the default context behind the global API, as if
+ * PifInitialize had captured it, and resolves the registered dispatch tables
+ * against it. The library takes ownership of Context. A context that was
+ * already published and since replaced is rejected with E_ALREADY.
+ */
+STATUS
+PIFAPI
+PifInitializeFromContext(
+    IN PPIF_CONTEXT Context
+    );
+
+/**
+ * Frees a context created by PifCreateContext, PifCreateContextFromSource or
+ * the snapshot loaders. The default context is owned by the library and must
+ * not be passed here.
+ */
+VOID
+PIFAPI
+PifDestroyContext(
+    IN PPIF_CONTEXT Context OPTIONAL
+    );
+
+/**
+ * Returns the context behind the global API, or NULL before initialization.
+ * It stays valid until PifDestroy, even once a later PifInitialize or
+ * PifInitializeAllCpus has replaced it.
+ */
+PCPIF_CONTEXT
+PIFAPI
+PifGetDefaultContext(
+    VOID
+    );
+
+/**
+ * Context variants of PifQueryLeaf, PifGetMaxLeaf and PifGetSubLeafCount.
+ */
+STATUS
+PIFAPI
+PifContextQueryLeaf(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO CpuInfo
+    );
+
+STATUS
+PIFAPI
+PifContextGetMaxLeaf(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 RangeBase,
+    OUT UINT32 *MaxLeaf
+    );
+
+STATUS
+PIFAPI
+PifContextGetSubLeafCount(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Leaf,
+    OUT UINT32 *SubLeafCount
+    );
+
+STATUS
+PIFAPI
+PifContextGetVendorString(
+    IN PCPIF_CONTEXT Context,
+    OUT CHAR *VendorString,
+    IN SIZE_T VendorStringMaxSize
+    );
+
+STATUS
+PIFAPI
+PifContextGetBrandString(
+    IN PCPIF_CONTEXT Context,
+    OUT CHAR *BrandString,
+    IN SIZE_T BrandStringMaxSize
+    );
+
+/**
+ * Features reported by CPUID in the context (the PifFeatures of a context).
+ */
+PCPIF_FEATURES
+PIFAPI
+PifContextGetFeatures(
+    IN PCPIF_CONTEXT Context
+    );
+
+/**
+ * Reported features masked by the context's XCR0 (its PifUsableFeatures).
+ */
+PCPIF_FEATURES
+PIFAPI
+PifContextGetUsableFeatures(
+    IN PCPIF_CONTEXT Context
+    );
+
+UINT64
+PIFAPI
+PifContextGetXfeatureEnabledMask(
+    IN PCPIF_CONTEXT Context
+    );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_CONTEXT_H_
@@ -0,0 +1,172 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file dispatch.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#ifndef _PIF_DISPATCH_H_
+#define _PIF_DISPATCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Feature flags a candidate requires from one feature word. A candidate may
+ * list the same word more than once; all of the listed flags are required.
+ */
+typedef struct _PIF_FEATURE_REQUIREMENT {
+    UINT32 Word;    //!< PIF_FEATURE_WORD
+    UINT32 Mask;    //!< X86_FEATURE_* flags of that word
+} PIF_FEATURE_REQUIREMENT, *PPIF_FEATURE_REQUIREMENT;
+
+/**
+ * Implementation of a dispatched function and the features it requires.
+ */
+typedef struct _PIF_DISPATCH_CANDIDATE {
+    PVOID Function;
+    CONST PIF_FEATURE_REQUIREMENT *Requirements;
+    UINT32 RequirementCount;
+} PIF_DISPATCH_CANDIDATE, *PPIF_DISPATCH_CANDIDATE;
+
+/**
+ * Dispatch slot. Candidates are ordered from most to least preferred and the
+ * first one whose requirements are all met is stored into *Target. The last
+ * candidate should be a fallback without requirements.
+ */
+typedef struct _PIF_DISPATCH_TABLE {
+    PVOID *Target;
+    CONST PIF_DISPATCH_CANDIDATE *Candidates;
+    UINT32 CandidateCount;
+    struct _PIF_DISPATCH_TABLE *Next;   //!< Owned by PIF once registered
+} PIF_DISPATCH_TABLE, *PPIF_DISPATCH_TABLE;
+
+//
+// Candidate initializers, e.g.:
+//
+//   static CONST PIF_DISPATCH_CANDIDATE CopyCandidates[] = {
+//       PIF_DISPATCH_CANDIDATE( CopyAvx2,
+//           PIF_REQUIRE( PifFeatureWord_00000001h_0_Ecx, X86_FEATURE_AVX ),
+//           PIF_REQUIRE( PifFeatureWord_00000007h_0_Ebx, X86_FEATURE_AVX2 ) ),
+//       PIF_DISPATCH_CANDIDATE( CopySse42,
+//           PIF_REQUIRE( PifFeatureWord_00000001h_0_Ecx, X86_FEATURE_SSE42 ) ),
+//       PIF_DISPATCH_FALLBACK( CopyGeneric ),
+//   };
+//
+// Requirements on the same word accumulate rather than replace each other.
+//
+#define PIF_REQUIRE(Word, Mask) \
+    { (UINT32)(Word), (UINT32)(Mask) }
+
+#define PIF_DISPATCH_CANDIDATE(Function, ...) \
+    { (PVOID)(Function), \
+      (CONST PIF_FEATURE_REQUIREMENT[]){ __VA_ARGS__ }, \
+      (UINT32)(sizeof( (PIF_FEATURE_REQUIREMENT[]){ __VA_ARGS__ } ) / sizeof( PIF_FEATURE_REQUIREMENT )) }
+
+#define PIF_DISPATCH_FALLBACK(Function) \
+    { (PVOID)(Function), NULL, 0 }
+
+#define PIF_DISPATCH_TABLE_INIT(Target, Candidates) \
+    { (PVOID*)&(Target), (Candidates), RTL_NUMBER_OF_V1( Candidates ), NULL }
+
+/**
+ * Loads the usable feature words of the snapshot captured by PifInitialize.
+ */
+STATUS
+PIFAPI
+PifGetFeatures(
+    OUT PPIF_FEATURES Features
+    );
+
+/**
+ * Executes CPUID and XGETBV directly to fill the usable feature set. Does not
+ * allocate and does not depend on PifInitialize, so it may be called from GNU
+ * ifunc resolvers.
+ */
+VOID
+PIFAPI
+PifCaptureFeatures(
+    OUT PPIF_FEATURES Features
+    );
+
+/**
+ * Returns TRUE if every feature in Required is present in Features.
+ */
+BOOLEAN
+PIFAPI
+PifHasFeatures(
+    IN CONST PIF_FEATURES *Features,
+    IN CONST PIF_FEATURES *Required
+    );
+
+/**
+ * Returns the first candidate function supported by Features, or NULL.
+ */
+PVOID
+PIFAPI
+PifSelectCandidate(
+    IN CONST PIF_FEATURES *Features,
+    IN CONST PIF_DISPATCH_CANDIDATE *Candidates,
+    IN UINT32 CandidateCount
+    );
+
+/**
+ * Registers a dispatch table. Its target is resolved by every successful
+ * PifInitialize, or immediately if PIF is already initialized. Tables must
+ * stay alive until PifDestroy and should be registered before other threads
+ * call through their targets. Returns E_NOTFOUND if no candidate matched, in
+ * which case the target is left untouched.
+ */
+STATUS
+PIFAPI
+PifRegisterDispatchTable(
+    IN PPIF_DISPATCH_TABLE Table
+    );
+
+#if defined(__GNUC__) && defined(__ELF__)
+
+//
+// GNU indirect functions. The dynamic loader resolves the symbol once at
+// relocation time, so calls go straight to the selected implementation:
+//
+//   PIF_DEFINE_IFUNC_RESOLVER( CopyResolver, CopyCandidates )
+//   VOID Copy( PVOID Dst, CONST VOID *Src, SIZE_T Size ) PIF_IFUNC( CopyResolver );
+//
+// The resolver runs before constructors, so PIF must be linked into the same
+// module as the resolver.
+//
+#define PIF_HAS_IFUNC 1
+
+#define PIF_DEFINE_IFUNC_RESOLVER(Resolver, Candidates) \
+    static PVOID Resolver( VOID ) \
+    { \
+        PIF_FEATURES Features; \
+        PifCaptureFeatures( &Features ); \
+        return PifSelectCandidate( &Features, (Candidates), RTL_NUMBER_OF_V1( Candidates ) ); \
+    }
+
+#define PIF_IFUNC(Resolver) \
+    __attribute__(( ifunc( #Resolver ) ))
+
+#endif // __GNUC__ && __ELF__
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_DISPATCH_H_
@@ -0,0 +1,728 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file features.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#ifndef _PIF_FEATURES_H_
+#define _PIF_FEATURES_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Feature words of the feature bitmap, one per CPUID register holding flags.
+ */
+typedef enum _PIF_FEATURE_WORD {
+    PifFeatureWord_00000001h_0_Ecx = 0,
+    PifFeatureWord_00000001h_0_Edx,
+    PifFeatureWord_00000007h_0_Ebx,
+    PifFeatureWord_00000007h_0_Ecx,
+    PifFeatureWord_00000007h_0_Edx,
+    PifFeatureWord_0000000Dh_1_Eax,
+    PifFeatureWord_80000001h_0_Ecx,
+    PifFeatureWord_80000001h_0_Edx,
+    PifFeatureWord_80000008h_0_Ebx,
+    PifFeatureWordCount
+} PIF_FEATURE_WORD;
+
+// Compatibility name, the XSAVE feature flags are reported in EAX.
+#define PifFeatureWord_0000000Dh_1_Ebx PifFeatureWord_0000000Dh_1_Eax
+
+//
+// The bitmap spans one cache line, leaving room for further feature words.
+//
+#define PIF_FEATURE_WORDS   16
+#define PIF_FEATURE_BITS    (PIF_FEATURE_WORDS * 32)
+
+/**
+ * Feature bitmap. Feature ID N is bit (N % 32) of Words[N / 32], so each word
+ * holds the X86_FEATURE_* flags of its PIF_FEATURE_WORD register unchanged.
+ */
+typedef struct ALIGNED(64) _PIF_FEATURES {
+    UINT32 Words[PIF_FEATURE_WORDS];
+} PIF_FEATURES, *PPIF_FEATURES;
+typedef CONST PIF_FEATURES *PCPIF_FEATURES;
+
+#define PIF_FEATURE_ID(Word, Bit)   ((Word) * 32 + (Bit))
+#define PIF_FEATURE_WORD_OF(Id)     ((UINT32)(Id) >> 5)
+#define PIF_FEATURE_MASK(Id)        (1u << ((UINT32)(Id) & 31))
+
+/**
+ * Stable feature IDs. Values are part of the ABI and never renumbered.
+ */
+typedef enum _PIF_FEATURE {
+    PifFeatureSSE3              = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 0 ),
+    PifFeaturePCLMULQDQ         = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 1 ),
+    PifFeatureMONITOR           = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 3 ),
+    PifFeatureVMX               = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 5 ),
+    PifFeatureSMX               = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 6 ),
+    PifFeatureEIST              = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 7 ),
+    PifFeatureSSSE3             = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 9 ),
+    PifFeatureFMA               = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 12 ),
+    PifFeatureCMPXCHG16B        = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 13 ),
+    PifFeatureSSE41             = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 19 ),
+    PifFeatureSSE42             = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 20 ),
+    PifFeatureMOVBE             = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 22 ),
+    PifFeaturePOPCNT            = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 23 ),
+    PifFeatureAES               = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 25 ),
+    PifFeatureXSAVE             = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 26 ),
+    PifFeatureOSXSAVE           = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 27 ),
+    PifFeatureAVX               = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 28 ),
+    PifFeatureF16C              = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 29 ),
+    PifFeatureRDRAND            = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Ecx, 30 ),
+
+    PifFeatureFPU               = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Edx, 0 ),
+    PifFeatureMSR               = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Edx, 5 ),
+    PifFeatureCMPXCHG8B         = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Edx, 8 ),
+    PifFeatureSEP               = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Edx, 11 ),
+    PifFeatureCMOV              = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Edx, 15 ),
+    PifFeatureCLFSH             = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Edx, 19 ),
+    PifFeatureMMX               = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Edx, 23 ),
+    PifFeatureFXSR              = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Edx, 24 ),
+    PifFeatureSSE               = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Edx, 25 ),
+    PifFeatureSSE2              = PIF_FEATURE_ID( PifFeatureWord_00000001h_0_Edx, 26 ),
+
+    PifFeatureFSGSBASE          = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 0 ),
+    PifFeatureTSCADJUST         = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 1 ),
+    PifFeatureSGX               = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 2 ),
+    PifFeatureBMI1              = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 3 ),
+    PifFeatureHLE               = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 4 ),
+    PifFeatureAVX2              = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 5 ),
+    PifFeatureBMI2              = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 8 ),
+    PifFeatureERMS              = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 9 ),
+    PifFeatureINVPCID           = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 10 ),
+    PifFeatureRTM               = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 11 ),
+    PifFeatureMPX               = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 14 ),
+    PifFeatureAVX512F           = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 16 ),
+    PifFeatureAVX512DQ          = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 17 ),
+    PifFeatureRDSEED            = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 18 ),
+    PifFeatureADX               = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 19 ),
+    PifFeatureAVX512IFMA        = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 21 ),
+    PifFeatureCLFLUSHOPT        = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 23 ),
+    PifFeatureCLWB              = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 24 ),
+    PifFeatureAVX512PF          = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 26 ),
+    PifFeatureAVX512ER          = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 27 ),
+    PifFeatureAVX512CD          = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 28 ),
+    PifFeatureSHA               = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 29 ),
+    PifFeatureAVX512BW          = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 30 ),
+    PifFeatureAVX512VL          = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ebx, 31 ),
+
+    PifFeaturePREFETCHWT1       = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 0 ),
+    PifFeatureAVX512VBMI1       = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 1 ),
+    PifFeatureUMIP              = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 2 ),
+    PifFeaturePKU               = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 3 ),
+    PifFeatureAVX512VBMI2       = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 6 ),
+    PifFeatureGFNI              = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 8 ),
+    PifFeatureVAES              = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 9 ),
+    PifFeatureVPCLMULQDQ        = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 10 ),
+    PifFeatureAVX512VNNI        = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 11 ),
+    PifFeatureAVX512BITALG      = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 12 ),
+    PifFeatureAVX512VPOPCNTDQ   = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 14 ),
+    PifFeatureRDPID             = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 22 ),
+    PifFeatureSGXLC             = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Ecx, 30 ),
+
+    PifFeatureAMXBF16           = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Edx, 22 ),
+    PifFeatureAMXTILE           = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Edx, 24 ),
+    PifFeatureAMXINT8           = PIF_FEATURE_ID( PifFeatureWord_00000007h_0_Edx, 25 ),
+
+    PifFeatureXSAVEOPT          = PIF_FEATURE_ID( PifFeatureWord_0000000Dh_1_Eax, 0 ),
+    PifFeatureXSAVEC            = PIF_FEATURE_ID( PifFeatureWord_0000000Dh_1_Eax, 1 ),
+    PifFeatureXSAVES            = PIF_FEATURE_ID( PifFeatureWord_0000000Dh_1_Eax, 3 ),
+
+    PifFeatureLAHF_LM           = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 0 ),
+    PifFeatureSVM               = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 2 ),
+    PifFeatureABM               = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 5 ),
+    PifFeatureSSE4a             = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 6 ),
+    PifFeatureMisalignedSSE     = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 7 ),
+    PifFeaturePRFCHW            = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 8 ),
+    PifFeatureXOP               = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 11 ),
+    PifFeatureSKINIT            = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 12 ),
+    PifFeatureFMA4              = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 16 ),
+    PifFeatureTCE               = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 17 ),
+    PifFeatureTBM               = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 21 ),
+    PifFeatureDBX               = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 26 ),
+    PifFeatureMONITORX          = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Ecx, 29 ),
+
+    PifFeatureSYSCALL           = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Edx, 11 ),
+    PifFeatureMTRR              = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Edx, 12 ),
+    PifFeatureNOEXECUTE         = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Edx, 20 ),
+    PifFeatureMMXEXT            = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Edx, 22 ),
+    PifFeatureRDTSCP            = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Edx, 27 ),
+    PifFeatureLONGMODE          = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Edx, 29 ),
+    PifFeature3DNOWEXT          = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Edx, 30 ),
+    PifFeature3DNOW             = PIF_FEATURE_ID( PifFeatureWord_80000001h_0_Edx, 31 ),
+
+    PifFeatureMWAIT             = PifFeatureMONITOR,
+    PifFeatureFXSAVE            = PifFeatureFXSR,
+    PifFeatureBMI               = PifFeatureBMI1,
+    PifFeatureAVX512VBMI        = PifFeatureAVX512VBMI1,
+    PifFeatureLZCNT             = PifFeatureABM,
+    PifFeatureSSE4A             = PifFeatureSSE4a,
+    PifFeaturePREFETCHW         = PifFeaturePRFCHW,
+    PifFeatureMWAITX            = PifFeatureMONITORX,
+} PIF_FEATURE;
+
+//
+// Features guaranteed by the compilation target. Code built with -march or
+// /arch flags cannot run without them, so checks against them fold to TRUE.
+//
+#if defined(__x86_64__) || defined(_M_X64) || defined(_M_AMD64)
+#define PIF_BASELINE_X64    1
+#else
+#define PIF_BASELINE_X64    0
+#endif
+
+#define PIF_BASELINE_IF(Cond, Flag) ((Cond) ? (Flag) : 0)
+
+#if defined(__SSE3__)
+#define PIF_BASELINE_SSE3 1
+#else
+#define PIF_BASELINE_SSE3 0
+#endif
+#if defined(__SSSE3__)
+#define PIF_BASELINE_SSSE3 1
+#else
+#define PIF_BASELINE_SSSE3 0
+#endif
+#if defined(__SSE4_1__)
+#define PIF_BASELINE_SSE41 1
+#else
+#define PIF_BASELINE_SSE41 0
+#endif
+#if defined(__SSE4_2__)
+#define PIF_BASELINE_SSE42 1
+#else
+#define PIF_BASELINE_SSE42 0
+#endif
+#if defined(__POPCNT__)
+#define PIF_BASELINE_POPCNT 1
+#else
+#define PIF_BASELINE_POPCNT 0
+#endif
+#if defined(__PCLMUL__)
+#define PIF_BASELINE_PCLMUL 1
+#else
+#define PIF_BASELINE_PCLMUL 0
+#endif
+#if defined(__AES__)
+#define PIF_BASELINE_AES 1
+#else
+#define PIF_BASELINE_AES 0
+#endif
+#if defined(__MOVBE__)
+#define PIF_BASELINE_MOVBE 1
+#else
+#define PIF_BASELINE_MOVBE 0
+#endif
+#if defined(__XSAVE__)
+#define PIF_BASELINE_XSAVE 1
+#else
+#define PIF_BASELINE_XSAVE 0
+#endif
+#if defined(__AVX__)
+#define PIF_BASELINE_AVX 1
+#else
+#define PIF_BASELINE_AVX 0
+#endif
+#if defined(__F16C__)
+#define PIF_BASELINE_F16C 1
+#else
+#define PIF_BASELINE_F16C 0
+#endif
+#if defined(__FMA__)
+#define PIF_BASELINE_FMA 1
+#else
+#define PIF_BASELINE_FMA 0
+#endif
+#if defined(__RDRND__)
+#define PIF_BASELINE_RDRND 1
+#else
+#define PIF_BASELINE_RDRND 0
+#endif
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+#define PIF_BASELINE_CX16 1
+#else
+#define PIF_BASELINE_CX16 0
+#endif
+#if defined(__SSE2__) || PIF_BASELINE_X64 || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIF_BASELINE_SSE2 1
+#else
+#define PIF_BASELINE_SSE2 0
+#endif
+#if defined(__SSE__) || PIF_BASELINE_SSE2 || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PIF_BASELINE_SSE 1
+#else
+#define PIF_BASELINE_SSE 0
+#endif
+#if defined(__MMX__) || PIF_BASELINE_X64
+#define PIF_BASELINE_MMX 1
+#else
+#define PIF_BASELINE_MMX 0
+#endif
+#if defined(__BMI__)
+#define PIF_BASELINE_BMI 1
+#else
+#define PIF_BASELINE_BMI 0
+#endif
+#if defined(__BMI2__)
+#define PIF_BASELINE_BMI2 1
+#else
+#define PIF_BASELINE_BMI2 0
+#endif
+#if defined(__AVX2__)
+#define PIF_BASELINE_AVX2 1
+#else
+#define PIF_BASELINE_AVX2 0
+#endif
+#if defined(__AVX512F__)
+#define PIF_BASELINE_AVX512F 1
+#else
+#define PIF_BASELINE_AVX512F 0
+#endif
+#if defined(__AVX512DQ__)
+#define PIF_BASELINE_AVX512DQ 1
+#else
+#define PIF_BASELINE_AVX512DQ 0
+#endif
+#if defined(__AVX512CD__)
+#define PIF_BASELINE_AVX512CD 1
+#else
+#define PIF_BASELINE_AVX512CD 0
+#endif
+#if defined(__AVX512BW__)
+#define PIF_BASELINE_AVX512BW 1
+#else
+#define PIF_BASELINE_AVX512BW 0
+#endif
+#if defined(__AVX512VL__)
+#define PIF_BASELINE_AVX512VL 1
+#else
+#define PIF_BASELINE_AVX512VL 0
+#endif
+#if defined(__AVX512IFMA__)
+#define PIF_BASELINE_AVX512IFMA 1
+#else
+#define PIF_BASELINE_AVX512IFMA 0
+#endif
+#if defined(__AVX512VBMI__)
+#define PIF_BASELINE_AVX512VBMI 1
+#else
+#define PIF_BASELINE_AVX512VBMI 0
+#endif
+#if defined(__AVX512VBMI2__)
+#define PIF_BASELINE_AVX512VBMI2 1
+#else
+#define PIF_BASELINE_AVX512VBMI2 0
+#endif
+#if defined(__AVX512VNNI__)
+#define PIF_BASELINE_AVX512VNNI 1
+#else
+#define PIF_BASELINE_AVX512VNNI 0
+#endif
+#if defined(__AVX512BITALG__)
+#define PIF_BASELINE_AVX512BITALG 1
+#else
+#define PIF_BASELINE_AVX512BITALG 0
+#endif
+#if defined(__AVX512VPOPCNTDQ__)
+#define PIF_BASELINE_AVX512VPOPCNTDQ 1
+#else
+#define PIF_BASELINE_AVX512VPOPCNTDQ 0
+#endif
+#if defined(__GFNI__)
+#define PIF_BASELINE_GFNI 1
+#else
+#define PIF_BASELINE_GFNI 0
+#endif
+#if defined(__VAES__)
+#define PIF_BASELINE_VAES 1
+#else
+#define PIF_BASELINE_VAES 0
+#endif
+#if defined(__VPCLMULQDQ__)
+#define PIF_BASELINE_VPCLMULQDQ 1
+#else
+#define PIF_BASELINE_VPCLMULQDQ 0
+#endif
+#if defined(__RDSEED__)
+#define PIF_BASELINE_RDSEED 1
+#else
+#define PIF_BASELINE_RDSEED 0
+#endif
+#if defined(__ADX__)
+#define PIF_BASELINE_ADX 1
+#else
+#define PIF_BASELINE_ADX 0
+#endif
+#if defined(__SHA__)
+#define PIF_BASELINE_SHA 1
+#else
+#define PIF_BASELINE_SHA 0
+#endif
+#if defined(__FSGSBASE__)
+#define PIF_BASELINE_FSGSBASE 1
+#else
+#define PIF_BASELINE_FSGSBASE 0
+#endif
+#if defined(__XSAVEOPT__)
+#define PIF_BASELINE_XSAVEOPT 1
+#else
+#define PIF_BASELINE_XSAVEOPT 0
+#endif
+#if defined(__XSAVEC__)
+#define PIF_BASELINE_XSAVEC 1
+#else
+#define PIF_BASELINE_XSAVEC 0
+#endif
+#if defined(__XSAVES__)
+#define PIF_BASELINE_XSAVES 1
+#else
+#define PIF_BASELINE_XSAVES 0
+#endif
+#if defined(__LZCNT__)
+#define PIF_BASELINE_LZCNT 1
+#else
+#define PIF_BASELINE_LZCNT 0
+#endif
+#if defined(__PRFCHW__)
+#define PIF_BASELINE_PRFCHW 1
+#else
+#define PIF_BASELINE_PRFCHW 0
+#endif
+#if defined(__SSE4A__)
+#define PIF_BASELINE_SSE4A 1
+#else
+#define PIF_BASELINE_SSE4A 0
+#endif
+#if defined(__FMA4__)
+#define PIF_BASELINE_FMA4 1
+#else
+#define PIF_BASELINE_FMA4 0
+#endif
+#if defined(__XOP__)
+#define PIF_BASELINE_XOP 1
+#else
+#define PIF_BASELINE_XOP 0
+#endif
+
+//
+// The first x64 parts lacked LAHF/SAHF in long mode; it is only guaranteed
+// from the x86-64-v2 level on.
+//
+#if PIF_BASELINE_X64 && PIF_BASELINE_CX16 && PIF_BASELINE_POPCNT && PIF_BASELINE_SSE3 && \
+    PIF_BASELINE_SSSE3 && PIF_BASELINE_SSE41 && PIF_BASELINE_SSE42 && defined(__LAHF_SAHF__)
+#define PIF_BASELINE_X64_V2 1
+#else
+#define PIF_BASELINE_X64_V2 0
+#endif
+
+#define PIF_BASELINE_00000001h_0_Ecx ( \
+    PIF_BASELINE_IF( PIF_BASELINE_SSE3, X86_FEATURE_SSE3 ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_PCLMUL, X86_FEATURE_PCLMULQDQ ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_SSSE3, X86_FEATURE_SSSE3 ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_FMA, X86_FEATURE_FMA ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_CX16, X86_FEATURE_CMPXCHG16B ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_SSE41, X86_FEATURE_SSE41 ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_SSE42, X86_FEATURE_SSE42 ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_MOVBE, X86_FEATURE_MOVBE ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_POPCNT, X86_FEATURE_POPCNT ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AES, X86_FEATURE_AES ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_XSAVE, X86_FEATURE_XSAVE ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX, X86_FEATURE_AVX ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_F16C, X86_FEATURE_F16C ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_RDRND, X86_FEATURE_RDRND ))
+
+#define PIF_BASELINE_00000001h_0_Edx ( \
+    PIF_BASELINE_IF( PIF_BASELINE_X64, X86_FEATURE_FPU | X86_FEATURE_CMPXCHG8B | X86_FEATURE_CMOV | X86_FEATURE_FXSR ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_MMX, X86_FEATURE_MMX ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_SSE, X86_FEATURE_SSE ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_SSE2, X86_FEATURE_SSE2 ))
+
+#define PIF_BASELINE_00000007h_0_Ebx ( \
+    PIF_BASELINE_IF( PIF_BASELINE_FSGSBASE, X86_FEATURE_FSGSBASE ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_BMI, X86_FEATURE_BMI1 ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX2, X86_FEATURE_AVX2 ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_BMI2, X86_FEATURE_BMI2 ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX512F, X86_FEATURE_AVX512F ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX512DQ, X86_FEATURE_AVX512DQ ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_RDSEED, X86_FEATURE_RDSEED ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_ADX, X86_FEATURE_ADX ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX512IFMA, X86_FEATURE_AVX512IFMA ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX512CD, X86_FEATURE_AVX512CD ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_SHA, X86_FEATURE_SHA ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX512BW, X86_FEATURE_AVX512BW ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX512VL, X86_FEATURE_AVX512VL ))
+
+#define PIF_BASELINE_00000007h_0_Ecx ( \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX512VBMI, X86_FEATURE_AVX512VBMI1 ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX512VBMI2, X86_FEATURE_AVX512VBMI2 ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_GFNI, X86_FEATURE_GFNI ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_VAES, X86_FEATURE_VAES ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_VPCLMULQDQ, X86_FEATURE_VPCLMULQDQ ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX512VNNI, X86_FEATURE_AVX512VNNI ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX512BITALG, X86_FEATURE_AVX512BITALG ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_AVX512VPOPCNTDQ, X86_FEATURE_AVX512VPOPCNTDQ ))
+
+#define PIF_BASELINE_0000000Dh_1_Eax ( \
+    PIF_BASELINE_IF( PIF_BASELINE_XSAVEOPT, X86_FEATURE_XSAVEOPT ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_XSAVEC, X86_FEATURE_XSAVEC ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_XSAVES, X86_FEATURE_XSAVES ))
+
+#define PIF_BASELINE_80000001h_0_Ecx ( \
+    PIF_BASELINE_IF( PIF_BASELINE_X64_V2, X86_FEATURE_LAHF_LM ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_LZCNT, X86_FEATURE_LZCNT ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_SSE4A, X86_FEATURE_SSE4A ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_PRFCHW, X86_FEATURE_PRFCHW ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_XOP, X86_FEATURE_XOP ) | \
+    PIF_BASELINE_IF( PIF_BASELINE_FMA4, X86_FEATURE_FMA4 ))
+
+#define PIF_BASELINE_80000001h_0_Edx ( \
+    PIF_BASELINE_IF( PIF_BASELINE_X64, X86_FEATURE_SEPEXT | X86_FEATURE_NOEXECUTE | X86_FEATURE_LONGMODE ))
+
+/**
+ * Baseline word of a PIF_FEATURE_WORD. Folds to a constant for constant words.
+ */
+#define PIF_BASELINE_WORD(Word) ((UINT32)( \
+    (Word) == PifFeatureWord_00000001h_0_Ecx ? PIF_BASELINE_00000001h_0_Ecx : \
+    (Word) == PifFeatureWord_00000001h_0_Edx ? PIF_BASELINE_00000001h_0_Edx : \
+    (Word) == PifFeatureWord_00000007h_0_Ebx ? PIF_BASELINE_00000007h_0_Ebx : \
+    (Word) == PifFeatureWord_00000007h_0_Ecx ? PIF_BASELINE_00000007h_0_Ecx : \
+    (Word) == PifFeatureWord_0000000Dh_1_Eax ? PIF_BASELINE_0000000Dh_1_Eax : \
+    (Word) == PifFeatureWord_80000001h_0_Ecx ? PIF_BASELINE_80000001h_0_Ecx : \
+    (Word) == PifFeatureWord_80000001h_0_Edx ? PIF_BASELINE_80000001h_0_Edx : 0))
+
+#define PIF_BASELINE_HAS(Id) \
+    ((PIF_BASELINE_WORD( PIF_FEATURE_WORD_OF( Id ) ) & PIF_FEATURE_MASK( Id )) != 0)
+
+//
+// Single feature tests. The baseline test is a constant, so features implied
+// by the build target never touch memory.
+//
+#define PIF_FEATURES_HAS(Features, Id) \
+    (((Features).Words[PIF_FEATURE_WORD_OF( Id )] & PIF_FEATURE_MASK( Id )) != 0)
+
+//
+// PIF_AUTO_INIT builds make sure the snapshot exists before reading it, so a
+// test that runs before the library constructor cannot see zeroed words.
+//
+#if defined(PIF_AUTO_INIT)
+#define PIF_ENSURE_INITIALIZED()    PifEnsureInitializedFast( )
+#else
+#define PIF_ENSURE_INITIALIZED()    ((VOID)0)
+#endif
+
+#define PIF_HAS(Id) \
+    ((BOOLEAN)(PIF_BASELINE_HAS( Id ) || \
+               (PIF_ENSURE_INITIALIZED( ), PIF_FEATURES_HAS( PifFeatures, Id ))))
+
+#define PIF_USABLE(Id) \
+    ((BOOLEAN)(PIF_BASELINE_HAS( Id ) || \
+               (PIF_ENSURE_INITIALIZED( ), PIF_FEATURES_HAS( PifUsableFeatures, Id ))))
+
+/**
+ * Returns the name of a feature ID (the Has* macro suffix), or NULL.
+ */
+PCSTR
+PIFAPI
+PifGetFeatureName(
+    IN UINT32 Id
+    );
+
+/**
+ * Looks up a feature ID by name, ignoring case.
+ */
+STATUS
+PIFAPI
+PifFindFeature(
+    IN CONST CHAR *Name,
+    OUT UINT32 *Id
+    );
+
+/**
+ * Fills Features with the compile-time baseline.
+ */
+FORCEINLINE
+VOID
+PifFeaturesBaseline(
+    OUT PPIF_FEATURES Features
+)
+{
+    UINT32 Index;
+
+    for (Index = 0; Index < PIF_FEATURE_WORDS; ++Index)
+    {
+        Features->Words[Index] = PIF_BASELINE_WORD( Index );
+    }
+}
+
+FORCEINLINE
+VOID
+PifFeaturesSet(
+    IN OUT PPIF_FEATURES Features,
+    IN UINT32 Id
+)
+{
+    Features->Words[PIF_FEATURE_WORD_OF( Id )] |= PIF_FEATURE_MASK( Id );
+}
+
+FORCEINLINE
+VOID
+PifFeaturesClear(
+    IN OUT PPIF_FEATURES Features,
+    IN UINT32 Id
+)
+{
+    Features->Words[PIF_FEATURE_WORD_OF( Id )] &= ~PIF_FEATURE_MASK( Id );
+}
+
+FORCEINLINE
+BOOLEAN
+PifFeaturesTest(
+    IN CONST PIF_FEATURES *Features,
+    IN UINT32 Id
+)
+{
+    return (BOOLEAN)PIF_FEATURES_HAS( *Features, Id );
+}
+
+/**
+ * Returns TRUE if every feature of Subset is in Set. The loop has a fixed
+ * trip count over one cache line, so compilers reduce it to a few vector
+ * compares.
+ */
+FORCEINLINE
+BOOLEAN
+PifFeaturesIsSubset(
+    IN CONST PIF_FEATURES *Subset,
+    IN CONST PIF_FEATURES *Set
+)
+{
+    UINT32 Missing = 0;
+    UINT32 Index;
+
+    for (Index = 0; Index < PIF_FEATURE_WORDS; ++Index)
+    {
+        Missing |= Subset->Words[Index] & ~Set->Words[Index];
+    }
+
+    return (BOOLEAN)(Missing == 0);
+}
+
+FORCEINLINE
+BOOLEAN
+PifFeaturesIsEqual(
+    IN CONST PIF_FEATURES *Left,
+    IN CONST PIF_FEATURES *Right
+)
+{
+    UINT32 Different = 0;
+    UINT32 Index;
+
+    for (Index = 0; Index < PIF_FEATURE_WORDS; ++Index)
+    {
+        Different |= Left->Words[Index] ^ Right->Words[Index];
+    }
+
+    return (BOOLEAN)(Different == 0);
+}
+
+FORCEINLINE
+VOID
+PifFeaturesIntersect(
+    OUT PPIF_FEATURES Result,
+    IN CONST PIF_FEATURES *Left,
+    IN CONST PIF_FEATURES *Right
+)
+{
+    UINT32 Index;
+
+    for (Index = 0; Index < PIF_FEATURE_WORDS; ++Index)
+    {
+        Result->Words[Index] = Left->Words[Index] & Right->Words[Index];
+    }
+}
+
+FORCEINLINE
+VOID
+PifFeaturesUnion(
+    OUT PPIF_FEATURES Result,
+    IN CONST PIF_FEATURES *Left,
+    IN CONST PIF_FEATURES *Right
+)
+{
+    UINT32 Index;
+
+    for (Index = 0; Index < PIF_FEATURE_WORDS; ++Index)
+    {
+        Result->Words[Index] = Left->Words[Index] | Right->Words[Index];
+    }
+}
+
+/**
+ * Result = Left \ Right, the features of Left missing from Right.
+ */
+FORCEINLINE
+VOID
+PifFeaturesDifference(
+    OUT PPIF_FEATURES Result,
+    IN CONST PIF_FEATURES *Left,
+    IN CONST PIF_FEATURES *Right
+)
+{
+    UINT32 Index;
+
+    for (Index = 0; Index < PIF_FEATURE_WORDS; ++Index)
+    {
+        Result->Words[Index] = Left->Words[Index] & ~Right->Words[Index];
+    }
+}
+
+FORCEINLINE
+UINT32
+PifFeaturesPopCount(
+    IN CONST PIF_FEATURES *Features
+)
+{
+    UINT32 Count = 0;
+    UINT32 Index;
+#if !defined(__GNUC__) && !defined(__clang__)
+    UINT32 Word;
+#endif
+
+    for (Index = 0; Index < PIF_FEATURE_WORDS; ++Index)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        Count += (UINT32)__builtin_popcount( Features->Words[Index] );
+#else
+        for (Word = Features->Words[Index]; Word != 0; Word &= Word - 1)
+        {
+            ++Count;
+        }
+#endif
+    }
+
+    return Count;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_FEATURES_H_
@@ -0,0 +1,84 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file fleet.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#ifndef _PIF_FLEET_H_
+#define _PIF_FLEET_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Feature algebra over a pool of nodes, each described by its usable feature
+ * set (typically loaded from a snapshot with PifLoadSnapshotFeatures).
+ */
+typedef struct _PIF_FLEET_SUMMARY {
+    PIF_FEATURES Common;        //!< Usable on every node, the lowest common denominator
+    PIF_FEATURES Any;           //!< Usable on at least one node
+    PIF_X86_64_LEVEL Level;     //!< x86-64 level of Common
+    UINT32 NodeCount;
+} PIF_FLEET_SUMMARY, *PPIF_FLEET_SUMMARY;
+
+/**
+ * Reads the usable feature set of a snapshot file.
+ */
+STATUS
+PIFAPI
+PifLoadSnapshotFeatures(
+    IN PCSTR Path,
+    OUT PPIF_FEATURES Features
+    );
+
+/**
+ * Computes the features common to all nodes, the features of any node and
+ * the x86-64 level of the common set.
+ */
+STATUS
+PIFAPI
+PifFleetSummarize(
+    IN CONST PIF_FEATURES *Nodes,
+    IN UINT32 NodeCount,
+    OUT PPIF_FLEET_SUMMARY Summary
+    );
+
+/**
+ * Finds the nodes lacking any feature of Target, i.e. the nodes a job built
+ * for Target, or a VM migrating from a node with Target, cannot run on.
+ * Their indices are written to Blockers in ascending order, up to
+ * MaxBlockers; BlockerCount always receives the total number of blockers.
+ */
+STATUS
+PIFAPI
+PifFleetFindBlockers(
+    IN CONST PIF_FEATURES *Nodes,
+    IN UINT32 NodeCount,
+    IN CONST PIF_FEATURES *Target,
+    OUT UINT32 *Blockers OPTIONAL,
+    IN UINT32 MaxBlockers,
+    OUT UINT32 *BlockerCount
+    );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_FLEET_H_
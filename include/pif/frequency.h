@@ -0,0 +1,163 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file frequency.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#ifndef _PIF_FREQUENCY_H_
+#define _PIF_FREQUENCY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Base (non-turbo) frequency in MHz from leaf 0x16, or from the TSC to
+ * crystal ratio of leaf 0x15 when leaf 0x16 is absent. Returns E_NOTFOUND
+ * when neither leaf reports it.
+ */
+STATUS
+PIFAPI
+PifContextGetBaseFrequency(
+    IN PCPIF_CONTEXT Context,
+    OUT UINT32 *BaseMhz
+    );
+
+STATUS
+PIFAPI
+PifGetBaseFrequency(
+    OUT UINT32 *BaseMhz
+    );
+
+/**
+ * Effective frequency of one processor over one sampling interval, from the
+ * APERF, MPERF and TSC deltas.
+ */
+typedef struct _PIF_FREQUENCY_SAMPLE {
+    UINT32 Cpu;
+    UINT32 EffectiveMhz;    //!< Average clock while not halted, 0 if MPERF did not advance
+    UINT32 BusyPermille;    //!< Share of the interval spent in C0, 0-1000
+    UINT32 Reserved;
+    UINT64 Time;            //!< CLOCK_MONOTONIC nanoseconds at the end of the interval
+    UINT64 AperfDelta;
+    UINT64 MperfDelta;
+    UINT64 TscDelta;
+} PIF_FREQUENCY_SAMPLE, *PPIF_FREQUENCY_SAMPLE;
+
+/**
+ * Samples APERF/MPERF of a set of processors through an MSR device and
+ * publishes one PIF_FREQUENCY_SAMPLE per processor per interval into a
+ * single-producer, single-consumer ring. Samples are dropped, and counted,
+ * when the ring is full.
+ */
+typedef struct _PIF_FREQUENCY_SAMPLER PIF_FREQUENCY_SAMPLER, *PPIF_FREQUENCY_SAMPLER;
+
+/**
+ * Creates a sampler for Cpus, or for every processor of Device when Cpus is
+ * NULL. Context must report APERF/MPERF (leaf 0x06), otherwise E_FEATURE is
+ * returned. The base frequency is taken from the context, falling back to
+ * MSR_PLATFORM_INFO on Intel; when neither reports it (AMD), the effective
+ * frequency is scaled by the TSC rate measured over each interval instead.
+ * Capacity is rounded up to a power of two.
+ * Device must outlive the sampler.
+ */
+STATUS
+PIFAPI
+PifCreateFrequencySampler(
+    IN PCPIF_CONTEXT Context,
+    IN PPIF_MSR_DEVICE Device,
+    IN CONST UINT32 *Cpus OPTIONAL,
+    IN UINT32 CpuCount,
+    IN UINT32 Capacity,
+    OUT PPIF_FREQUENCY_SAMPLER *Sampler
+    );
+
+/**
+ * Stops the sampling thread, if started, and frees the sampler.
+ */
+VOID
+PIFAPI
+PifDestroyFrequencySampler(
+    IN PPIF_FREQUENCY_SAMPLER Sampler OPTIONAL
+    );
+
+/**
+ * Takes one sample of every processor from the calling thread, for callers
+ * that drive their own interval. The first call only records the baseline.
+ * Returns E_BUSY while the sampling thread is running.
+ */
+STATUS
+PIFAPI
+PifSampleFrequency(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+    );
+
+/**
+ * Starts a thread that samples every IntervalMs milliseconds.
+ */
+STATUS
+PIFAPI
+PifStartFrequencySampler(
+    IN PPIF_FREQUENCY_SAMPLER Sampler,
+    IN UINT32 IntervalMs
+    );
+
+VOID
+PIFAPI
+PifStopFrequencySampler(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+    );
+
+/**
+ * Moves up to MaxSamples of the oldest samples out of the ring. Only one
+ * thread may read at a time.
+ */
+STATUS
+PIFAPI
+PifReadFrequencySamples(
+    IN PPIF_FREQUENCY_SAMPLER Sampler,
+    OUT PPIF_FREQUENCY_SAMPLE Samples,
+    IN UINT32 MaxSamples,
+    OUT UINT32 *SampleCount
+    );
+
+/**
+ * Base frequency the effective frequency is scaled from, 0 if unknown and
+ * the measured TSC rate is used instead.
+ */
+UINT32
+PIFAPI
+PifGetFrequencySamplerBaseMhz(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+    );
+
+/**
+ * Number of samples dropped because the ring was full.
+ */
+UINT32
+PIFAPI
+PifGetFrequencySamplerDropped(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+    );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_FREQUENCY_H_
@@ -0,0 +1,142 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file hypervisor.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#ifndef _PIF_HYPERVISOR_H_
+#define _PIF_HYPERVISOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Hypervisor identified from the signature of the hypervisor leaf range.
+ */
+typedef enum _PIF_HYPERVISOR {
+    PifHypervisorNone = 0,      //!< Not running as a guest
+    PifHypervisorUnknown,       //!< Guest of a hypervisor with an unknown signature
+    PifHypervisorKvm,
+    PifHypervisorHyperV,
+    PifHypervisorXen,
+    PifHypervisorVmware,
+    PifHypervisorBhyve,
+    PifHypervisorQemuTcg,
+    PifHypervisorVirtualBox,
+    PifHypervisorParallels,
+    PifHypervisorAcrn,
+    PifHypervisorMax
+} PIF_HYPERVISOR;
+
+//
+// Decoded hypervisor capabilities.
+//
+#define PIF_HV_INVARIANT_TSC            0x0001  // Leaf 0x80000007 reports an invariant TSC to the guest
+#define PIF_HV_TSC_EMULATED             0x0002  // RDTSC exits to the hypervisor (Xen vtsc)
+#define PIF_HV_KVM_CLOCK                0x0004  // KVM pvclock MSRs
+#define PIF_HV_KVM_CLOCK_STABLE         0x0008  // kvmclock is synchronized across vCPUs
+#define PIF_HV_KVM_STEAL_TIME           0x0010
+#define PIF_HV_KVM_REALTIME             0x0020  // vCPUs are never preempted
+#define PIF_HV_REFERENCE_COUNTER        0x0040  // Hyper-V partition reference counter MSR
+#define PIF_HV_REFERENCE_TSC            0x0080  // Hyper-V reference TSC page
+#define PIF_HV_FREQUENCY_MSRS           0x0100  // Hyper-V TSC and APIC frequency MSRs
+#define PIF_HV_TSC_INVARIANT_CONTROL    0x0200  // Hyper-V guest can enable an invariant TSC
+
+/**
+ * Hypervisor identification and capabilities.
+ */
+typedef struct _PIF_HYPERVISOR_INFO {
+    PIF_HYPERVISOR Hypervisor;
+    CHAR Signature[16];         //!< Signature at BaseLeaf, NUL terminated
+    UINT32 BaseLeaf;            //!< Base of the decoded range, 0x40000000-0x40010000, 0 if none
+    UINT32 MaxLeaf;             //!< Highest leaf of the hypervisor range
+    UINT32 Flags;               //!< PIF_HV_* capabilities
+    UINT32 VersionMajor;        //!< Hyper-V and Xen, otherwise 0
+    UINT32 VersionMinor;
+    UINT32 TscFrequencyKhz;     //!< Timing leaf (BaseLeaf + 0x10) or the Xen time leaf, 0 if not reported
+    UINT32 ApicFrequencyKhz;    //!< Timing leaf, 0 if not reported
+} PIF_HYPERVISOR_INFO, *PPIF_HYPERVISOR_INFO;
+
+/**
+ * Clocks a timing routine can read, cheapest first.
+ */
+typedef enum _PIF_CLOCK_SOURCE {
+    PifClockSourceTsc = 0,      //!< RDTSC directly
+    PifClockSourceKvmClock,     //!< KVM pvclock page
+    PifClockSourceHyperVTsc,    //!< Hyper-V reference TSC page
+    PifClockSourceOs,           //!< clock_gettime or QueryPerformanceCounter
+} PIF_CLOCK_SOURCE;
+
+/**
+ * Decodes the hypervisor range captured in a context. Hypervisor is
+ * PifHypervisorNone on bare metal.
+ */
+STATUS
+PIFAPI
+PifContextGetHypervisorInfo(
+    IN PCPIF_CONTEXT Context,
+    OUT PPIF_HYPERVISOR_INFO Info
+    );
+
+STATUS
+PIFAPI
+PifGetHypervisorInfo(
+    OUT PPIF_HYPERVISOR_INFO Info
+    );
+
+/**
+ * Returns the cheapest clock that stays monotonic and synchronized across
+ * processors: the TSC when it is invariant and not emulated, otherwise the
+ * paravirtual clock of the hypervisor when it is stable, otherwise the OS.
+ */
+PIF_CLOCK_SOURCE
+PIFAPI
+PifContextGetPreferredClockSource(
+    IN PCPIF_CONTEXT Context
+    );
+
+PIF_CLOCK_SOURCE
+PIFAPI
+PifGetPreferredClockSource(
+    VOID
+    );
+
+/**
+ * Returns the name of a hypervisor, or NULL.
+ */
+PCSTR
+PIFAPI
+PifGetHypervisorName(
+    IN PIF_HYPERVISOR Hypervisor
+    );
+
+/**
+ * Returns the name of a clock source, or NULL.
+ */
+PCSTR
+PIFAPI
+PifGetClockSourceName(
+    IN PIF_CLOCK_SOURCE ClockSource
+    );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_HYPERVISOR_H_
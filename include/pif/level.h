@@ -0,0 +1,107 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file level.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#ifndef _PIF_LEVEL_H_
+#define _PIF_LEVEL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * x86-64 psABI micro-architecture levels. Each level includes the previous.
+ */
+typedef enum _PIF_X86_64_LEVEL {
+    PifX86_64LevelNone = 0,     //!< Not a 64-bit capable processor
+    PifX86_64LevelV1 = 1,       //!< Baseline: CMOV, CX8, FPU, FXSR, MMX, SCE, SSE, SSE2
+    PifX86_64LevelV2 = 2,       //!< + CX16, LAHF-SAHF, POPCNT, SSE3, SSE4.1, SSE4.2, SSSE3
+    PifX86_64LevelV3 = 3,       //!< + AVX, AVX2, BMI1, BMI2, F16C, FMA, LZCNT, MOVBE, OSXSAVE
+    PifX86_64LevelV4 = 4,       //!< + AVX512F, AVX512BW, AVX512CD, AVX512DQ, AVX512VL
+    PifX86_64LevelMax = PifX86_64LevelV4
+} PIF_X86_64_LEVEL;
+
+/**
+ * Returns the features required by a level, including lower levels.
+ */
+STATUS
+PIFAPI
+PifGetLevelFeatures(
+    IN PIF_X86_64_LEVEL Level,
+    OUT PPIF_FEATURES Features
+    );
+
+/**
+ * Returns the highest level whose features are all present in Features.
+ */
+PIF_X86_64_LEVEL
+PIFAPI
+PifClassifyLevel(
+    IN CONST PIF_FEATURES *Features
+    );
+
+/**
+ * Returns the highest level supported by this processor and enabled by the
+ * OS, classified from PifUsableFeatures. Requires PifInitialize.
+ */
+PIF_X86_64_LEVEL
+PIFAPI
+PifGetLevel(
+    VOID
+    );
+
+/**
+ * Returns the features of a level that are not usable on this processor.
+ * Missing is empty when the level is supported.
+ */
+STATUS
+PIFAPI
+PifGetMissingLevelFeatures(
+    IN PIF_X86_64_LEVEL Level,
+    OUT PPIF_FEATURES Missing
+    );
+
+/**
+ * Returns the psABI name of a level, e.g. "x86-64-v3".
+ */
+PCSTR
+PIFAPI
+PifGetLevelName(
+    IN PIF_X86_64_LEVEL Level
+    );
+
+/**
+ * Executes the best variant of a program for this processor. Variants are
+ * looked up in the glibc-hwcaps layout, Directory/x86-64-vN/Name from the
+ * supported level down to v2, then Directory/Name. Only returns on failure.
+ */
+STATUS
+PIFAPI
+PifExecBestVariant(
+    IN CONST CHAR *Directory,
+    IN CONST CHAR *Name,
+    IN CHAR *CONST *Argv
+    );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_LEVEL_H_
@@ -0,0 +1,121 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file msr.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#ifndef _PIF_MSR_H_
+#define _PIF_MSR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * User-mode MSR access through the Linux msr driver, which exposes every
+ * processor as /dev/cpu/N/msr with the MSR index as the file offset. Each
+ * processor's file is opened on first use and kept open until the device is
+ * closed. The handle may be shared between threads.
+ */
+typedef struct _PIF_MSR_DEVICE PIF_MSR_DEVICE, *PPIF_MSR_DEVICE;
+
+/**
+ * One MSR of a batch read.
+ */
+typedef struct _PIF_MSR_REQUEST {
+    UINT32 Msr;         //!< MSR index
+    STATUS Status;      //!< Result of reading this MSR
+    UINT64 Value;       //!< MSR value, 0 if the read failed
+} PIF_MSR_REQUEST, *PPIF_MSR_REQUEST;
+
+/**
+ * Opens the MSR files under Root, or /dev/cpu when Root is NULL. A fake tree
+ * of regular files laid out as Root/N/msr can stand in for the driver, each
+ * MSR being the 8 bytes at offset Msr * 8. Returns E_UNSUPPORTED on platforms
+ * without the msr driver.
+ */
+STATUS
+PIFAPI
+PifOpenMsrDevice(
+    IN PCSTR Root OPTIONAL,
+    OUT PPIF_MSR_DEVICE *Device
+    );
+
+VOID
+PIFAPI
+PifCloseMsrDevice(
+    IN PPIF_MSR_DEVICE Device OPTIONAL
+    );
+
+/**
+ * Number of processors under the device root, one more than the highest
+ * processor number found.
+ */
+UINT32
+PIFAPI
+PifGetMsrDeviceCpuCount(
+    IN PPIF_MSR_DEVICE Device
+    );
+
+/**
+ * Reads an MSR of one processor. Returns E_ACCESS without CAP_SYS_RAWIO,
+ * E_NOSUCHDRIVER when the msr driver is not loaded, E_NOSUCHDEVICE when the
+ * processor is offline and E_IO when the processor does not implement the
+ * MSR.
+ */
+STATUS
+PIFAPI
+PifReadMsr(
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN UINT32 Msr,
+    OUT UINT64 *Value
+    );
+
+/**
+ * Reads several MSRs of one processor in one pass over its file. Every
+ * request receives its own status, and the first failure, if any, is
+ * returned.
+ */
+STATUS
+PIFAPI
+PifReadMsrBatch(
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN OUT PPIF_MSR_REQUEST Requests,
+    IN UINT32 RequestCount
+    );
+
+/**
+ * Writes an MSR of one processor.
+ */
+STATUS
+PIFAPI
+PifWriteMsr(
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN UINT32 Msr,
+    IN UINT64 Value
+    );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_MSR_H_
@@ -0,0 +1,205 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file pmu.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#ifndef _PIF_PMU_H_
+#define _PIF_PMU_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Counters supported by the programming interface. Leaf 0x0A may report
+// more, which are left alone.
+//
+#define PIF_PMU_MAX_GENERAL_COUNTERS    8
+#define PIF_PMU_MAX_FIXED_COUNTERS      4
+
+/**
+ * Architectural performance events enumerated by leaf 0x0A EBX.
+ */
+typedef enum _PIF_PMU_EVENT {
+    PifPmuEventCoreCycles = 0,
+    PifPmuEventInstructionsRetired,
+    PifPmuEventReferenceCycles,
+    PifPmuEventLlcReferences,
+    PifPmuEventLlcMisses,
+    PifPmuEventBranchesRetired,
+    PifPmuEventBranchMissesRetired,
+    PifPmuEventTopdownSlots,
+    PifPmuEventMax
+} PIF_PMU_EVENT;
+
+//
+// Fixed-function counters, as RDPMC selectors. Each counts a single event.
+//
+#define PIF_PMU_FIXED_COUNTER(Index)    (0x40000000u | (Index))
+#define PIF_PMU_GENERAL_COUNTER(Index)  (Index)
+
+#define PIF_PMU_FIXED_INSTRUCTIONS      0   // Instructions retired
+#define PIF_PMU_FIXED_CORE_CYCLES       1   // Unhalted core cycles
+#define PIF_PMU_FIXED_REFERENCE_CYCLES  2   // Unhalted reference cycles, at the TSC rate
+#define PIF_PMU_FIXED_TOPDOWN_SLOTS     3
+
+/**
+ * Architectural performance monitoring capabilities from leaf 0x0A.
+ */
+typedef struct _PIF_PMU_INFO {
+    UINT32 Version;                 //!< Architectural performance monitoring version
+    UINT32 GeneralCounterCount;     //!< Programmable counters per logical processor
+    UINT32 GeneralCounterWidth;     //!< Bits
+    UINT32 FixedCounterCount;
+    UINT32 FixedCounterWidth;       //!< Bits
+    UINT32 FixedCounterMask;        //!< Bit n set if fixed counter n is implemented
+    UINT32 Events;                  //!< Bit n set if PIF_PMU_EVENT n is available
+} PIF_PMU_INFO, *PPIF_PMU_INFO;
+typedef CONST PIF_PMU_INFO *PCPIF_PMU_INFO;
+
+/**
+ * Decodes leaf 0x0A. Returns E_UNSUPPORTED when the processor does not
+ * implement architectural performance monitoring (AMD does not).
+ */
+STATUS
+PIFAPI
+PifContextGetPmuInfo(
+    IN PCPIF_CONTEXT Context,
+    OUT PPIF_PMU_INFO Info
+    );
+
+STATUS
+PIFAPI
+PifGetPmuInfo(
+    OUT PPIF_PMU_INFO Info
+    );
+
+PCSTR
+PIFAPI
+PifGetPmuEventName(
+    IN PIF_PMU_EVENT Event
+    );
+
+/**
+ * Event select and unit mask of an architectural event, as the low 16 bits of
+ * IA32_PERFEVTSELx. Returns 0 for an unknown event.
+ */
+UINT32
+PIFAPI
+PifGetPmuEventSelect(
+    IN PIF_PMU_EVENT Event
+    );
+
+//
+// Privilege levels counted.
+//
+#define PIF_PMU_COUNT_USER      0x0001
+#define PIF_PMU_COUNT_KERNEL    0x0002
+
+//
+// Take over counters that are already enabled, such as those of the NMI
+// watchdog or another profiler.
+//
+#define PIF_PMU_FORCE           0x0100
+
+/**
+ * Counters to program on a processor. General counter n counts
+ * GeneralEvents[n], an IA32_PERFEVTSELx value (for example from
+ * PifGetPmuEventSelect). Only its event select, unit mask, edge, invert and
+ * counter mask fields are used; USR and OS come from Flags.
+ */
+typedef struct _PIF_PMU_CONFIG {
+    UINT32 Flags;                   //!< PIF_PMU_COUNT_* and PIF_PMU_FORCE
+    UINT32 FixedMask;               //!< Fixed counters to enable
+    UINT32 GeneralCount;            //!< General counters to enable, from counter 0
+    UINT32 GeneralEvents[PIF_PMU_MAX_GENERAL_COUNTERS];
+} PIF_PMU_CONFIG, *PPIF_PMU_CONFIG;
+typedef CONST PIF_PMU_CONFIG *PCPIF_PMU_CONFIG;
+
+/**
+ * Zeroes and enables the configured counters of one processor through its
+ * MSRs. Counters that are already enabled are not touched and E_BUSY is
+ * returned, unless PIF_PMU_FORCE is set. The kernel's perf subsystem is not
+ * told, so it should not be using the same counters.
+ */
+STATUS
+PIFAPI
+PifProgramPmu(
+    IN PCPIF_PMU_INFO Info,
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN PCPIF_PMU_CONFIG Config
+    );
+
+/**
+ * Disables the counters of Config on one processor.
+ */
+STATUS
+PIFAPI
+PifReleasePmu(
+    IN PCPIF_PMU_INFO Info,
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN PCPIF_PMU_CONFIG Config
+    );
+
+/**
+ * Whether RDPMC may be executed in user mode without a perf event mapped,
+ * which Linux allows when /sys/bus/event_source/devices/cpu/rdpmc is 2.
+ * RDPMC faults otherwise.
+ */
+BOOLEAN
+PIFAPI
+PifIsRdpmcPermitted(
+    VOID
+    );
+
+/**
+ * Reads a counter selected by PIF_PMU_FIXED_COUNTER or
+ * PIF_PMU_GENERAL_COUNTER on the current processor.
+ */
+FORCEINLINE
+UINT64
+PifReadPmuCounter(
+    IN UINT32 Counter
+)
+{
+    return PifReadPmc( Counter );
+}
+
+/**
+ * Difference of two reads of a counter Width bits wide, across a wrap.
+ */
+FORCEINLINE
+UINT64
+PifPmuCounterDelta(
+    IN UINT64 Start,
+    IN UINT64 End,
+    IN UINT32 Width
+)
+{
+    return (Width >= 64) ? End - Start : (End - Start) & ((1ull << Width) - 1);
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_PMU_H_
@@ -0,0 +1,343 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file profiler.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#ifndef _PIF_PROFILER_H_
+#define _PIF_PROFILER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Region profiler. Threads bracket a region with PifProfilerBegin and
+ * PifProfilerEnd, which read the TSC and, where RDPMC is permitted and RDTSCP
+ * can detect migrations, the instructions retired and unhalted core cycles
+ * fixed counters. The deltas go into a ring owned by the thread, which a
+ * drainer aggregates into per-region statistics and a log2 histogram of TSC
+ * ticks.
+ *
+ * The fixed counters must have been enabled on every processor, for example
+ * with PifProgramPmu, or the counter deltas read as 0.
+ */
+typedef struct _PIF_PROFILER PIF_PROFILER, *PPIF_PROFILER;
+
+//
+// PifCreateProfiler flags.
+//
+#define PIF_PROFILER_TSC_ONLY           0x0001  // Do not read the counters even if RDPMC is permitted
+
+//
+// Measurement modes, chosen when the profiler is created.
+//
+#define PIF_PROFILER_MODE_COUNTERS      0x0001  // Instructions and cycles through RDPMC
+#define PIF_PROFILER_MODE_RDTSCP        0x0002  // RDTSCP, which also detects processor migration
+
+//
+// PIF_PROFILER_RECORD flags.
+//
+#define PIF_PROFILER_RECORD_MIGRATED    0x0001  // Ended on another processor, counter deltas are 0
+
+/**
+ * One measured region.
+ */
+typedef struct _PIF_PROFILER_RECORD {
+    UINT32 Region;
+    UINT32 Flags;               //!< PIF_PROFILER_RECORD_*
+    UINT64 Tsc;                 //!< TSC ticks
+    UINT64 Instructions;        //!< Instructions retired, 0 in TSC-only mode
+    UINT64 Cycles;              //!< Unhalted core cycles, 0 in TSC-only mode
+} PIF_PROFILER_RECORD, *PPIF_PROFILER_RECORD;
+typedef CONST PIF_PROFILER_RECORD *PCPIF_PROFILER_RECORD;
+
+/**
+ * Values read by PifProfilerBegin.
+ */
+typedef struct _PIF_PROFILER_MARK {
+    UINT64 Tsc;
+    UINT64 Instructions;
+    UINT64 Cycles;
+    UINT32 Cpu;                 //!< IA32_TSC_AUX, the processor number on Linux and Windows
+} PIF_PROFILER_MARK, *PPIF_PROFILER_MARK;
+
+/**
+ * A registered thread's single-producer, single-consumer ring. The owning
+ * thread writes Head and the drainer writes Tail, each on its own cache
+ * line. The producer re-reads Tail only when its cached copy says the ring
+ * is full.
+ */
+typedef struct _PIF_PROFILER_THREAD {
+    ALIGNED(SYSTEM_CACHE_ALIGNMENT_SIZE) volatile UINT32 Head;
+    UINT32 CachedTail;
+    UINT32 Mask;
+    UINT32 Mode;                //!< PIF_PROFILER_MODE_*
+    UINT64 CounterMask;         //!< Fixed counter width mask
+    PPIF_PROFILER_RECORD Records;
+    volatile UINT32 Dropped;    //!< Records lost to a full ring
+
+    ALIGNED(SYSTEM_CACHE_ALIGNMENT_SIZE) volatile UINT32 Tail;
+    volatile UINT32 Retired;    //!< Set by PifUnregisterProfilerThread
+    UINT32 CachedDropped;       //!< Dropped as of the last drain
+    PPIF_PROFILER Profiler;
+    struct _PIF_PROFILER_THREAD *Next;
+} PIF_PROFILER_THREAD, *PPIF_PROFILER_THREAD;
+
+#define PIF_PROFILER_HISTOGRAM_BUCKETS  64
+
+/**
+ * Aggregated statistics of one region. Histogram bucket n counts the regions
+ * that took [2^n, 2^(n+1)) TSC ticks, and bucket 0 also counts 0 ticks.
+ */
+typedef struct _PIF_PROFILER_STATS {
+    UINT64 Count;
+    UINT64 Migrated;            //!< Records without counter deltas
+    UINT64 Dropped;             //!< Records lost to full rings, across all regions
+    UINT64 TscSum;
+    UINT64 TscMin;
+    UINT64 TscMax;
+    UINT64 InstructionsSum;
+    UINT64 CyclesSum;
+    UINT64 Histogram[PIF_PROFILER_HISTOGRAM_BUCKETS];
+} PIF_PROFILER_STATS, *PPIF_PROFILER_STATS;
+typedef CONST PIF_PROFILER_STATS *PCPIF_PROFILER_STATS;
+
+/**
+ * Creates a profiler for regions 0 to RegionCount - 1, with rings of
+ * RingCapacity records (rounded up to a power of two) per thread. The
+ * counters are read when RDPMC is permitted and Context reports RDTSCP and
+ * fixed counters 0 and 1; otherwise only the TSC is.
+ */
+STATUS
+PIFAPI
+PifCreateProfiler(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Flags,
+    IN UINT32 RegionCount,
+    IN UINT32 RingCapacity,
+    OUT PPIF_PROFILER *Profiler
+    );
+
+/**
+ * Stops the drainer and frees the profiler and every thread's ring. No
+ * thread may still be measuring.
+ */
+VOID
+PIFAPI
+PifDestroyProfiler(
+    IN PPIF_PROFILER Profiler OPTIONAL
+    );
+
+/**
+ * PIF_PROFILER_MODE_* flags the profiler measures with.
+ */
+UINT32
+PIFAPI
+PifGetProfilerMode(
+    IN PPIF_PROFILER Profiler
+    );
+
+/**
+ * Allocates the calling thread's ring. The handle is only used by that
+ * thread.
+ */
+STATUS
+PIFAPI
+PifRegisterProfilerThread(
+    IN PPIF_PROFILER Profiler,
+    OUT PPIF_PROFILER_THREAD *Thread
+    );
+
+/**
+ * Releases a thread's ring once the drainer has consumed it.
+ */
+VOID
+PIFAPI
+PifUnregisterProfilerThread(
+    IN PPIF_PROFILER_THREAD Thread OPTIONAL
+    );
+
+/**
+ * Aggregates every queued record from the calling thread.
+ */
+STATUS
+PIFAPI
+PifDrainProfiler(
+    IN PPIF_PROFILER Profiler
+    );
+
+/**
+ * Starts a thread that drains every IntervalMs milliseconds.
+ */
+STATUS
+PIFAPI
+PifStartProfilerDrainer(
+    IN PPIF_PROFILER Profiler,
+    IN UINT32 IntervalMs
+    );
+
+VOID
+PIFAPI
+PifStopProfilerDrainer(
+    IN PPIF_PROFILER Profiler
+    );
+
+/**
+ * Copies the statistics aggregated so far for a region.
+ */
+STATUS
+PIFAPI
+PifGetProfilerStats(
+    IN PPIF_PROFILER Profiler,
+    IN UINT32 Region,
+    OUT PPIF_PROFILER_STATS Stats
+    );
+
+/**
+ * Upper bound, in TSC ticks, of the histogram bucket holding the given
+ * percentile (0-100), or 0 if the region has no records.
+ */
+UINT64
+PIFAPI
+PifGetProfilerPercentile(
+    IN PCPIF_PROFILER_STATS Stats,
+    IN UINT32 Percentile
+    );
+
+/**
+ * Starts measuring a region on the calling thread.
+ */
+FORCEINLINE
+VOID
+PifProfilerBegin(
+    IN PPIF_PROFILER_THREAD Thread,
+    OUT PPIF_PROFILER_MARK Mark
+)
+{
+    barrier( );
+
+    //
+    // The counters are read between the RDTSCP here and the one in
+    // PifProfilerEnd, so equal processor numbers mean both reads came from
+    // the same processor's counters.
+    //
+    if (likely( Thread->Mode & PIF_PROFILER_MODE_RDTSCP ))
+    {
+        Mark->Tsc = PifReadTscp( &Mark->Cpu );
+    }
+    else
+    {
+        Mark->Cpu = 0;
+        Mark->Tsc = PifReadTsc( );
+    }
+
+    if (likely( Thread->Mode & PIF_PROFILER_MODE_COUNTERS ))
+    {
+        Mark->Instructions = PifReadPmc( PIF_PMU_FIXED_COUNTER( PIF_PMU_FIXED_INSTRUCTIONS ) );
+        Mark->Cycles = PifReadPmc( PIF_PMU_FIXED_COUNTER( PIF_PMU_FIXED_CORE_CYCLES ) );
+    }
+    else
+    {
+        Mark->Instructions = 0;
+        Mark->Cycles = 0;
+    }
+
+    barrier( );
+}
+
+/**
+ * Ends a region started by PifProfilerBegin and queues its record. The
+ * record is dropped and counted when the ring is full.
+ */
+FORCEINLINE
+VOID
+PifProfilerEnd(
+    IN PPIF_PROFILER_THREAD Thread,
+    IN UINT32 Region,
+    IN CONST PIF_PROFILER_MARK *Mark
+)
+{
+    PPIF_PROFILER_RECORD Record;
+    UINT64 Tsc;
+    UINT64 Instructions = 0;
+    UINT64 Cycles = 0;
+    UINT32 Cpu = 0;
+    UINT32 Head;
+
+    barrier( );
+
+    if (likely( Thread->Mode & PIF_PROFILER_MODE_COUNTERS ))
+    {
+        Cycles = PifReadPmc( PIF_PMU_FIXED_COUNTER( PIF_PMU_FIXED_CORE_CYCLES ) );
+        Instructions = PifReadPmc( PIF_PMU_FIXED_COUNTER( PIF_PMU_FIXED_INSTRUCTIONS ) );
+    }
+
+    //
+    // RDTSCP waits for the region's instructions to execute, RDTSC does not.
+    // It comes after the counter reads so a migration between them shows up
+    // as a different processor number.
+    //
+    if (likely( Thread->Mode & PIF_PROFILER_MODE_RDTSCP ))
+    {
+        Tsc = PifReadTscp( &Cpu );
+    }
+    else
+    {
+        PifLoadFence( );
+        Tsc = PifReadTsc( );
+    }
+
+    barrier( );
+
+    Head = Thread->Head;
+    if (unlikely( Head - Thread->CachedTail > Thread->Mask ))
+    {
+        Thread->CachedTail = PifLoadAcquire32( &Thread->Tail );
+        if (Head - Thread->CachedTail > Thread->Mask)
+        {
+            PifStoreRelease32( &Thread->Dropped, Thread->Dropped + 1 );
+            return;
+        }
+    }
+
+    Record = &Thread->Records[Head & Thread->Mask];
+    Record->Region = Region;
+    Record->Tsc = Tsc - Mark->Tsc;
+    if (likely( Cpu == Mark->Cpu ))
+    {
+        Record->Flags = 0;
+        Record->Instructions = (Instructions - Mark->Instructions) & Thread->CounterMask;
+        Record->Cycles = (Cycles - Mark->Cycles) & Thread->CounterMask;
+    }
+    else
+    {
+        Record->Flags = PIF_PROFILER_RECORD_MIGRATED;
+        Record->Instructions = 0;
+        Record->Cycles = 0;
+    }
+
+    PifStoreRelease32( &Thread->Head, Head + 1 );
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_PROFILER_H_
@@ -0,0 +1,97 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file replay.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#ifndef _PIF_REPLAY_H_
+#define _PIF_REPLAY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * CPUID results of one or more processors parsed from a text dump, served as
+ * a PIF_CPUID_SOURCE. Two dump formats are understood, and may be mixed:
+ *
+ *   cpuid -r:             CPU 0:
+ *                            0x00000004 0x01: eax=0x... ebx=0x... ecx=0x... edx=0x...
+ *   InstLatx64 / AIDA64:  CPU#000 AffMask: ...
+ *                         CPUID 00000004: EAX-EBX-ECX-EDX [SL 01]
+ *
+ * Lines in any other format are ignored. Leaves missing from the dump read as
+ * zero, which ends sub-leaf enumeration the same way hardware does.
+ */
+typedef struct _PIF_CPUID_REPLAY PIF_CPUID_REPLAY, *PPIF_CPUID_REPLAY;
+typedef CONST PIF_CPUID_REPLAY *PCPIF_CPUID_REPLAY;
+
+/**
+ * Parses a dump held in memory. Text does not need to be NUL terminated.
+ */
+STATUS
+PIFAPI
+PifParseCpuidDump(
+    IN CONST CHAR *Text,
+    IN SIZE_T Length,
+    OUT PPIF_CPUID_REPLAY *Replay
+    );
+
+/**
+ * Reads and parses a dump file.
+ */
+STATUS
+PIFAPI
+PifLoadCpuidDump(
+    IN PCSTR Path,
+    OUT PPIF_CPUID_REPLAY *Replay
+    );
+
+VOID
+PIFAPI
+PifDestroyCpuidReplay(
+    IN PPIF_CPUID_REPLAY Replay OPTIONAL
+    );
+
+/**
+ * Returns a CPUID source that replays the dump. It references Replay, which
+ * must outlive any capture using it.
+ */
+VOID
+PIFAPI
+PifGetCpuidReplaySource(
+    IN PCPIF_CPUID_REPLAY Replay,
+    OUT PPIF_CPUID_SOURCE Source
+    );
+
+/**
+ * Initializes the global API from a dump file instead of the host processor,
+ * so the feature tests, topology, caches and dispatch tables all reflect the
+ * dumped processor.
+ */
+STATUS
+PIFAPI
+PifInitializeFromCpuidDump(
+    IN PCSTR Path
+    );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_REPLAY_H_
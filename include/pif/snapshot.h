@@ -0,0 +1,87 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file snapshot.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#ifndef _PIF_SNAPSHOT_H_
+#define _PIF_SNAPSHOT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Version of the snapshot image format written by this library. Images with
+ * a different major version are rejected.
+ */
+#define PIF_SNAPSHOT_VERSION    2
+
+/**
+ * Serializes a context (its leaves, per-CPU leaves, strings, feature words,
+ * XCR0 and topology, where present) into a snapshot image. Pass a NULL Buffer
+ * to only query RequiredSize.
+ */
+STATUS
+PIFAPI
+PifSerializeSnapshot(
+    IN PCPIF_CONTEXT Context,
+    OUT VOID *Buffer OPTIONAL,
+    IN SIZE_T BufferSize,
+    OUT SIZE_T *RequiredSize
+    );
+
+/**
+ * Writes the snapshot image of a context to a file.
+ */
+STATUS
+PIFAPI
+PifSaveSnapshot(
+    IN PCPIF_CONTEXT Context,
+    IN PCSTR Path
+    );
+
+/**
+ * Creates a read-only context directly on top of a snapshot image in memory.
+ * Nothing is copied, so the image must be 8 byte aligned and outlive the
+ * context. Release the context with PifDestroyContext.
+ */
+STATUS
+PIFAPI
+PifLoadSnapshot(
+    IN CONST VOID *Image,
+    IN SIZE_T ImageSize,
+    OUT PPIF_CONTEXT *Context
+    );
+
+/**
+ * Memory-maps a snapshot file and creates a read-only context on top of it.
+ * PifDestroyContext unmaps the file.
+ */
+STATUS
+PIFAPI
+PifMapSnapshot(
+    IN PCSTR Path,
+    OUT PPIF_CONTEXT *Context
+    );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_SNAPSHOT_H_
@@ -0,0 +1,167 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file topology.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#ifndef _PIF_TOPOLOGY_H_
+#define _PIF_TOPOLOGY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Index value used for processors that are not present.
+ */
+#define PIF_INVALID_INDEX   ((UINT32)-1)
+
+/**
+ * Topology of a single logical processor, indexed by CPU number.
+ *
+ * The IDs are the fields of the x2APIC ID at each level, so CoreId is only
+ * unique within its die and DieId within its package. The *Index fields are
+ * positions in the PIF_TOPOLOGY arrays and are unique system wide.
+ */
+typedef struct _PIF_CPU_TOPOLOGY {
+    UINT32 ApicId;          //!< x2APIC ID (or initial APIC ID on older processors)
+    UINT32 PackageId;       //!< Physical package ID
+    UINT32 DieId;           //!< Die (AMD node) within the package
+    UINT32 CoreId;          //!< Core within the die
+    UINT32 SmtId;           //!< Hardware thread within the core
+    UINT32 PackageIndex;    //!< Index into PIF_TOPOLOGY::Packages
+    UINT32 DieIndex;        //!< Index into PIF_TOPOLOGY::Dies
+    UINT32 CoreIndex;       //!< Index into PIF_TOPOLOGY::Cores
+} PIF_CPU_TOPOLOGY, *PPIF_CPU_TOPOLOGY;
+
+/**
+ * Physical core. Its hardware threads are CpuList[FirstCpu..FirstCpu+CpuCount).
+ */
+typedef struct _PIF_TOPOLOGY_CORE {
+    UINT32 PackageIndex;
+    UINT32 DieIndex;
+    UINT32 CoreId;
+    UINT32 FirstCpu;
+    UINT32 CpuCount;
+} PIF_TOPOLOGY_CORE, *PPIF_TOPOLOGY_CORE;
+
+/**
+ * Die within a package. Its cores are Cores[FirstCore..FirstCore+CoreCount).
+ */
+typedef struct _PIF_TOPOLOGY_DIE {
+    UINT32 PackageIndex;
+    UINT32 DieId;
+    UINT32 FirstCore;
+    UINT32 CoreCount;
+    UINT32 FirstCpu;
+    UINT32 CpuCount;
+} PIF_TOPOLOGY_DIE, *PPIF_TOPOLOGY_DIE;
+
+/**
+ * Physical package (socket).
+ */
+typedef struct _PIF_TOPOLOGY_PACKAGE {
+    UINT32 PackageId;
+    UINT32 FirstDie;
+    UINT32 DieCount;
+    UINT32 FirstCore;
+    UINT32 CoreCount;
+    UINT32 FirstCpu;
+    UINT32 CpuCount;
+} PIF_TOPOLOGY_PACKAGE, *PPIF_TOPOLOGY_PACKAGE;
+
+/**
+ * System topology tree. CpuList holds the present CPU numbers ordered by
+ * (package, die, core, thread), so every package, die and core owns one
+ * contiguous run of it.
+ */
+typedef struct _PIF_TOPOLOGY {
+    UINT32 CpuCount;                //!< Number of entries in Cpus (highest CPU number + 1)
+    UINT32 LogicalCpuCount;         //!< Number of entries in CpuList
+    UINT32 CoreCount;
+    UINT32 DieCount;
+    UINT32 PackageCount;
+    UINT32 SmtShift;                //!< x2APIC ID bits below the core level
+    UINT32 DieShift;                //!< x2APIC ID bits below the die level
+    UINT32 PackageShift;            //!< x2APIC ID bits below the package level
+    PPIF_CPU_TOPOLOGY Cpus;
+    PPIF_TOPOLOGY_CORE Cores;
+    PPIF_TOPOLOGY_DIE Dies;
+    PPIF_TOPOLOGY_PACKAGE Packages;
+    PUINT32 CpuList;
+} PIF_TOPOLOGY, *PPIF_TOPOLOGY;
+typedef CONST PIF_TOPOLOGY *PCPIF_TOPOLOGY;
+
+/**
+ * Returns the topology derived by PifInitializeAllCpus from leaves 0x1F/0x0B
+ * (or leaves 0x01/0x04 on older processors) and AMD leaf 0x8000001E.
+ */
+STATUS
+PIFAPI
+PifGetTopology(
+    OUT CONST PIF_TOPOLOGY **Topology
+    );
+
+/**
+ * Returns the topology of a context: the one stored in the snapshot it was
+ * loaded from, or the one built when it was created with every processor
+ * captured. E_NOTFOUND otherwise.
+ */
+STATUS
+PIFAPI
+PifContextGetTopology(
+    IN PCPIF_CONTEXT Context,
+    OUT PCPIF_TOPOLOGY *Topology
+    );
+
+/**
+ * Returns the index of the physical core of a CPU, or PIF_INVALID_INDEX.
+ */
+UINT32
+PIFAPI
+PifGetCpuCore(
+    IN UINT32 Cpu
+    );
+
+/**
+ * Returns the CPU numbers of all hardware threads of a core.
+ */
+STATUS
+PIFAPI
+PifGetCoreSiblings(
+    IN UINT32 CoreIndex,
+    OUT CONST UINT32 **Cpus,
+    OUT UINT32 *CpuCount
+    );
+
+/**
+ * Returns the CPU numbers of all logical processors in a package.
+ */
+STATUS
+PIFAPI
+PifGetPackageCpus(
+    IN UINT32 PackageIndex,
+    OUT CONST UINT32 **Cpus,
+    OUT UINT32 *CpuCount
+    );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_TOPOLOGY_H_
@@ -0,0 +1,265 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file uarch.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#ifndef _PIF_UARCH_H_
+#define _PIF_UARCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Processor vendor, identified from the leaf 0x00 vendor string.
+ */
+typedef enum _PIF_CPU_VENDOR {
+    PifCpuVendorUnknown = 0,
+    PifCpuVendorIntel = 1,
+    PifCpuVendorAmd = 2,
+    PifCpuVendorHygon = 3,
+    PifCpuVendorZhaoxin = 4,
+    PifCpuVendorCentaur = 5,
+    PifCpuVendorVia = 6,
+    PifCpuVendorCyrix = 7,
+    PifCpuVendorTransmeta = 8,
+    PifCpuVendorNsc = 9,
+    PifCpuVendorNexGen = 10,
+    PifCpuVendorRise = 11,
+    PifCpuVendorSis = 12,
+    PifCpuVendorUmc = 13,
+    PifCpuVendorVortex = 14,
+    PifCpuVendorMax
+} PIF_CPU_VENDOR;
+
+/**
+ * Hygon processors are licensed AMD designs and follow AMD's CPUID
+ * definitions, including the topology and cache leaves.
+ */
+#define PIF_VENDOR_IS_AMD_COMPATIBLE(Vendor) \
+    ((Vendor) == PifCpuVendorAmd || (Vendor) == PifCpuVendorHygon)
+
+/**
+ * Processor signature decoded from leaf 0x01 EAX. Family and Model are the
+ * display values, which fold in the extended fields as the SDM and APM
+ * describe, and are what the vendors' documentation is keyed by.
+ */
+typedef struct _PIF_CPU_SIGNATURE {
+    UINT32 Family;              //!< BaseFamily, plus ExtendedFamily when BaseFamily is 0xF
+    UINT32 Model;               //!< BaseModel, plus ExtendedModel << 4 for base families 0x6 and up
+    UINT32 Stepping;
+    UINT32 BaseFamily;
+    UINT32 ExtendedFamily;
+    UINT32 BaseModel;
+    UINT32 ExtendedModel;
+    UINT32 ProcessorType;
+} PIF_CPU_SIGNATURE, *PPIF_CPU_SIGNATURE;
+
+/**
+ * Micro-architectures known to the identification table.
+ */
+typedef enum _PIF_UARCH {
+    PifUarchUnknown = 0,
+
+    PifUarchNehalem,
+    PifUarchWestmere,
+    PifUarchSandyBridge,
+    PifUarchIvyBridge,
+    PifUarchHaswell,
+    PifUarchBroadwell,
+    PifUarchSkylake,
+    PifUarchSkylakeX,
+    PifUarchCascadeLake,
+    PifUarchCooperLake,
+    PifUarchKabyLake,
+    PifUarchCoffeeLake,
+    PifUarchCometLake,
+    PifUarchCannonLake,
+    PifUarchIceLake,
+    PifUarchIceLakeX,
+    PifUarchTigerLake,
+    PifUarchRocketLake,
+    PifUarchAlderLake,
+    PifUarchRaptorLake,
+    PifUarchMeteorLake,
+    PifUarchArrowLake,
+    PifUarchLunarLake,
+    PifUarchSapphireRapids,
+    PifUarchEmeraldRapids,
+    PifUarchGraniteRapids,
+    PifUarchSilvermont,
+    PifUarchAirmont,
+    PifUarchGoldmont,
+    PifUarchGoldmontPlus,
+    PifUarchTremont,
+    PifUarchGracemont,
+    PifUarchCrestmont,
+    PifUarchKnightsLanding,
+    PifUarchKnightsMill,
+
+    PifUarchK8,
+    PifUarchK10,
+    PifUarchBobcat,
+    PifUarchBulldozer,
+    PifUarchPiledriver,
+    PifUarchSteamroller,
+    PifUarchExcavator,
+    PifUarchJaguar,
+    PifUarchPuma,
+    PifUarchZen,
+    PifUarchZenPlus,
+    PifUarchZen2,
+    PifUarchZen3,
+    PifUarchZen4,
+    PifUarchZen5,
+
+    PifUarchDhyana,
+
+    PifUarchIsaiah,
+    PifUarchZhangJiang,
+    PifUarchLuJiaZui,
+    PifUarchYongFeng,
+
+    PifUarchMax
+} PIF_UARCH;
+
+//
+// Micro-architecture tuning hints.
+//
+#define PIF_UARCH_AVX512_DOWNCLOCK      0x0001  // Sustained 512-bit (or heavy 256-bit) use lowers the core clock
+#define PIF_UARCH_AVX512_SPLIT          0x0002  // 512-bit operations execute as two 256-bit halves
+#define PIF_UARCH_FAST_REP_MOVSB        0x0004  // REP MOVSB/STOSB match vector loops for large copies
+#define PIF_UARCH_FAST_SHORT_REP_MOVSB  0x0008  // REP MOVSB is also fast for short copies
+#define PIF_UARCH_HYBRID                0x0010  // Mix of performance and efficiency cores
+#define PIF_UARCH_SLOW_GATHER           0x0020  // Vector gathers are slower than scalar loads
+
+/**
+ * Identification and tuning hints of a micro-architecture. VectorWidth is
+ * the widest vector, in bits, that code should prefer by default; it can be
+ * narrower than what the processor supports when wider vectors cost clock
+ * speed or throughput.
+ */
+typedef struct _PIF_UARCH_INFO {
+    PIF_UARCH Uarch;
+    PCSTR Name;
+    UINT32 VectorWidth;
+    UINT32 Flags;               //!< PIF_UARCH_* hints
+} PIF_UARCH_INFO, *PPIF_UARCH_INFO;
+typedef CONST PIF_UARCH_INFO *PCPIF_UARCH_INFO;
+
+PIF_CPU_VENDOR
+PIFAPI
+PifGetVendor(
+    VOID
+    );
+
+PIF_CPU_VENDOR
+PIFAPI
+PifContextGetVendor(
+    IN PCPIF_CONTEXT Context
+    );
+
+/**
+ * Identifies the vendor of leaf 0x00 EBX, EDX and ECX.
+ */
+PIF_CPU_VENDOR
+PIFAPI
+PifClassifyVendor(
+    IN UINT32 Ebx,
+    IN UINT32 Edx,
+    IN UINT32 Ecx
+    );
+
+/**
+ * Returns the name of a vendor, or NULL.
+ */
+PCSTR
+PIFAPI
+PifGetVendorName(
+    IN PIF_CPU_VENDOR Vendor
+    );
+
+/**
+ * Decodes a leaf 0x01 EAX value.
+ */
+VOID
+PIFAPI
+PifDecodeSignature(
+    IN UINT32 Eax,
+    OUT PPIF_CPU_SIGNATURE Signature
+    );
+
+STATUS
+PIFAPI
+PifGetSignature(
+    OUT PPIF_CPU_SIGNATURE Signature
+    );
+
+STATUS
+PIFAPI
+PifContextGetSignature(
+    IN PCPIF_CONTEXT Context,
+    OUT PPIF_CPU_SIGNATURE Signature
+    );
+
+/**
+ * Looks up the micro-architecture of a vendor and display family, model and
+ * stepping. Returns the PifUarchUnknown entry, which carries conservative
+ * hints, when the processor is not in the table.
+ */
+PCPIF_UARCH_INFO
+PIFAPI
+PifLookupMicroarchitecture(
+    IN PIF_CPU_VENDOR Vendor,
+    IN UINT32 Family,
+    IN UINT32 Model,
+    IN UINT32 Stepping
+    );
+
+/**
+ * Returns the micro-architecture of the processor a context describes, or of
+ * the default context.
+ */
+PCPIF_UARCH_INFO
+PIFAPI
+PifContextGetMicroarchitecture(
+    IN PCPIF_CONTEXT Context
+    );
+
+PCPIF_UARCH_INFO
+PIFAPI
+PifGetMicroarchitecture(
+    VOID
+    );
+
+/**
+ * Returns the information of a micro-architecture, or NULL.
+ */
+PCPIF_UARCH_INFO
+PIFAPI
+PifGetMicroarchitectureInfo(
+    IN PIF_UARCH Uarch
+    );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _PIF_UARCH_H_
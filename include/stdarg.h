@@ -23,6 +23,15 @@
 #pragma once
 #endif
 
+//
+// Hosted GCC/Clang builds defer to the compiler's own header. The C library
+// includes it by this name too, partially (__need___va_list), so the
+// passthrough sits outside the include guard.
+//
+#if (defined(__GNUC__) || defined(__clang__)) && (__STDC_HOSTED__ == 1)
+#include_next <stdarg.h>
+#else
+
 #ifndef _INC_STDARG
 #define _INC_STDARG
 
@@ -52,4 +61,6 @@ extern "C" {
 #pragma pack(pop)
 #endif
 
-#endif // _INC_STDARG
\ No newline at end of file
+#endif // _INC_STDARG
+
+#endif // __STDC_HOSTED__
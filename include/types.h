@@ -29,6 +29,19 @@
 #include "compiler.h"
 #include "error.h"
 
+//
+// Hosted GCC/Clang builds take the standard integer, size and time types from
+// the C library, so they agree with its own headers.
+//
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(_WIN32) && (__STDC_HOSTED__ == 1)
+#define PIF_HOSTED_LIBC 1
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <time.h>
+#endif
+
 
 #if defined(_MSC_VER)
 #pragma warning(push)
@@ -39,7 +52,9 @@
 //
 // Calling convention for Baselib
 //
-#if (defined(__x86_64__) || defined(_M_AMD64)) && \
+#if defined(PIF_HOSTED_LIBC) && (defined(__x86_64__) || defined(_M_AMD64))
+#define BLAPI   // Native System V ABI, like the C library
+#elif (defined(__x86_64__) || defined(_M_AMD64)) && \
     (defined(__GNUC__) || defined(__clang__))
 #define BLAPI __attribute__((ms_abi))
 #else
@@ -319,7 +334,9 @@ char( *RtlpNumberOf( UNALIGNED T( &)[N] ) )[N];
  * @v field     Field within structure
  * @ret offset  Offset within structure
  */
-#if (defined(__GNUC__) && (__GNUC__ > 3)) || defined(__clang__)
+#if defined(offsetof)
+// Already provided by <stddef.h>
+#elif (defined(__GNUC__) && (__GNUC__ > 3)) || defined(__clang__)
 #define offsetof(type, field)   __builtin_offsetof(type, field)
 #else
 #define offsetof(type, field)   FIELD_OFFSET(type, field)
@@ -425,6 +442,7 @@ typedef unsigned short wctype_t;
 #endif // !_MSC_EXTENSIONS
 
 
+#if !defined(PIF_HOSTED_LIBC)
 /** 7.18.1.1  Exact-width integer types */
 typedef signed char int8_t;
 typedef unsigned char uint8_t;
@@ -434,12 +452,14 @@ typedef int int32_t;
 typedef unsigned int uint32_t;
 __extension__ typedef __int64 int64_t;
 __extension__ typedef unsigned __int64 uint64_t;
+#endif // !PIF_HOSTED_LIBC
 
 typedef signed char sint8_t;
 typedef signed short sint16_t;
 typedef signed int sint32_t;
 __extension__ typedef signed __int64 sint64_t;
 
+#if !defined(PIF_HOSTED_LIBC)
 /** 7.18.1.2 Minimum-width integer types */
 typedef signed char int_least8_t;
 typedef unsigned char uint_least8_t;
@@ -531,6 +551,7 @@ __extension__ typedef __int64 ssize_t;
 __extension__ typedef int ssize_t;
 #endif /* __x86_64__ || _M_X64 */
 #endif /* _SSIZE_T_DEFINED */
+#endif // !PIF_HOSTED_LIBC
 
 #ifndef _RSIZE_T_DEFINED
 typedef size_t rsize_t;
@@ -589,6 +610,9 @@ typedef char CHAR;
 //#endif // !MIDL_PASS
 #endif // !VOID
 
+typedef CHAR *PSTR;
+typedef CONST CHAR *PCSTR;
+
 //typedef unsigned long   ULONG;
 //typedef long long       LONGLONG;
 //typedef unsigned long long ULONGLONG;
@@ -808,7 +832,7 @@ PtrToPtr32(
 #pragma clang diagnostic ignored "-Wint-to-void-pointer-cast"
 #elif defined(__GNUC__)
 #pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wint-to-void-pointer-cast"
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
 #endif
 
     return((void * POINTER_32) (unsigned long) (UINTN) p);
@@ -902,6 +926,7 @@ Handle64ToHandle(
 #define UintToPtr(ui)  UIntToPtr(ui)
 
 
+#if !defined(PIF_HOSTED_LIBC)
 /** 7.18.2  Limits of specified-width integer types */
 #if !defined(__cplusplus) || defined(__STDC_LIMIT_MACROS)
 
@@ -1028,6 +1053,7 @@ Handle64ToHandle(
 #define ULLONG_MAX      0xffffffffffffffffULL       // max unsigned long long
 #define LLONG_MAX       0x7fffffffffffffffLL        // max signed long long
 #define LLONG_MIN       (-0x7fffffffffffffffLL-1)   // min signed long long
+#endif // !PIF_HOSTED_LIBC
 
 #ifdef _MSC_VER
 typedef __int64 quad;
@@ -1072,6 +1098,7 @@ typedef unsigned long long uquad;
 #define MININTN         (~MAXINTN)
 
 
+#if !defined(PIF_HOSTED_LIBC)
 /** 7.18.4  Macros for integer constants */
 #if !defined(__cplusplus) || defined(__STDC_CONSTANT_MACROS)
 
@@ -1108,6 +1135,7 @@ The trick used here is from Clive D W Feather.
 #define UINTMAX_C( val ) val##ULL
 
 #endif /* !defined(__cplusplus) || defined(__STDC_CONSTANT_MACROS) */
+#endif // !PIF_HOSTED_LIBC
 
 
 
@@ -1115,9 +1143,11 @@ The trick used here is from Clive D W Feather.
 //
 // Time types
 //
+#if !defined(PIF_HOSTED_LIBC)
 typedef unsigned int clock_t;
 typedef long long int time_t;
 typedef int timer_t;
+#endif // !PIF_HOSTED_LIBC
 
 //
 // Major, minor numbers, dev_t's.
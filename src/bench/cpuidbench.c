@@ -0,0 +1,273 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file cpuidbench.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ *
+ * Measures the cost in TSC cycles of executing CPUID for every captured
+ * leaf/sub-leaf, compared to a lookup in the PIF snapshot. Under a hypervisor
+ * every CPUID is a VM exit, which is why callers must use the snapshot.
+ *
+ * Usage: CpuidBench [iterations]
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "arch.h"
+#include "pif.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#define BENCH_DEFAULT_ITERATIONS    1000
+#define BENCH_WARMUP_ITERATIONS     16
+
+typedef struct _BENCH_STATS {
+    UINT64 Min;
+    UINT64 P50;
+    UINT64 P90;
+    UINT64 P99;
+    UINT64 Max;
+} BENCH_STATS, *PBENCH_STATS;
+
+typedef enum _BENCH_METHOD {
+    BenchMethodNone,            //!< Empty timed region, measures the timer overhead
+    BenchMethodCpuid,
+    BenchMethodQuery
+} BENCH_METHOD;
+
+
+//
+// Reads the TSC after all previous instructions have retired (RDTSCP) and
+// before any later instruction starts (LFENCE).
+//
+FORCEINLINE
+UINT64
+BenchReadTsc(
+    VOID
+)
+{
+    UINT32 Aux;
+    UINT64 Tsc;
+
+    Tsc = PifReadTscp( &Aux );
+    PifLoadFence( );
+    return Tsc;
+}
+
+static
+int
+BenchCompareCycles(
+    IN CONST VOID *Left,
+    IN CONST VOID *Right
+)
+{
+    UINT64 A = *(CONST UINT64 *)Left;
+    UINT64 B = *(CONST UINT64 *)Right;
+
+    return (A < B) ? -1 : (A > B);
+}
+
+static
+VOID
+BenchMeasure(
+    IN BENCH_METHOD Method,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    IN UINT32 Iterations,
+    IN UINT64 Overhead,
+    IN PUINT64 Samples,
+    OUT PBENCH_STATS Stats
+)
+{
+    CPUID_INFO CpuInfo;
+    UINT64 Start;
+    UINT64 End;
+    UINT32 Index;
+
+    for (Index = 0; Index < BENCH_WARMUP_ITERATIONS + Iterations; ++Index)
+    {
+        PifLoadFence( );
+        Start = BenchReadTsc( );
+
+        switch (Method)
+        {
+        case BenchMethodCpuid:
+            PifCpuidEx( &CpuInfo, Leaf, SubLeaf );
+            break;
+        case BenchMethodQuery:
+            PifQueryLeaf( Leaf, SubLeaf, &CpuInfo );
+            break;
+        default:
+            break;
+        }
+
+        barrier( );
+        End = BenchReadTsc( );
+
+        if (Index >= BENCH_WARMUP_ITERATIONS)
+        {
+            Samples[Index - BENCH_WARMUP_ITERATIONS] = (End - Start > Overhead) ? End - Start - Overhead : 0;
+        }
+    }
+
+    qsort( Samples, Iterations, sizeof( UINT64 ), BenchCompareCycles );
+
+    Stats->Min = Samples[0];
+    Stats->P50 = Samples[(Iterations * 50) / 100];
+    Stats->P90 = Samples[(Iterations * 90) / 100];
+    Stats->P99 = Samples[(Iterations * 99) / 100];
+    Stats->Max = Samples[Iterations - 1];
+}
+
+static
+VOID
+BenchLeaf(
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    IN UINT32 Iterations,
+    IN UINT64 Overhead,
+    IN PUINT64 Samples,
+    IN OUT PUINT64 CpuidTotal,
+    IN OUT PUINT64 QueryTotal
+)
+{
+    BENCH_STATS Cpuid;
+    BENCH_STATS Query;
+
+    BenchMeasure( BenchMethodCpuid, Leaf, SubLeaf, Iterations, Overhead, Samples, &Cpuid );
+    BenchMeasure( BenchMethodQuery, Leaf, SubLeaf, Iterations, Overhead, Samples, &Query );
+
+    printf( "%08X %4u | %7llu %7llu %7llu %7llu %8llu | %5llu %5llu %5llu %5llu %7llu\n",
+            Leaf, SubLeaf,
+            (unsigned long long)Cpuid.Min, (unsigned long long)Cpuid.P50, (unsigned long long)Cpuid.P90,
+            (unsigned long long)Cpuid.P99, (unsigned long long)Cpuid.Max,
+            (unsigned long long)Query.Min, (unsigned long long)Query.P50, (unsigned long long)Query.P90,
+            (unsigned long long)Query.P99, (unsigned long long)Query.Max );
+
+    *CpuidTotal += Cpuid.P50;
+    *QueryTotal += Query.P50;
+}
+
+int
+main(
+    int argc,
+    char *argv[]
+)
+{
+    static CONST UINT32 RangeBases[] = {
+        CPUID_MAX_FUNCTION,
+        CPUID_HV_VENDOR_INFO,
+        CPUID_MAX_EXTENDED_FUNCTION,
+        CPUID_CENTAUR_MAX_FUNCTION
+    };
+    BENCH_STATS Timer;
+    PUINT64 Samples;
+    UINT64 CpuidTotal = 0;
+    UINT64 QueryTotal = 0;
+    UINT32 Iterations;
+    UINT32 LeafCount = 0;
+    UINT32 Range;
+    UINT32 Leaf;
+    UINT32 MaxLeaf;
+    UINT32 SubLeaf;
+    UINT32 SubLeafCount;
+    STATUS Status;
+#if defined(__linux__)
+    cpu_set_t CpuSet;
+#endif
+
+    Iterations = (argc > 1) ? (UINT32)strtoul( argv[1], NULL, 0 ) : BENCH_DEFAULT_ITERATIONS;
+    if (Iterations == 0)
+    {
+        Iterations = BENCH_DEFAULT_ITERATIONS;
+    }
+
+#if defined(__linux__)
+    //
+    // Stay on one processor, TSC deltas across a migration are meaningless.
+    //
+    CPU_ZERO( &CpuSet );
+    CPU_SET( sched_getcpu( ), &CpuSet );
+    sched_setaffinity( 0, sizeof( CpuSet ), &CpuSet );
+#endif
+
+    Status = PifEnsureInitialized( );
+    if (!SUCCESS( Status ))
+    {
+        fprintf( stderr, "PifEnsureInitialized failed (%d)\n", Status );
+        return 1;
+    }
+
+    Samples = malloc( sizeof( UINT64 ) * Iterations );
+    if (!Samples)
+    {
+        PifDestroy( );
+        return 1;
+    }
+
+    //
+    // Calibrate the cost of the timed region itself and subtract it from
+    // every sample.
+    //
+    BenchMeasure( BenchMethodNone, 0, 0, Iterations, 0, Samples, &Timer );
+
+    printf( "Cycles per call, %u iterations, timer overhead %llu cycles%s\n\n",
+            Iterations, (unsigned long long)Timer.Min,
+            (CpuidFn_00000001h_0_Ecx & X86_FEATURE_HYPERVISOR) ? ", running under a hypervisor" : "" );
+    printf( "Leaf      Sub |                  CPUID                   |           PifQueryLeaf\n" );
+    printf( "              |     min     p50     p90     p99      max |   min   p50   p90   p99     max\n" );
+
+    for (Range = 0; Range < RTL_NUMBER_OF_V1( RangeBases ); ++Range)
+    {
+        if (!SUCCESS( PifGetMaxLeaf( RangeBases[Range], &MaxLeaf ) ))
+        {
+            continue;
+        }
+
+        for (Leaf = RangeBases[Range]; Leaf <= MaxLeaf; ++Leaf)
+        {
+            if (!SUCCESS( PifGetSubLeafCount( Leaf, &SubLeafCount ) ))
+            {
+                continue;
+            }
+
+            for (SubLeaf = 0; SubLeaf < SubLeafCount; ++SubLeaf)
+            {
+                BenchLeaf( Leaf, SubLeaf, Iterations, Timer.Min, Samples, &CpuidTotal, &QueryTotal );
+                ++LeafCount;
+            }
+        }
+    }
+
+    if (LeafCount != 0)
+    {
+        printf( "\n%u leaves, mean of medians: CPUID %llu cycles, PifQueryLeaf %llu cycles\n",
+                LeafCount,
+                (unsigned long long)(CpuidTotal / LeafCount),
+                (unsigned long long)(QueryTotal / LeafCount) );
+    }
+
+    free( Samples );
+    PifDestroy( );
+    return 0;
+}
@@ -0,0 +1,580 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file cache.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#include "pifp.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Where a decoded cache came from, and the number of APIC ID bits shared by
+// all logical processors of one of its instances. Deterministic caches keep
+// their sub-leaf so the sharing can be read again on every processor.
+//
+typedef struct _PIF_CACHE_SOURCE {
+    UINT32 SubLeaf;
+    UINT32 SharingShift;
+} PIF_CACHE_SOURCE, *PPIF_CACHE_SOURCE;
+
+//
+// Hierarchy being decoded. Leaf is the deterministic cache leaf the caches
+// were decoded from, or 0 for the legacy leaves.
+//
+typedef struct _PIF_CACHE_BUILDER {
+    PCPIF_CONTEXT Context;
+    PPIF_CACHE_HIERARCHY Hierarchy;
+    UINT32 Leaf;
+    PIF_CACHE_SOURCE Sources[PIF_MAX_CACHES];
+} PIF_CACHE_BUILDER, *PPIF_CACHE_BUILDER;
+
+//
+// Sort key of a processor within one cache. The comparator has no context
+// parameter, so the key carries everything it compares.
+//
+typedef struct _PIF_CACHE_SORT_KEY {
+    UINT32 FirstApicId;     //!< Lowest APIC ID of the instance
+    UINT32 CacheId;
+    UINT32 Cpu;
+} PIF_CACHE_SORT_KEY, *PPIF_CACHE_SORT_KEY;
+
+
+FORCEINLINE
+UINT32
+PifpCacheSharingShift(
+    IN UINT32 Count
+)
+{
+    UINT32 Bits = 0;
+
+    while (Bits < 31 && (1u << Bits) < Count)
+    {
+        ++Bits;
+    }
+
+    return Bits;
+}
+
+static
+UINT32
+PifpDecodeL2Associativity(
+    IN UINT32 Code,
+    IN UINT32 Lines
+)
+{
+    //
+    // Associativity encoding of leaf 0x80000006 ECX[15:12] and EDX[15:12].
+    //
+    switch (Code)
+    {
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_DIRECT_MAPPED: return 1;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_2_WAY:   return 2;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_3_WAY:   return 3;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_4_WAY:   return 4;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_6_WAY:   return 6;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_8_WAY:   return 8;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_16_WAY:  return 16;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_32_WAY:  return 32;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_48_WAY:  return 48;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_64_WAY:  return 64;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_96_WAY:  return 96;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_128_WAY: return 128;
+    case CPUID_EXTENDED_CACHE_INFO_ECX_L2_ASSOCIATIVITY_FULL:    return Lines;
+    default:                                                    return 0;
+    }
+}
+
+static
+VOID
+PifpAddLegacyCache(
+    IN OUT PPIF_CACHE_BUILDER Builder,
+    IN UINT32 Level,
+    IN PIF_CACHE_TYPE Type,
+    IN UINT32 Size,
+    IN UINT32 Ways,
+    IN UINT32 LineSize,
+    IN UINT32 SharingShift
+)
+{
+    PPIF_CACHE_HIERARCHY Hierarchy = Builder->Hierarchy;
+    PPIF_CACHE_DESCRIPTOR Cache;
+
+    if (Size == 0 || Ways == 0 || LineSize == 0 || Hierarchy->CacheCount >= PIF_MAX_CACHES)
+    {
+        return;
+    }
+
+    Cache = &Hierarchy->Caches[Hierarchy->CacheCount];
+    Cache->Level = Level;
+    Cache->Type = Type;
+    Cache->Flags = (Ways * LineSize == Size) ? PIF_CACHE_FULLY_ASSOCIATIVE : 0;
+    Cache->Size = Size;
+    Cache->Ways = Ways;
+    Cache->LineSize = LineSize;
+    Cache->Partitions = 1;
+    Cache->Sets = Size / (Ways * LineSize);
+    Cache->MaxSharingCpus = 1u << SharingShift;
+
+    Builder->Sources[Hierarchy->CacheCount++].SharingShift = SharingShift;
+}
+
+static
+VOID
+PifpDecodeDeterministicCaches(
+    IN OUT PPIF_CACHE_BUILDER Builder,
+    IN UINT32 Leaf
+)
+{
+    PPIF_CACHE_HIERARCHY Hierarchy = Builder->Hierarchy;
+    PPIF_CACHE_DESCRIPTOR Cache;
+    CPUID_INFO CpuInfo;
+    UINT32 SubLeaf;
+
+    //
+    // Leaf 0x04 and AMD leaf 0x8000001D share the same format.
+    //
+    Builder->Leaf = Leaf;
+    for (SubLeaf = 0;
+         Hierarchy->CacheCount < PIF_MAX_CACHES &&
+         SUCCESS( PifContextQueryLeaf( Builder->Context, Leaf, SubLeaf, &CpuInfo ) ) &&
+         (CpuInfo.Eax & 0x1F) != PifCacheTypeNull;
+         ++SubLeaf)
+    {
+        Cache = &Hierarchy->Caches[Hierarchy->CacheCount];
+        Cache->Type = (PIF_CACHE_TYPE)(CpuInfo.Eax & 0x1F);
+        Cache->Level = (CpuInfo.Eax >> 5) & 0x7;
+        Cache->Flags = 0;
+        if (CpuInfo.Eax & (1u << 8))
+        {
+            Cache->Flags |= PIF_CACHE_SELF_INITIALIZING;
+        }
+        if (CpuInfo.Eax & (1u << 9))
+        {
+            Cache->Flags |= PIF_CACHE_FULLY_ASSOCIATIVE;
+        }
+        if (CpuInfo.Edx & (1u << 0))
+        {
+            Cache->Flags |= PIF_CACHE_WBINVD_NOT_INCLUSIVE;
+        }
+        if (CpuInfo.Edx & (1u << 1))
+        {
+            Cache->Flags |= PIF_CACHE_INCLUSIVE;
+        }
+        if (CpuInfo.Edx & (1u << 2))
+        {
+            Cache->Flags |= PIF_CACHE_COMPLEX_INDEXING;
+        }
+
+        Cache->LineSize = (CpuInfo.Ebx & 0xFFF) + 1;
+        Cache->Partitions = ((CpuInfo.Ebx >> 12) & 0x3FF) + 1;
+        Cache->Ways = ((CpuInfo.Ebx >> 22) & 0x3FF) + 1;
+        Cache->Sets = CpuInfo.Ecx + 1;
+        Cache->Size = Cache->Ways * Cache->Partitions * Cache->LineSize * Cache->Sets;
+        Cache->MaxSharingCpus = ((CpuInfo.Eax >> 14) & 0xFFF) + 1;
+
+        Builder->Sources[Hierarchy->CacheCount].SubLeaf = SubLeaf;
+        Builder->Sources[Hierarchy->CacheCount++].SharingShift = PifpCacheSharingShift( Cache->MaxSharingCpus );
+    }
+}
+
+static
+VOID
+PifpDecodeLegacyCaches(
+    IN OUT PPIF_CACHE_BUILDER Builder,
+    IN CONST PIF_TOPOLOGY *Topology OPTIONAL
+)
+{
+    CPUID_INFO CpuInfo;
+    UINT32 Ways;
+    UINT32 SmtShift;
+    UINT32 DieShift;
+
+    //
+    // Without deterministic parameters, L1 and L2 are assumed private to a
+    // core and L3 shared by the die.
+    //
+    SmtShift = Topology ? Topology->SmtShift : 0;
+    DieShift = Topology ? Topology->DieShift : 0;
+    Builder->Leaf = 0;
+
+    if (SUCCESS( PifContextQueryLeaf( Builder->Context, CPUID_AMD_L1_CACHE_INFO, 0, &CpuInfo ) ))
+    {
+        Ways = (CpuInfo.Ecx >> 16) & 0xFF;
+        if (Ways == CPUID_AMD_L1_CACHE_INFO_ASSOCIATIVITY_FULL)
+        {
+            Ways = ((CpuInfo.Ecx >> 24) * KIBIBYTE) / ((CpuInfo.Ecx & 0xFF) ? (CpuInfo.Ecx & 0xFF) : 1);
+        }
+        PifpAddLegacyCache( Builder, 1, PifCacheTypeData, (CpuInfo.Ecx >> 24) * KIBIBYTE, Ways,
+                                     CpuInfo.Ecx & 0xFF, SmtShift );
+
+        Ways = (CpuInfo.Edx >> 16) & 0xFF;
+        if (Ways == CPUID_AMD_L1_CACHE_INFO_ASSOCIATIVITY_FULL)
+        {
+            Ways = ((CpuInfo.Edx >> 24) * KIBIBYTE) / ((CpuInfo.Edx & 0xFF) ? (CpuInfo.Edx & 0xFF) : 1);
+        }
+        PifpAddLegacyCache( Builder, 1, PifCacheTypeInstruction, (CpuInfo.Edx >> 24) * KIBIBYTE, Ways,
+                                     CpuInfo.Edx & 0xFF, SmtShift );
+    }
+
+    if (SUCCESS( PifContextQueryLeaf( Builder->Context, CPUID_EXTENDED_CACHE_INFO, 0, &CpuInfo ) ))
+    {
+        //
+        // ECX[31:16] is the L2 size in KB, EDX[31:18] the L3 size in 512KB units.
+        //
+        if ((CpuInfo.Ecx & 0xFF) != 0)
+        {
+            PifpAddLegacyCache( Builder, 2, PifCacheTypeUnified, (CpuInfo.Ecx >> 16) * KIBIBYTE,
+                                         PifpDecodeL2Associativity( (CpuInfo.Ecx >> 12) & 0xF,
+                                                                    ((CpuInfo.Ecx >> 16) * KIBIBYTE) / (CpuInfo.Ecx & 0xFF) ),
+                                         CpuInfo.Ecx & 0xFF, SmtShift );
+        }
+
+        if ((CpuInfo.Edx & 0xFF) != 0)
+        {
+            PifpAddLegacyCache( Builder, 3, PifCacheTypeUnified, (CpuInfo.Edx >> 18) * 512 * KIBIBYTE,
+                                         PifpDecodeL2Associativity( (CpuInfo.Edx >> 12) & 0xF,
+                                                                    ((CpuInfo.Edx >> 18) * 512 * KIBIBYTE) / (CpuInfo.Edx & 0xFF) ),
+                                         CpuInfo.Edx & 0xFF, DieShift );
+        }
+    }
+}
+
+//
+// Orders the caches by level, then data, instruction and unified, keeping
+// their sources alongside. There are only a handful, so an insertion sort.
+//
+static
+VOID
+PifpSortCaches(
+    IN OUT PPIF_CACHE_BUILDER Builder
+)
+{
+    PPIF_CACHE_HIERARCHY Hierarchy = Builder->Hierarchy;
+    PIF_CACHE_DESCRIPTOR Cache;
+    PIF_CACHE_SOURCE Source;
+    UINT32 Index;
+    UINT32 Slot;
+
+    for (Index = 1; Index < Hierarchy->CacheCount; ++Index)
+    {
+        Cache = Hierarchy->Caches[Index];
+        Source = Builder->Sources[Index];
+
+        for (Slot = Index;
+             Slot > 0 &&
+             (Hierarchy->Caches[Slot - 1].Level > Cache.Level ||
+              (Hierarchy->Caches[Slot - 1].Level == Cache.Level && Hierarchy->Caches[Slot - 1].Type > Cache.Type));
+             --Slot)
+        {
+            Hierarchy->Caches[Slot] = Hierarchy->Caches[Slot - 1];
+            Builder->Sources[Slot] = Builder->Sources[Slot - 1];
+        }
+
+        Hierarchy->Caches[Slot] = Cache;
+        Builder->Sources[Slot] = Source;
+    }
+}
+
+//
+// Number of APIC ID bits shared by the processors of the instance of a cache
+// that Cpu belongs to. Hybrid parts report the sharing of their own core type,
+// such as a private P-core L2 and an L2 shared by a cluster of E-cores, so it
+// is read from the processor's own deterministic leaf when captured.
+//
+static
+UINT32
+PifpCpuCacheSharingShift(
+    IN CONST PIF_CACHE_BUILDER *Builder,
+    IN UINT32 CacheIndex,
+    IN UINT32 Cpu
+)
+{
+    PCPIF_CACHE_DESCRIPTOR Cache = &Builder->Hierarchy->Caches[CacheIndex];
+    CPUID_INFO CpuInfo;
+
+    if (Builder->Leaf != 0 &&
+        SUCCESS( PifpContextQueryLeafOnCpu( Builder->Context, Cpu, Builder->Leaf,
+                                            Builder->Sources[CacheIndex].SubLeaf, &CpuInfo ) ) &&
+        (PIF_CACHE_TYPE)(CpuInfo.Eax & 0x1F) == Cache->Type &&
+        ((CpuInfo.Eax >> 5) & 0x7) == Cache->Level)
+    {
+        return PifpCacheSharingShift( ((CpuInfo.Eax >> 14) & 0xFFF) + 1 );
+    }
+
+    return Builder->Sources[CacheIndex].SharingShift;
+}
+
+static
+int
+PifpCompareCacheCpus(
+    IN CONST VOID *Left,
+    IN CONST VOID *Right
+)
+{
+    CONST PIF_CACHE_SORT_KEY *A = (CONST PIF_CACHE_SORT_KEY *)Left;
+    CONST PIF_CACHE_SORT_KEY *B = (CONST PIF_CACHE_SORT_KEY *)Right;
+
+    if (A->FirstApicId != B->FirstApicId)
+    {
+        return (A->FirstApicId < B->FirstApicId) ? -1 : 1;
+    }
+
+    return (A->Cpu < B->Cpu) ? -1 : (A->Cpu > B->Cpu);
+}
+
+static
+STATUS
+PifpBuildCacheInstances(
+    IN OUT PPIF_CACHE_BUILDER Builder,
+    IN CONST PIF_TOPOLOGY *Topology
+)
+{
+    PPIF_CACHE_HIERARCHY Hierarchy = Builder->Hierarchy;
+    PPIF_CACHE_DESCRIPTOR Cache;
+    PPIF_CACHE_INSTANCE Instance;
+    PPIF_CACHE_SORT_KEY Keys;
+    PUINT32 CpuList;
+    UINT32 CacheIndex;
+    UINT32 Index;
+    UINT32 Cpu;
+    UINT32 ApicId;
+    UINT32 Shift;
+    UINT32 Count;
+
+    Count = Topology->LogicalCpuCount;
+
+    //
+    // Every cache lists all logical processors once, grouped by instance, so
+    // the instance and CPU lists are bounded by CacheCount * Count entries.
+    //
+    Hierarchy->CpuList = calloc( (SIZE_T)Hierarchy->CacheCount * Count, sizeof( UINT32 ) );
+    Hierarchy->Instances = calloc( (SIZE_T)Hierarchy->CacheCount * Count, sizeof( PIF_CACHE_INSTANCE ) );
+    Keys = malloc( (SIZE_T)Count * sizeof( PIF_CACHE_SORT_KEY ) );
+    if (!Hierarchy->CpuList || !Hierarchy->Instances || !Keys)
+    {
+        free( Keys );
+        return E_NOMEM;
+    }
+
+    for (CacheIndex = 0; CacheIndex < Hierarchy->CacheCount; ++CacheIndex)
+    {
+        Cache = &Hierarchy->Caches[CacheIndex];
+        CpuList = &Hierarchy->CpuList[(SIZE_T)CacheIndex * Count];
+
+        //
+        // Instances are told apart by their lowest APIC ID rather than the
+        // shifted ID, which can repeat between core types sharing differently.
+        //
+        for (Index = 0; Index < Count; ++Index)
+        {
+            Cpu = Topology->CpuList[Index];
+            ApicId = Topology->Cpus[Cpu].ApicId;
+            Shift = PifpCpuCacheSharingShift( Builder, CacheIndex, Cpu );
+
+            Keys[Index].FirstApicId = (Shift >= 32) ? 0 : (ApicId & ~((1u << Shift) - 1));
+            Keys[Index].CacheId = (Shift >= 32) ? 0 : (ApicId >> Shift);
+            Keys[Index].Cpu = Cpu;
+        }
+
+        qsort( Keys, Count, sizeof( PIF_CACHE_SORT_KEY ), PifpCompareCacheCpus );
+
+        Cache->FirstInstance = Hierarchy->InstanceCount;
+        Instance = NULL;
+
+        for (Index = 0; Index < Count; ++Index)
+        {
+            CpuList[Index] = Keys[Index].Cpu;
+
+            if (Index == 0 || Keys[Index].FirstApicId != Keys[Index - 1].FirstApicId)
+            {
+                Instance = &Hierarchy->Instances[Hierarchy->InstanceCount++];
+                Instance->CacheId = Keys[Index].CacheId;
+                Instance->FirstCpu = CacheIndex * Count + Index;
+                Cache->InstanceCount++;
+            }
+
+            Instance->CpuCount++;
+        }
+    }
+
+    free( Keys );
+    return STATUS_OK;
+}
+
+VOID
+PifpDestroyCacheHierarchy(
+    IN PPIF_CACHE_HIERARCHY Hierarchy OPTIONAL
+)
+{
+    if (Hierarchy == NULL)
+    {
+        return;
+    }
+
+    free( Hierarchy->Instances );
+    free( Hierarchy->CpuList );
+    free( Hierarchy );
+}
+
+STATUS
+PifpCreateCacheHierarchy(
+    IN PCPIF_CONTEXT Context,
+    IN CONST PIF_TOPOLOGY *Topology OPTIONAL,
+    OUT PPIF_CACHE_HIERARCHY *HierarchyOut
+)
+{
+    PIF_CACHE_BUILDER Builder;
+    PPIF_CACHE_HIERARCHY Hierarchy;
+    CPUID_INFO CpuInfo;
+    STATUS Status;
+
+    Hierarchy = calloc( 1, sizeof( PIF_CACHE_HIERARCHY ) );
+    if (!Hierarchy)
+    {
+        return E_NOMEM;
+    }
+
+    memset( &Builder, 0, sizeof( Builder ) );
+    Builder.Context = Context;
+    Builder.Hierarchy = Hierarchy;
+
+    //
+    // Prefer the deterministic cache parameters. AMD only reports them in
+    // leaf 0x8000001D when topology extensions are supported, and reports
+    // zeroes in leaf 0x04.
+    //
+    if (SUCCESS( PifContextQueryLeaf( Context, CPUID_EXTENDED_FEATURES, 0, &CpuInfo ) ) &&
+        (CpuInfo.Ecx & X86_FEATURE_TOPOEXT) != 0)
+    {
+        PifpDecodeDeterministicCaches( &Builder, CPUID_AMD_CACHE_TOPOLOGY );
+    }
+
+    if (Hierarchy->CacheCount == 0)
+    {
+        PifpDecodeDeterministicCaches( &Builder, CPUID_CACHE_PARAMS );
+    }
+
+    if (Hierarchy->CacheCount == 0)
+    {
+        PifpDecodeLegacyCaches( &Builder, Topology );
+    }
+
+    PifpSortCaches( &Builder );
+
+    if (Topology != NULL && Topology->LogicalCpuCount != 0 && Hierarchy->CacheCount != 0)
+    {
+        Status = PifpBuildCacheInstances( &Builder, Topology );
+        if (!SUCCESS( Status ))
+        {
+            PifpDestroyCacheHierarchy( Hierarchy );
+            return Status;
+        }
+    }
+
+    *HierarchyOut = Hierarchy;
+    return STATUS_OK;
+}
+
+//
+// Cache hierarchy of the default context. Contexts replaced as the default
+// are only destroyed by PifDestroy, so it stays valid while the caller uses
+// it.
+//
+FORCEINLINE
+CONST PIF_CACHE_HIERARCHY *
+PifpGetDefaultCacheHierarchy(
+    VOID
+)
+{
+    PCPIF_CONTEXT Context = PifGetDefaultContext( );
+
+    return (Context != NULL) ? Context->CacheHierarchy : NULL;
+}
+
+STATUS
+PIFAPI
+PifGetCacheHierarchy(
+    OUT CONST PIF_CACHE_HIERARCHY **Hierarchy
+)
+{
+    CONST PIF_CACHE_HIERARCHY *CacheHierarchy;
+
+    if (Hierarchy == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    CacheHierarchy = PifpGetDefaultCacheHierarchy( );
+    if (CacheHierarchy == NULL || CacheHierarchy->CacheCount == 0)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    *Hierarchy = CacheHierarchy;
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifContextGetCacheHierarchy(
+    IN PCPIF_CONTEXT Context,
+    OUT CONST PIF_CACHE_HIERARCHY **Hierarchy
+)
+{
+    if (Context == NULL || Hierarchy == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if (Context->CacheHierarchy == NULL || Context->CacheHierarchy->CacheCount == 0)
+    {
+        return E_NOTFOUND;
+    }
+
+    *Hierarchy = Context->CacheHierarchy;
+    return STATUS_OK;
+}
+
+PCPIF_CACHE_DESCRIPTOR
+PIFAPI
+PifGetDataCache(
+    IN UINT32 Level
+)
+{
+    CONST PIF_CACHE_HIERARCHY *CacheHierarchy;
+    UINT32 Index;
+
+    CacheHierarchy = PifpGetDefaultCacheHierarchy( );
+    if (CacheHierarchy == NULL)
+    {
+        return NULL;
+    }
+
+    for (Index = 0; Index < CacheHierarchy->CacheCount; ++Index)
+    {
+        if (CacheHierarchy->Caches[Index].Level == Level &&
+            CacheHierarchy->Caches[Index].Type != PifCacheTypeInstruction)
+        {
+            return &CacheHierarchy->Caches[Index];
+        }
+    }
+
+    return NULL;
+}
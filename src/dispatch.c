@@ -0,0 +1,258 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file dispatch.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#include "pifp.h"
+
+#include <string.h>
+
+static PPIF_DISPATCH_TABLE DispatchTables = NULL;
+
+
+static
+STATUS
+PifpResolveDispatchTable(
+    IN PPIF_DISPATCH_TABLE Table,
+    IN CONST PIF_FEATURES *Features
+)
+{
+    PVOID Function;
+
+    Function = PifSelectCandidate( Features, Table->Candidates, Table->CandidateCount );
+    if (Function == NULL)
+    {
+        return E_NOTFOUND;
+    }
+
+    *Table->Target = Function;
+    return STATUS_OK;
+}
+
+VOID
+PifpInitializeDispatch(
+    IN PCPIF_CONTEXT Context
+)
+{
+    PPIF_DISPATCH_TABLE Table;
+
+    //
+    // Dispatch on the usable features, so a candidate is never selected for
+    // register state the OS has not enabled. Tables without a matching
+    // candidate keep their current target. Registered tables stay on the
+    // list across PifDestroy and are resolved again by the next PifInitialize.
+    //
+    for (Table = DispatchTables; Table != NULL; Table = Table->Next)
+    {
+        PifpResolveDispatchTable( Table, &Context->UsableFeatures );
+    }
+}
+
+STATUS
+PIFAPI
+PifGetFeatures(
+    OUT PPIF_FEATURES Features
+)
+{
+    PCPIF_CONTEXT Context;
+
+    if (Features == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    Context = PifGetDefaultContext( );
+    if (Context == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    *Features = Context->UsableFeatures;
+    return STATUS_OK;
+}
+
+VOID
+PIFAPI
+PifCaptureFeatures(
+    OUT PPIF_FEATURES Features
+)
+{
+    CPUID_INFO CpuInfo;
+    UINT32 MaxFunction;
+    UINT32 MaxExtendedFunction;
+    UINT32 Index;
+
+    //
+    // No libc calls here, this may run from an ifunc resolver before the
+    // process is fully relocated.
+    //
+    for (Index = 0; Index < PIF_FEATURE_WORDS; ++Index)
+    {
+        Features->Words[Index] = 0;
+    }
+
+    PifCpuid( &CpuInfo, CPUID_MAX_FUNCTION );
+    MaxFunction = CpuInfo.Eax;
+
+    if (MaxFunction >= CPUID_FEATURES)
+    {
+        PifCpuid( &CpuInfo, CPUID_FEATURES );
+        Features->Words[PifFeatureWord_00000001h_0_Ecx] = CpuInfo.Ecx;
+        Features->Words[PifFeatureWord_00000001h_0_Edx] = CpuInfo.Edx;
+    }
+
+    if (MaxFunction >= CPUID_STRUCTURED_EXTENDED_FEATURES)
+    {
+        PifCpuidEx( &CpuInfo, CPUID_STRUCTURED_EXTENDED_FEATURES, 0 );
+        Features->Words[PifFeatureWord_00000007h_0_Ebx] = CpuInfo.Ebx;
+        Features->Words[PifFeatureWord_00000007h_0_Ecx] = CpuInfo.Ecx;
+        Features->Words[PifFeatureWord_00000007h_0_Edx] = CpuInfo.Edx;
+    }
+
+    if (MaxFunction >= CPUID_EXTENDED_STATE)
+    {
+        PifCpuidEx( &CpuInfo, CPUID_EXTENDED_STATE, CPUID_EXTENDED_STATE_SUB_LEAF );
+        Features->Words[PifFeatureWord_0000000Dh_1_Eax] = CpuInfo.Eax;
+    }
+
+    PifCpuid( &CpuInfo, CPUID_MAX_EXTENDED_FUNCTION );
+    MaxExtendedFunction = CpuInfo.Eax;
+    if (MaxExtendedFunction > CPUID_MAX_EXTENDED_FUNCTION + 0xFFFF)
+    {
+        MaxExtendedFunction = 0;
+    }
+
+    if (MaxExtendedFunction >= CPUID_EXTENDED_FEATURES)
+    {
+        PifCpuid( &CpuInfo, CPUID_EXTENDED_FEATURES );
+        Features->Words[PifFeatureWord_80000001h_0_Ecx] = CpuInfo.Ecx;
+        Features->Words[PifFeatureWord_80000001h_0_Edx] = CpuInfo.Edx;
+    }
+
+    if (MaxExtendedFunction >= CPUID_EXTENDED_FEATURES_EXTENSION)
+    {
+        PifCpuid( &CpuInfo, CPUID_EXTENDED_FEATURES_EXTENSION );
+        Features->Words[PifFeatureWord_80000008h_0_Ebx] = CpuInfo.Ebx;
+    }
+
+    PifpMaskUnusableFeatures( Features, PifpReadXcr0( Features->Words[PifFeatureWord_00000001h_0_Ecx] ) );
+}
+
+BOOLEAN
+PIFAPI
+PifHasFeatures(
+    IN CONST PIF_FEATURES *Features,
+    IN CONST PIF_FEATURES *Required
+)
+{
+    return PifFeaturesIsSubset( Required, Features );
+}
+
+static
+BOOLEAN
+PifpMeetsRequirements(
+    IN CONST PIF_FEATURES *Features,
+    IN CONST PIF_DISPATCH_CANDIDATE *Candidate
+)
+{
+    CONST PIF_FEATURE_REQUIREMENT *Requirement;
+    UINT32 Index;
+
+    for (Index = 0; Index < Candidate->RequirementCount; ++Index)
+    {
+        Requirement = &Candidate->Requirements[Index];
+
+        //
+        // A requirement on a word this build does not know can never be met.
+        //
+        if (Requirement->Word >= PIF_FEATURE_WORDS ||
+            (Features->Words[Requirement->Word] & Requirement->Mask) != Requirement->Mask)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+PVOID
+PIFAPI
+PifSelectCandidate(
+    IN CONST PIF_FEATURES *Features,
+    IN CONST PIF_DISPATCH_CANDIDATE *Candidates,
+    IN UINT32 CandidateCount
+)
+{
+    UINT32 Index;
+
+    for (Index = 0; Index < CandidateCount; ++Index)
+    {
+        if (PifpMeetsRequirements( Features, &Candidates[Index] ))
+        {
+            return Candidates[Index].Function;
+        }
+    }
+
+    return NULL;
+}
+
+STATUS
+PIFAPI
+PifRegisterDispatchTable(
+    IN PPIF_DISPATCH_TABLE Table
+)
+{
+    PCPIF_CONTEXT Context;
+    PPIF_DISPATCH_TABLE Entry;
+    STATUS Status;
+
+    if (Table == NULL || Table->Target == NULL || Table->Candidates == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    //
+    // Registering under the publish lock keeps a concurrent publication from
+    // missing the table or resolving it against the context it replaces.
+    //
+    PifpAcquirePublishLock( );
+
+    //
+    // Registering the same table twice would make the list cyclic.
+    //
+    for (Entry = DispatchTables; Entry != NULL; Entry = Entry->Next)
+    {
+        if (Entry == Table)
+        {
+            break;
+        }
+    }
+
+    if (Entry == NULL)
+    {
+        Table->Next = DispatchTables;
+        DispatchTables = Table;
+    }
+
+    Context = PifGetDefaultContext( );
+    Status = (Context != NULL) ? PifpResolveDispatchTable( Table, &Context->UsableFeatures ) : STATUS_OK;
+
+    PifpReleasePublishLock( );
+    return Status;
+}
@@ -0,0 +1,200 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file features.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#include "pifp.h"
+
+#include <string.h>
+
+//
+// Names of the feature IDs, matching the Has* macro suffixes.
+//
+static CONST CHAR *CONST PifFeatureNames[PIF_FEATURE_BITS] = {
+    [PifFeatureSSE3] = "SSE3",
+    [PifFeaturePCLMULQDQ] = "PCLMULQDQ",
+    [PifFeatureMONITOR] = "MONITOR",
+    [PifFeatureVMX] = "VMX",
+    [PifFeatureSMX] = "SMX",
+    [PifFeatureEIST] = "EIST",
+    [PifFeatureSSSE3] = "SSSE3",
+    [PifFeatureFMA] = "FMA",
+    [PifFeatureCMPXCHG16B] = "CMPXCHG16B",
+    [PifFeatureSSE41] = "SSE41",
+    [PifFeatureSSE42] = "SSE42",
+    [PifFeatureMOVBE] = "MOVBE",
+    [PifFeaturePOPCNT] = "POPCNT",
+    [PifFeatureAES] = "AES",
+    [PifFeatureXSAVE] = "XSAVE",
+    [PifFeatureOSXSAVE] = "OSXSAVE",
+    [PifFeatureAVX] = "AVX",
+    [PifFeatureF16C] = "F16C",
+    [PifFeatureRDRAND] = "RDRAND",
+    [PifFeatureFPU] = "FPU",
+    [PifFeatureMSR] = "MSR",
+    [PifFeatureCMPXCHG8B] = "CMPXCHG8B",
+    [PifFeatureSEP] = "SEP",
+    [PifFeatureCMOV] = "CMOV",
+    [PifFeatureCLFSH] = "CLFSH",
+    [PifFeatureMMX] = "MMX",
+    [PifFeatureFXSR] = "FXSR",
+    [PifFeatureSSE] = "SSE",
+    [PifFeatureSSE2] = "SSE2",
+    [PifFeatureFSGSBASE] = "FSGSBASE",
+    [PifFeatureTSCADJUST] = "TSCADJUST",
+    [PifFeatureSGX] = "SGX",
+    [PifFeatureBMI1] = "BMI1",
+    [PifFeatureHLE] = "HLE",
+    [PifFeatureAVX2] = "AVX2",
+    [PifFeatureBMI2] = "BMI2",
+    [PifFeatureERMS] = "ERMS",
+    [PifFeatureINVPCID] = "INVPCID",
+    [PifFeatureRTM] = "RTM",
+    [PifFeatureMPX] = "MPX",
+    [PifFeatureAVX512F] = "AVX512F",
+    [PifFeatureAVX512DQ] = "AVX512DQ",
+    [PifFeatureRDSEED] = "RDSEED",
+    [PifFeatureADX] = "ADX",
+    [PifFeatureAVX512IFMA] = "AVX512IFMA",
+    [PifFeatureCLFLUSHOPT] = "CLFLUSHOPT",
+    [PifFeatureCLWB] = "CLWB",
+    [PifFeatureAVX512PF] = "AVX512PF",
+    [PifFeatureAVX512ER] = "AVX512ER",
+    [PifFeatureAVX512CD] = "AVX512CD",
+    [PifFeatureSHA] = "SHA",
+    [PifFeatureAVX512BW] = "AVX512BW",
+    [PifFeatureAVX512VL] = "AVX512VL",
+    [PifFeaturePREFETCHWT1] = "PREFETCHWT1",
+    [PifFeatureAVX512VBMI1] = "AVX512VBMI1",
+    [PifFeatureUMIP] = "UMIP",
+    [PifFeaturePKU] = "PKU",
+    [PifFeatureAVX512VBMI2] = "AVX512VBMI2",
+    [PifFeatureGFNI] = "GFNI",
+    [PifFeatureVAES] = "VAES",
+    [PifFeatureVPCLMULQDQ] = "VPCLMULQDQ",
+    [PifFeatureAVX512VNNI] = "AVX512VNNI",
+    [PifFeatureAVX512BITALG] = "AVX512BITALG",
+    [PifFeatureAVX512VPOPCNTDQ] = "AVX512VPOPCNTDQ",
+    [PifFeatureRDPID] = "RDPID",
+    [PifFeatureSGXLC] = "SGXLC",
+    [PifFeatureAMXBF16] = "AMXBF16",
+    [PifFeatureAMXTILE] = "AMXTILE",
+    [PifFeatureAMXINT8] = "AMXINT8",
+    [PifFeatureXSAVEOPT] = "XSAVEOPT",
+    [PifFeatureXSAVEC] = "XSAVEC",
+    [PifFeatureXSAVES] = "XSAVES",
+    [PifFeatureLAHF_LM] = "LAHF_LM",
+    [PifFeatureSVM] = "SVM",
+    [PifFeatureABM] = "ABM",
+    [PifFeatureSSE4a] = "SSE4a",
+    [PifFeatureMisalignedSSE] = "MisalignedSSE",
+    [PifFeaturePRFCHW] = "PRFCHW",
+    [PifFeatureXOP] = "XOP",
+    [PifFeatureSKINIT] = "SKINIT",
+    [PifFeatureFMA4] = "FMA4",
+    [PifFeatureTCE] = "TCE",
+    [PifFeatureTBM] = "TBM",
+    [PifFeatureDBX] = "DBX",
+    [PifFeatureMONITORX] = "MONITORX",
+    [PifFeatureSYSCALL] = "SYSCALL",
+    [PifFeatureMTRR] = "MTRR",
+    [PifFeatureNOEXECUTE] = "NOEXECUTE",
+    [PifFeatureMMXEXT] = "MMXEXT",
+    [PifFeatureRDTSCP] = "RDTSCP",
+    [PifFeatureLONGMODE] = "LONGMODE",
+    [PifFeature3DNOWEXT] = "3DNOWEXT",
+    [PifFeature3DNOW] = "3DNOW",
+};
+
+
+PCSTR
+PIFAPI
+PifGetFeatureName(
+    IN UINT32 Id
+)
+{
+    if (Id >= PIF_FEATURE_BITS)
+    {
+        return NULL;
+    }
+
+    return PifFeatureNames[Id];
+}
+
+STATUS
+PIFAPI
+PifFindFeature(
+    IN CONST CHAR *Name,
+    OUT UINT32 *Id
+)
+{
+    CONST CHAR *Left;
+    CONST CHAR *Right;
+    UINT32 Index;
+
+    if (Name == NULL || Id == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    //
+    // Names are compared case insensitively, so "avx2" finds AVX2.
+    //
+    for (Index = 0; Index < PIF_FEATURE_BITS; ++Index)
+    {
+        if (PifFeatureNames[Index] == NULL)
+        {
+            continue;
+        }
+
+        for (Left = PifFeatureNames[Index], Right = Name; *Left != '\0'; ++Left, ++Right)
+        {
+            if ((*Left | 0x20) != (*Right | 0x20))
+            {
+                break;
+            }
+        }
+
+        if (*Left == '\0' && *Right == '\0')
+        {
+            *Id = Index;
+            return STATUS_OK;
+        }
+    }
+
+    return E_NOTFOUND;
+}
+
+VOID
+PifpGetNamedFeatures(
+    OUT PPIF_FEATURES Features
+)
+{
+    UINT32 Index;
+
+    memset( Features, 0, sizeof( *Features ) );
+
+    for (Index = 0; Index < PIF_FEATURE_BITS; ++Index)
+    {
+        if (PifFeatureNames[Index] != NULL)
+        {
+            PifFeaturesSet( Features, Index );
+        }
+    }
+}
@@ -0,0 +1,153 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file fleet.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#include "pifp.h"
+
+STATUS
+PIFAPI
+PifLoadSnapshotFeatures(
+    IN PCSTR Path,
+    OUT PPIF_FEATURES Features
+)
+{
+    PPIF_CONTEXT Context;
+    STATUS Status;
+
+    if (Path == NULL || Features == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    //
+    // Mapping validates the header and section bounds and decodes the cache
+    // leaves, so loading a snapshot costs little more than the open and mmap
+    // system calls.
+    //
+    Status = PifMapSnapshot( Path, &Context );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    *Features = *PifContextGetUsableFeatures( Context );
+    PifDestroyContext( Context );
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifFleetSummarize(
+    IN CONST PIF_FEATURES *Nodes,
+    IN UINT32 NodeCount,
+    OUT PPIF_FLEET_SUMMARY Summary
+)
+{
+    PIF_FEATURES Named;
+    PIF_FEATURES Common;
+    PIF_FEATURES Any;
+    UINT32 Node;
+    UINT32 Index;
+
+    if (Nodes == NULL || Summary == NULL)
+    {
+        return E_NULLPARAM;
+    }
+    if (NodeCount == 0)
+    {
+        return E_NODATA;
+    }
+
+    //
+    // The feature sets are 64 byte aligned rows of a fixed number of words,
+    // so the compiler turns the inner loops into a few vector ANDs and ORs
+    // per node.
+    //
+    Common = Nodes[0];
+    Any = Nodes[0];
+    for (Node = 1; Node < NodeCount; ++Node)
+    {
+        for (Index = 0; Index < PIF_FEATURE_WORDS; ++Index)
+        {
+            Common.Words[Index] &= Nodes[Node].Words[Index];
+            Any.Words[Index] |= Nodes[Node].Words[Index];
+        }
+    }
+
+    //
+    // Only the named features are summarized, the words also carry fields
+    // such as MAWAU and flags such as HYPERVISOR.
+    //
+    PifpGetNamedFeatures( &Named );
+    PifFeaturesIntersect( &Summary->Common, &Common, &Named );
+    PifFeaturesIntersect( &Summary->Any, &Any, &Named );
+    Summary->Level = PifClassifyLevel( &Summary->Common );
+    Summary->NodeCount = NodeCount;
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifFleetFindBlockers(
+    IN CONST PIF_FEATURES *Nodes,
+    IN UINT32 NodeCount,
+    IN CONST PIF_FEATURES *Target,
+    OUT UINT32 *Blockers OPTIONAL,
+    IN UINT32 MaxBlockers,
+    OUT UINT32 *BlockerCount
+)
+{
+    PIF_FEATURES Named;
+    PIF_FEATURES Required;
+    UINT32 Count = 0;
+    UINT32 Node;
+
+    if (Nodes == NULL || Target == NULL || BlockerCount == NULL)
+    {
+        return E_NULLPARAM;
+    }
+    if (Blockers == NULL && MaxBlockers != 0)
+    {
+        return E_INVALID;
+    }
+
+    //
+    // A node only blocks the target when it misses a named feature, not when
+    // the words differ in a field or flag.
+    //
+    PifpGetNamedFeatures( &Named );
+    PifFeaturesIntersect( &Required, Target, &Named );
+
+    for (Node = 0; Node < NodeCount; ++Node)
+    {
+        if (!PifFeaturesIsSubset( &Required, &Nodes[Node] ))
+        {
+            if (Count < MaxBlockers)
+            {
+                Blockers[Count] = Node;
+            }
+            ++Count;
+        }
+    }
+
+    *BlockerCount = Count;
+    return STATUS_OK;
+}
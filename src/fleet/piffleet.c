@@ -0,0 +1,343 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file piffleet.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ *
+ *
+ * Computes the lowest common denominator of a pool of nodes from their PIF
+ * snapshots, and reports which nodes block a job built for a target, or a VM
+ * migrating from a node with the target's features.
+ *
+ * Usage: PifFleet [--target TARGET] SNAPSHOT...
+ *
+ * TARGET is an x86-64 level name (x86-64-v3), a comma separated list of
+ * feature names (AVX2,BMI2), or @SNAPSHOT for the usable features of a node.
+ * A SNAPSHOT of - reads further snapshot paths from stdin, one per line.
+ */
+
+#include "arch.h"
+#include "pif.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+typedef struct _FLEET_NODES {
+    PCSTR *Paths;
+    UINT32 Count;
+    UINT32 Capacity;
+} FLEET_NODES, *PFLEET_NODES;
+
+
+//
+// Appends a copy of Path, so paths read from stdin and from the command line
+// are owned and freed the same way.
+//
+static
+STATUS
+FleetAddNode(
+    IN OUT PFLEET_NODES Nodes,
+    IN PCSTR Path
+)
+{
+    PCSTR *Paths;
+    UINT32 Capacity;
+    SIZE_T Length;
+    CHAR *Copy;
+
+    if (Nodes->Count == Nodes->Capacity)
+    {
+        Capacity = Nodes->Capacity ? Nodes->Capacity * 2 : 64;
+        Paths = realloc( (VOID *)Nodes->Paths, Capacity * sizeof( PCSTR ) );
+        if (!Paths)
+        {
+            return E_NOMEM;
+        }
+        Nodes->Paths = Paths;
+        Nodes->Capacity = Capacity;
+    }
+
+    Length = strlen( Path );
+    Copy = malloc( Length + 1 );
+    if (!Copy)
+    {
+        return E_NOMEM;
+    }
+    memcpy( Copy, Path, Length + 1 );
+
+    Nodes->Paths[Nodes->Count++] = Copy;
+    return STATUS_OK;
+}
+
+static
+VOID
+FleetFreeNodes(
+    IN OUT PFLEET_NODES Nodes
+)
+{
+    UINT32 Node;
+
+    for (Node = 0; Node < Nodes->Count; ++Node)
+    {
+        free( (VOID *)Nodes->Paths[Node] );
+    }
+    free( (VOID *)Nodes->Paths );
+
+    Nodes->Paths = NULL;
+    Nodes->Count = 0;
+    Nodes->Capacity = 0;
+}
+
+static
+STATUS
+FleetReadNodeList(
+    IN OUT PFLEET_NODES Nodes
+)
+{
+    CHAR Line[4096];
+    SIZE_T Length;
+    STATUS Status;
+
+    while (fgets( Line, sizeof( Line ), stdin ))
+    {
+        Length = strcspn( Line, "\r\n" );
+        if (Length == 0)
+        {
+            continue;
+        }
+        Line[Length] = '\0';
+
+        Status = FleetAddNode( Nodes, Line );
+        if (!SUCCESS( Status ))
+        {
+            return Status;
+        }
+    }
+
+    return STATUS_OK;
+}
+
+//
+// Parses a target: a level name, @SNAPSHOT or a comma separated feature list.
+//
+static
+STATUS
+FleetParseTarget(
+    IN PCSTR Spec,
+    OUT PPIF_FEATURES Target
+)
+{
+    CHAR Name[64];
+    PCSTR Next;
+    SIZE_T Length;
+    UINT32 Level;
+    UINT32 Id;
+    STATUS Status;
+
+    if (Spec[0] == '@')
+    {
+        return PifLoadSnapshotFeatures( Spec + 1, Target );
+    }
+
+    for (Level = PifX86_64LevelV1; Level <= PifX86_64LevelMax; ++Level)
+    {
+        if (strcmp( Spec, PifGetLevelName( (PIF_X86_64_LEVEL)Level ) ) == 0)
+        {
+            return PifGetLevelFeatures( (PIF_X86_64_LEVEL)Level, Target );
+        }
+    }
+
+    memset( Target, 0, sizeof( PIF_FEATURES ) );
+    for (; *Spec != '\0'; Spec = (*Next != '\0') ? Next + 1 : Next)
+    {
+        Next = Spec + strcspn( Spec, "," );
+        Length = (SIZE_T)(Next - Spec);
+        if (Length == 0 || Length >= sizeof( Name ))
+        {
+            return E_INVALID;
+        }
+        memcpy( Name, Spec, Length );
+        Name[Length] = '\0';
+
+        Status = PifFindFeature( Name, &Id );
+        if (!SUCCESS( Status ))
+        {
+            fprintf( stderr, "Unknown feature %s\n", Name );
+            return Status;
+        }
+        PifFeaturesSet( Target, Id );
+    }
+
+    return STATUS_OK;
+}
+
+static
+VOID
+FleetPrintFeatures(
+    IN PCSTR Label,
+    IN CONST PIF_FEATURES *Features
+)
+{
+    UINT32 Count = 0;
+    UINT32 Id;
+
+    //
+    // Only named features are reported; the feature words also carry
+    // reserved and unassigned bits.
+    //
+    for (Id = 0; Id < PIF_FEATURE_BITS; ++Id)
+    {
+        Count += (PifFeaturesTest( Features, Id ) && PifGetFeatureName( Id ) != NULL);
+    }
+
+    printf( "%s (%u):", Label, Count );
+    for (Id = 0; Id < PIF_FEATURE_BITS; ++Id)
+    {
+        if (PifFeaturesTest( Features, Id ) && PifGetFeatureName( Id ) != NULL)
+        {
+            printf( " %s", PifGetFeatureName( Id ) );
+        }
+    }
+    printf( "\n" );
+}
+
+STATUS main( int argc, char *argv[] )
+{
+    FLEET_NODES Nodes = { 0 };
+    PPIF_FEATURES Features = NULL;
+    PIF_FLEET_SUMMARY Summary;
+    PIF_FEATURES Target;
+    PIF_FEATURES Varying;
+    PIF_FEATURES Missing;
+    PCSTR TargetSpec = NULL;
+    UINT32 *Blockers = NULL;
+    UINT32 BlockerCount;
+    UINT32 Node;
+    STATUS Status = STATUS_OK;
+    int Arg = 1;
+
+    if (Arg + 1 < argc && strcmp( argv[Arg], "--target" ) == 0)
+    {
+        TargetSpec = argv[Arg + 1];
+        Arg += 2;
+    }
+
+    for (; Arg < argc && SUCCESS( Status ); ++Arg)
+    {
+        Status = (strcmp( argv[Arg], "-" ) == 0) ? FleetReadNodeList( &Nodes ) :
+                                                   FleetAddNode( &Nodes, argv[Arg] );
+    }
+
+    if (!SUCCESS( Status ))
+    {
+        fprintf( stderr, "Failed to read the node list (%d)\n", Status );
+        goto Exit;
+    }
+    if (Nodes.Count == 0)
+    {
+        fprintf( stderr, "Usage: PifFleet [--target LEVEL|FEATURE,...|@SNAPSHOT] SNAPSHOT... [-]\n" );
+        Status = E_INVALID;
+        goto Exit;
+    }
+
+    if (TargetSpec != NULL)
+    {
+        Status = FleetParseTarget( TargetSpec, &Target );
+        if (!SUCCESS( Status ))
+        {
+            fprintf( stderr, "Invalid target %s (%d)\n", TargetSpec, Status );
+            goto Exit;
+        }
+    }
+
+    //
+    // One cache line per node keeps the feature rows aligned for the vector
+    // reductions in PifFleetSummarize.
+    //
+#if defined(_WIN32)
+    Features = _aligned_malloc( (SIZE_T)Nodes.Count * sizeof( PIF_FEATURES ), SYSTEM_CACHE_ALIGNMENT_SIZE );
+#else
+    {
+        VOID *Buffer;
+
+        Features = (posix_memalign( &Buffer, SYSTEM_CACHE_ALIGNMENT_SIZE,
+                                    (SIZE_T)Nodes.Count * sizeof( PIF_FEATURES ) ) == 0) ?
+                   (PPIF_FEATURES)Buffer : NULL;
+    }
+#endif
+    Blockers = malloc( (SIZE_T)Nodes.Count * sizeof( UINT32 ) );
+    if (!Features || !Blockers)
+    {
+        Status = E_NOMEM;
+        goto Exit;
+    }
+
+    for (Node = 0; Node < Nodes.Count; ++Node)
+    {
+        Status = PifLoadSnapshotFeatures( Nodes.Paths[Node], &Features[Node] );
+        if (!SUCCESS( Status ))
+        {
+            fprintf( stderr, "Failed to load snapshot %s (%d)\n", Nodes.Paths[Node], Status );
+            goto Exit;
+        }
+    }
+
+    Status = PifFleetSummarize( Features, Nodes.Count, &Summary );
+    if (!SUCCESS( Status ))
+    {
+        goto Exit;
+    }
+
+    PifFeaturesDifference( &Varying, &Summary.Any, &Summary.Common );
+
+    printf( "Nodes: %u\n", Summary.NodeCount );
+    printf( "Common x86-64 level is %s\n", PifGetLevelName( Summary.Level ) );
+    FleetPrintFeatures( "Common features", &Summary.Common );
+    FleetPrintFeatures( "Features missing on some nodes", &Varying );
+
+    if (TargetSpec == NULL)
+    {
+        goto Exit;
+    }
+
+    Status = PifFleetFindBlockers( Features, Nodes.Count, &Target, Blockers, Nodes.Count, &BlockerCount );
+    if (!SUCCESS( Status ))
+    {
+        goto Exit;
+    }
+
+    printf( "\nTarget %s is blocked by %u of %u nodes\n", TargetSpec, BlockerCount, Nodes.Count );
+    for (Node = 0; Node < BlockerCount; ++Node)
+    {
+        PifFeaturesDifference( &Missing, &Target, &Features[Blockers[Node]] );
+        FleetPrintFeatures( Nodes.Paths[Blockers[Node]], &Missing );
+    }
+
+Exit:
+#if defined(_WIN32)
+    _aligned_free( Features );
+#else
+    free( Features );
+#endif
+    free( Blockers );
+    FleetFreeNodes( &Nodes );
+    return Status;
+}
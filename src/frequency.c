@@ -0,0 +1,589 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file frequency.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#include "pifp.h"
+#include "arch/msr.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <time.h>
+#endif
+
+STATUS
+PIFAPI
+PifContextGetBaseFrequency(
+    IN PCPIF_CONTEXT Context,
+    OUT UINT32 *BaseMhz
+)
+{
+    CPUID_INFO CpuInfo;
+
+    if (BaseMhz == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *BaseMhz = 0;
+
+    if (Context == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    //
+    // Leaf 0x16 EAX[15:0] is the base frequency in MHz.
+    //
+    if (SUCCESS( PifContextQueryLeaf( Context, CPUID_PROCESSOR_FREQUENCY, 0, &CpuInfo ) ) &&
+        (CpuInfo.Eax & 0xFFFF) != 0)
+    {
+        *BaseMhz = CpuInfo.Eax & 0xFFFF;
+        return STATUS_OK;
+    }
+
+    //
+    // Leaf 0x15 gives the TSC frequency as the crystal clock (ECX, in Hz)
+    // times EBX/EAX. The invariant TSC runs at the base frequency.
+    //
+    if (SUCCESS( PifContextQueryLeaf( Context, CPUID_TIME_STAMP_COUNTER, 0, &CpuInfo ) ) &&
+        CpuInfo.Eax != 0 && CpuInfo.Ebx != 0 && CpuInfo.Ecx != 0)
+    {
+        *BaseMhz = (UINT32)(((UINT64)CpuInfo.Ecx * CpuInfo.Ebx / CpuInfo.Eax + 500000) / 1000000);
+        if (*BaseMhz != 0)
+        {
+            return STATUS_OK;
+        }
+    }
+
+    return E_NOTFOUND;
+}
+
+STATUS
+PIFAPI
+PifGetBaseFrequency(
+    OUT UINT32 *BaseMhz
+)
+{
+    return PifContextGetBaseFrequency( PifGetDefaultContext( ), BaseMhz );
+}
+
+#if defined(__linux__)
+
+//
+// Largest ring accepted, in samples.
+//
+#define PIF_FREQUENCY_MAX_CAPACITY  (1u << 24)
+
+//
+// MSRs read from every processor in one batch, in PIF_FREQUENCY_MSR_* order.
+//
+#define PIF_FREQUENCY_MSR_APERF     0
+#define PIF_FREQUENCY_MSR_MPERF     1
+#define PIF_FREQUENCY_MSR_TSC       2
+#define PIF_FREQUENCY_MSR_COUNT     3
+
+typedef struct _PIF_FREQUENCY_COUNTERS {
+    UINT64 Aperf;
+    UINT64 Mperf;
+    UINT64 Tsc;
+    UINT64 Time;
+    BOOLEAN Valid;
+} PIF_FREQUENCY_COUNTERS, *PPIF_FREQUENCY_COUNTERS;
+
+//
+// The ring indices only ever increase and are reduced by RingMask, so Head -
+// Tail is the number of samples queued. Head is written by the producer and
+// Tail by the consumer, each on its own cache line.
+//
+struct _PIF_FREQUENCY_SAMPLER {
+    PPIF_MSR_DEVICE Device;
+    UINT32 BaseMhz;
+    UINT32 CpuCount;
+    UINT32 *Cpus;
+    PPIF_FREQUENCY_COUNTERS Previous;
+    PPIF_FREQUENCY_SAMPLE Ring;
+    UINT32 RingMask;
+
+    PIF_PERIODIC_WORKER Worker;
+
+    ALIGNED(SYSTEM_CACHE_ALIGNMENT_SIZE) volatile UINT32 Head;
+    volatile UINT32 Dropped;
+    ALIGNED(SYSTEM_CACHE_ALIGNMENT_SIZE) volatile UINT32 Tail;
+};
+
+static
+UINT64
+PifpMonotonicTime(
+    VOID
+)
+{
+    struct timespec Now;
+
+    clock_gettime( CLOCK_MONOTONIC, &Now );
+    return (UINT64)Now.tv_sec * 1000000000 + (UINT64)Now.tv_nsec;
+}
+
+static
+VOID
+PifpPushFrequencySample(
+    IN PPIF_FREQUENCY_SAMPLER Sampler,
+    IN CONST PIF_FREQUENCY_SAMPLE *Sample
+)
+{
+    UINT32 Head = Sampler->Head;
+
+    //
+    // Only the producer writes Dropped, the store is atomic for the reader.
+    //
+    if (Head - PifLoadAcquire32( &Sampler->Tail ) > Sampler->RingMask)
+    {
+        PifStoreRelease32( &Sampler->Dropped, Sampler->Dropped + 1 );
+        return;
+    }
+
+    Sampler->Ring[Head & Sampler->RingMask] = *Sample;
+    PifStoreRelease32( &Sampler->Head, Head + 1 );
+}
+
+//
+// Reads APERF, MPERF and the TSC of every processor and publishes their
+// deltas from the previous pass. A processor that fails to read (offline,
+// or the driver went away) restarts from a fresh baseline.
+//
+static
+VOID
+PifpSampleFrequency(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+)
+{
+    PIF_MSR_REQUEST Requests[PIF_FREQUENCY_MSR_COUNT];
+    PIF_FREQUENCY_SAMPLE Sample;
+    PPIF_FREQUENCY_COUNTERS Previous;
+    UINT64 Time;
+    UINT64 TscMhz;
+    UINT32 Index;
+
+    Requests[PIF_FREQUENCY_MSR_APERF].Msr = MSR_APERF;
+    Requests[PIF_FREQUENCY_MSR_MPERF].Msr = MSR_MPERF;
+    Requests[PIF_FREQUENCY_MSR_TSC].Msr = MSR_TIME_STAMP_COUNTER;
+
+    memset( &Sample, 0, sizeof( Sample ) );
+
+    for (Index = 0; Index < Sampler->CpuCount; ++Index)
+    {
+        Previous = &Sampler->Previous[Index];
+
+        if (!SUCCESS( PifReadMsrBatch( Sampler->Device, Sampler->Cpus[Index], Requests, PIF_FREQUENCY_MSR_COUNT ) ))
+        {
+            Previous->Valid = FALSE;
+            continue;
+        }
+
+        //
+        // Timestamped per processor, so the elapsed time matches the TSC
+        // delta even when reading the others took a while.
+        //
+        Time = PifpMonotonicTime( );
+
+        if (Previous->Valid)
+        {
+            Sample.Cpu = Sampler->Cpus[Index];
+            Sample.Time = Time;
+            Sample.AperfDelta = Requests[PIF_FREQUENCY_MSR_APERF].Value - Previous->Aperf;
+            Sample.MperfDelta = Requests[PIF_FREQUENCY_MSR_MPERF].Value - Previous->Mperf;
+            Sample.TscDelta = Requests[PIF_FREQUENCY_MSR_TSC].Value - Previous->Tsc;
+
+            //
+            // APERF counts at the actual clock and MPERF at the base clock,
+            // both only in C0, and MPERF ticks at the TSC rate. Without a
+            // known base frequency (AMD reports none), the TSC rate measured
+            // over the interval stands in for it.
+            //
+            TscMhz = Sampler->BaseMhz;
+            if (TscMhz == 0 && Time > Previous->Time)
+            {
+                TscMhz = Sample.TscDelta * 1000 / (Time - Previous->Time);
+            }
+
+            Sample.EffectiveMhz = (Sample.MperfDelta != 0) ?
+                                  (UINT32)(Sample.AperfDelta * TscMhz / Sample.MperfDelta) : 0;
+            Sample.BusyPermille = (Sample.TscDelta != 0) ?
+                                  (UINT32)((Sample.MperfDelta >= Sample.TscDelta) ?
+                                           1000 : Sample.MperfDelta * 1000 / Sample.TscDelta) : 0;
+
+            PifpPushFrequencySample( Sampler, &Sample );
+        }
+
+        Previous->Aperf = Requests[PIF_FREQUENCY_MSR_APERF].Value;
+        Previous->Mperf = Requests[PIF_FREQUENCY_MSR_MPERF].Value;
+        Previous->Tsc = Requests[PIF_FREQUENCY_MSR_TSC].Value;
+        Previous->Time = Time;
+        Previous->Valid = TRUE;
+    }
+}
+
+static
+VOID
+PifpFrequencySamplerRoutine(
+    IN PVOID Parameter
+)
+{
+    PifpSampleFrequency( (PPIF_FREQUENCY_SAMPLER)Parameter );
+}
+
+STATUS
+PIFAPI
+PifCreateFrequencySampler(
+    IN PCPIF_CONTEXT Context,
+    IN PPIF_MSR_DEVICE Device,
+    IN CONST UINT32 *Cpus OPTIONAL,
+    IN UINT32 CpuCount,
+    IN UINT32 Capacity,
+    OUT PPIF_FREQUENCY_SAMPLER *Sampler
+)
+{
+    PPIF_FREQUENCY_SAMPLER NewSampler;
+    CPUID_INFO CpuInfo;
+    UINT64 PlatformInfo;
+    UINT32 DeviceCpuCount;
+    UINT32 RingSize;
+    UINT32 Index;
+    VOID *Buffer;
+
+    if (Device == NULL || Sampler == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Sampler = NULL;
+
+    if (Context == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    if (!SUCCESS( PifContextQueryLeaf( Context, CPUID_THERMAL_POWER_MANAGEMENT, 0, &CpuInfo ) ) ||
+        (CpuInfo.Ecx & CPUID_THERMAL_POWER_MANAGEMENT_ECX_HARDWARE_COORDINATION_FEEDBACK) == 0)
+    {
+        return E_FEATURE;
+    }
+
+    DeviceCpuCount = PifGetMsrDeviceCpuCount( Device );
+    if (Cpus == NULL)
+    {
+        CpuCount = DeviceCpuCount;
+    }
+
+    if (CpuCount == 0)
+    {
+        return E_NODATA;
+    }
+
+    if (Capacity > PIF_FREQUENCY_MAX_CAPACITY)
+    {
+        return E_BOUNDS;
+    }
+
+    for (Index = 0; Cpus != NULL && Index < CpuCount; ++Index)
+    {
+        if (Cpus[Index] >= DeviceCpuCount)
+        {
+            return E_BOUNDS;
+        }
+    }
+
+    for (RingSize = 2; RingSize < Capacity; RingSize <<= 1)
+    {
+    }
+
+    if (posix_memalign( &Buffer, SYSTEM_CACHE_ALIGNMENT_SIZE, sizeof( PIF_FREQUENCY_SAMPLER ) ) != 0)
+    {
+        return E_NOMEM;
+    }
+
+    NewSampler = (PPIF_FREQUENCY_SAMPLER)Buffer;
+    memset( NewSampler, 0, sizeof( PIF_FREQUENCY_SAMPLER ) );
+    NewSampler->Device = Device;
+    NewSampler->CpuCount = CpuCount;
+    NewSampler->RingMask = RingSize - 1;
+    NewSampler->Cpus = malloc( CpuCount * sizeof( UINT32 ) );
+    NewSampler->Previous = calloc( CpuCount, sizeof( PIF_FREQUENCY_COUNTERS ) );
+    NewSampler->Ring = malloc( RingSize * sizeof( PIF_FREQUENCY_SAMPLE ) );
+    if (NewSampler->Cpus == NULL || NewSampler->Previous == NULL || NewSampler->Ring == NULL)
+    {
+        free( NewSampler->Cpus );
+        free( NewSampler->Previous );
+        free( NewSampler->Ring );
+        free( NewSampler );
+        return E_NOMEM;
+    }
+
+    for (Index = 0; Index < CpuCount; ++Index)
+    {
+        NewSampler->Cpus[Index] = (Cpus != NULL) ? Cpus[Index] : Index;
+    }
+
+    //
+    // MSR_PLATFORM_INFO[15:8] is the maximum non-turbo ratio of the 100 MHz
+    // bus clock on Intel processors since Nehalem.
+    //
+    if (!SUCCESS( PifContextGetBaseFrequency( Context, &NewSampler->BaseMhz ) ) &&
+        PifContextGetVendor( Context ) == PifCpuVendorIntel &&
+        SUCCESS( PifReadMsr( Device, NewSampler->Cpus[0], MSR_PLATFORM_INFO, &PlatformInfo ) ))
+    {
+        NewSampler->BaseMhz = (UINT32)((PlatformInfo >> 8) & 0xFF) * 100;
+    }
+
+    PifpInitializePeriodicWorker( &NewSampler->Worker, PifpFrequencySamplerRoutine, NewSampler );
+
+    *Sampler = NewSampler;
+    return STATUS_OK;
+}
+
+VOID
+PIFAPI
+PifDestroyFrequencySampler(
+    IN PPIF_FREQUENCY_SAMPLER Sampler OPTIONAL
+)
+{
+    if (Sampler == NULL)
+    {
+        return;
+    }
+
+    PifpDestroyPeriodicWorker( &Sampler->Worker );
+
+    free( Sampler->Cpus );
+    free( Sampler->Previous );
+    free( Sampler->Ring );
+    free( Sampler );
+}
+
+STATUS
+PIFAPI
+PifSampleFrequency(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+)
+{
+    if (Sampler == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if (PifpIsPeriodicWorkerRunning( &Sampler->Worker ))
+    {
+        return E_BUSY;
+    }
+
+    PifpSampleFrequency( Sampler );
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifStartFrequencySampler(
+    IN PPIF_FREQUENCY_SAMPLER Sampler,
+    IN UINT32 IntervalMs
+)
+{
+    if (Sampler == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    return PifpStartPeriodicWorker( &Sampler->Worker, IntervalMs );
+}
+
+VOID
+PIFAPI
+PifStopFrequencySampler(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+)
+{
+    if (Sampler == NULL)
+    {
+        return;
+    }
+
+    PifpStopPeriodicWorker( &Sampler->Worker );
+}
+
+STATUS
+PIFAPI
+PifReadFrequencySamples(
+    IN PPIF_FREQUENCY_SAMPLER Sampler,
+    OUT PPIF_FREQUENCY_SAMPLE Samples,
+    IN UINT32 MaxSamples,
+    OUT UINT32 *SampleCount
+)
+{
+    UINT32 Head;
+    UINT32 Tail;
+    UINT32 Count;
+
+    if (Sampler == NULL || Samples == NULL || SampleCount == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    Tail = Sampler->Tail;
+    Head = PifLoadAcquire32( &Sampler->Head );
+
+    for (Count = 0; Count < MaxSamples && Tail != Head; ++Count, ++Tail)
+    {
+        Samples[Count] = Sampler->Ring[Tail & Sampler->RingMask];
+    }
+
+    PifStoreRelease32( &Sampler->Tail, Tail );
+
+    *SampleCount = Count;
+    return (Count != 0) ? STATUS_OK : E_EMPTY;
+}
+
+UINT32
+PIFAPI
+PifGetFrequencySamplerBaseMhz(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+)
+{
+    return (Sampler != NULL) ? Sampler->BaseMhz : 0;
+}
+
+UINT32
+PIFAPI
+PifGetFrequencySamplerDropped(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+)
+{
+    return (Sampler != NULL) ? PifLoadAcquire32( &Sampler->Dropped ) : 0;
+}
+
+#else
+
+STATUS
+PIFAPI
+PifCreateFrequencySampler(
+    IN PCPIF_CONTEXT Context,
+    IN PPIF_MSR_DEVICE Device,
+    IN CONST UINT32 *Cpus OPTIONAL,
+    IN UINT32 CpuCount,
+    IN UINT32 Capacity,
+    OUT PPIF_FREQUENCY_SAMPLER *Sampler
+)
+{
+    (VOID)Context;
+    (VOID)Device;
+    (VOID)Cpus;
+    (VOID)CpuCount;
+    (VOID)Capacity;
+
+    if (Sampler == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Sampler = NULL;
+    return E_UNSUPPORTED;
+}
+
+VOID
+PIFAPI
+PifDestroyFrequencySampler(
+    IN PPIF_FREQUENCY_SAMPLER Sampler OPTIONAL
+)
+{
+    (VOID)Sampler;
+}
+
+STATUS
+PIFAPI
+PifSampleFrequency(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+)
+{
+    (VOID)Sampler;
+    return E_UNSUPPORTED;
+}
+
+STATUS
+PIFAPI
+PifStartFrequencySampler(
+    IN PPIF_FREQUENCY_SAMPLER Sampler,
+    IN UINT32 IntervalMs
+)
+{
+    (VOID)Sampler;
+    (VOID)IntervalMs;
+    return E_UNSUPPORTED;
+}
+
+VOID
+PIFAPI
+PifStopFrequencySampler(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+)
+{
+    (VOID)Sampler;
+}
+
+STATUS
+PIFAPI
+PifReadFrequencySamples(
+    IN PPIF_FREQUENCY_SAMPLER Sampler,
+    OUT PPIF_FREQUENCY_SAMPLE Samples,
+    IN UINT32 MaxSamples,
+    OUT UINT32 *SampleCount
+)
+{
+    (VOID)Sampler;
+    (VOID)Samples;
+    (VOID)MaxSamples;
+
+    if (SampleCount != NULL)
+    {
+        *SampleCount = 0;
+    }
+    return E_UNSUPPORTED;
+}
+
+UINT32
+PIFAPI
+PifGetFrequencySamplerBaseMhz(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+)
+{
+    (VOID)Sampler;
+    return 0;
+}
+
+UINT32
+PIFAPI
+PifGetFrequencySamplerDropped(
+    IN PPIF_FREQUENCY_SAMPLER Sampler
+)
+{
+    (VOID)Sampler;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,361 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file hypervisor.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#include "pifp.h"
+
+#include <string.h>
+
+typedef struct _PIF_HYPERVISOR_SIGNATURE {
+    UINT32 Ebx;
+    UINT32 Ecx;
+    UINT32 Edx;
+    PIF_HYPERVISOR Hypervisor;
+} PIF_HYPERVISOR_SIGNATURE;
+
+#define HYPERVISOR_SIGNATURE(Name, Hypervisor) \
+    { CPUID_SIGNATURE_##Name##_EBX, CPUID_SIGNATURE_##Name##_ECX, CPUID_SIGNATURE_##Name##_EDX, (Hypervisor) }
+
+static CONST PIF_HYPERVISOR_SIGNATURE PifHypervisorSignatures[] = {
+    HYPERVISOR_SIGNATURE( KVM, PifHypervisorKvm ),
+    HYPERVISOR_SIGNATURE( MS_HV, PifHypervisorHyperV ),
+    HYPERVISOR_SIGNATURE( XEN, PifHypervisorXen ),
+    HYPERVISOR_SIGNATURE( VMWARE, PifHypervisorVmware ),
+    HYPERVISOR_SIGNATURE( BHYVE, PifHypervisorBhyve ),
+    HYPERVISOR_SIGNATURE( TCG, PifHypervisorQemuTcg ),
+    HYPERVISOR_SIGNATURE( VBOX, PifHypervisorVirtualBox ),
+    HYPERVISOR_SIGNATURE( PARALLELS, PifHypervisorParallels ),
+    HYPERVISOR_SIGNATURE( ACRN, PifHypervisorAcrn ),
+};
+
+//
+// Leaves of the hypervisor range are defined relative to its base, which is
+// not 0x40000000 when the hypervisor also implements the Hyper-V interface.
+//
+#define HV_LEAF(Info, Leaf) \
+    ((Info)->BaseLeaf + ((Leaf) - CPUID_HV_VENDOR_INFO))
+
+static CONST CHAR *CONST PifHypervisorNames[PifHypervisorMax] = {
+    [PifHypervisorNone]         = "none",
+    [PifHypervisorUnknown]      = "unknown",
+    [PifHypervisorKvm]          = "KVM",
+    [PifHypervisorHyperV]       = "Hyper-V",
+    [PifHypervisorXen]          = "Xen",
+    [PifHypervisorVmware]       = "VMware",
+    [PifHypervisorBhyve]        = "bhyve",
+    [PifHypervisorQemuTcg]      = "QEMU TCG",
+    [PifHypervisorVirtualBox]   = "VirtualBox",
+    [PifHypervisorParallels]    = "Parallels",
+    [PifHypervisorAcrn]         = "ACRN",
+};
+
+static CONST CHAR *CONST PifClockSourceNames[] = {
+    [PifClockSourceTsc]         = "tsc",
+    [PifClockSourceKvmClock]    = "kvm-clock",
+    [PifClockSourceHyperVTsc]   = "hyperv-tsc",
+    [PifClockSourceOs]          = "os",
+};
+
+PIF_HYPERVISOR
+PifpClassifyHypervisor(
+    IN CONST CPUID_INFO *CpuInfo
+)
+{
+    UINT32 Index;
+
+    for (Index = 0; Index < RTL_NUMBER_OF_V1( PifHypervisorSignatures ); ++Index)
+    {
+        if (((CpuInfo->Ebx ^ PifHypervisorSignatures[Index].Ebx) |
+             (CpuInfo->Ecx ^ PifHypervisorSignatures[Index].Ecx) |
+             (CpuInfo->Edx ^ PifHypervisorSignatures[Index].Edx)) == 0)
+        {
+            return PifHypervisorSignatures[Index].Hypervisor;
+        }
+    }
+
+    return PifHypervisorUnknown;
+}
+
+static
+VOID
+PifpDecodeKvm(
+    IN PCPIF_CONTEXT Context,
+    IN OUT PPIF_HYPERVISOR_INFO Info
+)
+{
+    CPUID_INFO CpuInfo;
+
+    if (!SUCCESS( PifContextQueryLeaf( Context, HV_LEAF( Info, CPUID_KVM_FEATURES ), 0, &CpuInfo ) ))
+    {
+        return;
+    }
+
+    if ((CpuInfo.Eax & (CPUID_KVM_FEATURES_EAX_CLOCKSOURCE | CPUID_KVM_FEATURES_EAX_CLOCKSOURCE2)) != 0)
+    {
+        Info->Flags |= PIF_HV_KVM_CLOCK;
+        if ((CpuInfo.Eax & CPUID_KVM_FEATURES_EAX_CLOCKSOURCE_STABLE) != 0)
+        {
+            Info->Flags |= PIF_HV_KVM_CLOCK_STABLE;
+        }
+    }
+    if ((CpuInfo.Eax & CPUID_KVM_FEATURES_EAX_STEAL_TIME) != 0)
+    {
+        Info->Flags |= PIF_HV_KVM_STEAL_TIME;
+    }
+    if ((CpuInfo.Edx & CPUID_KVM_FEATURES_EDX_HINTS_REALTIME) != 0)
+    {
+        Info->Flags |= PIF_HV_KVM_REALTIME;
+    }
+}
+
+static
+VOID
+PifpDecodeHyperV(
+    IN PCPIF_CONTEXT Context,
+    IN OUT PPIF_HYPERVISOR_INFO Info
+)
+{
+    CPUID_INFO CpuInfo;
+
+    //
+    // The Hyper-V leaves are only defined for the "Hv#1" interface, which
+    // other hypervisors also implement to run Windows guests.
+    //
+    if (!SUCCESS( PifContextQueryLeaf( Context, HV_LEAF( Info, CPUID_HV_INTERFACE_INFO ), 0, &CpuInfo ) ) ||
+        CpuInfo.Eax != CPUID_HV_INTERFACE_SIGNATURE)
+    {
+        return;
+    }
+
+    if (SUCCESS( PifContextQueryLeaf( Context, HV_LEAF( Info, CPUID_HV_VERSION_INFO ), 0, &CpuInfo ) ))
+    {
+        Info->VersionMajor = CpuInfo.Ebx >> 16;
+        Info->VersionMinor = CpuInfo.Ebx & 0xFFFF;
+    }
+
+    if (SUCCESS( PifContextQueryLeaf( Context, HV_LEAF( Info, CPUID_HV_FEATURES ), 0, &CpuInfo ) ))
+    {
+        if ((CpuInfo.Eax & CPUID_HV_FEATURES_EAX_ACCESS_REFERENCE_COUNTER) != 0)
+        {
+            Info->Flags |= PIF_HV_REFERENCE_COUNTER;
+        }
+        if ((CpuInfo.Eax & CPUID_HV_FEATURES_EAX_ACCESS_REFERENCE_TSC) != 0)
+        {
+            Info->Flags |= PIF_HV_REFERENCE_TSC;
+        }
+        if ((CpuInfo.Eax & CPUID_HV_FEATURES_EAX_ACCESS_FREQUENCY_MSRS) != 0 &&
+            (CpuInfo.Edx & CPUID_HV_FEATURES_EDX_FREQUENCY_MSRS_AVAILABLE) != 0)
+        {
+            Info->Flags |= PIF_HV_FREQUENCY_MSRS;
+        }
+        if ((CpuInfo.Eax & CPUID_HV_FEATURES_EAX_ACCESS_TSC_INVARIANT) != 0)
+        {
+            Info->Flags |= PIF_HV_TSC_INVARIANT_CONTROL;
+        }
+    }
+}
+
+static
+VOID
+PifpDecodeXen(
+    IN PCPIF_CONTEXT Context,
+    IN OUT PPIF_HYPERVISOR_INFO Info
+)
+{
+    CPUID_INFO CpuInfo;
+
+    if (SUCCESS( PifContextQueryLeaf( Context, HV_LEAF( Info, CPUID_XEN_VERSION ), 0, &CpuInfo ) ))
+    {
+        Info->VersionMajor = CpuInfo.Eax >> 16;
+        Info->VersionMinor = CpuInfo.Eax & 0xFFFF;
+    }
+
+    //
+    // Sub-leaf 0 of the time leaf reports whether the TSC is emulated and the
+    // guest TSC frequency.
+    //
+    if (SUCCESS( PifContextQueryLeaf( Context, HV_LEAF( Info, CPUID_XEN_TIME ), 0, &CpuInfo ) ))
+    {
+        if ((CpuInfo.Eax & CPUID_XEN_TIME_EAX_VTSC) != 0)
+        {
+            Info->Flags |= PIF_HV_TSC_EMULATED;
+        }
+        Info->TscFrequencyKhz = CpuInfo.Ecx;
+    }
+}
+
+STATUS
+PIFAPI
+PifContextGetHypervisorInfo(
+    IN PCPIF_CONTEXT Context,
+    OUT PPIF_HYPERVISOR_INFO Info
+)
+{
+    CPUID_INFO CpuInfo;
+
+    if (Info == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if (Context == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    memset( Info, 0, sizeof( PIF_HYPERVISOR_INFO ) );
+
+    if (SUCCESS( PifContextQueryLeaf( Context, CPUID_EXTENDED_TIME_STAMP_COUNTER, 0, &CpuInfo ) ) &&
+        (CpuInfo.Edx & CPUID_EXTENDED_TIME_STAMP_COUNTER_EDX_INVARIANT_TSC) != 0)
+    {
+        Info->Flags |= PIF_HV_INVARIANT_TSC;
+    }
+
+    //
+    // The hypervisor range is only captured when leaf 0x01 reports a guest.
+    //
+    Info->BaseLeaf = Context->Ranges[CPUID_HV_VENDOR_INFO >> CPUID_RANGE_SHIFT].Base;
+    if (!SUCCESS( PifContextQueryLeaf( Context, Info->BaseLeaf, 0, &CpuInfo ) ))
+    {
+        Info->Hypervisor = PifHypervisorNone;
+        Info->BaseLeaf = 0;
+        return STATUS_OK;
+    }
+
+    memcpy( &Info->Signature[0], &CpuInfo.Ebx, sizeof( UINT32 ) );
+    memcpy( &Info->Signature[4], &CpuInfo.Ecx, sizeof( UINT32 ) );
+    memcpy( &Info->Signature[8], &CpuInfo.Edx, sizeof( UINT32 ) );
+    Info->MaxLeaf = CpuInfo.Eax;
+    Info->Hypervisor = PifpClassifyHypervisor( &CpuInfo );
+
+    switch (Info->Hypervisor)
+    {
+    case PifHypervisorKvm:
+        PifpDecodeKvm( Context, Info );
+        break;
+
+    case PifHypervisorHyperV:
+        PifpDecodeHyperV( Context, Info );
+        break;
+
+    case PifHypervisorXen:
+        PifpDecodeXen( Context, Info );
+        break;
+
+    default:
+        break;
+    }
+
+    //
+    // The generic timing leaf defined by VMware and also implemented by KVM,
+    // bhyve, VirtualBox and ACRN. Hyper-V and Xen use the range differently.
+    //
+    if (Info->Hypervisor != PifHypervisorHyperV && Info->Hypervisor != PifHypervisorXen &&
+        SUCCESS( PifContextQueryLeaf( Context, HV_LEAF( Info, CPUID_HV_TIMER_INFO ), 0, &CpuInfo ) ))
+    {
+        Info->TscFrequencyKhz = CpuInfo.Eax;
+        Info->ApicFrequencyKhz = CpuInfo.Ebx;
+    }
+
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifGetHypervisorInfo(
+    OUT PPIF_HYPERVISOR_INFO Info
+)
+{
+    return PifContextGetHypervisorInfo( PifGetDefaultContext( ), Info );
+}
+
+PIF_CLOCK_SOURCE
+PIFAPI
+PifContextGetPreferredClockSource(
+    IN PCPIF_CONTEXT Context
+)
+{
+    PIF_HYPERVISOR_INFO Info;
+
+    if (!SUCCESS( PifContextGetHypervisorInfo( Context, &Info ) ))
+    {
+        return PifClockSourceOs;
+    }
+
+    //
+    // A guest only sees an invariant TSC when the hypervisor guarantees it
+    // (KVM hides it unless the VM cannot migrate), so it is trusted unless
+    // the hypervisor says it traps RDTSC.
+    //
+    if ((Info.Flags & (PIF_HV_INVARIANT_TSC | PIF_HV_TSC_EMULATED)) == PIF_HV_INVARIANT_TSC)
+    {
+        return PifClockSourceTsc;
+    }
+
+    if ((Info.Flags & (PIF_HV_KVM_CLOCK | PIF_HV_KVM_CLOCK_STABLE)) == (PIF_HV_KVM_CLOCK | PIF_HV_KVM_CLOCK_STABLE))
+    {
+        return PifClockSourceKvmClock;
+    }
+
+    if ((Info.Flags & PIF_HV_REFERENCE_TSC) != 0)
+    {
+        return PifClockSourceHyperVTsc;
+    }
+
+    return PifClockSourceOs;
+}
+
+PIF_CLOCK_SOURCE
+PIFAPI
+PifGetPreferredClockSource(
+    VOID
+)
+{
+    return PifContextGetPreferredClockSource( PifGetDefaultContext( ) );
+}
+
+PCSTR
+PIFAPI
+PifGetHypervisorName(
+    IN PIF_HYPERVISOR Hypervisor
+)
+{
+    if ((UINT32)Hypervisor >= PifHypervisorMax)
+    {
+        return NULL;
+    }
+
+    return PifHypervisorNames[Hypervisor];
+}
+
+PCSTR
+PIFAPI
+PifGetClockSourceName(
+    IN PIF_CLOCK_SOURCE ClockSource
+)
+{
+    if ((UINT32)ClockSource >= RTL_NUMBER_OF_V1( PifClockSourceNames ))
+    {
+        return NULL;
+    }
+
+    return PifClockSourceNames[ClockSource];
+}
@@ -30,9 +30,10 @@ SECTION .text
 ;
 global ASM_PFX(__cpuid)
 ASM_PFX(__cpuid):
+    push    ebx
     push    ebp
-    mov     ebp, dword [esp + 8]
-    mov     eax, dword [esp + 0Ch]
+    mov     ebp, dword [esp + 0Ch]
+    mov     eax, dword [esp + 10h]
     xor     ecx, ecx
     cpuid
     mov     dword [ebp + 0], eax
@@ -40,6 +41,7 @@ ASM_PFX(__cpuid):
     mov     dword [ebp + 8], ecx
     mov     dword [ebp + 0Ch], edx
     pop     ebp
+    pop     ebx
     ret
 
 ;
@@ -47,14 +49,62 @@ ASM_PFX(__cpuid):
 ;
 global ASM_PFX(__cpuidex)
 ASM_PFX(__cpuidex):
+    push    ebx
     push    ebp
-    mov     ebp, dword [esp + 8]
-    mov     eax, dword [esp + 0Ch]
-    mov     ecx, dword [esp + 10h]
+    mov     ebp, dword [esp + 0Ch]
+    mov     eax, dword [esp + 10h]
+    mov     ecx, dword [esp + 14h]
     cpuid
     mov     dword [ebp + 0], eax
     mov     dword [ebp + 4], ebx
     mov     dword [ebp + 8], ecx
     mov     dword [ebp + 0Ch], edx
     pop     ebp
-    ret
\ No newline at end of file
+    pop     ebx
+    ret
+
+;
+; unsigned __int64 __cdecl _xgetbv( unsigned int _Xcr );
+;
+global ASM_PFX(_xgetbv)
+ASM_PFX(_xgetbv):
+    mov     ecx, dword [esp + 4]
+    xgetbv
+    ret
+
+;
+; unsigned __int64 __cdecl __rdtsc( void );
+;
+global ASM_PFX(__rdtsc)
+ASM_PFX(__rdtsc):
+    rdtsc
+    ret
+
+;
+; unsigned __int64 __cdecl __rdtscp( unsigned int *_Aux );
+;
+global ASM_PFX(__rdtscp)
+ASM_PFX(__rdtscp):
+    push    ebx
+    rdtscp
+    mov     ebx, dword [esp + 8]
+    mov     dword [ebx], ecx
+    pop     ebx
+    ret
+
+;
+; unsigned __int64 __cdecl __readpmc( unsigned long _Counter );
+;
+global ASM_PFX(__readpmc)
+ASM_PFX(__readpmc):
+    mov     ecx, dword [esp + 4]
+    rdpmc
+    ret
+
+;
+; void __cdecl _mm_lfence( void );
+;
+global ASM_PFX(_mm_lfence)
+ASM_PFX(_mm_lfence):
+    lfence
+    ret
@@ -0,0 +1,236 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file level.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#include "pifp.h"
+
+#include <stdio.h>
+#include <string.h>
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+//
+// Features added by each level over the previous one, as defined by the
+// x86-64 psABI. OSFXSR cannot be observed from user mode and is implied by
+// SSE being usable at all.
+//
+static CONST UINT32 PifLevelFeatureIds[PifX86_64LevelMax + 1][10] = {
+    [PifX86_64LevelV1] = {
+        PifFeatureCMOV, PifFeatureCMPXCHG8B, PifFeatureFPU, PifFeatureFXSR, PifFeatureMMX,
+        PifFeatureSYSCALL, PifFeatureSSE, PifFeatureSSE2, PifFeatureLONGMODE
+    },
+    [PifX86_64LevelV2] = {
+        PifFeatureCMPXCHG16B, PifFeatureLAHF_LM, PifFeaturePOPCNT, PifFeatureSSE3,
+        PifFeatureSSE41, PifFeatureSSE42, PifFeatureSSSE3
+    },
+    [PifX86_64LevelV3] = {
+        PifFeatureAVX, PifFeatureAVX2, PifFeatureBMI1, PifFeatureBMI2, PifFeatureF16C,
+        PifFeatureFMA, PifFeatureLZCNT, PifFeatureMOVBE, PifFeatureOSXSAVE
+    },
+    [PifX86_64LevelV4] = {
+        PifFeatureAVX512F, PifFeatureAVX512BW, PifFeatureAVX512CD, PifFeatureAVX512DQ,
+        PifFeatureAVX512VL
+    },
+};
+
+static CONST UINT32 PifLevelFeatureCount[PifX86_64LevelMax + 1] = {
+    0, 9, 7, 9, 5
+};
+
+static CONST CHAR *CONST PifLevelNames[PifX86_64LevelMax + 1] = {
+    "none", "x86-64", "x86-64-v2", "x86-64-v3", "x86-64-v4"
+};
+
+
+STATUS
+PIFAPI
+PifGetLevelFeatures(
+    IN PIF_X86_64_LEVEL Level,
+    OUT PPIF_FEATURES Features
+)
+{
+    UINT32 Current;
+    UINT32 Index;
+
+    if (Features == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if ((UINT32)Level > PifX86_64LevelMax)
+    {
+        return E_BOUNDS;
+    }
+
+    memset( Features, 0, sizeof( *Features ) );
+    for (Current = PifX86_64LevelV1; Current <= (UINT32)Level; ++Current)
+    {
+        for (Index = 0; Index < PifLevelFeatureCount[Current]; ++Index)
+        {
+            PifFeaturesSet( Features, PifLevelFeatureIds[Current][Index] );
+        }
+    }
+
+    return STATUS_OK;
+}
+
+PIF_X86_64_LEVEL
+PIFAPI
+PifClassifyLevel(
+    IN CONST PIF_FEATURES *Features
+)
+{
+    PIF_FEATURES Required;
+    UINT32 Level;
+
+    //
+    // Levels are cumulative, so the first level not fully present ends the
+    // search.
+    //
+    for (Level = PifX86_64LevelV1; Level <= PifX86_64LevelMax; ++Level)
+    {
+        PifGetLevelFeatures( (PIF_X86_64_LEVEL)Level, &Required );
+        if (!PifFeaturesIsSubset( &Required, Features ))
+        {
+            break;
+        }
+    }
+
+    return (PIF_X86_64_LEVEL)(Level - 1);
+}
+
+PIF_X86_64_LEVEL
+PIFAPI
+PifGetLevel(
+    VOID
+)
+{
+    return PifClassifyLevel( &PifUsableFeatures );
+}
+
+STATUS
+PIFAPI
+PifGetMissingLevelFeatures(
+    IN PIF_X86_64_LEVEL Level,
+    OUT PPIF_FEATURES Missing
+)
+{
+    PIF_FEATURES Required;
+    STATUS Status;
+
+    if (Missing == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    Status = PifGetLevelFeatures( Level, &Required );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    PifFeaturesDifference( Missing, &Required, &PifUsableFeatures );
+    return STATUS_OK;
+}
+
+PCSTR
+PIFAPI
+PifGetLevelName(
+    IN PIF_X86_64_LEVEL Level
+)
+{
+    if ((UINT32)Level > PifX86_64LevelMax)
+    {
+        return NULL;
+    }
+
+    return PifLevelNames[Level];
+}
+
+#if defined(__linux__)
+
+STATUS
+PIFAPI
+PifExecBestVariant(
+    IN CONST CHAR *Directory,
+    IN CONST CHAR *Name,
+    IN CHAR *CONST *Argv
+)
+{
+    CHAR Path[4096];
+    UINT32 Level;
+    int Length;
+
+    if (Directory == NULL || Name == NULL || Argv == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    //
+    // A variant that exists but fails to execute falls through to the next
+    // lower level.
+    //
+    for (Level = PifGetLevel( ); Level >= PifX86_64LevelV2; --Level)
+    {
+        Length = snprintf( Path, sizeof( Path ), "%s/%s/%s", Directory, PifLevelNames[Level], Name );
+        if (Length < 0 || (SIZE_T)Length >= sizeof( Path ))
+        {
+            return E_OVERFLOW;
+        }
+
+        if (access( Path, X_OK ) == 0)
+        {
+            execv( Path, Argv );
+        }
+    }
+
+    Length = snprintf( Path, sizeof( Path ), "%s/%s", Directory, Name );
+    if (Length < 0 || (SIZE_T)Length >= sizeof( Path ))
+    {
+        return E_OVERFLOW;
+    }
+
+    if (access( Path, X_OK ) != 0)
+    {
+        return E_NOSUCHFILE;
+    }
+
+    execv( Path, Argv );
+    return E_EXECUTE;
+}
+
+#else
+
+STATUS
+PIFAPI
+PifExecBestVariant(
+    IN CONST CHAR *Directory,
+    IN CONST CHAR *Name,
+    IN CHAR *CONST *Argv
+)
+{
+    (VOID)Directory;
+    (VOID)Name;
+    (VOID)Argv;
+    return E_UNSUPPORTED;
+}
+
+#endif // __linux__
@@ -1,21 +1,288 @@
 #include "arch.h"
 #include "pif.h"
+#include "output.h"
 
 #include <stdio.h>
+#include <string.h>
 
+//
+// The Has* tests fold in the features implied by the build target, which a
+// replayed processor need not have, so the report tests the captured words.
+//
+#define FeatureSupportedMessage(Features, _XX) \
+    printf( #_XX " is%s\n", PifFeaturesTest( (Features), PifFeature##_XX ) ? " supported" : " not supported" )
 
-STATUS main( )
+
+//
+// Initializes from a CPUID dump if one is given, otherwise from the host,
+// capturing every processor where supported when AllCpus is set.
+//
+static
+STATUS
+Initialize(
+    IN PCSTR ReplayPath OPTIONAL,
+    IN BOOLEAN AllCpus
+)
 {
     STATUS Status;
+
+    if (ReplayPath != NULL)
+    {
+        Status = PifInitializeFromCpuidDump( ReplayPath );
+        if (!SUCCESS( Status ))
+        {
+            fprintf( stderr, "Failed to replay %s (%d)\n", ReplayPath, Status );
+        }
+        return Status;
+    }
+
+    if (AllCpus)
+    {
+        Status = PifInitializeAllCpus( );
+        if (Status != E_UNSUPPORTED)
+        {
+            return Status;
+        }
+    }
+
+    return PifEnsureInitialized( );
+}
+
+//
+// Writes the whole report through the structured output writer: identity,
+// every named feature, topology and caches.
+//
+static
+STATUS
+Report(
+    IN OUTPUT_FORMAT Format
+)
+{
+    static CONST CHAR *CONST CacheTypeNames[] = { "null", "data", "instruction", "unified" };
+    CHAR Buffer[32768];
+    OUTPUT Output;
     CHAR VendorString[16];
     CHAR BrandString[64];
+    PIF_CPU_SIGNATURE Signature = { 0 };
+    PCPIF_UARCH_INFO Uarch;
+    PIF_HYPERVISOR_INFO Hypervisor;
+    CONST PIF_TOPOLOGY *Topology;
+    CONST PIF_CACHE_HIERARCHY *Hierarchy;
+    PCPIF_CACHE_DESCRIPTOR Cache;
+    PCSTR Name;
+    UINT32 Index;
+    STATUS Status;
 
-    Status = PifInitialize( );
+    Status = PifGetVendorString( VendorString, sizeof( VendorString ) );
+    if (SUCCESS( Status ))
+    {
+        Status = PifGetBrandString( BrandString, sizeof( BrandString ) );
+    }
     if (!SUCCESS( Status ))
     {
         return Status;
     }
 
+    OutputInitialize( &Output, Format, Buffer, sizeof( Buffer ) );
+    OutputBeginObject( &Output, NULL );
+
+    OutputString( &Output, "vendor", VendorString );
+    OutputString( &Output, "vendor_name", PifGetVendorName( PifGetVendor( ) ) );
+    OutputString( &Output, "brand", BrandString );
+
+    PifGetSignature( &Signature );
+    OutputUnsigned( &Output, "family", Signature.Family );
+    OutputUnsigned( &Output, "model", Signature.Model );
+    OutputUnsigned( &Output, "stepping", Signature.Stepping );
+
+    Uarch = PifGetMicroarchitecture( );
+    OutputBeginObject( &Output, "uarch" );
+    OutputString( &Output, "name", Uarch->Name );
+    OutputUnsigned( &Output, "vector_width", Uarch->VectorWidth );
+    OutputBoolean( &Output, "avx512_downclock", (BOOLEAN)((Uarch->Flags & PIF_UARCH_AVX512_DOWNCLOCK) != 0) );
+    OutputBoolean( &Output, "avx512_split", (BOOLEAN)((Uarch->Flags & PIF_UARCH_AVX512_SPLIT) != 0) );
+    OutputBoolean( &Output, "fast_rep_movsb", (BOOLEAN)((Uarch->Flags & PIF_UARCH_FAST_REP_MOVSB) != 0) );
+    OutputBoolean( &Output, "fast_short_rep_movsb",
+                   (BOOLEAN)((Uarch->Flags & PIF_UARCH_FAST_SHORT_REP_MOVSB) != 0) );
+    OutputBoolean( &Output, "hybrid", (BOOLEAN)((Uarch->Flags & PIF_UARCH_HYBRID) != 0) );
+    OutputBoolean( &Output, "slow_gather", (BOOLEAN)((Uarch->Flags & PIF_UARCH_SLOW_GATHER) != 0) );
+    OutputEndObject( &Output );
+
+    if (SUCCESS( PifGetHypervisorInfo( &Hypervisor ) ))
+    {
+        OutputBeginObject( &Output, "hypervisor" );
+        OutputString( &Output, "name", PifGetHypervisorName( Hypervisor.Hypervisor ) );
+        OutputString( &Output, "signature", Hypervisor.Signature );
+        OutputUnsigned( &Output, "version_major", Hypervisor.VersionMajor );
+        OutputUnsigned( &Output, "version_minor", Hypervisor.VersionMinor );
+        OutputUnsigned( &Output, "tsc_khz", Hypervisor.TscFrequencyKhz );
+        OutputUnsigned( &Output, "apic_khz", Hypervisor.ApicFrequencyKhz );
+        OutputBoolean( &Output, "invariant_tsc", (BOOLEAN)((Hypervisor.Flags & PIF_HV_INVARIANT_TSC) != 0) );
+        OutputBoolean( &Output, "tsc_emulated", (BOOLEAN)((Hypervisor.Flags & PIF_HV_TSC_EMULATED) != 0) );
+        OutputString( &Output, "clock_source", PifGetClockSourceName( PifGetPreferredClockSource( ) ) );
+        OutputEndObject( &Output );
+    }
+
+    OutputString( &Output, "level", PifGetLevelName( PifGetLevel( ) ) );
+    OutputUnsigned( &Output, "xcr0", PifXfeatureEnabledMask );
+
+    OutputBeginObject( &Output, "features" );
+    for (Index = 0; Index < PIF_FEATURE_BITS; ++Index)
+    {
+        Name = PifGetFeatureName( Index );
+        if (Name != NULL)
+        {
+            OutputBoolean( &Output, Name, PifFeaturesTest( &PifFeatures, Index ) );
+        }
+    }
+    OutputEndObject( &Output );
+
+    OutputBeginObject( &Output, "usable" );
+    for (Index = 0; Index < PIF_FEATURE_BITS; ++Index)
+    {
+        Name = PifGetFeatureName( Index );
+        if (Name != NULL)
+        {
+            OutputBoolean( &Output, Name, PifFeaturesTest( &PifUsableFeatures, Index ) );
+        }
+    }
+    OutputEndObject( &Output );
+
+    if (SUCCESS( PifGetTopology( &Topology ) ))
+    {
+        OutputBeginObject( &Output, "topology" );
+        OutputUnsigned( &Output, "packages", Topology->PackageCount );
+        OutputUnsigned( &Output, "dies", Topology->DieCount );
+        OutputUnsigned( &Output, "cores", Topology->CoreCount );
+        OutputUnsigned( &Output, "logical_cpus", Topology->LogicalCpuCount );
+        OutputBeginArray( &Output, "cpus" );
+        for (Index = 0; Index < Topology->LogicalCpuCount; ++Index)
+        {
+            CONST PIF_CPU_TOPOLOGY *Cpu = &Topology->Cpus[Topology->CpuList[Index]];
+
+            OutputBeginObject( &Output, NULL );
+            OutputUnsigned( &Output, "cpu", Topology->CpuList[Index] );
+            OutputUnsigned( &Output, "apic_id", Cpu->ApicId );
+            OutputUnsigned( &Output, "package", Cpu->PackageIndex );
+            OutputUnsigned( &Output, "die", Cpu->DieIndex );
+            OutputUnsigned( &Output, "core", Cpu->CoreIndex );
+            OutputUnsigned( &Output, "smt", Cpu->SmtId );
+            OutputEndObject( &Output );
+        }
+        OutputEndArray( &Output );
+        OutputEndObject( &Output );
+    }
+
+    if (SUCCESS( PifGetCacheHierarchy( &Hierarchy ) ))
+    {
+        OutputBeginArray( &Output, "caches" );
+        for (Index = 0; Index < Hierarchy->CacheCount; ++Index)
+        {
+            Cache = &Hierarchy->Caches[Index];
+
+            OutputBeginObject( &Output, NULL );
+            OutputUnsigned( &Output, "level", Cache->Level );
+            OutputString( &Output, "type", CacheTypeNames[Cache->Type & 3] );
+            OutputUnsigned( &Output, "size", Cache->Size );
+            OutputUnsigned( &Output, "ways", Cache->Ways );
+            OutputUnsigned( &Output, "line_size", Cache->LineSize );
+            OutputUnsigned( &Output, "sets", Cache->Sets );
+            OutputUnsigned( &Output, "max_sharing_cpus", Cache->MaxSharingCpus );
+            OutputUnsigned( &Output, "instances", Cache->InstanceCount );
+            OutputBoolean( &Output, "inclusive", (BOOLEAN)((Cache->Flags & PIF_CACHE_INCLUSIVE) != 0) );
+            OutputBoolean( &Output, "fully_associative",
+                           (BOOLEAN)((Cache->Flags & PIF_CACHE_FULLY_ASSOCIATIVE) != 0) );
+            OutputBoolean( &Output, "complex_indexing",
+                           (BOOLEAN)((Cache->Flags & PIF_CACHE_COMPLEX_INDEXING) != 0) );
+            OutputEndObject( &Output );
+        }
+        OutputEndArray( &Output );
+    }
+
+    OutputEndObject( &Output );
+    return OutputWrite( &Output, stdout );
+}
+
+STATUS main( int argc, char *argv[] )
+{
+    STATUS Status;
+    CHAR VendorString[16];
+    CHAR BrandString[64];
+    PIF_X86_64_LEVEL Level;
+    PCPIF_FEATURES Features;
+    PIF_FEATURES Missing;
+    PIF_CPU_SIGNATURE Signature;
+    PIF_HYPERVISOR_INFO Hypervisor;
+    UINT32 Id;
+    PCSTR ReplayPath = NULL;
+    PCSTR SnapshotPath = NULL;
+    OUTPUT_FORMAT Format = OutputFormatText;
+    BOOLEAN FormatGiven = FALSE;
+    int Arg;
+
+    for (Arg = 1; Arg < argc; ++Arg)
+    {
+        if (strncmp( argv[Arg], "--format=", 9 ) == 0)
+        {
+            if (!SUCCESS( OutputParseFormat( argv[Arg] + 9, &Format ) ))
+            {
+                break;
+            }
+            FormatGiven = TRUE;
+        }
+        else if (Arg + 1 < argc && strcmp( argv[Arg], "--replay" ) == 0)
+        {
+            ReplayPath = argv[++Arg];
+        }
+        else if (Arg + 1 < argc && strcmp( argv[Arg], "--save-snapshot" ) == 0)
+        {
+            SnapshotPath = argv[++Arg];
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (Arg != argc)
+    {
+        fprintf( stderr, "Usage: CpuInfo [--format=text|json|csv|kv] [--replay CPUID_DUMP] [--save-snapshot FILE]\n" );
+        return E_INVALID;
+    }
+
+    //
+    // Structured reports include the topology and cache instances, which
+    // need every processor captured.
+    //
+    Status = Initialize( ReplayPath, (BOOLEAN)(SnapshotPath != NULL || Format != OutputFormatText) );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    //
+    // Saving a snapshot only prints a report when a format was requested.
+    //
+    if (SnapshotPath != NULL)
+    {
+        Status = PifSaveSnapshot( PifGetDefaultContext( ), SnapshotPath );
+        if (!SUCCESS( Status ))
+        {
+            fprintf( stderr, "Failed to save snapshot to %s (%d)\n", SnapshotPath, Status );
+            return Status;
+        }
+
+        if (!FormatGiven)
+        {
+            return Status;
+        }
+    }
+
+    if (Format != OutputFormatText)
+    {
+        return Report( Format );
+    }
+
     Status = PifGetVendorString( VendorString, sizeof( VendorString ) );
     if (!SUCCESS( Status ))
     {
@@ -29,62 +296,96 @@ STATUS main( )
     }
     
     printf( "Vendor is %s\n", VendorString );
-    printf( "\t%s\n\n", BrandString );
-
-    IsFeatureSupportedMessage( 3DNOW );
-    IsFeatureSupportedMessage( 3DNOWEXT );
-    IsFeatureSupportedMessage( ABM );
-    IsFeatureSupportedMessage( ADX );
-    IsFeatureSupportedMessage( AES );
-    IsFeatureSupportedMessage( AVX );
-    IsFeatureSupportedMessage( AVX2 );
-    IsFeatureSupportedMessage( AVX512CD );
-    IsFeatureSupportedMessage( AVX512F );
-    IsFeatureSupportedMessage( AVX512PF );
-    IsFeatureSupportedMessage( BMI1 );
-    IsFeatureSupportedMessage( BMI2 );
-    IsFeatureSupportedMessage( CLFSH );
-    IsFeatureSupportedMessage( CMPXCHG16B );
-    IsFeatureSupportedMessage( CMPXCHG8B );
-    IsFeatureSupportedMessage( ERMS );
-    IsFeatureSupportedMessage( F16C );
-    IsFeatureSupportedMessage( FMA );
-    IsFeatureSupportedMessage( FSGSBASE );
-    IsFeatureSupportedMessage( FXSR );
-    IsFeatureSupportedMessage( HLE );
-    IsFeatureSupportedMessage( INVPCID );
-    IsFeatureSupportedMessage( LAHF_LM );
-    IsFeatureSupportedMessage( LZCNT );
-    IsFeatureSupportedMessage( MMX );
-    IsFeatureSupportedMessage( MMXEXT );
-    IsFeatureSupportedMessage( MONITOR );
-    IsFeatureSupportedMessage( VMX );
-    IsFeatureSupportedMessage( SMX );
-    IsFeatureSupportedMessage( EIST );
-    IsFeatureSupportedMessage( MOVBE );
-    IsFeatureSupportedMessage( MSR );
-    IsFeatureSupportedMessage( OSXSAVE );
-    IsFeatureSupportedMessage( PCLMULQDQ );
-    IsFeatureSupportedMessage( POPCNT );
-    IsFeatureSupportedMessage( PREFETCHWT1 );
-    IsFeatureSupportedMessage( RDPID );
-    IsFeatureSupportedMessage( RDRAND );
-    IsFeatureSupportedMessage( RDSEED );
-    IsFeatureSupportedMessage( RDTSCP );
-    IsFeatureSupportedMessage( RTM );
-    IsFeatureSupportedMessage( SEP );
-    IsFeatureSupportedMessage( SHA );
-    IsFeatureSupportedMessage( SSE );
-    IsFeatureSupportedMessage( SSE2 );
-    IsFeatureSupportedMessage( SSE3 );
-    IsFeatureSupportedMessage( SSE41 );
-    IsFeatureSupportedMessage( SSE42 );
-    IsFeatureSupportedMessage( SSE4a );
-    IsFeatureSupportedMessage( SSSE3 );
-    IsFeatureSupportedMessage( SYSCALL );
-    IsFeatureSupportedMessage( TBM );
-    IsFeatureSupportedMessage( XOP );
-    IsFeatureSupportedMessage( XSAVE );
+    printf( "\t%s\n", BrandString );
+
+    if (SUCCESS( PifGetSignature( &Signature ) ))
+    {
+        printf( "\tFamily 0x%X, model 0x%X, stepping 0x%X (%s)\n",
+                Signature.Family, Signature.Model, Signature.Stepping, PifGetMicroarchitecture( )->Name );
+    }
+    if (SUCCESS( PifGetHypervisorInfo( &Hypervisor ) ) && Hypervisor.Hypervisor != PifHypervisorNone)
+    {
+        printf( "\tRunning under %s, preferred clock source %s\n",
+                PifGetHypervisorName( Hypervisor.Hypervisor ),
+                PifGetClockSourceName( PifGetPreferredClockSource( ) ) );
+    }
+    printf( "\n" );
+
+    Features = PifContextGetFeatures( PifGetDefaultContext( ) );
+    FeatureSupportedMessage( Features, 3DNOW );
+    FeatureSupportedMessage( Features, 3DNOWEXT );
+    FeatureSupportedMessage( Features, ABM );
+    FeatureSupportedMessage( Features, ADX );
+    FeatureSupportedMessage( Features, AES );
+    FeatureSupportedMessage( Features, AVX );
+    FeatureSupportedMessage( Features, AVX2 );
+    FeatureSupportedMessage( Features, AVX512CD );
+    FeatureSupportedMessage( Features, AVX512F );
+    FeatureSupportedMessage( Features, AVX512PF );
+    FeatureSupportedMessage( Features, BMI1 );
+    FeatureSupportedMessage( Features, BMI2 );
+    FeatureSupportedMessage( Features, CLFSH );
+    FeatureSupportedMessage( Features, CMPXCHG16B );
+    FeatureSupportedMessage( Features, CMPXCHG8B );
+    FeatureSupportedMessage( Features, ERMS );
+    FeatureSupportedMessage( Features, F16C );
+    FeatureSupportedMessage( Features, FMA );
+    FeatureSupportedMessage( Features, FSGSBASE );
+    FeatureSupportedMessage( Features, FXSR );
+    FeatureSupportedMessage( Features, HLE );
+    FeatureSupportedMessage( Features, INVPCID );
+    FeatureSupportedMessage( Features, LAHF_LM );
+    FeatureSupportedMessage( Features, LZCNT );
+    FeatureSupportedMessage( Features, MMX );
+    FeatureSupportedMessage( Features, MMXEXT );
+    FeatureSupportedMessage( Features, MONITOR );
+    FeatureSupportedMessage( Features, VMX );
+    FeatureSupportedMessage( Features, SMX );
+    FeatureSupportedMessage( Features, EIST );
+    FeatureSupportedMessage( Features, MOVBE );
+    FeatureSupportedMessage( Features, MSR );
+    FeatureSupportedMessage( Features, OSXSAVE );
+    FeatureSupportedMessage( Features, PCLMULQDQ );
+    FeatureSupportedMessage( Features, POPCNT );
+    FeatureSupportedMessage( Features, PREFETCHWT1 );
+    FeatureSupportedMessage( Features, RDPID );
+    FeatureSupportedMessage( Features, RDRAND );
+    FeatureSupportedMessage( Features, RDSEED );
+    FeatureSupportedMessage( Features, RDTSCP );
+    FeatureSupportedMessage( Features, RTM );
+    FeatureSupportedMessage( Features, SEP );
+    FeatureSupportedMessage( Features, SHA );
+    FeatureSupportedMessage( Features, SSE );
+    FeatureSupportedMessage( Features, SSE2 );
+    FeatureSupportedMessage( Features, SSE3 );
+    FeatureSupportedMessage( Features, SSE41 );
+    FeatureSupportedMessage( Features, SSE42 );
+    FeatureSupportedMessage( Features, SSE4a );
+    FeatureSupportedMessage( Features, SSSE3 );
+    FeatureSupportedMessage( Features, SYSCALL );
+    FeatureSupportedMessage( Features, TBM );
+    FeatureSupportedMessage( Features, XOP );
+    FeatureSupportedMessage( Features, XSAVE );
+
+    //
+    // Report the x86-64 micro-architecture level and what the next one lacks.
+    //
+    Level = PifGetLevel( );
+    printf( "\nx86-64 level is %s\n", PifGetLevelName( Level ) );
+
+    if (Level < PifX86_64LevelMax &&
+        SUCCESS( PifGetMissingLevelFeatures( (PIF_X86_64_LEVEL)(Level + 1), &Missing ) ))
+    {
+        printf( "\t%s is missing:", PifGetLevelName( (PIF_X86_64_LEVEL)(Level + 1) ) );
+        for (Id = 0; Id < PIF_FEATURE_BITS; ++Id)
+        {
+            if (PifFeaturesTest( &Missing, Id ))
+            {
+                printf( " %s", PifGetFeatureName( Id ) );
+            }
+        }
+        printf( "\n" );
+    }
 
     return Status;
 }
\ No newline at end of file
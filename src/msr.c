@@ -0,0 +1,483 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file msr.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#if defined(__linux__) && !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64 // MSR indices above 0x7FFFFFFF as pread offsets
+#endif
+
+#include "pifp.h"
+
+#if defined(__linux__)
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PIF_MSR_DEFAULT_ROOT    "/dev/cpu"
+
+//
+// Upper bound on processor numbers accepted from the device root.
+//
+#define PIF_MSR_MAX_CPUS        65536
+
+//
+// Longest path of a processor's MSR file, Root/N/msr.
+//
+#define PIF_MSR_MAX_PATH        4096
+
+struct _PIF_MSR_DEVICE {
+    UINT32 CpuCount;
+    UINT32 OffsetShift;         //!< 3 in a fake tree of regular files, where MSRs are 8 bytes apart
+    volatile UINT32 *Files;     //!< Descriptor + 1 of each processor's file, 0 until opened
+    CHAR *Root;
+};
+
+static
+STATUS
+PifpMsrStatusFromErrno(
+    IN int Error
+)
+{
+    switch (Error)
+    {
+    case EACCES:
+    case EPERM:
+    case EBADF:
+        return E_ACCESS;
+    case ENOENT:
+        return E_NOSUCHDRIVER;
+    case ENXIO:
+    case ENODEV:
+        return E_NOSUCHDEVICE;
+    case ENOMEM:
+        return E_NOMEM;
+    default:
+        return E_IO;
+    }
+}
+
+//
+// Returns the descriptor of a processor's MSR file, opening it on first use.
+// Threads racing to open the same file keep whichever descriptor is
+// published first.
+//
+static
+STATUS
+PifpGetMsrFile(
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    OUT int *Fd
+)
+{
+    CHAR Path[PIF_MSR_MAX_PATH];
+    UINT32 File;
+    int NewFd;
+
+    if (Cpu >= Device->CpuCount)
+    {
+        return E_BOUNDS;
+    }
+
+    File = PifLoadAcquire32( &Device->Files[Cpu] );
+    if (File != 0)
+    {
+        *Fd = (int)(File - 1);
+        return STATUS_OK;
+    }
+
+    snprintf( Path, sizeof( Path ), "%s/%u/msr", Device->Root, Cpu );
+
+    //
+    // Writing needs the file open for writing, reading alone does not.
+    //
+    NewFd = open( Path, O_RDWR | O_CLOEXEC );
+    if (NewFd < 0 && (errno == EACCES || errno == EPERM || errno == EROFS))
+    {
+        NewFd = open( Path, O_RDONLY | O_CLOEXEC );
+    }
+    if (NewFd < 0)
+    {
+        return PifpMsrStatusFromErrno( errno );
+    }
+
+    File = PifCompareExchange32( &Device->Files[Cpu], (UINT32)NewFd + 1, 0 );
+    if (File != 0)
+    {
+        close( NewFd );
+        NewFd = (int)(File - 1);
+    }
+
+    *Fd = NewFd;
+    return STATUS_OK;
+}
+
+static
+STATUS
+PifpReadMsrFile(
+    IN PPIF_MSR_DEVICE Device,
+    IN int Fd,
+    IN UINT32 Msr,
+    OUT UINT64 *Value
+)
+{
+    ssize_t Transferred;
+
+    Transferred = pread( Fd, Value, sizeof( UINT64 ), (off_t)Msr << Device->OffsetShift );
+    if (Transferred == (ssize_t)sizeof( UINT64 ))
+    {
+        return STATUS_OK;
+    }
+
+    *Value = 0;
+    return (Transferred < 0) ? PifpMsrStatusFromErrno( errno ) : E_IO;
+}
+
+STATUS
+PIFAPI
+PifOpenMsrDevice(
+    IN PCSTR Root OPTIONAL,
+    OUT PPIF_MSR_DEVICE *Device
+)
+{
+    PPIF_MSR_DEVICE NewDevice;
+    struct dirent *Entry;
+    DIR *Directory;
+    struct stat FileStat;
+    CHAR Path[PIF_MSR_MAX_PATH];
+    SIZE_T RootLength;
+    UINT32 OffsetShift;
+    UINT32 CpuCount;
+    unsigned long Cpu;
+    char *End;
+
+    if (Device == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Device = NULL;
+
+    if (Root == NULL)
+    {
+        Root = PIF_MSR_DEFAULT_ROOT;
+    }
+
+    RootLength = strlen( Root );
+    if (RootLength > PIF_MSR_MAX_PATH - 32)
+    {
+        return E_BOUNDS;
+    }
+
+    Directory = opendir( Root );
+    if (Directory == NULL)
+    {
+        return (errno == ENOENT) ? E_NOSUCHDIR : (errno == ENOTDIR) ? E_NOTDIR : PifpMsrStatusFromErrno( errno );
+    }
+
+    //
+    // Processors are the numbered entries, size the descriptor table by the
+    // highest one since offline processors leave gaps.
+    //
+    CpuCount = 0;
+    while ((Entry = readdir( Directory )) != NULL)
+    {
+        if (Entry->d_name[0] < '0' || Entry->d_name[0] > '9')
+        {
+            continue;
+        }
+
+        Cpu = strtoul( Entry->d_name, &End, 10 );
+        if (*End == '\0' && Cpu < PIF_MSR_MAX_CPUS && Cpu >= CpuCount)
+        {
+            CpuCount = (UINT32)Cpu + 1;
+        }
+    }
+    closedir( Directory );
+
+    if (CpuCount == 0)
+    {
+        return E_NOSUCHDEVICE;
+    }
+
+    //
+    // The driver takes the MSR index as the offset of an 8 byte read, which
+    // would make neighbouring MSRs overlap in a regular file.
+    //
+    snprintf( Path, sizeof( Path ), "%s/%u/msr", Root, CpuCount - 1 );
+    OffsetShift = (stat( Path, &FileStat ) == 0 && S_ISREG( FileStat.st_mode )) ? 3 : 0;
+
+    NewDevice = calloc( 1, sizeof( PIF_MSR_DEVICE ) + CpuCount * sizeof( UINT32 ) + RootLength + 1 );
+    if (NewDevice == NULL)
+    {
+        return E_NOMEM;
+    }
+
+    NewDevice->CpuCount = CpuCount;
+    NewDevice->OffsetShift = OffsetShift;
+    NewDevice->Files = (volatile UINT32 *)(NewDevice + 1);
+    NewDevice->Root = (CHAR *)(NewDevice->Files + CpuCount);
+    memcpy( NewDevice->Root, Root, RootLength + 1 );
+
+    *Device = NewDevice;
+    return STATUS_OK;
+}
+
+VOID
+PIFAPI
+PifCloseMsrDevice(
+    IN PPIF_MSR_DEVICE Device OPTIONAL
+)
+{
+    UINT32 Cpu;
+
+    if (Device == NULL)
+    {
+        return;
+    }
+
+    for (Cpu = 0; Cpu < Device->CpuCount; ++Cpu)
+    {
+        if (Device->Files[Cpu] != 0)
+        {
+            close( (int)(Device->Files[Cpu] - 1) );
+        }
+    }
+
+    free( Device );
+}
+
+UINT32
+PIFAPI
+PifGetMsrDeviceCpuCount(
+    IN PPIF_MSR_DEVICE Device
+)
+{
+    return (Device != NULL) ? Device->CpuCount : 0;
+}
+
+STATUS
+PIFAPI
+PifReadMsr(
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN UINT32 Msr,
+    OUT UINT64 *Value
+)
+{
+    STATUS Status;
+    int Fd;
+
+    if (Device == NULL || Value == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Value = 0;
+
+    Status = PifpGetMsrFile( Device, Cpu, &Fd );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    return PifpReadMsrFile( Device, Fd, Msr, Value );
+}
+
+STATUS
+PIFAPI
+PifReadMsrBatch(
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN OUT PPIF_MSR_REQUEST Requests,
+    IN UINT32 RequestCount
+)
+{
+    STATUS FirstStatus;
+    STATUS Status;
+    UINT32 Index;
+    int Fd;
+
+    if (Device == NULL || (Requests == NULL && RequestCount != 0))
+    {
+        return E_NULLPARAM;
+    }
+
+    //
+    // The driver reads one MSR per pread (a longer read repeats the same
+    // MSR), so a batch is one descriptor lookup followed by back-to-back
+    // reads, each a single cross-call to the target processor.
+    //
+    Status = PifpGetMsrFile( Device, Cpu, &Fd );
+    if (!SUCCESS( Status ))
+    {
+        for (Index = 0; Index < RequestCount; ++Index)
+        {
+            Requests[Index].Status = Status;
+            Requests[Index].Value = 0;
+        }
+        return Status;
+    }
+
+    FirstStatus = STATUS_OK;
+    for (Index = 0; Index < RequestCount; ++Index)
+    {
+        Status = PifpReadMsrFile( Device, Fd, Requests[Index].Msr, &Requests[Index].Value );
+        Requests[Index].Status = Status;
+        if (!SUCCESS( Status ) && SUCCESS( FirstStatus ))
+        {
+            FirstStatus = Status;
+        }
+    }
+
+    return FirstStatus;
+}
+
+STATUS
+PIFAPI
+PifWriteMsr(
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN UINT32 Msr,
+    IN UINT64 Value
+)
+{
+    ssize_t Transferred;
+    STATUS Status;
+    int Fd;
+
+    if (Device == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    Status = PifpGetMsrFile( Device, Cpu, &Fd );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    Transferred = pwrite( Fd, &Value, sizeof( UINT64 ), (off_t)Msr << Device->OffsetShift );
+    if (Transferred == (ssize_t)sizeof( UINT64 ))
+    {
+        return STATUS_OK;
+    }
+
+    return (Transferred < 0) ? PifpMsrStatusFromErrno( errno ) : E_IO;
+}
+
+#else
+
+STATUS
+PIFAPI
+PifOpenMsrDevice(
+    IN PCSTR Root OPTIONAL,
+    OUT PPIF_MSR_DEVICE *Device
+)
+{
+    (VOID)Root;
+
+    if (Device == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Device = NULL;
+    return E_UNSUPPORTED;
+}
+
+VOID
+PIFAPI
+PifCloseMsrDevice(
+    IN PPIF_MSR_DEVICE Device OPTIONAL
+)
+{
+    (VOID)Device;
+}
+
+UINT32
+PIFAPI
+PifGetMsrDeviceCpuCount(
+    IN PPIF_MSR_DEVICE Device
+)
+{
+    (VOID)Device;
+    return 0;
+}
+
+STATUS
+PIFAPI
+PifReadMsr(
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN UINT32 Msr,
+    OUT UINT64 *Value
+)
+{
+    (VOID)Device;
+    (VOID)Cpu;
+    (VOID)Msr;
+
+    if (Value != NULL)
+    {
+        *Value = 0;
+    }
+    return E_UNSUPPORTED;
+}
+
+STATUS
+PIFAPI
+PifReadMsrBatch(
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN OUT PPIF_MSR_REQUEST Requests,
+    IN UINT32 RequestCount
+)
+{
+    (VOID)Device;
+    (VOID)Cpu;
+    (VOID)Requests;
+    (VOID)RequestCount;
+    return E_UNSUPPORTED;
+}
+
+STATUS
+PIFAPI
+PifWriteMsr(
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN UINT32 Msr,
+    IN UINT64 Value
+)
+{
+    (VOID)Device;
+    (VOID)Cpu;
+    (VOID)Msr;
+    (VOID)Value;
+    return E_UNSUPPORTED;
+}
+
+#endif
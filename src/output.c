@@ -0,0 +1,514 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * @file output.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#include "output.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+static
+BOOLEAN
+OutputReserve(
+    IN OUT POUTPUT Output,
+    IN SIZE_T Size
+)
+{
+    SIZE_T Capacity;
+    CHAR *Buffer;
+
+    if (!SUCCESS( Output->Status ))
+    {
+        return FALSE;
+    }
+    if (Output->Capacity - Output->Length >= Size)
+    {
+        return TRUE;
+    }
+
+    Capacity = Output->Capacity * 2;
+    if (Capacity < Output->Length + Size)
+    {
+        Capacity = Output->Length + Size;
+    }
+
+    if (Output->Allocated)
+    {
+        Buffer = realloc( Output->Buffer, Capacity );
+    }
+    else
+    {
+        Buffer = malloc( Capacity );
+        if (Buffer && Output->Length != 0)
+        {
+            memcpy( Buffer, Output->Buffer, Output->Length );
+        }
+    }
+    if (!Buffer)
+    {
+        Output->Status = E_NOMEM;
+        return FALSE;
+    }
+
+    Output->Buffer = Buffer;
+    Output->Capacity = Capacity;
+    Output->Allocated = TRUE;
+    return TRUE;
+}
+
+static
+VOID
+OutputAppend(
+    IN OUT POUTPUT Output,
+    IN CONST CHAR *Text,
+    IN SIZE_T Length
+)
+{
+    if (OutputReserve( Output, Length ))
+    {
+        memcpy( Output->Buffer + Output->Length, Text, Length );
+        Output->Length += Length;
+    }
+}
+
+static
+VOID
+OutputAppendChar(
+    IN OUT POUTPUT Output,
+    IN CHAR Char
+)
+{
+    if (OutputReserve( Output, 1 ))
+    {
+        Output->Buffer[Output->Length++] = Char;
+    }
+}
+
+static
+VOID
+OutputAppendUnsigned(
+    IN OUT POUTPUT Output,
+    IN UINT64 Value
+)
+{
+    CHAR Digits[20];
+    UINT32 Count = 0;
+
+    do
+    {
+        Digits[sizeof( Digits ) - ++Count] = (CHAR)('0' + Value % 10);
+        Value /= 10;
+    } while (Value != 0);
+
+    OutputAppend( Output, &Digits[sizeof( Digits ) - Count], Count );
+}
+
+//
+// Appends a string quoted and escaped as the output format requires: a JSON
+// string, a CSV field quoted only when it must be, or a key=value value that
+// runs to the end of the line and so cannot contain line breaks.
+//
+static
+VOID
+OutputAppendString(
+    IN OUT POUTPUT Output,
+    IN PCSTR Value
+)
+{
+    static CONST CHAR HexDigits[] = "0123456789abcdef";
+    CONST UINT8 *Char;
+    BOOLEAN Quote;
+
+    switch (Output->Format)
+    {
+    case OutputFormatJson:
+        OutputAppendChar( Output, '"' );
+        for (Char = (CONST UINT8 *)Value; *Char != '\0'; ++Char)
+        {
+            if (*Char == '"' || *Char == '\\')
+            {
+                OutputAppendChar( Output, '\\' );
+                OutputAppendChar( Output, (CHAR)*Char );
+            }
+            else if (*Char < 0x20)
+            {
+                OutputAppend( Output, "\\u00", 4 );
+                OutputAppendChar( Output, HexDigits[*Char >> 4] );
+                OutputAppendChar( Output, HexDigits[*Char & 0xF] );
+            }
+            else
+            {
+                OutputAppendChar( Output, (CHAR)*Char );
+            }
+        }
+        OutputAppendChar( Output, '"' );
+        break;
+
+    case OutputFormatCsv:
+        Quote = (BOOLEAN)(Value[strcspn( Value, ",\"\r\n" )] != '\0');
+        if (!Quote)
+        {
+            OutputAppend( Output, Value, strlen( Value ) );
+            break;
+        }
+        OutputAppendChar( Output, '"' );
+        for (Char = (CONST UINT8 *)Value; *Char != '\0'; ++Char)
+        {
+            if (*Char == '"')
+            {
+                OutputAppendChar( Output, '"' );
+            }
+            OutputAppendChar( Output, (CHAR)*Char );
+        }
+        OutputAppendChar( Output, '"' );
+        break;
+
+    default:
+        for (Char = (CONST UINT8 *)Value; *Char != '\0'; ++Char)
+        {
+            OutputAppendChar( Output, (*Char < 0x20) ? ' ' : (CHAR)*Char );
+        }
+        break;
+    }
+}
+
+//
+// Starts a member of the innermost scope. JSON gets the separator and member
+// name, the flat formats get the member name or array index appended to the
+// key path.
+//
+static
+VOID
+OutputBeginMember(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL
+)
+{
+    POUTPUT_SCOPE Scope;
+    CHAR Index[12];
+    SIZE_T Length;
+
+    if (Output->Depth == 0)
+    {
+        return;
+    }
+
+    Scope = &Output->Scopes[Output->Depth - 1];
+    if (Output->Format == OutputFormatJson)
+    {
+        if (Scope->Count != 0)
+        {
+            OutputAppendChar( Output, ',' );
+        }
+        if (!Scope->Array)
+        {
+            OutputAppendString( Output, (Name != NULL) ? Name : "" );
+            OutputAppendChar( Output, ':' );
+        }
+    }
+    else
+    {
+        if (Scope->Array || Name == NULL)
+        {
+            snprintf( Index, sizeof( Index ), "%u", Scope->Count );
+            Name = Index;
+        }
+
+        Length = strlen( Name );
+        if (Output->PathLength + Length + 1 >= OUTPUT_MAX_PATH)
+        {
+            Output->Status = E_OVERFLOW;
+        }
+        else
+        {
+            memcpy( &Output->Path[Output->PathLength], Name, Length );
+            Output->PathLength += (UINT32)Length;
+        }
+    }
+
+    ++Scope->Count;
+}
+
+static
+VOID
+OutputBeginScope(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL,
+    IN BOOLEAN Array
+)
+{
+    POUTPUT_SCOPE Scope;
+    UINT32 PathLength = Output->PathLength;
+
+    if (Output->Depth == OUTPUT_MAX_DEPTH)
+    {
+        Output->Status = E_OVERFLOW;
+        return;
+    }
+
+    OutputBeginMember( Output, Name );
+    if (Output->Format == OutputFormatJson)
+    {
+        OutputAppendChar( Output, Array ? '[' : '{' );
+    }
+    else if (Output->Depth != 0 && Output->PathLength + 1 < OUTPUT_MAX_PATH)
+    {
+        Output->Path[Output->PathLength++] = '.';
+    }
+
+    Scope = &Output->Scopes[Output->Depth++];
+    Scope->Array = Array;
+    Scope->Count = 0;
+    Scope->PathLength = PathLength;
+}
+
+static
+VOID
+OutputEndScope(
+    IN OUT POUTPUT Output
+)
+{
+    POUTPUT_SCOPE Scope;
+
+    if (Output->Depth == 0)
+    {
+        Output->Status = E_INVALID;
+        return;
+    }
+
+    Scope = &Output->Scopes[--Output->Depth];
+    Output->PathLength = Scope->PathLength;
+    if (Output->Format == OutputFormatJson)
+    {
+        OutputAppendChar( Output, Scope->Array ? ']' : '}' );
+        if (Output->Depth == 0)
+        {
+            OutputAppendChar( Output, '\n' );
+        }
+    }
+}
+
+//
+// Writes the value of a member: the JSON value, or one key,value or
+// key=value line with the current key path.
+//
+static
+VOID
+OutputBeginValue(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL,
+    OUT UINT32 *PathLength
+)
+{
+    *PathLength = Output->PathLength;
+    OutputBeginMember( Output, Name );
+    if (Output->Format != OutputFormatJson)
+    {
+        OutputAppend( Output, Output->Path, Output->PathLength );
+        OutputAppendChar( Output, (Output->Format == OutputFormatCsv) ? ',' : '=' );
+    }
+}
+
+static
+VOID
+OutputEndValue(
+    IN OUT POUTPUT Output,
+    IN UINT32 PathLength
+)
+{
+    if (Output->Format != OutputFormatJson)
+    {
+        OutputAppendChar( Output, '\n' );
+        Output->PathLength = PathLength;
+    }
+}
+
+STATUS
+OutputParseFormat(
+    IN PCSTR Name,
+    OUT OUTPUT_FORMAT *Format
+)
+{
+    if (strcmp( Name, "text" ) == 0)
+    {
+        *Format = OutputFormatText;
+    }
+    else if (strcmp( Name, "json" ) == 0)
+    {
+        *Format = OutputFormatJson;
+    }
+    else if (strcmp( Name, "csv" ) == 0)
+    {
+        *Format = OutputFormatCsv;
+    }
+    else if (strcmp( Name, "kv" ) == 0)
+    {
+        *Format = OutputFormatKv;
+    }
+    else
+    {
+        return E_INVALID;
+    }
+
+    return STATUS_OK;
+}
+
+VOID
+OutputInitialize(
+    OUT POUTPUT Output,
+    IN OUTPUT_FORMAT Format,
+    IN CHAR *Buffer,
+    IN SIZE_T BufferSize
+)
+{
+    Output->Format = Format;
+    Output->Status = STATUS_OK;
+    Output->Buffer = Buffer;
+    Output->Length = 0;
+    Output->Capacity = BufferSize;
+    Output->Allocated = FALSE;
+    Output->Depth = 0;
+    Output->PathLength = 0;
+
+    if (Format == OutputFormatCsv)
+    {
+        OutputAppend( Output, "key,value\n", 10 );
+    }
+}
+
+VOID
+OutputBeginObject(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL
+)
+{
+    OutputBeginScope( Output, Name, FALSE );
+}
+
+VOID
+OutputEndObject(
+    IN OUT POUTPUT Output
+)
+{
+    OutputEndScope( Output );
+}
+
+VOID
+OutputBeginArray(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL
+)
+{
+    OutputBeginScope( Output, Name, TRUE );
+}
+
+VOID
+OutputEndArray(
+    IN OUT POUTPUT Output
+)
+{
+    OutputEndScope( Output );
+}
+
+VOID
+OutputString(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL,
+    IN PCSTR Value
+)
+{
+    UINT32 PathLength;
+
+    OutputBeginValue( Output, Name, &PathLength );
+    OutputAppendString( Output, Value );
+    OutputEndValue( Output, PathLength );
+}
+
+VOID
+OutputUnsigned(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL,
+    IN UINT64 Value
+)
+{
+    UINT32 PathLength;
+
+    OutputBeginValue( Output, Name, &PathLength );
+    OutputAppendUnsigned( Output, Value );
+    OutputEndValue( Output, PathLength );
+}
+
+VOID
+OutputBoolean(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL,
+    IN BOOLEAN Value
+)
+{
+    UINT32 PathLength;
+
+    OutputBeginValue( Output, Name, &PathLength );
+    if (Output->Format == OutputFormatJson)
+    {
+        OutputAppend( Output, Value ? "true" : "false", Value ? 4 : 5 );
+    }
+    else
+    {
+        OutputAppendChar( Output, Value ? '1' : '0' );
+    }
+    OutputEndValue( Output, PathLength );
+}
+
+STATUS
+OutputWrite(
+    IN OUT POUTPUT Output,
+    IN FILE *Stream
+)
+{
+    STATUS Status = Output->Status;
+
+    if (SUCCESS( Status ) && Output->Depth != 0)
+    {
+        Status = E_INVALID;
+    }
+
+    //
+    // An unbuffered stream hands the whole report to a single write instead of
+    // splitting it into stdio buffer sized pieces.
+    //
+    if (SUCCESS( Status ) &&
+        (setvbuf( Stream, NULL, _IONBF, 0 ) != 0 ||
+         fwrite( Output->Buffer, 1, Output->Length, Stream ) != Output->Length))
+    {
+        Status = E_IO;
+    }
+
+    if (Output->Allocated)
+    {
+        free( Output->Buffer );
+    }
+    Output->Buffer = NULL;
+    Output->Length = 0;
+    Output->Capacity = 0;
+    Output->Allocated = FALSE;
+    return Status;
+}
@@ -0,0 +1,143 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * @file output.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ *
+ * @brief Structured report writer of the CpuInfo utility.
+ */
+
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+#include "arch.h"
+#include "pif.h"
+
+#include <stdio.h>
+
+#define OUTPUT_MAX_DEPTH    8
+#define OUTPUT_MAX_PATH     128
+
+typedef enum _OUTPUT_FORMAT {
+    OutputFormatText,           //!< Human readable report, not produced by this writer
+    OutputFormatJson,           //!< One JSON document
+    OutputFormatCsv,            //!< key,value records under a key,value header
+    OutputFormatKv,             //!< key=value lines
+} OUTPUT_FORMAT;
+
+typedef struct _OUTPUT_SCOPE {
+    BOOLEAN Array;
+    UINT32 Count;               //!< Members written so far
+    UINT32 PathLength;          //!< Length of the key path when the scope was opened
+} OUTPUT_SCOPE, *POUTPUT_SCOPE;
+
+/**
+ * Report under construction. Values are appended to a single buffer, which
+ * starts as caller storage and only moves to the heap if it fills up, and
+ * OutputWrite emits it with one write. The CSV and key=value formats flatten
+ * the tree into dotted keys, with array elements keyed by their index
+ * (cache.0.size).
+ */
+typedef struct _OUTPUT {
+    OUTPUT_FORMAT Format;
+    STATUS Status;              //!< First error, later calls do nothing
+    CHAR *Buffer;
+    SIZE_T Length;
+    SIZE_T Capacity;
+    BOOLEAN Allocated;
+    UINT32 Depth;
+    OUTPUT_SCOPE Scopes[OUTPUT_MAX_DEPTH];
+    UINT32 PathLength;
+    CHAR Path[OUTPUT_MAX_PATH];
+} OUTPUT, *POUTPUT;
+
+/**
+ * Parses a format name: json, csv or kv.
+ */
+STATUS
+OutputParseFormat(
+    IN PCSTR Name,
+    OUT OUTPUT_FORMAT *Format
+    );
+
+VOID
+OutputInitialize(
+    OUT POUTPUT Output,
+    IN OUTPUT_FORMAT Format,
+    IN CHAR *Buffer,
+    IN SIZE_T BufferSize
+    );
+
+//
+// Name is the member name inside an object and ignored inside an array. The
+// outermost value is the unnamed root object.
+//
+VOID
+OutputBeginObject(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL
+    );
+
+VOID
+OutputEndObject(
+    IN OUT POUTPUT Output
+    );
+
+VOID
+OutputBeginArray(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL
+    );
+
+VOID
+OutputEndArray(
+    IN OUT POUTPUT Output
+    );
+
+VOID
+OutputString(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL,
+    IN PCSTR Value
+    );
+
+VOID
+OutputUnsigned(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL,
+    IN UINT64 Value
+    );
+
+VOID
+OutputBoolean(
+    IN OUT POUTPUT Output,
+    IN PCSTR Name OPTIONAL,
+    IN BOOLEAN Value
+    );
+
+/**
+ * Writes the report to Stream with a single write and releases the buffer.
+ * Nothing may have been written to Stream before. Returns the first error encountered while building or writing it.
+ */
+STATUS
+OutputWrite(
+    IN OUT POUTPUT Output,
+    IN FILE *Stream
+    );
+
+#endif // _OUTPUT_H_
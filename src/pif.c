@@ -19,215 +19,1764 @@
  * @date 11/16/2018
  */
 
-#include "pif.h"
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // sched_getcpu, pthread_attr_setaffinity_np
+#endif
 
-#include <string.h>
+#include "pifp.h"
 
-typedef struct _CPUID_INFO {
-    UINT32 Eax, Ebx, Ecx, Edx;
-} CPUID_INFO, *PCPUID_INFO;
+#include <stdlib.h>
+#include <string.h>
 
-typedef enum _CPU_VENDOR {
-    CpuVendorUnsupported = 0,
-    CpuVendorIntel = 1,
-    CpuVendorAmd = 2,
-} CPU_VENDOR;
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
+//
+// Base leaf of each range, indexed by Leaf >> CPUID_RANGE_SHIFT.
+//
+static CONST UINT32 CpuidRangeBases[CPUID_RANGE_COUNT] = {
+    CPUID_MAX_FUNCTION,
+    CPUID_HV_VENDOR_INFO,
+    CPUID_MAX_EXTENDED_FUNCTION,
+    CPUID_CENTAUR_MAX_FUNCTION,
+};
 
-static UINT32 CpuidMaxFunction = 0;
-static UINT32 CpuidMaxExtendedFunction = 0;
-static PCPUID_INFO CpuidCache = NULL;
-static PCPUID_INFO CpuidExtendedCache = NULL;
+//
+// Context behind the global API. Readers load it with acquire semantics and
+// never lock. Publishers swap it under PifPublishLock once the topology and
+// caches derived from it are built. Replaced contexts are kept on the retired
+// list, also guarded by the lock, until PifDestroy. The lock also serializes
+// dispatch table registration against the publication that resolves them.
+//
+static PPIF_CONTEXT PifDefaultContext = NULL;
+static PPIF_CONTEXT PifRetiredContexts = NULL;
+static volatile UINT32 PifPublishLock = 0;
 
-static CPU_VENDOR CpuVendor = CpuVendorUnsupported;
-static CHAR CpuVendorString[32] = { 0 };
-static CHAR CpuBrandString[64] = { 0 };
+// Defined in pif.h and mirrored from the default context.
+PIF_FEATURES PifFeatures = { { 0 } };
+C_ASSERT( PifFeatureWordCount <= PIF_FEATURE_WORDS );
 
-// Defined in pif.h and intiialized in PifInitialize.
-UINT32 CpuidFn_00000001h_0_Ecx = 0;
-UINT32 CpuidFn_00000001h_0_Edx = 0;
+UINT64 PifXfeatureEnabledMask = 0;
+PIF_FEATURES PifUsableFeatures = { { 0 } };
 
-UINT32 CpuidFn_00000007h_0_Ebx = 0;
-UINT32 CpuidFn_00000007h_0_Ecx = 0;
-UINT32 CpuidFn_00000007h_0_Edx = 0;
+volatile UINT32 PifInitState = PIF_INIT_NONE;
+static STATUS PifInitStatus = E_NOTINITIALIZED;
 
-UINT32 CpuidFn_0000000Dh_1_Ebx = 0;
+//
+// Features whose instructions fault unless the OS enables the register state
+// they operate on in XCR0.
+//
+typedef struct _PIF_XSTATE_FEATURE {
+    PIF_FEATURE_WORD Word;
+    UINT32 Mask;
+    UINT64 Xcr0;
+} PIF_XSTATE_FEATURE;
 
-UINT32 CpuidFn_80000001h_0_Ecx = 0;
-UINT32 CpuidFn_80000001h_0_Edx = 0;
+static CONST PIF_XSTATE_FEATURE PifXstateFeatures[] = {
+    { PifFeatureWord_00000001h_0_Ecx, X86_FEATURE_AVX | X86_FEATURE_FMA | X86_FEATURE_F16C,
+      X64_XCR0_AVX_STATE },
+    { PifFeatureWord_00000007h_0_Ebx, X86_FEATURE_AVX2,
+      X64_XCR0_AVX_STATE },
+    { PifFeatureWord_00000007h_0_Ebx, X86_FEATURE_AVX512F | X86_FEATURE_AVX512DQ | X86_FEATURE_AVX512IFMA |
+                                      X86_FEATURE_AVX512PF | X86_FEATURE_AVX512ER | X86_FEATURE_AVX512CD |
+                                      X86_FEATURE_AVX512BW | X86_FEATURE_AVX512VL,
+      X64_XCR0_AVX512_STATE },
+    { PifFeatureWord_00000007h_0_Ebx, X86_FEATURE_MPX,
+      X64_XCR0_MPX_STATE },
+    { PifFeatureWord_00000007h_0_Ecx, X86_FEATURE_VAES | X86_FEATURE_VPCLMULQDQ,
+      X64_XCR0_AVX_STATE },
+    { PifFeatureWord_00000007h_0_Ecx, X86_FEATURE_AVX512VBMI1 | X86_FEATURE_AVX512VBMI2 | X86_FEATURE_AVX512VNNI |
+                                      X86_FEATURE_AVX512BITALG | X86_FEATURE_AVX512VPOPCNTDQ,
+      X64_XCR0_AVX512_STATE },
+    { PifFeatureWord_00000007h_0_Ecx, X86_FEATURE_PKU,
+      X64_XCR0_PKRU },
+    { PifFeatureWord_00000007h_0_Edx, X86_FEATURE_AVX5124VNNIW | X86_FEATURE_AVX5124FMAPS,
+      X64_XCR0_AVX512_STATE },
+    { PifFeatureWord_00000007h_0_Edx, X86_FEATURE_AMX_BF16 | X86_FEATURE_AMX_TILE | X86_FEATURE_AMX_INT8,
+      X64_XCR0_AMX_STATE },
+    { PifFeatureWord_0000000Dh_1_Eax, 0xFFFFFFFF,
+      X64_XCR0_X87 },
+    { PifFeatureWord_80000001h_0_Ecx, X86_FEATURE_XOP | X86_FEATURE_FMA4,
+      X64_XCR0_AVX_STATE },
+};
 
-UINT32 CpuidFn_80000008h_0_Ebx = 0;
 
+VOID
+PifpMaskUnusableFeatures(
+    IN OUT PPIF_FEATURES Features,
+    IN UINT64 Xcr0
+)
+{
+    UINT32 Index;
 
-#define CPU_INFO(X) \
-    CpuidCache[(X)-CPUID_MAX_FUNCTION]
+    for (Index = 0; Index < RTL_NUMBER_OF_V1( PifXstateFeatures ); ++Index)
+    {
+        if ((Xcr0 & PifXstateFeatures[Index].Xcr0) != PifXstateFeatures[Index].Xcr0)
+        {
+            Features->Words[PifXstateFeatures[Index].Word] &= ~PifXstateFeatures[Index].Mask;
+        }
+    }
+}
 
-#define CPU_EXTENDED_INFO(X) \
-    CpuidExtendedCache[(X)-CPUID_MAX_EXTENDED_FUNCTION]
+UINT64
+PifpReadXcr0(
+    IN UINT32 FeaturesEcx
+)
+{
+    //
+    // XGETBV raises #UD unless the OS has set CR4.OSXSAVE.
+    //
+    if ((FeaturesEcx & X86_FEATURE_OSXSAVE) == 0)
+    {
+        return 0;
+    }
 
+    return PifXgetbv( X64_XCR_XFEATURE_ENABLED_MASK );
+}
 
+//
+// Executes CPUID on the processor Cpu of the capture source of a context.
+// Without a source Cpu is ignored and the executing processor is used.
+//
 FORCEINLINE
-VOID
-PifpDestroy(
+STATUS
+PifpExecuteCpuid(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Cpu,
+    OUT PCPUID_INFO CpuInfo,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf
+)
+{
+    if (Context->Source != NULL)
+    {
+        return Context->Source->Cpuid( Context->Source->Parameter, Cpu, Leaf, SubLeaf, CpuInfo );
+    }
+
+    PifCpuidEx( CpuInfo, Leaf, SubLeaf );
+    return STATUS_OK;
+}
+
+
+#define CPU_LEAF(Context, X) \
+    (Context)->Ranges[(X) >> CPUID_RANGE_SHIFT].Leaves[(X)-(Context)->Ranges[(X) >> CPUID_RANGE_SHIFT].Base]
+
+#define CPU_SUBLEAF_INFO(Context, X, S) \
+    (Context)->Info[CPU_LEAF( Context, X ).Offset + (S)]
+
+#define CPU_INFO(Context, X) \
+    CPU_SUBLEAF_INFO( Context, X, 0 )
+
+#define CPU_HYPERVISOR_INFO(Context, X) \
+    CPU_SUBLEAF_INFO( Context, X, 0 )
+
+#define CPU_EXTENDED_INFO(Context, X) \
+    CPU_SUBLEAF_INFO( Context, X, 0 )
+
+#define CpuidMaxFunction(Context) \
+    (Context)->Ranges[CPUID_MAX_FUNCTION >> CPUID_RANGE_SHIFT].Max
+#define CpuidMaxHypervisorFunction(Context) \
+    (Context)->Ranges[CPUID_HV_VENDOR_INFO >> CPUID_RANGE_SHIFT].Max
+#define CpuidMaxExtendedFunction(Context) \
+    (Context)->Ranges[CPUID_MAX_EXTENDED_FUNCTION >> CPUID_RANGE_SHIFT].Max
+
+
+PPIF_CONTEXT
+PifpAllocateContext(
     VOID
 )
 {
-    if (CpuidExtendedCache != NULL)
+    PPIF_CONTEXT Context;
+    UINT32 Index;
+
+    //
+    // PIF_FEATURES is declared 64 byte aligned, which malloc does not
+    // guarantee.
+    //
+#if defined(_WIN32)
+    Context = _aligned_malloc( sizeof( PIF_CONTEXT ), SYSTEM_CACHE_ALIGNMENT_SIZE );
+#else
+    VOID *Buffer;
+
+    Context = (posix_memalign( &Buffer, SYSTEM_CACHE_ALIGNMENT_SIZE, sizeof( PIF_CONTEXT ) ) == 0) ?
+              (PPIF_CONTEXT)Buffer : NULL;
+#endif
+    if (!Context)
     {
-        free( CpuidExtendedCache );
-        CpuidExtendedCache = NULL;
+        return NULL;
     }
 
-    if (CpuidCache != NULL)
+    memset( Context, 0, sizeof( PIF_CONTEXT ) );
+    for (Index = 0; Index < CPUID_RANGE_COUNT; ++Index)
     {
-        free( CpuidCache );
-        CpuidCache = NULL;
+        Context->Ranges[Index].Base = CpuidRangeBases[Index];
     }
 
-    CpuidMaxExtendedFunction = 0;
-    CpuidMaxFunction = 0;
+    return Context;
 }
 
+VOID
+PIFAPI
+PifDestroyContext(
+    IN PPIF_CONTEXT Context OPTIONAL
+)
+{
+    if (Context == NULL)
+    {
+        return;
+    }
+
+    if (Context->Topology != &Context->SnapshotTopology)
+    {
+        PifpDestroyTopology( (PPIF_TOPOLOGY)Context->Topology );
+    }
+
+    PifpDestroyCacheHierarchy( Context->CacheHierarchy );
+
+    if (Context->Snapshot != NULL)
+    {
+        if (Context->SnapshotMapped)
+        {
+            PifpUnmapSnapshot( Context->Snapshot, Context->SnapshotSize );
+        }
+    }
+    else
+    {
+        free( Context->Ranges[0].Leaves );
+        free( Context->Info );
+        free( Context->PerCpuPresent );
+#if defined(_WIN32)
+        _aligned_free( Context->PerCpuInfo );
+#else
+        free( Context->PerCpuInfo );
+#endif
+    }
+
+#if defined(_WIN32)
+    _aligned_free( Context );
+#else
+    free( Context );
+#endif
+}
 
+static
 STATUS
-PIFAPI
-PifInitialize(
-    VOID
+PifpCaptureSubLeaf(
+    IN OUT PPIF_CONTEXT Context,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO *CpuInfo OPTIONAL
+)
+{
+    PCPUID_INFO NewInfo;
+    UINT32 NewCapacity;
+    STATUS Status;
+
+    //
+    // Grow the flat sub-leaf array geometrically. Entries are referenced by
+    // index, so moving the array is harmless.
+    //
+    if (Context->InfoCount == Context->InfoCapacity)
+    {
+        NewCapacity = (Context->InfoCapacity != 0) ? Context->InfoCapacity * 2 : 128;
+        NewInfo = realloc( Context->Info, sizeof( CPUID_INFO ) * NewCapacity );
+        if (!NewInfo)
+        {
+            return E_NOMEM;
+        }
+
+        Context->Info = NewInfo;
+        Context->InfoCapacity = NewCapacity;
+    }
+
+    Status = PifpExecuteCpuid( Context, 0, &Context->Info[Context->InfoCount], Leaf, SubLeaf );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    if (CpuInfo)
+    {
+        *CpuInfo = &Context->Info[Context->InfoCount];
+    }
+
+    ++Context->InfoCount;
+    return STATUS_OK;
+}
+
+FORCEINLINE
+UINT32
+PifpHighestBit64(
+    IN UINT64 Value
+)
+{
+    UINT32 Bit = 0;
+
+    while (Value >>= 1)
+    {
+        ++Bit;
+    }
+
+    return Bit;
+}
+
+static
+BOOLEAN
+PifpIsLastSubLeaf(
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    IN CONST CPUID_INFO *CpuInfo
+)
+{
+    switch (Leaf)
+    {
+    case CPUID_CACHE_PARAMS:
+    case CPUID_AMD_CACHE_TOPOLOGY:
+        //
+        // Cache type field is null, no more caches.
+        //
+        return (BOOLEAN)((CpuInfo->Eax & 0x1F) == 0);
+
+    case CPUID_EXTENDED_TOPOLOGY:
+    case CPUID_V2_EXTENDED_TOPOLOGY:
+        //
+        // Level type field is invalid, no more levels.
+        //
+        return (BOOLEAN)(((CpuInfo->Ecx >> 8) & 0xFF) == CPUID_EXTENDED_TOPOLOGY_LEVEL_TYPE_INVALID);
+
+    case CPUID_INTEL_SGX:
+        //
+        // EPC section sub-leaves start at 2 and end with an invalid type.
+        //
+        return (BOOLEAN)(SubLeaf >= CPUID_INTEL_SGX_CAPABILITIES_RESOURCES_SUB_LEAF &&
+                         (CpuInfo->Eax & 0x0F) == 0);
+
+    default:
+        return TRUE;
+    }
+}
+static
+STATUS
+PifpCaptureLeaf(
+    IN OUT PPIF_CONTEXT Context,
+    IN UINT32 Leaf,
+    OUT PCPUID_LEAF CpuLeaf
+)
+{
+    PCPUID_INFO CpuInfo;
+    UINT64 Mask;
+    UINT32 SubLeafCount;
+    UINT32 SubLeaf;
+    STATUS Status;
+
+    CpuLeaf->Offset = Context->InfoCount;
+    CpuLeaf->SubLeafCount = 1;
+    CpuLeaf->Flags = 0;
+
+    Status = PifpCaptureSubLeaf( Context, Leaf, 0, &CpuInfo );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    //
+    // Determine the number of sub-leaves using the architectural enumeration
+    // rule of each indexed leaf. A SubLeafCount of zero means the leaf is
+    // walked until PifpIsLastSubLeaf, and the terminating sub-leaf is kept
+    // so callers walking the cache see the same terminator as the hardware.
+    //
+    switch (Leaf)
+    {
+    case CPUID_STRUCTURED_EXTENDED_FEATURES:
+    case CPUID_INTEL_PROCESSOR_TRACE:
+    case CPUID_SOC_VENDOR:
+        //
+        // EAX of sub-leaf 0 reports the maximum valid sub-leaf.
+        //
+        SubLeafCount = CpuInfo->Eax + 1;
+        break;
+
+    case CPUID_EXTENDED_STATE:
+        //
+        // Sub-leaf N >= 2 describes state component N. Components are
+        // reported by sub-leaf 0 (XCR0) and sub-leaf 1 (IA32_XSS).
+        //
+        Mask = ((UINT64)CpuInfo->Edx << 32) | CpuInfo->Eax;
+        Status = PifpCaptureSubLeaf( Context, Leaf, CPUID_EXTENDED_STATE_SUB_LEAF, &CpuInfo );
+        if (!SUCCESS( Status ))
+        {
+            return Status;
+        }
+        Mask |= ((UINT64)CpuInfo->Edx << 32) | CpuInfo->Ecx;
+        SubLeafCount = PifpHighestBit64( Mask | 3 ) + 1;
+        break;
+
+    case CPUID_INTEL_RDT_MONITORING:
+        //
+        // EDX of sub-leaf 0 is a bitmap of the supported resource types.
+        //
+        SubLeafCount = PifpHighestBit64( CpuInfo->Edx | 1 ) + 1;
+        break;
+
+    case CPUID_INTEL_RDT_ALLOCATION:
+        //
+        // EBX of sub-leaf 0 is a bitmap of the supported resource types.
+        //
+        SubLeafCount = PifpHighestBit64( CpuInfo->Ebx | 1 ) + 1;
+        break;
+
+    case CPUID_CACHE_PARAMS:
+    case CPUID_EXTENDED_TOPOLOGY:
+    case CPUID_V2_EXTENDED_TOPOLOGY:
+    case CPUID_INTEL_SGX:
+    case CPUID_AMD_CACHE_TOPOLOGY:
+        SubLeafCount = 0;
+        break;
+
+    default:
+        return STATUS_OK;
+    }
+
+    CpuLeaf->Flags |= CPUID_LEAF_SUB_LEAF_INDEXED;
+
+    if (SubLeafCount != 0)
+    {
+        if (SubLeafCount > CPUID_MAX_SUB_LEAVES)
+        {
+            SubLeafCount = CPUID_MAX_SUB_LEAVES;
+        }
+
+        for (SubLeaf = Context->InfoCount - CpuLeaf->Offset; SubLeaf < SubLeafCount; ++SubLeaf)
+        {
+            Status = PifpCaptureSubLeaf( Context, Leaf, SubLeaf, NULL );
+            if (!SUCCESS( Status ))
+            {
+                return Status;
+            }
+        }
+    }
+    else
+    {
+        for (SubLeaf = 1;
+             SubLeaf < CPUID_MAX_SUB_LEAVES && !PifpIsLastSubLeaf( Leaf, SubLeaf - 1, CpuInfo );
+             ++SubLeaf)
+        {
+            Status = PifpCaptureSubLeaf( Context, Leaf, SubLeaf, &CpuInfo );
+            if (!SUCCESS( Status ))
+            {
+                return Status;
+            }
+        }
+    }
+
+    CpuLeaf->SubLeafCount = (UINT16)(Context->InfoCount - CpuLeaf->Offset);
+    return STATUS_OK;
+}
+
+static
+STATUS
+PifpCaptureRange(
+    IN OUT PPIF_CONTEXT Context,
+    IN PCPUID_RANGE Range,
+    IN UINT32 Max
 )
 {
     UINT32 Index;
-    CPUID_INFO CpuInfo;
+    STATUS Status;
+
+    Range->Max = Max;
+
+    //
+    // Cache the data for the CPUID functions of this range.
+    //
+    for (Index = Range->Base; Index <= Max; ++Index)
+    {
+        Status = PifpCaptureLeaf( Context, Index, &Range->Leaves[Index - Range->Base] );
+        if (!SUCCESS( Status ))
+        {
+            return Status;
+        }
+    }
+
+    return STATUS_OK;
+}
+
+static
+STATUS
+PifpCaptureLayout(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Cpu,
+    OUT PCPUID_INFO Info
+)
+{
+    CONST CPUID_RANGE *Range;
+    CONST CPUID_LEAF *CpuLeaf;
+    UINT32 Index;
+    UINT32 Leaf;
+    UINT32 SubLeaf;
     STATUS Status;
 
     //
-    // Get the number of the highest valid ID.
+    // Re-execute every (leaf, sub-leaf) pair of the snapshot layout on the
+    // processor, storing each result at the same offset.
     //
-    __cpuid( (int*)&CpuInfo, CPUID_MAX_FUNCTION );
-    CpuidMaxFunction = CpuInfo.Eax;
+    for (Index = 0; Index < CPUID_RANGE_COUNT; ++Index)
+    {
+        Range = &Context->Ranges[Index];
+        if (Range->Leaves == NULL)
+        {
+            continue;
+        }
+
+        for (Leaf = Range->Base; Leaf <= Range->Max; ++Leaf)
+        {
+            CpuLeaf = &Range->Leaves[Leaf - Range->Base];
+            for (SubLeaf = 0; SubLeaf < CpuLeaf->SubLeafCount; ++SubLeaf)
+            {
+                Status = PifpExecuteCpuid( Context, Cpu, &Info[CpuLeaf->Offset + SubLeaf], Leaf, SubLeaf );
+                if (!SUCCESS( Status ))
+                {
+                    return Status;
+                }
+            }
+        }
+    }
+
+    return STATUS_OK;
+}
+
+static
+STATUS
+PifpLookupLeaf(
+    IN PCPIF_CONTEXT Context,
+    IN CONST CPUID_INFO *Info,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO CpuInfo
+)
+{
+    CONST CPUID_RANGE *Range;
+    CONST CPUID_LEAF *CpuLeaf;
+
+    Range = &Context->Ranges[Leaf >> CPUID_RANGE_SHIFT];
+    if (Range->Leaves == NULL || Leaf < Range->Base || Leaf > Range->Max)
+    {
+        return E_NOTFOUND;
+    }
 
     //
-    // Allocate memory for the CPUID functions data.
+    // Leaves that ignore ECX return sub-leaf 0 for any sub-leaf, exactly like
+    // the CPUID instruction. Indexed leaves only serve enumerated sub-leaves.
     //
-    CpuidCache = malloc( sizeof( CPUID_INFO ) * (CpuidMaxFunction - CPUID_MAX_FUNCTION + 1) );
-    if (!CpuidCache)
+    CpuLeaf = &Range->Leaves[Leaf - Range->Base];
+    if (SubLeaf >= CpuLeaf->SubLeafCount)
     {
-        return E_NOMEM;
+        if (CpuLeaf->Flags & CPUID_LEAF_SUB_LEAF_INDEXED)
+        {
+            return E_NOTFOUND;
+        }
+
+        SubLeaf = 0;
+    }
+
+    *CpuInfo = Info[CpuLeaf->Offset + SubLeaf];
+    return STATUS_OK;
+}
+
+//
+// Selects the base of the hypervisor range. A hypervisor that implements the
+// Hyper-V interface for Windows guests (KVM, Xen) reports it at 0x40000000
+// and moves its own leaves to a higher base, so every base up to 0x40010000
+// is probed like Linux does, and the first known signature other than
+// Hyper-V wins. The maximum of each base must lie within its 0x100 window.
+//
+static
+VOID
+PifpFindHypervisorRange(
+    IN PPIF_CONTEXT Context,
+    IN OUT PCPUID_RANGE Range,
+    OUT UINT32 *MaxFunction
+)
+{
+    PIF_HYPERVISOR Hypervisor;
+    CPUID_INFO CpuInfo;
+    UINT32 Base;
+
+    *MaxFunction = 0;
+
+    for (Base = CPUID_HV_VENDOR_INFO; Base <= CPUID_HV_VENDOR_INFO + 0x10000; Base += 0x100)
+    {
+        if (!SUCCESS( PifpExecuteCpuid( Context, 0, &CpuInfo, Base, 0 ) ) ||
+            CpuInfo.Eax < Base || CpuInfo.Eax > Base + 0xFF)
+        {
+            continue;
+        }
+
+        //
+        // Fall back to the architectural base when nothing better is found.
+        //
+        if (Base == CPUID_HV_VENDOR_INFO)
+        {
+            *MaxFunction = CpuInfo.Eax;
+        }
+
+        Hypervisor = PifpClassifyHypervisor( &CpuInfo );
+        if (Hypervisor != PifHypervisorUnknown && Hypervisor != PifHypervisorHyperV)
+        {
+            Range->Base = Base;
+            *MaxFunction = CpuInfo.Eax;
+            return;
+        }
     }
+}
 
-    Status = STATUS_OK;
+static
+STATUS
+PifpCaptureContext(
+    IN OUT PPIF_CONTEXT Context
+)
+{
+    UINT32 MaxFunction[CPUID_RANGE_COUNT] = { 0 };
+    PCPUID_LEAF Leaves;
+    UINT32 LeafCount;
+    UINT32 Index;
+    UINT32 FeaturesEcx;
+    CPUID_INFO CpuInfo;
+    STATUS Status;
 
     //
-    // Cache the data for the CPUID functions.
+    // Get the number of the highest valid ID of each range. The hypervisor
+    // range is only defined when running as a guest. Older processors report
+    // garbage outside of the extended range.
     //
-    for (Index = CPUID_MAX_FUNCTION; Index <= CpuidMaxFunction; ++Index)
+    Status = PifpExecuteCpuid( Context, 0, &CpuInfo, CPUID_MAX_FUNCTION, 0 );
+    if (!SUCCESS( Status ))
     {
-        __cpuidex( (int*)&CPU_INFO( Index ), Index, 0 );
+        return Status;
     }
 
     //
-    // Capture CPU vendor.
+    // No processor comes close to this, but a replayed dump might.
     //
-    memset( CpuVendorString, 0, sizeof( CpuVendorString ) );
-    *(int*)(CpuVendorString + sizeof(int) * 0) = CPU_INFO( CPUID_SIGNATURE ).Ebx;
-    *(int*)(CpuVendorString + sizeof(int) * 1) = CPU_INFO( CPUID_SIGNATURE ).Edx;
-    *(int*)(CpuVendorString + sizeof(int) * 2) = CPU_INFO( CPUID_SIGNATURE ).Ecx;
+    if (CpuInfo.Eax > 0xFFFF)
+    {
+        return E_CPUID;
+    }
+
+    MaxFunction[CPUID_MAX_FUNCTION >> CPUID_RANGE_SHIFT] = CpuInfo.Eax;
+    Context->Vendor = PifClassifyVendor( CpuInfo.Ebx, CpuInfo.Edx, CpuInfo.Ecx );
 
-    if (strncmp( CpuVendorString, "GenuineIntel", 12 ) == 0)
+    if (MaxFunction[CPUID_MAX_FUNCTION >> CPUID_RANGE_SHIFT] >= CPUID_FEATURES &&
+        SUCCESS( PifpExecuteCpuid( Context, 0, &CpuInfo, CPUID_FEATURES, 0 ) ) &&
+        (CpuInfo.Ecx & X86_FEATURE_HYPERVISOR) != 0)
     {
-        CpuVendor = CpuVendorIntel;
+        PifpFindHypervisorRange( Context, &Context->Ranges[CPUID_HV_VENDOR_INFO >> CPUID_RANGE_SHIFT],
+                                 &MaxFunction[CPUID_HV_VENDOR_INFO >> CPUID_RANGE_SHIFT] );
     }
-    else if (strncmp( CpuVendorString, "AuthenticAMD", 12 ) == 0)
+
+    if (SUCCESS( PifpExecuteCpuid( Context, 0, &CpuInfo, CPUID_MAX_EXTENDED_FUNCTION, 0 ) ) &&
+        CpuInfo.Eax >= CPUID_MAX_EXTENDED_FUNCTION && CpuInfo.Eax <= CPUID_MAX_EXTENDED_FUNCTION + 0xFFFF)
     {
-        CpuVendor = CpuVendorAmd;
+        MaxFunction[CPUID_MAX_EXTENDED_FUNCTION >> CPUID_RANGE_SHIFT] = CpuInfo.Eax;
     }
 
     //
-    // Load bitset with flags for CPUID function 0x00000001 sub-function 0.
+    // Only Centaur and Zhaoxin define the 0xC0000000 range (PadLock and power
+    // management leaves); other vendors return unrelated data there.
     //
-    if (CpuidMaxFunction >= CPUID_FEATURES)
+    if ((Context->Vendor == PifCpuVendorCentaur || Context->Vendor == PifCpuVendorZhaoxin) &&
+        SUCCESS( PifpExecuteCpuid( Context, 0, &CpuInfo, CPUID_CENTAUR_MAX_FUNCTION, 0 ) ) &&
+        CpuInfo.Eax >= CPUID_CENTAUR_MAX_FUNCTION && CpuInfo.Eax <= CPUID_CENTAUR_MAX_FUNCTION + 0xFF)
     {
-        CpuidFn_00000001h_0_Ecx = CPU_INFO( CPUID_FEATURES ).Ecx;
-        CpuidFn_00000001h_0_Edx = CPU_INFO( CPUID_FEATURES ).Edx;
+        MaxFunction[CPUID_CENTAUR_MAX_FUNCTION >> CPUID_RANGE_SHIFT] = CpuInfo.Eax;
     }
 
     //
-    // Load bitset with flags for CPUID function 0x00000007 sub-function 0.
+    // Allocate the leaf tables of all ranges in one block.
+    //
+    LeafCount = 0;
+    for (Index = 0; Index < CPUID_RANGE_COUNT; ++Index)
+    {
+        if (Index == 0 || MaxFunction[Index] != 0)
+        {
+            LeafCount += MaxFunction[Index] - Context->Ranges[Index].Base + 1;
+        }
+    }
+
+    Leaves = calloc( LeafCount, sizeof( CPUID_LEAF ) );
+    if (!Leaves)
+    {
+        return E_NOMEM;
+    }
+
+    //
+    // Cache the data for every leaf and sub-leaf of each range.
     //
-    if (CpuidMaxFunction >= CPUID_STRUCTURED_EXTENDED_FEATURES)
+    for (Index = 0; Index < CPUID_RANGE_COUNT; ++Index)
     {
-        CpuidFn_00000007h_0_Ebx = CPU_INFO( CPUID_STRUCTURED_EXTENDED_FEATURES ).Ebx;
-        CpuidFn_00000007h_0_Ecx = CPU_INFO( CPUID_STRUCTURED_EXTENDED_FEATURES ).Ecx;
-        CpuidFn_00000007h_0_Edx = CPU_INFO( CPUID_STRUCTURED_EXTENDED_FEATURES ).Edx;
+        if (Index != 0 && MaxFunction[Index] == 0)
+        {
+            continue;
+        }
+
+        Context->Ranges[Index].Leaves = Leaves;
+        Leaves += MaxFunction[Index] - Context->Ranges[Index].Base + 1;
+
+        Status = PifpCaptureRange( Context, &Context->Ranges[Index], MaxFunction[Index] );
+        if (!SUCCESS( Status ))
+        {
+            return Status;
+        }
     }
 
     //
-    // Load bitset with flags in EBX for CPUID function 0x0000000D sub-function 1.
+    // The register state enabled by the OS decides which features are usable.
     //
-    if (CpuidMaxFunction >= CPUID_EXTENDED_STATE)
+    FeaturesEcx = (CpuidMaxFunction( Context ) >= CPUID_FEATURES) ? CPU_INFO( Context, CPUID_FEATURES ).Ecx : 0;
+    if (Context->Source == NULL)
+    {
+        Context->XfeatureEnabledMask = PifpReadXcr0( FeaturesEcx );
+    }
+    else if ((FeaturesEcx & X86_FEATURE_OSXSAVE) != 0)
     {
-        __cpuidex( (int*)&CpuInfo, CPUID_EXTENDED_STATE, CPUID_EXTENDED_STATE_SUB_LEAF );
-        CpuidFn_0000000Dh_1_Ebx = CpuInfo.Ebx;
+        //
+        // A source has no XGETBV. Unless told otherwise, assume the OS
+        // enables every state component the processor supports.
+        //
+        Context->XfeatureEnabledMask = Context->Source->XfeatureEnabledMask;
+        if (Context->XfeatureEnabledMask == 0 && CpuidMaxFunction( Context ) >= CPUID_EXTENDED_STATE)
+        {
+            Context->XfeatureEnabledMask = ((UINT64)CPU_INFO( Context, CPUID_EXTENDED_STATE ).Edx << 32) |
+                                           CPU_INFO( Context, CPUID_EXTENDED_STATE ).Eax;
+        }
     }
 
+    return STATUS_OK;
+}
+
+//
+// Derives the vendor string, brand string and feature words of a context
+// from its captured leaves and XCR0. Executes no CPUID.
+//
+static
+VOID
+PifpDecodeContext(
+    IN OUT PPIF_CONTEXT Context
+)
+{
+    PPIF_FEATURES Features = &Context->Features;
+
+    //
+    // Capture CPU vendor.
     //
-    // Get the number of the highest valid extended ID.
+    memset( Context->VendorString, 0, sizeof( Context->VendorString ) );
+    *(int*)(Context->VendorString + sizeof(int) * 0) = CPU_INFO( Context, CPUID_SIGNATURE ).Ebx;
+    *(int*)(Context->VendorString + sizeof(int) * 1) = CPU_INFO( Context, CPUID_SIGNATURE ).Edx;
+    *(int*)(Context->VendorString + sizeof(int) * 2) = CPU_INFO( Context, CPUID_SIGNATURE ).Ecx;
+
+    memset( Features, 0, sizeof( PIF_FEATURES ) );
+
+    //
+    // Load bitset with flags for CPUID function 0x00000001 sub-function 0.
     //
-    __cpuid( (int*)&CpuInfo, CPUID_MAX_EXTENDED_FUNCTION );
-    CpuidMaxExtendedFunction = CpuInfo.Eax;
+    if (CpuidMaxFunction( Context ) >= CPUID_FEATURES)
+    {
+        Features->Words[PifFeatureWord_00000001h_0_Ecx] = CPU_INFO( Context, CPUID_FEATURES ).Ecx;
+        Features->Words[PifFeatureWord_00000001h_0_Edx] = CPU_INFO( Context, CPUID_FEATURES ).Edx;
+    }
 
     //
-    // Allocate memory for the extended CPUID functions data.
+    // Load bitset with flags for CPUID function 0x00000007 sub-function 0.
     //
-    CpuidExtendedCache = malloc( sizeof( CPUID_INFO ) * (CpuidMaxExtendedFunction - CPUID_MAX_EXTENDED_FUNCTION + 1) );
-    if (!CpuidExtendedCache)
+    if (CpuidMaxFunction( Context ) >= CPUID_STRUCTURED_EXTENDED_FEATURES)
     {
-        Status = E_NOMEM;
-        goto Exit;
+        Features->Words[PifFeatureWord_00000007h_0_Ebx] = CPU_INFO( Context, CPUID_STRUCTURED_EXTENDED_FEATURES ).Ebx;
+        Features->Words[PifFeatureWord_00000007h_0_Ecx] = CPU_INFO( Context, CPUID_STRUCTURED_EXTENDED_FEATURES ).Ecx;
+        Features->Words[PifFeatureWord_00000007h_0_Edx] = CPU_INFO( Context, CPUID_STRUCTURED_EXTENDED_FEATURES ).Edx;
     }
 
     //
-    // Cache the data for the extended CPUID functions.
+    // Load bitset with flags in EAX for CPUID function 0x0000000D sub-function 1.
     //
-    for (Index = CPUID_MAX_EXTENDED_FUNCTION; Index <= CpuidMaxExtendedFunction; ++Index)
+    if (CpuidMaxFunction( Context ) >= CPUID_EXTENDED_STATE)
     {
-        __cpuidex( (int*)&CPU_EXTENDED_INFO( Index ), Index, 0);
+        Features->Words[PifFeatureWord_0000000Dh_1_Eax] =
+            CPU_SUBLEAF_INFO( Context, CPUID_EXTENDED_STATE, CPUID_EXTENDED_STATE_SUB_LEAF ).Eax;
     }
 
     //
     // Load bitset with flags for function 0x80000001.
     //
-    if (CpuidMaxExtendedFunction >= CPUID_EXTENDED_FEATURES)
+    if (CpuidMaxExtendedFunction( Context ) >= CPUID_EXTENDED_FEATURES)
     {
-        CpuidFn_80000001h_0_Ecx = CPU_EXTENDED_INFO( CPUID_EXTENDED_FEATURES ).Ecx;
-        CpuidFn_80000001h_0_Edx = CPU_EXTENDED_INFO( CPUID_EXTENDED_FEATURES ).Edx;
+        Features->Words[PifFeatureWord_80000001h_0_Ecx] = CPU_EXTENDED_INFO( Context, CPUID_EXTENDED_FEATURES ).Ecx;
+        Features->Words[PifFeatureWord_80000001h_0_Edx] = CPU_EXTENDED_INFO( Context, CPUID_EXTENDED_FEATURES ).Edx;
     }
 
     //
     // Interpret CPU brand string, if reported.
     //
-    memset( CpuBrandString, 0, sizeof( CpuBrandString ) );
-    if (CpuidMaxExtendedFunction >= CPUID_BRAND_STRING3)
+    memset( Context->BrandString, 0, sizeof( Context->BrandString ) );
+    if (CpuidMaxExtendedFunction( Context ) >= CPUID_BRAND_STRING3)
     {
-        memcpy( CpuBrandString + sizeof(CPUID_INFO) * 0, &CPU_EXTENDED_INFO( CPUID_BRAND_STRING1 ), sizeof( CPUID_INFO ) );
-        memcpy( CpuBrandString + sizeof(CPUID_INFO) * 1, &CPU_EXTENDED_INFO( CPUID_BRAND_STRING2 ), sizeof( CPUID_INFO ) );
-        memcpy( CpuBrandString + sizeof(CPUID_INFO) * 2, &CPU_EXTENDED_INFO( CPUID_BRAND_STRING3 ), sizeof( CPUID_INFO ) );
+        memcpy( Context->BrandString + sizeof(CPUID_INFO) * 0, &CPU_EXTENDED_INFO( Context, CPUID_BRAND_STRING1 ), sizeof( CPUID_INFO ) );
+        memcpy( Context->BrandString + sizeof(CPUID_INFO) * 1, &CPU_EXTENDED_INFO( Context, CPUID_BRAND_STRING2 ), sizeof( CPUID_INFO ) );
+        memcpy( Context->BrandString + sizeof(CPUID_INFO) * 2, &CPU_EXTENDED_INFO( Context, CPUID_BRAND_STRING3 ), sizeof( CPUID_INFO ) );
     }
 
     //
     // Load bitset with flags in EBX for function 0x80000008.
     //
-    if (CpuidMaxExtendedFunction >= CPUID_EXTENDED_FEATURES_EXTENSION)
+    if (CpuidMaxExtendedFunction( Context ) >= CPUID_EXTENDED_FEATURES_EXTENSION)
     {
-        CpuidFn_80000008h_0_Ebx = CPU_EXTENDED_INFO( CPUID_EXTENDED_FEATURES_EXTENSION ).Ebx;
+        Features->Words[PifFeatureWord_80000008h_0_Ebx] = CPU_EXTENDED_INFO( Context, CPUID_EXTENDED_FEATURES_EXTENSION ).Ebx;
     }
 
-Exit:
     //
-    // Destroy resources allocated during initialization.
+    // Derive the usable feature set from the reported features and the
+    // register state enabled by the OS.
     //
-    PifpDestroy( );
+    Context->UsableFeatures = *Features;
+    PifpMaskUnusableFeatures( &Context->UsableFeatures, Context->XfeatureEnabledMask );
+}
 
-    return Status;
+//
+// Builds the topology and cache hierarchy of a new context, before it is
+// returned to the caller. They are freed along with the context.
+//
+STATUS
+PifpPrepareContext(
+    IN OUT PPIF_CONTEXT Context
+)
+{
+    PPIF_TOPOLOGY Topology;
+    STATUS Status;
+
+    //
+    // Derive the processor topology from the per-processor snapshots, if
+    // captured and not already loaded from a snapshot image, then decode the
+    // caches and group them into instances shared by those processors.
+    //
+    if (Context->Topology == NULL && Context->PerCpuInfo != NULL)
+    {
+        Status = PifpCreateTopology( Context, &Topology );
+        if (!SUCCESS( Status ))
+        {
+            return Status;
+        }
+
+        Context->Topology = Topology;
+    }
+
+    if (Context->CacheHierarchy == NULL)
+    {
+        Status = PifpCreateCacheHierarchy( Context, Context->Topology, &Context->CacheHierarchy );
+        if (!SUCCESS( Status ))
+        {
+            return Status;
+        }
+    }
+
+    return STATUS_OK;
+}
+
+//
+// Captures and decodes the executing processor into a new context, without
+// deriving its topology and caches yet.
+//
+static
+STATUS
+PifpCaptureHostContext(
+    OUT PPIF_CONTEXT *Context
+)
+{
+    PPIF_CONTEXT NewContext;
+    STATUS Status;
+
+    NewContext = PifpAllocateContext( );
+    if (!NewContext)
+    {
+        return E_NOMEM;
+    }
+
+    Status = PifpCaptureContext( NewContext );
+    if (!SUCCESS( Status ))
+    {
+        PifDestroyContext( NewContext );
+        return Status;
+    }
+
+    PifpDecodeContext( NewContext );
+
+    *Context = NewContext;
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifCreateContext(
+    OUT PPIF_CONTEXT *Context
+)
+{
+    PPIF_CONTEXT NewContext;
+    STATUS Status;
+
+    if (Context == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Context = NULL;
+
+    Status = PifpCaptureHostContext( &NewContext );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    Status = PifpPrepareContext( NewContext );
+    if (!SUCCESS( Status ))
+    {
+        PifDestroyContext( NewContext );
+        return Status;
+    }
+
+    *Context = NewContext;
+    return STATUS_OK;
+}
+
+//
+// Allocates the per-processor copies of Info for CpuCount processors. Each
+// copy is rounded up to whole cache lines so collection on neighbouring
+// processors never writes to the same line.
+//
+static
+STATUS
+PifpAllocatePerCpuInfo(
+    IN OUT PPIF_CONTEXT Context,
+    IN UINT32 CpuCount
+)
+{
+    SIZE_T Size;
+
+    Context->PerCpuStride = (UINT32)((Context->InfoCount * sizeof( CPUID_INFO ) + SYSTEM_CACHE_ALIGNMENT_SIZE - 1) &
+                                     ~(SYSTEM_CACHE_ALIGNMENT_SIZE - 1)) / sizeof( CPUID_INFO );
+    Size = (SIZE_T)CpuCount * Context->PerCpuStride * sizeof( CPUID_INFO );
+
+#if defined(_WIN32)
+    Context->PerCpuInfo = _aligned_malloc( Size, SYSTEM_CACHE_ALIGNMENT_SIZE );
+#else
+    VOID *Buffer;
+
+    Context->PerCpuInfo = (posix_memalign( &Buffer, SYSTEM_CACHE_ALIGNMENT_SIZE, Size ) == 0) ?
+                          (PCPUID_INFO)Buffer : NULL;
+#endif
+    Context->PerCpuPresent = calloc( CpuCount, sizeof( BOOLEAN ) );
+    if (!Context->PerCpuInfo || !Context->PerCpuPresent)
+    {
+        return E_NOMEM;
+    }
+
+    memset( Context->PerCpuInfo, 0, Size );
+    Context->CpuCount = CpuCount;
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifCreateContextFromSource(
+    IN PCPIF_CPUID_SOURCE Source,
+    OUT PPIF_CONTEXT *Context
+)
+{
+    PPIF_CONTEXT NewContext;
+    UINT32 Cpu;
+    STATUS Status;
+
+    if (Source == NULL || Source->Cpuid == NULL || Context == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Context = NULL;
+
+    NewContext = PifpAllocateContext( );
+    if (!NewContext)
+    {
+        return E_NOMEM;
+    }
+
+    //
+    // Capture the layout from processor 0 of the source, then replay it on
+    // the others. Processors the source fails for are left absent.
+    //
+    NewContext->Source = Source;
+
+    Status = PifpCaptureContext( NewContext );
+    if (SUCCESS( Status ) && Source->CpuCount > 1)
+    {
+        Status = PifpAllocatePerCpuInfo( NewContext, Source->CpuCount );
+        for (Cpu = 0; SUCCESS( Status ) && Cpu < Source->CpuCount; ++Cpu)
+        {
+            NewContext->PerCpuPresent[Cpu] =
+                (BOOLEAN)SUCCESS( PifpCaptureLayout( NewContext, Cpu,
+                                                     &NewContext->PerCpuInfo[(SIZE_T)Cpu * NewContext->PerCpuStride] ) );
+        }
+    }
+
+    NewContext->Source = NULL;
+
+    if (SUCCESS( Status ))
+    {
+        PifpDecodeContext( NewContext );
+        Status = PifpPrepareContext( NewContext );
+    }
+
+    if (!SUCCESS( Status ))
+    {
+        PifDestroyContext( NewContext );
+        return Status;
+    }
+
+    *Context = NewContext;
+    return STATUS_OK;
+}
+
+VOID
+PifpAcquirePublishLock(
+    VOID
+)
+{
+    while (PifCompareExchange32( &PifPublishLock, 1, 0 ) != 0)
+    {
+        PifYieldProcessor( );
+    }
+}
+
+VOID
+PifpReleasePublishLock(
+    VOID
+)
+{
+    PifStoreRelease32( &PifPublishLock, 0 );
+}
+
+//
+// Mirrors the feature words of Context, or zeroes, into the globals declared
+// in pif.h. Readers test single words without locking, so each word is
+// stored atomically and holds the value of either the old or the new context.
+//
+static
+VOID
+PifpPublishFeatures(
+    IN PCPIF_CONTEXT Context OPTIONAL
+)
+{
+    UINT32 Index;
+
+    for (Index = 0; Index < PIF_FEATURE_WORDS; ++Index)
+    {
+        PifStoreRelease32( &PifFeatures.Words[Index], Context ? Context->Features.Words[Index] : 0 );
+        PifStoreRelease32( &PifUsableFeatures.Words[Index], Context ? Context->UsableFeatures.Words[Index] : 0 );
+    }
+
+    PifStoreRelease64( &PifXfeatureEnabledMask, Context ? Context->XfeatureEnabledMask : 0 );
+}
+
+//
+// Makes Context the default context, which takes ownership of it. Contexts
+// are complete once created, so readers see its topology and caches as soon
+// as the pointer is published.
+//
+static
+STATUS
+PifpPublishContext(
+    IN PPIF_CONTEXT Context
+)
+{
+    PPIF_CONTEXT OldContext;
+
+    PifpAcquirePublishLock( );
+
+    if (Context == PifDefaultContext)
+    {
+        PifpReleasePublishLock( );
+        return STATUS_OK;
+    }
+
+    //
+    // A replaced context is already on the retired list, and linking it a
+    // second time would free it twice.
+    //
+    if (Context->Published)
+    {
+        PifpReleasePublishLock( );
+        return E_ALREADY;
+    }
+
+    Context->Published = TRUE;
+    OldContext = PifExchangePointer( &PifDefaultContext, Context );
+    PifpPublishFeatures( Context );
+
+    //
+    // Resolve the registered dispatch tables against the new snapshot.
+    //
+    PifpInitializeDispatch( Context );
+
+    //
+    // Lock-free readers may still be using the previous context and the
+    // topology and caches it owns, so it is only retired here.
+    //
+    if (OldContext != NULL)
+    {
+        OldContext->NextRetired = PifRetiredContexts;
+        PifRetiredContexts = OldContext;
+    }
+
+    PifpReleasePublishLock( );
+    return STATUS_OK;
+}
+
+static
+VOID
+PifpDestroy(
+    VOID
+)
+{
+    PPIF_CONTEXT Context;
+    PPIF_CONTEXT Next;
+
+    PifpAcquirePublishLock( );
+
+    Context = PifExchangePointer( &PifDefaultContext, NULL );
+    PifpPublishFeatures( NULL );
+
+    //
+    // The caller guarantees no thread uses the library any more, so the
+    // default context and every retired one can be freed.
+    //
+    if (Context != NULL)
+    {
+        Context->NextRetired = PifRetiredContexts;
+        PifRetiredContexts = Context;
+    }
+
+    for (Context = PifRetiredContexts; Context != NULL; Context = Next)
+    {
+        Next = Context->NextRetired;
+        PifDestroyContext( Context );
+    }
+
+    PifRetiredContexts = NULL;
+    PifpReleasePublishLock( );
+}
+
+static
+STATUS
+PifpInitialize(
+    VOID
+)
+{
+    PPIF_CONTEXT Context;
+    STATUS Status;
+
+    //
+    // The new snapshot is captured off to the side, so readers keep using the
+    // previous one until it is published.
+    //
+    Status = PifCreateContext( &Context );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    return PifpPublishContext( Context );
+}
+
+STATUS
+PIFAPI
+PifInitialize(
+    VOID
+)
+{
+    STATUS Status;
+
+    //
+    // A failed reinitialization keeps the previous default context, and with
+    // it the previous state.
+    //
+    Status = PifpInitialize( );
+    if (SUCCESS( Status ))
+    {
+        PifInitStatus = Status;
+        PifStoreRelease32( &PifInitState, PIF_INIT_DONE );
+    }
+
+    return Status;
+}
+
+STATUS
+PIFAPI
+PifInitializeFromContext(
+    IN PPIF_CONTEXT Context
+)
+{
+    STATUS Status;
+
+    if (Context == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    Status = PifpPublishContext( Context );
+    if (SUCCESS( Status ))
+    {
+        PifInitStatus = Status;
+        PifStoreRelease32( &PifInitState, PIF_INIT_DONE );
+    }
+
+    return Status;
+}
+
+STATUS
+PIFAPI
+PifEnsureInitialized(
+    VOID
+)
+{
+    UINT32 State;
+
+    State = PifLoadAcquire32( &PifInitState );
+    if (likely( State == PIF_INIT_DONE ) || State == PIF_INIT_FAILED)
+    {
+        return PifInitStatus;
+    }
+
+    //
+    // The first caller to move the state out of PIF_INIT_NONE captures the
+    // snapshot, the others wait for it to finish. A failure is recorded as
+    // PIF_INIT_FAILED so PifIsInitialized stays FALSE and features read as
+    // absent, without every caller retrying.
+    //
+    if (State == PIF_INIT_NONE &&
+        PifCompareExchange32( &PifInitState, PIF_INIT_RUNNING, PIF_INIT_NONE ) == PIF_INIT_NONE)
+    {
+        PifInitStatus = PifpInitialize( );
+        PifStoreRelease32( &PifInitState, SUCCESS( PifInitStatus ) ? PIF_INIT_DONE : PIF_INIT_FAILED );
+        return PifInitStatus;
+    }
+
+    while (PifLoadAcquire32( &PifInitState ) == PIF_INIT_RUNNING)
+    {
+        PifYieldProcessor( );
+    }
+
+    return PifInitStatus;
+}
+
+#if defined(PIF_AUTO_INIT)
+
+//
+// Capture the snapshot before main and before the constructors of other
+// modules that select code paths, which run at a later (higher) priority.
+//
+#if defined(__GNUC__) || defined(__clang__)
+
+#ifndef PIF_INIT_PRIORITY
+#define PIF_INIT_PRIORITY   101 // First priority not reserved for the implementation
+#endif
+
+static
+VOID
+__attribute__((constructor( PIF_INIT_PRIORITY )))
+PifpAutoInitialize(
+    VOID
+)
+{
+    (VOID)PifEnsureInitialized( );
+}
+
+#elif defined(_MSC_VER)
+
+static
+VOID
+__cdecl
+PifpAutoInitialize(
+    VOID
+)
+{
+    (VOID)PifEnsureInitialized( );
+}
+
+//
+// .CRT$XCT runs ahead of the C++ dynamic initializers in .CRT$XCU.
+//
+#pragma section(".CRT$XCT", read)
+__declspec(allocate(".CRT$XCT")) VOID (__cdecl *PifAutoInitializeEntry)(VOID) = PifpAutoInitialize;
+#if defined(_M_IX86)
+#pragma comment(linker, "/include:_PifAutoInitializeEntry")
+#else
+#pragma comment(linker, "/include:PifAutoInitializeEntry")
+#endif
+
+#endif
+
+#endif // PIF_AUTO_INIT
+
+VOID
+PIFAPI
+PifDestroy(
+    VOID
+)
+{
+    PifpDestroy( );
+
+    PifInitStatus = E_NOTINITIALIZED;
+    PifStoreRelease32( &PifInitState, PIF_INIT_NONE );
+}
+
+PCPIF_CONTEXT
+PIFAPI
+PifGetDefaultContext(
+    VOID
+)
+{
+    return PifLoadAcquirePointer( &PifDefaultContext );
+}
+
+STATUS
+PIFAPI
+PifContextQueryLeaf(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO CpuInfo
+)
+{
+    if (CpuInfo == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if (Context == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    return PifpLookupLeaf( Context, Context->Info, Leaf, SubLeaf, CpuInfo );
+}
+
+STATUS
+PIFAPI
+PifContextGetMaxLeaf(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 RangeBase,
+    OUT UINT32 *MaxLeaf
+)
+{
+    CONST CPUID_RANGE *Range;
+
+    if (MaxLeaf == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if (Context == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    //
+    // The hypervisor range may have been captured at a higher base, which is
+    // also accepted.
+    //
+    Range = &Context->Ranges[RangeBase >> CPUID_RANGE_SHIFT];
+    if (Range->Leaves == NULL ||
+        (Range->Base != RangeBase && CpuidRangeBases[RangeBase >> CPUID_RANGE_SHIFT] != RangeBase))
+    {
+        return E_NOTFOUND;
+    }
+
+    *MaxLeaf = Range->Max;
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifContextGetSubLeafCount(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Leaf,
+    OUT UINT32 *SubLeafCount
+)
+{
+    CONST CPUID_RANGE *Range;
+
+    if (SubLeafCount == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if (Context == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    Range = &Context->Ranges[Leaf >> CPUID_RANGE_SHIFT];
+    if (Range->Leaves == NULL || Leaf < Range->Base || Leaf > Range->Max)
+    {
+        return E_NOTFOUND;
+    }
+
+    *SubLeafCount = Range->Leaves[Leaf - Range->Base].SubLeafCount;
+    return STATUS_OK;
+}
+
+PCPIF_FEATURES
+PIFAPI
+PifContextGetFeatures(
+    IN PCPIF_CONTEXT Context
+)
+{
+    return &Context->Features;
+}
+
+PCPIF_FEATURES
+PIFAPI
+PifContextGetUsableFeatures(
+    IN PCPIF_CONTEXT Context
+)
+{
+    return &Context->UsableFeatures;
+}
+
+UINT64
+PIFAPI
+PifContextGetXfeatureEnabledMask(
+    IN PCPIF_CONTEXT Context
+)
+{
+    return Context->XfeatureEnabledMask;
+}
+
+STATUS
+PIFAPI
+PifQueryLeaf(
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO CpuInfo
+)
+{
+    return PifContextQueryLeaf( PifGetDefaultContext( ), Leaf, SubLeaf, CpuInfo );
+}
+
+STATUS
+PIFAPI
+PifGetMaxLeaf(
+    IN UINT32 RangeBase,
+    OUT UINT32 *MaxLeaf
+)
+{
+    return PifContextGetMaxLeaf( PifGetDefaultContext( ), RangeBase, MaxLeaf );
+}
+
+STATUS
+PIFAPI
+PifGetSubLeafCount(
+    IN UINT32 Leaf,
+    OUT UINT32 *SubLeafCount
+)
+{
+    return PifContextGetSubLeafCount( PifGetDefaultContext( ), Leaf, SubLeafCount );
+}
+
+#if defined(__linux__)
+
+typedef struct _PIF_CPU_WORKER {
+    pthread_t Thread;
+    PPIF_CONTEXT Context;
+    UINT32 Cpu;
+    BOOLEAN Started;
+} PIF_CPU_WORKER, *PPIF_CPU_WORKER;
+
+static
+VOID *
+PifpCpuWorker(
+    IN VOID *Parameter
+)
+{
+    PPIF_CPU_WORKER Worker = (PPIF_CPU_WORKER)Parameter;
+    PPIF_CONTEXT Context = Worker->Context;
+
+    //
+    // The thread was created with its affinity already restricted to the
+    // target processor, so it never runs anywhere else. Verify that before
+    // trusting the results, in case a cpuset changed underneath us.
+    //
+    if (sched_getcpu( ) != (int)Worker->Cpu)
+    {
+        return NULL;
+    }
+
+    Context->PerCpuPresent[Worker->Cpu] =
+        (BOOLEAN)SUCCESS( PifpCaptureLayout( Context, Worker->Cpu,
+                                             &Context->PerCpuInfo[(SIZE_T)Worker->Cpu * Context->PerCpuStride] ) );
+    return NULL;
+}
+
+static
+STATUS
+PifpCaptureAllCpus(
+    IN OUT PPIF_CONTEXT Context
+)
+{
+    PPIF_CPU_WORKER Workers;
+    pthread_attr_t Attributes;
+    cpu_set_t Allowed;
+    cpu_set_t Target;
+    UINT32 CpuCount;
+    UINT32 Cpu;
+    STATUS Status;
+
+    CPU_ZERO( &Allowed );
+    if (sched_getaffinity( 0, sizeof( Allowed ), &Allowed ) != 0)
+    {
+        return E_PERM;
+    }
+
+    CpuCount = 0;
+    for (Cpu = 0; Cpu < CPU_SETSIZE; ++Cpu)
+    {
+        if (CPU_ISSET( Cpu, &Allowed ))
+        {
+            CpuCount = Cpu + 1;
+        }
+    }
+
+    Status = PifpAllocatePerCpuInfo( Context, CpuCount );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    Workers = calloc( CpuCount, sizeof( PIF_CPU_WORKER ) );
+    if (!Workers)
+    {
+        return E_NOMEM;
+    }
+
+    //
+    // Fan out one small pinned worker per allowed processor. Every worker
+    // writes only its own slot, and joining them publishes the results.
+    //
+    pthread_attr_init( &Attributes );
+    pthread_attr_setstacksize( &Attributes, 64 * KIBIBYTE );
+
+    for (Cpu = 0; Cpu < CpuCount; ++Cpu)
+    {
+        if (!CPU_ISSET( Cpu, &Allowed ))
+        {
+            continue;
+        }
+
+        CPU_ZERO( &Target );
+        CPU_SET( Cpu, &Target );
+        if (pthread_attr_setaffinity_np( &Attributes, sizeof( Target ), &Target ) != 0)
+        {
+            continue;
+        }
+
+        Workers[Cpu].Context = Context;
+        Workers[Cpu].Cpu = Cpu;
+        Workers[Cpu].Started = (BOOLEAN)(pthread_create( &Workers[Cpu].Thread, &Attributes,
+                                                         PifpCpuWorker, &Workers[Cpu] ) == 0);
+    }
+
+    for (Cpu = 0; Cpu < CpuCount; ++Cpu)
+    {
+        if (Workers[Cpu].Started)
+        {
+            pthread_join( Workers[Cpu].Thread, NULL );
+        }
+    }
+
+    pthread_attr_destroy( &Attributes );
+    free( Workers );
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifInitializeAllCpus(
+    VOID
+)
+{
+    PPIF_CONTEXT Context;
+    STATUS Status;
+
+    //
+    // Capture the snapshot layout on the current processor first, then
+    // replay it on every processor before anything is published.
+    //
+    Status = PifpCaptureHostContext( &Context );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    Status = PifpCaptureAllCpus( Context );
+    if (SUCCESS( Status ))
+    {
+        Status = PifpPrepareContext( Context );
+    }
+
+    if (!SUCCESS( Status ))
+    {
+        PifDestroyContext( Context );
+        return Status;
+    }
+
+    return PifInitializeFromContext( Context );
+}
+
+#else
+
+STATUS
+PIFAPI
+PifInitializeAllCpus(
+    VOID
+)
+{
+    return E_UNSUPPORTED;
+}
+
+#endif // __linux__
+
+UINT32
+PIFAPI
+PifGetCpuCount(
+    VOID
+)
+{
+    PCPIF_CONTEXT Context = PifGetDefaultContext( );
+
+    return (Context != NULL) ? Context->CpuCount : 0;
+}
+
+BOOLEAN
+PIFAPI
+PifIsCpuPresent(
+    IN UINT32 Cpu
+)
+{
+    PCPIF_CONTEXT Context = PifGetDefaultContext( );
+
+    return (BOOLEAN)(Context != NULL && Cpu < Context->CpuCount && Context->PerCpuPresent[Cpu]);
+}
+
+STATUS
+PifpContextQueryLeafOnCpu(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Cpu,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO CpuInfo
+)
+{
+    if (CpuInfo == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if (Context == NULL || Context->PerCpuInfo == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    if (Cpu >= Context->CpuCount || !Context->PerCpuPresent[Cpu])
+    {
+        return E_NOSUCHDEVICE;
+    }
+
+    return PifpLookupLeaf( Context, &Context->PerCpuInfo[(SIZE_T)Cpu * Context->PerCpuStride], Leaf, SubLeaf, CpuInfo );
+}
+
+STATUS
+PIFAPI
+PifQueryLeafOnCpu(
+    IN UINT32 Cpu,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO CpuInfo
+)
+{
+    return PifpContextQueryLeafOnCpu( PifGetDefaultContext( ), Cpu, Leaf, SubLeaf, CpuInfo );
+}
+
+//
+// Portable stand-in for strcpy_s, which only the Microsoft CRT provides.
+//
+static
+STATUS
+PifpCopyString(
+    OUT CHAR *Destination,
+    IN SIZE_T DestinationSize,
+    IN CONST CHAR *Source
+)
+{
+    SIZE_T Length;
+
+    if (Destination == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    Length = strlen( Source );
+    if (Length >= DestinationSize)
+    {
+        if (DestinationSize != 0)
+        {
+            Destination[0] = '\0';
+        }
+        return E_BOUNDS;
+    }
+
+    memcpy( Destination, Source, Length + 1 );
+    return STATUS_OK;
+}
+
+
+STATUS
+PIFAPI
+PifContextGetVendorString(
+    IN PCPIF_CONTEXT Context,
+    OUT CHAR *VendorString,
+    IN SIZE_T VendorStringMaxSize
+)
+{
+    if (Context == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    return PifpCopyString( VendorString, VendorStringMaxSize, Context->VendorString );
+}
+
+STATUS
+PIFAPI
+PifContextGetBrandString(
+    IN PCPIF_CONTEXT Context,
+    OUT CHAR *BrandString,
+    IN SIZE_T BrandStringMaxSize
+)
+{
+    if (Context == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    return PifpCopyString( BrandString, BrandStringMaxSize, Context->BrandString );
 }
 
 STATUS
@@ -237,7 +1786,7 @@ PifGetVendorString(
     IN SIZE_T VendorStringMaxSize
 )
 {
-    return strcpy_s( VendorString, VendorStringMaxSize, CpuVendorString );
+    return PifContextGetVendorString( PifGetDefaultContext( ), VendorString, VendorStringMaxSize );
 }
 
 STATUS
@@ -247,5 +1796,5 @@ PifGetBrandString(
     IN SIZE_T BrandStringMaxSize
 )
 {
-    return strcpy_s( BrandString, BrandStringMaxSize, CpuBrandString );
+    return PifContextGetBrandString( PifGetDefaultContext( ), BrandString, BrandStringMaxSize );
 }
@@ -0,0 +1,301 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file pifp.h
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ *
+ * @brief Private interfaces shared between the PIF source files.
+ */
+
+#ifndef _PIFP_H_
+#define _PIFP_H_
+
+#include "pif.h"
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+//
+// The CPUID leaf ranges are selected by the top two bits of the leaf number,
+// so a cached leaf can be located with a single shift and bounds check.
+//
+#define CPUID_RANGE_SHIFT       30
+#define CPUID_RANGE_COUNT       4
+
+//
+// Upper bound on the number of sub-leaves captured for a single leaf. This
+// guards against hypervisors reporting bogus enumeration counts.
+//
+#define CPUID_MAX_SUB_LEAVES    64
+
+//
+// The leaf is indexed by ECX. Sub-leaves beyond SubLeafCount are not cached.
+// Leaves without this flag ignore ECX and only sub-leaf 0 is captured.
+//
+#define CPUID_LEAF_SUB_LEAF_INDEXED 0x0001
+
+typedef struct _CPUID_LEAF {
+    UINT32 Offset;          //!< Index of sub-leaf 0 in Info
+    UINT16 SubLeafCount;    //!< Number of consecutive sub-leaves captured
+    UINT16 Flags;           //!< CPUID_LEAF_* flags
+} CPUID_LEAF, *PCPUID_LEAF;
+
+typedef struct _CPUID_RANGE {
+    UINT32 Base;
+    UINT32 Max;
+    PCPUID_LEAF Leaves;
+} CPUID_RANGE, *PCPUID_RANGE;
+
+//
+// Snapshot behind a PIF_CONTEXT. The feature words come first so the 64 byte
+// alignment of PIF_FEATURES is kept by the aligned allocation.
+//
+struct _PIF_CONTEXT {
+    PIF_FEATURES Features;
+    PIF_FEATURES UsableFeatures;
+    UINT64 XfeatureEnabledMask;
+
+    //
+    // The leaf tables of all ranges share one allocation owned by Ranges[0].
+    //
+    CPUID_RANGE Ranges[CPUID_RANGE_COUNT];
+
+    //
+    // Flat array of every captured (leaf, sub-leaf) pair, in enumeration order.
+    //
+    PCPUID_INFO Info;
+    UINT32 InfoCount;
+    UINT32 InfoCapacity;
+
+    //
+    // Per logical processor copies of Info, captured by PifInitializeAllCpus
+    // using the same layout. Each processor owns PerCpuStride entries
+    // starting on a cache line boundary.
+    //
+    PCPUID_INFO PerCpuInfo;
+    PBOOLEAN PerCpuPresent;
+    UINT32 PerCpuStride;
+    UINT32 CpuCount;
+
+    PIF_CPU_VENDOR Vendor;
+    CHAR VendorString[32];
+    CHAR BrandString[64];
+
+    //
+    // Topology derived from the per-processor snapshots, if any. Points at
+    // SnapshotTopology, or at a topology owned by the context that is built
+    // when it is created.
+    //
+    PCPIF_TOPOLOGY Topology;
+
+    //
+    // Cache hierarchy owned by the context, built when it is created.
+    //
+    PPIF_CACHE_HIERARCHY CacheHierarchy;
+
+    //
+    // Next context replaced as the default. Lock-free readers may still be
+    // using a replaced context, so it is only destroyed by PifDestroy.
+    //
+    struct _PIF_CONTEXT *NextRetired;
+
+    //
+    // Set under the publish lock once the context has been published as the
+    // default. It is owned by the library from then on, and once replaced can
+    // never be published again.
+    //
+    BOOLEAN Published;
+
+    //
+    // Set for contexts loaded from a snapshot image. The leaf tables above
+    // point into the image and are not owned by the context; the image is
+    // unmapped on destroy if the library mapped it.
+    //
+    CONST VOID *Snapshot;
+    SIZE_T SnapshotSize;
+    BOOLEAN SnapshotMapped;
+    PIF_TOPOLOGY SnapshotTopology;
+    //
+    // Source of the CPUID results while the context is being captured, or
+    // NULL for the executing processor. Cleared once capture completes.
+    //
+    PCPIF_CPUID_SOURCE Source;
+};
+
+//
+// pif.c
+//
+PPIF_CONTEXT
+PifpAllocateContext(
+    VOID
+    );
+
+VOID
+PifpMaskUnusableFeatures(
+    IN OUT PPIF_FEATURES Features,
+    IN UINT64 Xcr0
+    );
+
+UINT64
+PifpReadXcr0(
+    IN UINT32 FeaturesEcx
+    );
+
+STATUS
+PifpPrepareContext(
+    IN OUT PPIF_CONTEXT Context
+    );
+
+VOID
+PifpAcquirePublishLock(
+    VOID
+    );
+
+VOID
+PifpReleasePublishLock(
+    VOID
+    );
+
+STATUS
+PifpContextQueryLeafOnCpu(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Cpu,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO CpuInfo
+    );
+
+//
+// topology.c
+//
+STATUS
+PifpCreateTopology(
+    IN PCPIF_CONTEXT Context,
+    OUT PPIF_TOPOLOGY *Topology
+    );
+
+VOID
+PifpDestroyTopology(
+    IN PPIF_TOPOLOGY Topology OPTIONAL
+    );
+
+//
+// snapshot.c
+//
+VOID
+PifpUnmapSnapshot(
+    IN CONST VOID *Image,
+    IN SIZE_T ImageSize
+    );
+
+//
+// cache.c
+//
+STATUS
+PifpCreateCacheHierarchy(
+    IN PCPIF_CONTEXT Context,
+    IN CONST PIF_TOPOLOGY *Topology OPTIONAL,
+    OUT PPIF_CACHE_HIERARCHY *Hierarchy
+    );
+
+VOID
+PifpDestroyCacheHierarchy(
+    IN PPIF_CACHE_HIERARCHY Hierarchy OPTIONAL
+    );
+
+//
+// dispatch.c
+//
+VOID
+PifpInitializeDispatch(
+    IN PCPIF_CONTEXT Context
+    );
+
+//
+// features.c
+//
+VOID
+PifpGetNamedFeatures(
+    OUT PPIF_FEATURES Features
+    );
+
+//
+// hypervisor.c
+//
+PIF_HYPERVISOR
+PifpClassifyHypervisor(
+    IN CONST CPUID_INFO *CpuInfo
+    );
+
+#if !defined(_WIN32)
+
+//
+// worker.c
+//
+typedef
+VOID
+(*PPIF_PERIODIC_ROUTINE)(
+    IN PVOID Parameter
+    );
+
+//
+// Runs Routine on its own thread at a fixed cadence until stopped. The
+// routine is never called with the worker lock held.
+//
+typedef struct _PIF_PERIODIC_WORKER {
+    PPIF_PERIODIC_ROUTINE Routine;
+    PVOID Parameter;
+    pthread_t Thread;
+    pthread_mutex_t Lock;       //!< Protects IntervalMs, Running and StopRequested
+    pthread_cond_t Wake;
+    UINT32 IntervalMs;
+    BOOLEAN Running;            //!< Cleared by the stop that claims the join
+    BOOLEAN StopRequested;      //!< Set until the stopped thread has been joined
+} PIF_PERIODIC_WORKER, *PPIF_PERIODIC_WORKER;
+
+VOID
+PifpInitializePeriodicWorker(
+    OUT PPIF_PERIODIC_WORKER Worker,
+    IN PPIF_PERIODIC_ROUTINE Routine,
+    IN PVOID Parameter
+    );
+
+VOID
+PifpDestroyPeriodicWorker(
+    IN PPIF_PERIODIC_WORKER Worker
+    );
+
+STATUS
+PifpStartPeriodicWorker(
+    IN PPIF_PERIODIC_WORKER Worker,
+    IN UINT32 IntervalMs
+    );
+
+VOID
+PifpStopPeriodicWorker(
+    IN PPIF_PERIODIC_WORKER Worker
+    );
+
+BOOLEAN
+PifpIsPeriodicWorkerRunning(
+    IN PPIF_PERIODIC_WORKER Worker
+    );
+
+#endif
+
+#endif // _PIFP_H_
@@ -0,0 +1,451 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file pmu.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#include "pifp.h"
+#include "arch/msr.h"
+
+#include <stdio.h>
+#include <string.h>
+
+//
+// IA32_PERFEVTSELx control bits set by the library.
+//
+#define PIF_PERFEVTSEL_USR          0x00010000
+#define PIF_PERFEVTSEL_OS           0x00020000
+#define PIF_PERFEVTSEL_EN           0x00400000
+
+//
+// Fields of a caller's event select that are passed through: event select,
+// unit mask, edge detect, invert and counter mask. The interrupt, AnyThread
+// and reserved bits are never set on the caller's behalf.
+//
+#define PIF_PERFEVTSEL_EVENT        0x000000FF
+#define PIF_PERFEVTSEL_UMASK        0x0000FF00
+#define PIF_PERFEVTSEL_EDGE         0x00040000
+#define PIF_PERFEVTSEL_INV          0x00800000
+#define PIF_PERFEVTSEL_CMASK        0xFF000000
+#define PIF_PERFEVTSEL_EVENT_FIELDS (PIF_PERFEVTSEL_EVENT | PIF_PERFEVTSEL_UMASK | PIF_PERFEVTSEL_EDGE | \
+                                     PIF_PERFEVTSEL_INV | PIF_PERFEVTSEL_CMASK)
+
+//
+// IA32_FIXED_CTR_CTRL has a 4 bit field per fixed counter.
+//
+#define PIF_FIXED_CTRL_OS           0x1
+#define PIF_FIXED_CTRL_USR          0x2
+#define PIF_FIXED_CTRL_FIELD        0xF
+#define PIF_FIXED_CTRL_SHIFT(Index) ((Index) * 4)
+
+//
+// IA32_PERF_GLOBAL_CTRL enables the fixed counters from bit 32.
+//
+#define PIF_GLOBAL_CTRL_FIXED_SHIFT 32
+
+static CONST CHAR *CONST PifPmuEventNames[PifPmuEventMax] = {
+    [PifPmuEventCoreCycles]             = "core-cycles",
+    [PifPmuEventInstructionsRetired]    = "instructions",
+    [PifPmuEventReferenceCycles]        = "ref-cycles",
+    [PifPmuEventLlcReferences]          = "llc-references",
+    [PifPmuEventLlcMisses]              = "llc-misses",
+    [PifPmuEventBranchesRetired]        = "branches",
+    [PifPmuEventBranchMissesRetired]    = "branch-misses",
+    [PifPmuEventTopdownSlots]           = "topdown-slots",
+};
+
+//
+// Unit mask << 8 | event select, from the SDM's architectural event table.
+//
+static CONST UINT16 PifPmuEventSelects[PifPmuEventMax] = {
+    [PifPmuEventCoreCycles]             = 0x003C,
+    [PifPmuEventInstructionsRetired]    = 0x00C0,
+    [PifPmuEventReferenceCycles]        = 0x013C,
+    [PifPmuEventLlcReferences]          = 0x4F2E,
+    [PifPmuEventLlcMisses]              = 0x412E,
+    [PifPmuEventBranchesRetired]        = 0x00C4,
+    [PifPmuEventBranchMissesRetired]    = 0x00C5,
+    [PifPmuEventTopdownSlots]           = 0x01A4,
+};
+
+STATUS
+PIFAPI
+PifContextGetPmuInfo(
+    IN PCPIF_CONTEXT Context,
+    OUT PPIF_PMU_INFO Info
+)
+{
+    CPUID_INFO CpuInfo;
+    UINT32 EventCount;
+
+    if (Info == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    memset( Info, 0, sizeof( PIF_PMU_INFO ) );
+
+    if (Context == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    if (!SUCCESS( PifContextQueryLeaf( Context, CPUID_ARCHITECTURAL_PERFORMANCE_MONITORING, 0, &CpuInfo ) ) ||
+        (CpuInfo.Eax & 0xFF) == 0)
+    {
+        return E_UNSUPPORTED;
+    }
+
+    Info->Version = CpuInfo.Eax & 0xFF;
+    Info->GeneralCounterCount = (CpuInfo.Eax >> 8) & 0xFF;
+    Info->GeneralCounterWidth = (CpuInfo.Eax >> 16) & 0xFF;
+
+    //
+    // EBX flags the events that are *not* available, and only its low
+    // EAX[31:24] bits are defined.
+    //
+    EventCount = CpuInfo.Eax >> 24;
+    if (EventCount > PifPmuEventMax)
+    {
+        EventCount = PifPmuEventMax;
+    }
+    Info->Events = ~CpuInfo.Ebx & ((1u << EventCount) - 1);
+
+    //
+    // Fixed counters exist from version 2. Version 5 adds the ECX bitmap of
+    // fixed counters implemented beyond the first EDX[4:0].
+    //
+    if (Info->Version >= 2)
+    {
+        Info->FixedCounterCount = CpuInfo.Edx & 0x1F;
+        Info->FixedCounterWidth = (CpuInfo.Edx >> 5) & 0xFF;
+        Info->FixedCounterMask = (Info->FixedCounterCount >= 32) ? 0xFFFFFFFF : (1u << Info->FixedCounterCount) - 1;
+        if (Info->Version >= 5)
+        {
+            Info->FixedCounterMask |= CpuInfo.Ecx;
+        }
+    }
+
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifGetPmuInfo(
+    OUT PPIF_PMU_INFO Info
+)
+{
+    return PifContextGetPmuInfo( PifGetDefaultContext( ), Info );
+}
+
+PCSTR
+PIFAPI
+PifGetPmuEventName(
+    IN PIF_PMU_EVENT Event
+)
+{
+    if ((UINT32)Event >= PifPmuEventMax)
+    {
+        return NULL;
+    }
+
+    return PifPmuEventNames[Event];
+}
+
+UINT32
+PIFAPI
+PifGetPmuEventSelect(
+    IN PIF_PMU_EVENT Event
+)
+{
+    if ((UINT32)Event >= PifPmuEventMax)
+    {
+        return 0;
+    }
+
+    return PifPmuEventSelects[Event];
+}
+
+//
+// Checks a configuration against the counters leaf 0x0A reports, and
+// returns the IA32_PERF_GLOBAL_CTRL bits of its counters.
+//
+static
+STATUS
+PifpValidatePmuConfig(
+    IN PCPIF_PMU_INFO Info,
+    IN PCPIF_PMU_CONFIG Config,
+    OUT UINT64 *GlobalMask
+)
+{
+    UINT32 GeneralLimit;
+    UINT32 FixedLimit;
+
+    if (Info->Version == 0)
+    {
+        return E_UNSUPPORTED;
+    }
+
+    GeneralLimit = (Info->GeneralCounterCount < PIF_PMU_MAX_GENERAL_COUNTERS) ?
+                   Info->GeneralCounterCount : PIF_PMU_MAX_GENERAL_COUNTERS;
+    FixedLimit = Info->FixedCounterMask & ((1u << PIF_PMU_MAX_FIXED_COUNTERS) - 1);
+
+    if (Config->GeneralCount > GeneralLimit || (Config->FixedMask & ~FixedLimit) != 0)
+    {
+        return E_BOUNDS;
+    }
+
+    *GlobalMask = ((1ull << Config->GeneralCount) - 1) |
+                  ((UINT64)Config->FixedMask << PIF_GLOBAL_CTRL_FIXED_SHIFT);
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifProgramPmu(
+    IN PCPIF_PMU_INFO Info,
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN PCPIF_PMU_CONFIG Config
+)
+{
+    UINT64 GlobalMask;
+    UINT64 GlobalCtrl = 0;
+    UINT64 FixedCtrl = 0;
+    UINT64 EventSelect;
+    UINT32 FixedField;
+    UINT32 Index;
+    STATUS Status;
+
+    if (Info == NULL || Device == NULL || Config == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if ((Config->Flags & (PIF_PMU_COUNT_USER | PIF_PMU_COUNT_KERNEL)) == 0)
+    {
+        return E_INVALID;
+    }
+
+    Status = PifpValidatePmuConfig( Info, Config, &GlobalMask );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    FixedField = ((Config->Flags & PIF_PMU_COUNT_USER) ? PIF_FIXED_CTRL_USR : 0) |
+                 ((Config->Flags & PIF_PMU_COUNT_KERNEL) ? PIF_FIXED_CTRL_OS : 0);
+
+    //
+    // Refuse counters someone else has enabled before changing anything.
+    //
+    if (Config->FixedMask != 0)
+    {
+        Status = PifReadMsr( Device, Cpu, MSR_FIXED_CTR_CTRL, &FixedCtrl );
+        if (!SUCCESS( Status ))
+        {
+            return Status;
+        }
+    }
+
+    if ((Config->Flags & PIF_PMU_FORCE) == 0)
+    {
+        for (Index = 0; Index < Config->GeneralCount; ++Index)
+        {
+            Status = PifReadMsr( Device, Cpu, MSR_PERFEVTSEL0 + Index, &EventSelect );
+            if (!SUCCESS( Status ))
+            {
+                return Status;
+            }
+            if ((EventSelect & PIF_PERFEVTSEL_EN) != 0)
+            {
+                return E_BUSY;
+            }
+        }
+
+        for (Index = 0; Index < PIF_PMU_MAX_FIXED_COUNTERS; ++Index)
+        {
+            if ((Config->FixedMask & (1u << Index)) != 0 &&
+                ((FixedCtrl >> PIF_FIXED_CTRL_SHIFT( Index )) & (PIF_FIXED_CTRL_OS | PIF_FIXED_CTRL_USR)) != 0)
+            {
+                return E_BUSY;
+            }
+        }
+    }
+
+    //
+    // Stop the counters while they are zeroed and reprogrammed, so they all
+    // start counting together.
+    //
+    if (Info->Version >= 2)
+    {
+        Status = PifReadMsr( Device, Cpu, MSR_PERF_GLOBAL_CTRL, &GlobalCtrl );
+        if (SUCCESS( Status ))
+        {
+            Status = PifWriteMsr( Device, Cpu, MSR_PERF_GLOBAL_CTRL, GlobalCtrl & ~GlobalMask );
+        }
+        if (!SUCCESS( Status ))
+        {
+            return Status;
+        }
+    }
+
+    for (Index = 0; Index < Config->GeneralCount && SUCCESS( Status ); ++Index)
+    {
+        EventSelect = (Config->GeneralEvents[Index] & PIF_PERFEVTSEL_EVENT_FIELDS) |
+                      PIF_PERFEVTSEL_EN |
+                      ((Config->Flags & PIF_PMU_COUNT_USER) ? PIF_PERFEVTSEL_USR : 0) |
+                      ((Config->Flags & PIF_PMU_COUNT_KERNEL) ? PIF_PERFEVTSEL_OS : 0);
+
+        Status = PifWriteMsr( Device, Cpu, MSR_PERFEVTSEL0 + Index, 0 );
+        if (SUCCESS( Status ))
+        {
+            Status = PifWriteMsr( Device, Cpu, MSR_PMC0 + Index, 0 );
+        }
+        if (SUCCESS( Status ))
+        {
+            Status = PifWriteMsr( Device, Cpu, MSR_PERFEVTSEL0 + Index, EventSelect );
+        }
+    }
+
+    if (Config->FixedMask != 0 && SUCCESS( Status ))
+    {
+        for (Index = 0; Index < PIF_PMU_MAX_FIXED_COUNTERS && SUCCESS( Status ); ++Index)
+        {
+            if ((Config->FixedMask & (1u << Index)) != 0)
+            {
+                FixedCtrl &= ~((UINT64)PIF_FIXED_CTRL_FIELD << PIF_FIXED_CTRL_SHIFT( Index ));
+                FixedCtrl |= (UINT64)FixedField << PIF_FIXED_CTRL_SHIFT( Index );
+                Status = PifWriteMsr( Device, Cpu, MSR_FIXED_CTR0 + Index, 0 );
+            }
+        }
+
+        if (SUCCESS( Status ))
+        {
+            Status = PifWriteMsr( Device, Cpu, MSR_FIXED_CTR_CTRL, FixedCtrl );
+        }
+    }
+
+    if (Info->Version >= 2 && SUCCESS( Status ))
+    {
+        Status = PifWriteMsr( Device, Cpu, MSR_PERF_GLOBAL_CTRL, GlobalCtrl | GlobalMask );
+    }
+
+    return Status;
+}
+
+STATUS
+PIFAPI
+PifReleasePmu(
+    IN PCPIF_PMU_INFO Info,
+    IN PPIF_MSR_DEVICE Device,
+    IN UINT32 Cpu,
+    IN PCPIF_PMU_CONFIG Config
+)
+{
+    UINT64 GlobalMask;
+    UINT64 GlobalCtrl;
+    UINT64 FixedCtrl;
+    UINT32 Index;
+    STATUS Status;
+
+    if (Info == NULL || Device == NULL || Config == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    Status = PifpValidatePmuConfig( Info, Config, &GlobalMask );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    if (Info->Version >= 2)
+    {
+        Status = PifReadMsr( Device, Cpu, MSR_PERF_GLOBAL_CTRL, &GlobalCtrl );
+        if (SUCCESS( Status ))
+        {
+            Status = PifWriteMsr( Device, Cpu, MSR_PERF_GLOBAL_CTRL, GlobalCtrl & ~GlobalMask );
+        }
+        if (!SUCCESS( Status ))
+        {
+            return Status;
+        }
+    }
+
+    for (Index = 0; Index < Config->GeneralCount && SUCCESS( Status ); ++Index)
+    {
+        Status = PifWriteMsr( Device, Cpu, MSR_PERFEVTSEL0 + Index, 0 );
+    }
+
+    if (Config->FixedMask != 0 && SUCCESS( Status ))
+    {
+        Status = PifReadMsr( Device, Cpu, MSR_FIXED_CTR_CTRL, &FixedCtrl );
+        if (SUCCESS( Status ))
+        {
+            for (Index = 0; Index < PIF_PMU_MAX_FIXED_COUNTERS; ++Index)
+            {
+                if ((Config->FixedMask & (1u << Index)) != 0)
+                {
+                    FixedCtrl &= ~((UINT64)PIF_FIXED_CTRL_FIELD << PIF_FIXED_CTRL_SHIFT( Index ));
+                }
+            }
+            Status = PifWriteMsr( Device, Cpu, MSR_FIXED_CTR_CTRL, FixedCtrl );
+        }
+    }
+
+    return Status;
+}
+
+BOOLEAN
+PIFAPI
+PifIsRdpmcPermitted(
+    VOID
+)
+{
+#if defined(__linux__)
+    static CONST CHAR *CONST Paths[] = {
+        "/sys/bus/event_source/devices/cpu/rdpmc",
+        "/sys/bus/event_source/devices/cpu_core/rdpmc",    // Hybrid processors
+    };
+    FILE *File;
+    UINT32 Index;
+    int Mode;
+
+    //
+    // 1, the default, only allows RDPMC to tasks with a perf event mapped,
+    // and 2 allows it to every task.
+    //
+    for (Index = 0; Index < RTL_NUMBER_OF_V1( Paths ); ++Index)
+    {
+        File = fopen( Paths[Index], "r" );
+        if (File != NULL)
+        {
+            if (fscanf( File, "%d", &Mode ) != 1)
+            {
+                Mode = 0;
+            }
+            fclose( File );
+            return (BOOLEAN)(Mode == 2);
+        }
+    }
+#endif
+
+    return FALSE;
+}
@@ -0,0 +1,607 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file profiler.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#include "pifp.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+
+#include <pthread.h>
+
+//
+// Largest ring accepted per thread, in records.
+//
+#define PIF_PROFILER_MAX_CAPACITY   (1u << 24)
+
+struct _PIF_PROFILER {
+    UINT32 Mode;
+    UINT32 RegionCount;
+    UINT32 RingSize;
+    UINT64 CounterMask;
+    PPIF_PROFILER_STATS Stats;
+    UINT64 Dropped;
+    PPIF_PROFILER_THREAD Threads;
+
+    pthread_mutex_t Lock;       //!< Protects Stats, Dropped and Threads
+    PIF_PERIODIC_WORKER Drainer;
+};
+
+static
+UINT32
+PifpHistogramBucket(
+    IN UINT64 Ticks
+)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (Ticks > 1) ? 63 - (UINT32)__builtin_clzll( Ticks ) : 0;
+#else
+    UINT32 Bucket = 0;
+
+    while (Ticks >>= 1)
+    {
+        ++Bucket;
+    }
+
+    return Bucket;
+#endif
+}
+
+static
+VOID
+PifpFreeProfilerThread(
+    IN PPIF_PROFILER_THREAD Thread
+)
+{
+    free( Thread->Records );
+    free( Thread );
+}
+
+//
+// Moves every queued record of every thread into the region statistics, and
+// frees the threads that were unregistered once their rings are empty.
+// Called with the profiler lock held.
+//
+static
+VOID
+PifpDrainProfiler(
+    IN PPIF_PROFILER Profiler
+)
+{
+    PPIF_PROFILER_THREAD *Link;
+    PPIF_PROFILER_THREAD Thread;
+    PCPIF_PROFILER_RECORD Record;
+    PPIF_PROFILER_STATS Stats;
+    UINT32 Dropped;
+    UINT32 Retired;
+    UINT32 Head;
+    UINT32 Tail;
+
+    Link = &Profiler->Threads;
+    while ((Thread = *Link) != NULL)
+    {
+        //
+        // Retired is read before Head, so a thread that retires after its
+        // last record was published has nothing left once drained.
+        //
+        Retired = PifLoadAcquire32( &Thread->Retired );
+        Head = PifLoadAcquire32( &Thread->Head );
+
+        for (Tail = Thread->Tail; Tail != Head; ++Tail)
+        {
+            Record = &Thread->Records[Tail & Thread->Mask];
+            if (Record->Region >= Profiler->RegionCount)
+            {
+                continue;
+            }
+
+            Stats = &Profiler->Stats[Record->Region];
+            Stats->Count++;
+            Stats->TscSum += Record->Tsc;
+            if (Record->Tsc < Stats->TscMin)
+            {
+                Stats->TscMin = Record->Tsc;
+            }
+            if (Record->Tsc > Stats->TscMax)
+            {
+                Stats->TscMax = Record->Tsc;
+            }
+            if (Record->Flags & PIF_PROFILER_RECORD_MIGRATED)
+            {
+                Stats->Migrated++;
+            }
+            Stats->InstructionsSum += Record->Instructions;
+            Stats->CyclesSum += Record->Cycles;
+            Stats->Histogram[PifpHistogramBucket( Record->Tsc )]++;
+        }
+
+        PifStoreRelease32( &Thread->Tail, Tail );
+
+        //
+        // The counter only ever grows, the drainer keeps its own total.
+        //
+        Dropped = PifLoadAcquire32( &Thread->Dropped );
+        Profiler->Dropped += Dropped - Thread->CachedDropped;
+        Thread->CachedDropped = Dropped;
+
+        if (Retired)
+        {
+            *Link = Thread->Next;
+            PifpFreeProfilerThread( Thread );
+        }
+        else
+        {
+            Link = &Thread->Next;
+        }
+    }
+}
+
+static
+VOID
+PifpProfilerDrainerRoutine(
+    IN PVOID Parameter
+)
+{
+    PPIF_PROFILER Profiler = (PPIF_PROFILER)Parameter;
+
+    pthread_mutex_lock( &Profiler->Lock );
+    PifpDrainProfiler( Profiler );
+    pthread_mutex_unlock( &Profiler->Lock );
+}
+
+STATUS
+PIFAPI
+PifCreateProfiler(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Flags,
+    IN UINT32 RegionCount,
+    IN UINT32 RingCapacity,
+    OUT PPIF_PROFILER *Profiler
+)
+{
+    PPIF_PROFILER NewProfiler;
+    PIF_PMU_INFO PmuInfo;
+    UINT32 RingSize;
+    UINT32 Region;
+
+    if (Profiler == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Profiler = NULL;
+
+    if (Context == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    if (RegionCount == 0)
+    {
+        return E_INVALID;
+    }
+
+    if (RingCapacity > PIF_PROFILER_MAX_CAPACITY)
+    {
+        return E_BOUNDS;
+    }
+
+    for (RingSize = 2; RingSize < RingCapacity; RingSize <<= 1)
+    {
+    }
+
+    NewProfiler = calloc( 1, sizeof( PIF_PROFILER ) );
+    if (NewProfiler == NULL)
+    {
+        return E_NOMEM;
+    }
+
+    NewProfiler->Stats = calloc( RegionCount, sizeof( PIF_PROFILER_STATS ) );
+    if (NewProfiler->Stats == NULL)
+    {
+        free( NewProfiler );
+        return E_NOMEM;
+    }
+
+    for (Region = 0; Region < RegionCount; ++Region)
+    {
+        NewProfiler->Stats[Region].TscMin = (UINT64)-1;
+    }
+
+    NewProfiler->RegionCount = RegionCount;
+    NewProfiler->RingSize = RingSize;
+
+    if (PifFeaturesTest( PifContextGetFeatures( Context ), PifFeatureRDTSCP ))
+    {
+        NewProfiler->Mode |= PIF_PROFILER_MODE_RDTSCP;
+    }
+
+    //
+    // RDPMC faults unless the kernel allows it, so the counters are only
+    // read once that is known, and fall back to the TSC otherwise. Counter
+    // deltas are only valid without a migration, which takes RDTSCP to see.
+    //
+    if ((Flags & PIF_PROFILER_TSC_ONLY) == 0 &&
+        (NewProfiler->Mode & PIF_PROFILER_MODE_RDTSCP) != 0 &&
+        SUCCESS( PifContextGetPmuInfo( Context, &PmuInfo ) ) &&
+        (PmuInfo.FixedCounterMask & ((1u << PIF_PMU_FIXED_INSTRUCTIONS) | (1u << PIF_PMU_FIXED_CORE_CYCLES))) ==
+            ((1u << PIF_PMU_FIXED_INSTRUCTIONS) | (1u << PIF_PMU_FIXED_CORE_CYCLES)) &&
+        PifIsRdpmcPermitted( ))
+    {
+        NewProfiler->Mode |= PIF_PROFILER_MODE_COUNTERS;
+        NewProfiler->CounterMask = (PmuInfo.FixedCounterWidth >= 64 || PmuInfo.FixedCounterWidth == 0) ?
+                                   (UINT64)-1 : (1ull << PmuInfo.FixedCounterWidth) - 1;
+    }
+
+    pthread_mutex_init( &NewProfiler->Lock, NULL );
+    PifpInitializePeriodicWorker( &NewProfiler->Drainer, PifpProfilerDrainerRoutine, NewProfiler );
+
+    *Profiler = NewProfiler;
+    return STATUS_OK;
+}
+
+VOID
+PIFAPI
+PifDestroyProfiler(
+    IN PPIF_PROFILER Profiler OPTIONAL
+)
+{
+    PPIF_PROFILER_THREAD Thread;
+
+    if (Profiler == NULL)
+    {
+        return;
+    }
+
+    PifpDestroyPeriodicWorker( &Profiler->Drainer );
+
+    while ((Thread = Profiler->Threads) != NULL)
+    {
+        Profiler->Threads = Thread->Next;
+        PifpFreeProfilerThread( Thread );
+    }
+
+    pthread_mutex_destroy( &Profiler->Lock );
+    free( Profiler->Stats );
+    free( Profiler );
+}
+
+UINT32
+PIFAPI
+PifGetProfilerMode(
+    IN PPIF_PROFILER Profiler
+)
+{
+    return (Profiler != NULL) ? Profiler->Mode : 0;
+}
+
+STATUS
+PIFAPI
+PifRegisterProfilerThread(
+    IN PPIF_PROFILER Profiler,
+    OUT PPIF_PROFILER_THREAD *Thread
+)
+{
+    PPIF_PROFILER_THREAD NewThread;
+    VOID *Buffer;
+
+    if (Profiler == NULL || Thread == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Thread = NULL;
+
+    //
+    // Head and Tail are declared cache line aligned, which malloc does not
+    // guarantee.
+    //
+    if (posix_memalign( &Buffer, SYSTEM_CACHE_ALIGNMENT_SIZE, sizeof( PIF_PROFILER_THREAD ) ) != 0)
+    {
+        return E_NOMEM;
+    }
+
+    NewThread = (PPIF_PROFILER_THREAD)Buffer;
+    memset( NewThread, 0, sizeof( PIF_PROFILER_THREAD ) );
+    NewThread->Records = malloc( Profiler->RingSize * sizeof( PIF_PROFILER_RECORD ) );
+    if (NewThread->Records == NULL)
+    {
+        free( NewThread );
+        return E_NOMEM;
+    }
+
+    NewThread->Mask = Profiler->RingSize - 1;
+    NewThread->Mode = Profiler->Mode;
+    NewThread->CounterMask = Profiler->CounterMask;
+    NewThread->Profiler = Profiler;
+
+    pthread_mutex_lock( &Profiler->Lock );
+    NewThread->Next = Profiler->Threads;
+    Profiler->Threads = NewThread;
+    pthread_mutex_unlock( &Profiler->Lock );
+
+    *Thread = NewThread;
+    return STATUS_OK;
+}
+
+VOID
+PIFAPI
+PifUnregisterProfilerThread(
+    IN PPIF_PROFILER_THREAD Thread OPTIONAL
+)
+{
+    if (Thread == NULL)
+    {
+        return;
+    }
+
+    //
+    // The next drain consumes what is left and frees the ring.
+    //
+    PifStoreRelease32( &Thread->Retired, TRUE );
+}
+
+STATUS
+PIFAPI
+PifDrainProfiler(
+    IN PPIF_PROFILER Profiler
+)
+{
+    if (Profiler == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    pthread_mutex_lock( &Profiler->Lock );
+    PifpDrainProfiler( Profiler );
+    pthread_mutex_unlock( &Profiler->Lock );
+
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifStartProfilerDrainer(
+    IN PPIF_PROFILER Profiler,
+    IN UINT32 IntervalMs
+)
+{
+    if (Profiler == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    return PifpStartPeriodicWorker( &Profiler->Drainer, IntervalMs );
+}
+
+VOID
+PIFAPI
+PifStopProfilerDrainer(
+    IN PPIF_PROFILER Profiler
+)
+{
+    if (Profiler == NULL)
+    {
+        return;
+    }
+
+    PifpStopPeriodicWorker( &Profiler->Drainer );
+}
+
+STATUS
+PIFAPI
+PifGetProfilerStats(
+    IN PPIF_PROFILER Profiler,
+    IN UINT32 Region,
+    OUT PPIF_PROFILER_STATS Stats
+)
+{
+    if (Profiler == NULL || Stats == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if (Region >= Profiler->RegionCount)
+    {
+        return E_BOUNDS;
+    }
+
+    pthread_mutex_lock( &Profiler->Lock );
+    *Stats = Profiler->Stats[Region];
+    Stats->Dropped = Profiler->Dropped;
+    pthread_mutex_unlock( &Profiler->Lock );
+
+    if (Stats->Count == 0)
+    {
+        Stats->TscMin = 0;
+    }
+
+    return STATUS_OK;
+}
+
+#else
+
+STATUS
+PIFAPI
+PifCreateProfiler(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Flags,
+    IN UINT32 RegionCount,
+    IN UINT32 RingCapacity,
+    OUT PPIF_PROFILER *Profiler
+)
+{
+    (VOID)Context;
+    (VOID)Flags;
+    (VOID)RegionCount;
+    (VOID)RingCapacity;
+
+    if (Profiler == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Profiler = NULL;
+    return E_UNSUPPORTED;
+}
+
+VOID
+PIFAPI
+PifDestroyProfiler(
+    IN PPIF_PROFILER Profiler OPTIONAL
+)
+{
+    (VOID)Profiler;
+}
+
+UINT32
+PIFAPI
+PifGetProfilerMode(
+    IN PPIF_PROFILER Profiler
+)
+{
+    (VOID)Profiler;
+    return 0;
+}
+
+STATUS
+PIFAPI
+PifRegisterProfilerThread(
+    IN PPIF_PROFILER Profiler,
+    OUT PPIF_PROFILER_THREAD *Thread
+)
+{
+    (VOID)Profiler;
+
+    if (Thread != NULL)
+    {
+        *Thread = NULL;
+    }
+    return E_UNSUPPORTED;
+}
+
+VOID
+PIFAPI
+PifUnregisterProfilerThread(
+    IN PPIF_PROFILER_THREAD Thread OPTIONAL
+)
+{
+    (VOID)Thread;
+}
+
+STATUS
+PIFAPI
+PifDrainProfiler(
+    IN PPIF_PROFILER Profiler
+)
+{
+    (VOID)Profiler;
+    return E_UNSUPPORTED;
+}
+
+STATUS
+PIFAPI
+PifStartProfilerDrainer(
+    IN PPIF_PROFILER Profiler,
+    IN UINT32 IntervalMs
+)
+{
+    (VOID)Profiler;
+    (VOID)IntervalMs;
+    return E_UNSUPPORTED;
+}
+
+VOID
+PIFAPI
+PifStopProfilerDrainer(
+    IN PPIF_PROFILER Profiler
+)
+{
+    (VOID)Profiler;
+}
+
+STATUS
+PIFAPI
+PifGetProfilerStats(
+    IN PPIF_PROFILER Profiler,
+    IN UINT32 Region,
+    OUT PPIF_PROFILER_STATS Stats
+)
+{
+    (VOID)Profiler;
+    (VOID)Region;
+    (VOID)Stats;
+    return E_UNSUPPORTED;
+}
+
+#endif
+
+UINT64
+PIFAPI
+PifGetProfilerPercentile(
+    IN PCPIF_PROFILER_STATS Stats,
+    IN UINT32 Percentile
+)
+{
+    UINT64 Target;
+    UINT64 Seen = 0;
+    UINT32 Bucket;
+
+    if (Stats == NULL || Stats->Count == 0)
+    {
+        return 0;
+    }
+
+    if (Percentile > 100)
+    {
+        Percentile = 100;
+    }
+
+    //
+    // The rank of the percentile, rounded up, and at least the first record.
+    //
+    Target = (Stats->Count * Percentile + 99) / 100;
+    if (Target == 0)
+    {
+        Target = 1;
+    }
+
+    for (Bucket = 0; Bucket < PIF_PROFILER_HISTOGRAM_BUCKETS; ++Bucket)
+    {
+        Seen += Stats->Histogram[Bucket];
+        if (Seen >= Target)
+        {
+            break;
+        }
+    }
+
+    if (Bucket >= PIF_PROFILER_HISTOGRAM_BUCKETS - 1)
+    {
+        return Stats->TscMax;
+    }
+
+    //
+    // Never report more than the largest value seen.
+    //
+    return ((2ull << Bucket) - 1 < Stats->TscMax) ? (2ull << Bucket) - 1 : Stats->TscMax;
+}
@@ -0,0 +1,454 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file replay.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#include "pifp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Upper bound on processor numbers accepted from a dump, every processor
+// gets its own copy of the snapshot.
+//
+#define PIF_REPLAY_MAX_CPUS     4096
+
+//
+// Longest dump line looked at, the rest of a longer line is ignored.
+//
+#define PIF_REPLAY_MAX_LINE     256
+
+typedef struct _PIF_CPUID_REPLAY_ENTRY {
+    UINT32 Cpu;
+    UINT32 Leaf;
+    UINT32 SubLeaf;
+    UINT32 Sequence;        //!< Position in the dump, the first duplicate wins
+    CPUID_INFO Info;
+} PIF_CPUID_REPLAY_ENTRY, *PPIF_CPUID_REPLAY_ENTRY;
+
+//
+// Entries sorted by (Cpu, Leaf, SubLeaf) for binary search.
+//
+struct _PIF_CPUID_REPLAY {
+    PPIF_CPUID_REPLAY_ENTRY Entries;
+    UINT32 EntryCount;
+    UINT32 EntryCapacity;
+    UINT32 CpuCount;
+};
+
+
+static
+int
+PifpCompareReplayEntries(
+    IN CONST VOID *Left,
+    IN CONST VOID *Right
+)
+{
+    CONST PIF_CPUID_REPLAY_ENTRY *A = (CONST PIF_CPUID_REPLAY_ENTRY *)Left;
+    CONST PIF_CPUID_REPLAY_ENTRY *B = (CONST PIF_CPUID_REPLAY_ENTRY *)Right;
+
+    if (A->Cpu != B->Cpu)
+    {
+        return (A->Cpu < B->Cpu) ? -1 : 1;
+    }
+    if (A->Leaf != B->Leaf)
+    {
+        return (A->Leaf < B->Leaf) ? -1 : 1;
+    }
+    if (A->SubLeaf != B->SubLeaf)
+    {
+        return (A->SubLeaf < B->SubLeaf) ? -1 : 1;
+    }
+    return (A->Sequence < B->Sequence) ? -1 : (A->Sequence > B->Sequence);
+}
+
+//
+// Returns the index of the first entry not ordered before (Cpu, Leaf, SubLeaf).
+//
+static
+UINT32
+PifpLowerBoundReplayEntry(
+    IN PCPIF_CPUID_REPLAY Replay,
+    IN UINT32 Cpu,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf
+)
+{
+    CONST PIF_CPUID_REPLAY_ENTRY *Entry;
+    UINT32 Low = 0;
+    UINT32 High = Replay->EntryCount;
+    UINT32 Middle;
+
+    while (Low < High)
+    {
+        Middle = Low + (High - Low) / 2;
+        Entry = &Replay->Entries[Middle];
+        if (Entry->Cpu < Cpu ||
+            (Entry->Cpu == Cpu && (Entry->Leaf < Leaf || (Entry->Leaf == Leaf && Entry->SubLeaf < SubLeaf))))
+        {
+            Low = Middle + 1;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    return Low;
+}
+
+static
+STATUS
+BLAPI
+PifpReplayCpuid(
+    IN VOID *Parameter,
+    IN UINT32 Cpu,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    OUT PCPUID_INFO CpuInfo
+)
+{
+    PCPIF_CPUID_REPLAY Replay = (PCPIF_CPUID_REPLAY)Parameter;
+    CONST PIF_CPUID_REPLAY_ENTRY *Entry;
+    UINT32 Index;
+
+    Index = PifpLowerBoundReplayEntry( Replay, Cpu, Leaf, SubLeaf );
+    if (Index < Replay->EntryCount)
+    {
+        Entry = &Replay->Entries[Index];
+        if (Entry->Cpu == Cpu && Entry->Leaf == Leaf && Entry->SubLeaf == SubLeaf)
+        {
+            *CpuInfo = Entry->Info;
+            return STATUS_OK;
+        }
+    }
+
+    //
+    // A processor is present if the dump has any leaf for it.
+    //
+    Index = PifpLowerBoundReplayEntry( Replay, Cpu, 0, 0 );
+    if (Index >= Replay->EntryCount || Replay->Entries[Index].Cpu != Cpu)
+    {
+        return E_NOSUCHDEVICE;
+    }
+
+    memset( CpuInfo, 0, sizeof( CPUID_INFO ) );
+    return STATUS_OK;
+}
+
+static
+STATUS
+PifpAddReplayEntry(
+    IN OUT PPIF_CPUID_REPLAY Replay,
+    IN UINT32 Cpu,
+    IN UINT32 Leaf,
+    IN UINT32 SubLeaf,
+    IN CONST CPUID_INFO *Info
+)
+{
+    PPIF_CPUID_REPLAY_ENTRY NewEntries;
+    PPIF_CPUID_REPLAY_ENTRY Entry;
+    UINT32 NewCapacity;
+
+    if (Replay->EntryCount == Replay->EntryCapacity)
+    {
+        NewCapacity = (Replay->EntryCapacity != 0) ? Replay->EntryCapacity * 2 : 256;
+        NewEntries = realloc( Replay->Entries, sizeof( PIF_CPUID_REPLAY_ENTRY ) * NewCapacity );
+        if (!NewEntries)
+        {
+            return E_NOMEM;
+        }
+
+        Replay->Entries = NewEntries;
+        Replay->EntryCapacity = NewCapacity;
+    }
+
+    Entry = &Replay->Entries[Replay->EntryCount];
+    Entry->Cpu = Cpu;
+    Entry->Leaf = Leaf;
+    Entry->SubLeaf = SubLeaf;
+    Entry->Sequence = Replay->EntryCount;
+    Entry->Info = *Info;
+    ++Replay->EntryCount;
+
+    if (Cpu >= Replay->CpuCount)
+    {
+        Replay->CpuCount = Cpu + 1;
+    }
+
+    return STATUS_OK;
+}
+
+//
+// Parses one dump line, which is NUL terminated and has no leading blanks.
+// Updates Cpu on processor headers.
+//
+static
+STATUS
+PifpParseDumpLine(
+    IN OUT PPIF_CPUID_REPLAY Replay,
+    IN CONST CHAR *Line,
+    IN OUT UINT32 *Cpu
+)
+{
+    unsigned int Values[6];
+    unsigned int Number;
+    CONST CHAR *SubLeaf;
+    CPUID_INFO Info;
+
+    //
+    // InstLatx64/AIDA64: "CPUID 00000004: 1C004121-01C0003F-0000003F-00000000 [SL 01]"
+    //
+    if (sscanf( Line, "CPUID %x: %x-%x-%x-%x", &Values[0], &Values[2], &Values[3], &Values[4], &Values[5] ) == 5)
+    {
+        SubLeaf = strstr( Line, "[SL " );
+        if (SubLeaf == NULL || sscanf( SubLeaf + 4, "%x", &Values[1] ) != 1)
+        {
+            Values[1] = 0;
+        }
+    }
+    //
+    // cpuid -r: "0x00000004 0x01: eax=0x1c004122 ebx=0x01c0003f ecx=0x0000003f edx=0x00000000"
+    //
+    else if (sscanf( Line, "0x%x 0x%x: eax=0x%x ebx=0x%x ecx=0x%x edx=0x%x",
+                     &Values[0], &Values[1], &Values[2], &Values[3], &Values[4], &Values[5] ) != 6)
+    {
+        //
+        // Processor headers, "CPU#001 ..." or "CPU 1:".
+        //
+        if ((strncmp( Line, "CPU#", 4 ) == 0 && sscanf( Line + 4, "%u", &Number ) == 1) ||
+            sscanf( Line, "CPU %u:", &Number ) == 1)
+        {
+            if (Number >= PIF_REPLAY_MAX_CPUS)
+            {
+                return E_BOUNDS;
+            }
+
+            *Cpu = Number;
+        }
+
+        return STATUS_OK;
+    }
+
+    Info.Eax = Values[2];
+    Info.Ebx = Values[3];
+    Info.Ecx = Values[4];
+    Info.Edx = Values[5];
+    return PifpAddReplayEntry( Replay, *Cpu, Values[0], Values[1], &Info );
+}
+
+VOID
+PIFAPI
+PifDestroyCpuidReplay(
+    IN PPIF_CPUID_REPLAY Replay OPTIONAL
+)
+{
+    if (Replay == NULL)
+    {
+        return;
+    }
+
+    free( Replay->Entries );
+    free( Replay );
+}
+
+STATUS
+PIFAPI
+PifParseCpuidDump(
+    IN CONST CHAR *Text,
+    IN SIZE_T Length,
+    OUT PPIF_CPUID_REPLAY *Replay
+)
+{
+    PPIF_CPUID_REPLAY NewReplay;
+    CHAR Line[PIF_REPLAY_MAX_LINE];
+    SIZE_T Position;
+    SIZE_T LineLength;
+    UINT32 Cpu;
+    UINT32 Index;
+    UINT32 Count;
+    STATUS Status;
+
+    if (Text == NULL || Replay == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Replay = NULL;
+
+    NewReplay = calloc( 1, sizeof( PIF_CPUID_REPLAY ) );
+    if (!NewReplay)
+    {
+        return E_NOMEM;
+    }
+
+    //
+    // Leaves before the first processor header belong to processor 0.
+    //
+    Cpu = 0;
+    Status = STATUS_OK;
+    Position = 0;
+    while (SUCCESS( Status ) && Position < Length)
+    {
+        while (Position < Length && (Text[Position] == ' ' || Text[Position] == '\t'))
+        {
+            ++Position;
+        }
+
+        LineLength = 0;
+        while (Position < Length && Text[Position] != '\n')
+        {
+            if (LineLength < sizeof( Line ) - 1)
+            {
+                Line[LineLength++] = Text[Position];
+            }
+            ++Position;
+        }
+
+        ++Position;
+        Line[LineLength] = '\0';
+        Status = PifpParseDumpLine( NewReplay, Line, &Cpu );
+    }
+
+    if (SUCCESS( Status ) && NewReplay->EntryCount == 0)
+    {
+        Status = E_NODATA;
+    }
+
+    if (!SUCCESS( Status ))
+    {
+        PifDestroyCpuidReplay( NewReplay );
+        return Status;
+    }
+
+    //
+    // Sort for lookup and drop repeated leaves, keeping the first one seen.
+    //
+    qsort( NewReplay->Entries, NewReplay->EntryCount, sizeof( PIF_CPUID_REPLAY_ENTRY ), PifpCompareReplayEntries );
+
+    Count = 1;
+    for (Index = 1; Index < NewReplay->EntryCount; ++Index)
+    {
+        if (NewReplay->Entries[Index].Cpu != NewReplay->Entries[Count - 1].Cpu ||
+            NewReplay->Entries[Index].Leaf != NewReplay->Entries[Count - 1].Leaf ||
+            NewReplay->Entries[Index].SubLeaf != NewReplay->Entries[Count - 1].SubLeaf)
+        {
+            NewReplay->Entries[Count++] = NewReplay->Entries[Index];
+        }
+    }
+
+    NewReplay->EntryCount = Count;
+
+    *Replay = NewReplay;
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifLoadCpuidDump(
+    IN PCSTR Path,
+    OUT PPIF_CPUID_REPLAY *Replay
+)
+{
+    FILE *File;
+    CHAR *Text;
+    long Length;
+    STATUS Status;
+
+    if (Path == NULL || Replay == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Replay = NULL;
+
+    File = fopen( Path, "rb" );
+    if (File == NULL)
+    {
+        return E_NOSUCHFILE;
+    }
+
+    if (fseek( File, 0, SEEK_END ) != 0 || (Length = ftell( File )) < 0 || fseek( File, 0, SEEK_SET ) != 0)
+    {
+        fclose( File );
+        return E_IO;
+    }
+
+    Text = malloc( (SIZE_T)Length + 1 );
+    if (!Text)
+    {
+        fclose( File );
+        return E_NOMEM;
+    }
+
+    Status = (fread( Text, 1, (SIZE_T)Length, File ) == (SIZE_T)Length) ? STATUS_OK : E_IO;
+    fclose( File );
+
+    if (SUCCESS( Status ))
+    {
+        Status = PifParseCpuidDump( Text, (SIZE_T)Length, Replay );
+    }
+
+    free( Text );
+    return Status;
+}
+
+VOID
+PIFAPI
+PifGetCpuidReplaySource(
+    IN PCPIF_CPUID_REPLAY Replay,
+    OUT PPIF_CPUID_SOURCE Source
+)
+{
+    memset( Source, 0, sizeof( PIF_CPUID_SOURCE ) );
+    Source->Cpuid = PifpReplayCpuid;
+    Source->Parameter = (VOID *)Replay;
+    Source->CpuCount = Replay->CpuCount;
+}
+
+STATUS
+PIFAPI
+PifInitializeFromCpuidDump(
+    IN PCSTR Path
+)
+{
+    PPIF_CPUID_REPLAY Replay;
+    PIF_CPUID_SOURCE Source;
+    PPIF_CONTEXT Context;
+    STATUS Status;
+
+    Status = PifLoadCpuidDump( Path, &Replay );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    PifGetCpuidReplaySource( Replay, &Source );
+    Status = PifCreateContextFromSource( &Source, &Context );
+    PifDestroyCpuidReplay( Replay );
+
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    return PifInitializeFromContext( Context );
+}
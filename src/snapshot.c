@@ -0,0 +1,826 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file snapshot.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#include "pifp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//
+// Snapshot image layout. Every field is little-endian, the native byte order
+// of all processors this library runs on, so an image is used in place with
+// no conversion. Sections are located by absolute offset from the start of
+// the image and begin on a 64 byte boundary:
+//
+//   PIF_SNAPSHOT_HEADER
+//   CPUID_LEAF  Leaves[]                               leaf tables of all ranges
+//   CPUID_INFO  Info[InfoCount]
+//   CPUID_INFO  PerCpuInfo[CpuCount * PerCpuStride]    PIF_SNAPSHOT_FLAG_PER_CPU
+//   BOOLEAN     PerCpuPresent[CpuCount]                PIF_SNAPSHOT_FLAG_PER_CPU
+//   PIF_SNAPSHOT_TOPOLOGY, followed by its arrays      PIF_SNAPSHOT_FLAG_TOPOLOGY
+//
+// Loading only validates the header and the table bounds, and then points a
+// context at the sections.
+//
+#define PIF_SNAPSHOT_MAGIC          0x53464950  // 'PIFS'
+#define PIF_SNAPSHOT_BYTE_ORDER     0x01020304
+#define PIF_SNAPSHOT_ALIGNMENT      64
+
+#define PIF_SNAPSHOT_FLAG_PER_CPU   0x0001
+#define PIF_SNAPSHOT_FLAG_TOPOLOGY  0x0002
+
+typedef struct _PIF_SNAPSHOT_SECTION {
+    UINT64 Offset;
+    UINT64 Size;
+} PIF_SNAPSHOT_SECTION, *PPIF_SNAPSHOT_SECTION;
+
+typedef struct _PIF_SNAPSHOT_HEADER {
+    UINT32 Magic;                                   //!< PIF_SNAPSHOT_MAGIC
+    UINT16 Version;                                 //!< PIF_SNAPSHOT_VERSION
+    UINT16 HeaderSize;                              //!< Offset of the first section
+    UINT32 ByteOrder;                               //!< PIF_SNAPSHOT_BYTE_ORDER
+    UINT32 Flags;                                   //!< PIF_SNAPSHOT_* flags
+    UINT64 ImageSize;
+    UINT64 XfeatureEnabledMask;
+    UINT32 Vendor;
+    UINT32 InfoCount;
+    UINT32 CpuCount;
+    UINT32 PerCpuStride;
+    UINT32 RangeLeafOffset[CPUID_RANGE_COUNT];      //!< Index of the first leaf of each range in Leaves
+    UINT32 RangeLeafCount[CPUID_RANGE_COUNT];       //!< Zero when the range is not reported
+    UINT32 RangeBase[CPUID_RANGE_COUNT];            //!< First leaf of each range
+    CHAR VendorString[32];
+    CHAR BrandString[64];
+    UINT32 Features[PIF_FEATURE_WORDS];
+    UINT32 UsableFeatures[PIF_FEATURE_WORDS];
+    PIF_SNAPSHOT_SECTION Leaves;
+    PIF_SNAPSHOT_SECTION Info;
+    PIF_SNAPSHOT_SECTION PerCpuInfo;
+    PIF_SNAPSHOT_SECTION PerCpuPresent;
+    PIF_SNAPSHOT_SECTION Topology;
+} PIF_SNAPSHOT_HEADER, *PPIF_SNAPSHOT_HEADER;
+typedef CONST PIF_SNAPSHOT_HEADER *PCPIF_SNAPSHOT_HEADER;
+
+typedef struct _PIF_SNAPSHOT_TOPOLOGY {
+    UINT32 CpuCount;
+    UINT32 LogicalCpuCount;
+    UINT32 CoreCount;
+    UINT32 DieCount;
+    UINT32 PackageCount;
+    UINT32 SmtShift;
+    UINT32 DieShift;
+    UINT32 PackageShift;
+    UINT64 Cpus;                                    //!< Offsets of the PIF_TOPOLOGY arrays
+    UINT64 Cores;
+    UINT64 Dies;
+    UINT64 Packages;
+    UINT64 CpuList;
+} PIF_SNAPSHOT_TOPOLOGY, *PPIF_SNAPSHOT_TOPOLOGY;
+typedef CONST PIF_SNAPSHOT_TOPOLOGY *PCPIF_SNAPSHOT_TOPOLOGY;
+
+//
+// The format is fixed, the structures must not depend on the compiler.
+//
+C_ASSERT( sizeof( PIF_SNAPSHOT_HEADER ) == 400 );
+C_ASSERT( sizeof( PIF_SNAPSHOT_TOPOLOGY ) == 72 );
+C_ASSERT( sizeof( CPUID_LEAF ) == 8 );
+C_ASSERT( sizeof( CPUID_INFO ) == 16 );
+C_ASSERT( sizeof( BOOLEAN ) == 1 );
+C_ASSERT( sizeof( PIF_FEATURES ) == PIF_FEATURE_WORDS * sizeof( UINT32 ) );
+C_ASSERT( sizeof( PIF_CPU_TOPOLOGY ) == 32 );
+C_ASSERT( sizeof( PIF_TOPOLOGY_CORE ) == 20 );
+C_ASSERT( sizeof( PIF_TOPOLOGY_DIE ) == 24 );
+C_ASSERT( sizeof( PIF_TOPOLOGY_PACKAGE ) == 28 );
+
+#define PifpAlignSnapshotOffset(Offset) \
+    (((Offset) + PIF_SNAPSHOT_ALIGNMENT - 1) & ~(UINT64)(PIF_SNAPSHOT_ALIGNMENT - 1))
+
+
+//
+// Places a section of Size bytes at the next aligned offset.
+//
+static
+VOID
+PifpPlaceSection(
+    OUT PPIF_SNAPSHOT_SECTION Section,
+    IN OUT UINT64 *Offset,
+    IN UINT64 Size
+)
+{
+    Section->Offset = PifpAlignSnapshotOffset( *Offset );
+    Section->Size = Size;
+    *Offset = Section->Offset + Size;
+}
+
+static
+UINT64
+PifpPlaceArray(
+    IN OUT UINT64 *Offset,
+    IN UINT64 Size
+)
+{
+    UINT64 ArrayOffset = PifpAlignSnapshotOffset( *Offset );
+
+    *Offset = ArrayOffset + Size;
+    return ArrayOffset;
+}
+
+//
+// Fills in the header of the image of a context, including the offset of
+// every section, and returns the total image size.
+//
+static
+UINT64
+PifpLayoutSnapshot(
+    IN PCPIF_CONTEXT Context,
+    IN PCPIF_TOPOLOGY Topology OPTIONAL,
+    OUT PPIF_SNAPSHOT_HEADER Header,
+    OUT PPIF_SNAPSHOT_TOPOLOGY SnapshotTopology
+)
+{
+    CONST CPUID_RANGE *Range;
+    UINT32 LeafCount;
+    UINT32 Index;
+    UINT64 Offset;
+
+    memset( Header, 0, sizeof( PIF_SNAPSHOT_HEADER ) );
+    memset( SnapshotTopology, 0, sizeof( PIF_SNAPSHOT_TOPOLOGY ) );
+
+    Header->Magic = PIF_SNAPSHOT_MAGIC;
+    Header->Version = PIF_SNAPSHOT_VERSION;
+    Header->HeaderSize = sizeof( PIF_SNAPSHOT_HEADER );
+    Header->ByteOrder = PIF_SNAPSHOT_BYTE_ORDER;
+    Header->XfeatureEnabledMask = Context->XfeatureEnabledMask;
+    Header->Vendor = (UINT32)Context->Vendor;
+    Header->InfoCount = Context->InfoCount;
+    memcpy( Header->VendorString, Context->VendorString, sizeof( Header->VendorString ) );
+    memcpy( Header->BrandString, Context->BrandString, sizeof( Header->BrandString ) );
+    memcpy( Header->Features, &Context->Features, sizeof( Header->Features ) );
+    memcpy( Header->UsableFeatures, &Context->UsableFeatures, sizeof( Header->UsableFeatures ) );
+
+    LeafCount = 0;
+    for (Index = 0; Index < CPUID_RANGE_COUNT; ++Index)
+    {
+        Range = &Context->Ranges[Index];
+        if (Range->Leaves != NULL)
+        {
+            Header->RangeLeafOffset[Index] = LeafCount;
+            Header->RangeLeafCount[Index] = Range->Max - Range->Base + 1;
+            Header->RangeBase[Index] = Range->Base;
+            LeafCount += Header->RangeLeafCount[Index];
+        }
+    }
+
+    Offset = sizeof( PIF_SNAPSHOT_HEADER );
+    PifpPlaceSection( &Header->Leaves, &Offset, (UINT64)LeafCount * sizeof( CPUID_LEAF ) );
+    PifpPlaceSection( &Header->Info, &Offset, (UINT64)Context->InfoCount * sizeof( CPUID_INFO ) );
+
+    if (Context->PerCpuInfo != NULL)
+    {
+        Header->Flags |= PIF_SNAPSHOT_FLAG_PER_CPU;
+        Header->CpuCount = Context->CpuCount;
+        Header->PerCpuStride = Context->PerCpuStride;
+        PifpPlaceSection( &Header->PerCpuInfo, &Offset,
+                          (UINT64)Context->CpuCount * Context->PerCpuStride * sizeof( CPUID_INFO ) );
+        PifpPlaceSection( &Header->PerCpuPresent, &Offset, (UINT64)Context->CpuCount * sizeof( BOOLEAN ) );
+    }
+
+    if (Topology != NULL)
+    {
+        Header->Flags |= PIF_SNAPSHOT_FLAG_TOPOLOGY;
+        SnapshotTopology->CpuCount = Topology->CpuCount;
+        SnapshotTopology->LogicalCpuCount = Topology->LogicalCpuCount;
+        SnapshotTopology->CoreCount = Topology->CoreCount;
+        SnapshotTopology->DieCount = Topology->DieCount;
+        SnapshotTopology->PackageCount = Topology->PackageCount;
+        SnapshotTopology->SmtShift = Topology->SmtShift;
+        SnapshotTopology->DieShift = Topology->DieShift;
+        SnapshotTopology->PackageShift = Topology->PackageShift;
+
+        PifpPlaceSection( &Header->Topology, &Offset, sizeof( PIF_SNAPSHOT_TOPOLOGY ) );
+        SnapshotTopology->Cpus = PifpPlaceArray( &Offset, (UINT64)Topology->CpuCount * sizeof( PIF_CPU_TOPOLOGY ) );
+        SnapshotTopology->Cores = PifpPlaceArray( &Offset, (UINT64)Topology->CoreCount * sizeof( PIF_TOPOLOGY_CORE ) );
+        SnapshotTopology->Dies = PifpPlaceArray( &Offset, (UINT64)Topology->DieCount * sizeof( PIF_TOPOLOGY_DIE ) );
+        SnapshotTopology->Packages = PifpPlaceArray( &Offset, (UINT64)Topology->PackageCount * sizeof( PIF_TOPOLOGY_PACKAGE ) );
+        SnapshotTopology->CpuList = PifpPlaceArray( &Offset, (UINT64)Topology->LogicalCpuCount * sizeof( UINT32 ) );
+        Header->Topology.Size = Offset - Header->Topology.Offset;
+    }
+
+    Header->ImageSize = PifpAlignSnapshotOffset( Offset );
+    return Header->ImageSize;
+}
+
+STATUS
+PIFAPI
+PifSerializeSnapshot(
+    IN PCPIF_CONTEXT Context,
+    OUT VOID *Buffer OPTIONAL,
+    IN SIZE_T BufferSize,
+    OUT SIZE_T *RequiredSize
+)
+{
+    PIF_SNAPSHOT_HEADER Header;
+    PIF_SNAPSHOT_TOPOLOGY SnapshotTopology;
+    PCPIF_TOPOLOGY Topology;
+    CONST CPUID_RANGE *Range;
+    UINT8 *Image = (UINT8 *)Buffer;
+    UINT64 ImageSize;
+    UINT32 Index;
+
+    if (Context == NULL || RequiredSize == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if (!SUCCESS( PifContextGetTopology( Context, &Topology ) ))
+    {
+        Topology = NULL;
+    }
+
+    ImageSize = PifpLayoutSnapshot( Context, Topology, &Header, &SnapshotTopology );
+    if (ImageSize > (SIZE_T)-1)
+    {
+        return E_OVERFLOW;
+    }
+
+    *RequiredSize = (SIZE_T)ImageSize;
+    if (Buffer == NULL)
+    {
+        return STATUS_OK;
+    }
+
+    if (BufferSize < ImageSize)
+    {
+        return E_BOUNDS;
+    }
+
+    //
+    // Zero the padding too, so identical snapshots produce identical images.
+    //
+    memset( Image, 0, (SIZE_T)ImageSize );
+    memcpy( Image, &Header, sizeof( Header ) );
+
+    for (Index = 0; Index < CPUID_RANGE_COUNT; ++Index)
+    {
+        Range = &Context->Ranges[Index];
+        if (Range->Leaves != NULL)
+        {
+            memcpy( Image + Header.Leaves.Offset + (SIZE_T)Header.RangeLeafOffset[Index] * sizeof( CPUID_LEAF ),
+                    Range->Leaves, (SIZE_T)Header.RangeLeafCount[Index] * sizeof( CPUID_LEAF ) );
+        }
+    }
+
+    memcpy( Image + Header.Info.Offset, Context->Info, (SIZE_T)Header.Info.Size );
+
+    if (Header.Flags & PIF_SNAPSHOT_FLAG_PER_CPU)
+    {
+        memcpy( Image + Header.PerCpuInfo.Offset, Context->PerCpuInfo, (SIZE_T)Header.PerCpuInfo.Size );
+        memcpy( Image + Header.PerCpuPresent.Offset, Context->PerCpuPresent, (SIZE_T)Header.PerCpuPresent.Size );
+    }
+
+    if (Header.Flags & PIF_SNAPSHOT_FLAG_TOPOLOGY)
+    {
+        memcpy( Image + Header.Topology.Offset, &SnapshotTopology, sizeof( SnapshotTopology ) );
+        memcpy( Image + SnapshotTopology.Cpus, Topology->Cpus, (SIZE_T)Topology->CpuCount * sizeof( PIF_CPU_TOPOLOGY ) );
+        memcpy( Image + SnapshotTopology.Cores, Topology->Cores, (SIZE_T)Topology->CoreCount * sizeof( PIF_TOPOLOGY_CORE ) );
+        memcpy( Image + SnapshotTopology.Dies, Topology->Dies, (SIZE_T)Topology->DieCount * sizeof( PIF_TOPOLOGY_DIE ) );
+        memcpy( Image + SnapshotTopology.Packages, Topology->Packages, (SIZE_T)Topology->PackageCount * sizeof( PIF_TOPOLOGY_PACKAGE ) );
+        memcpy( Image + SnapshotTopology.CpuList, Topology->CpuList, (SIZE_T)Topology->LogicalCpuCount * sizeof( UINT32 ) );
+    }
+
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifSaveSnapshot(
+    IN PCPIF_CONTEXT Context,
+    IN PCSTR Path
+)
+{
+    VOID *Image;
+    SIZE_T ImageSize;
+    FILE *File;
+    STATUS Status;
+
+    if (Path == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    Status = PifSerializeSnapshot( Context, NULL, 0, &ImageSize );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    Image = malloc( ImageSize );
+    if (!Image)
+    {
+        return E_NOMEM;
+    }
+
+    Status = PifSerializeSnapshot( Context, Image, ImageSize, &ImageSize );
+    if (SUCCESS( Status ))
+    {
+        File = fopen( Path, "wb" );
+        if (File == NULL)
+        {
+            Status = E_NOCREATE;
+        }
+        else
+        {
+            if (fwrite( Image, 1, ImageSize, File ) != ImageSize)
+            {
+                Status = E_IO;
+            }
+
+            if (fclose( File ) != 0)
+            {
+                Status = E_IO;
+            }
+        }
+    }
+
+    free( Image );
+    return Status;
+}
+
+//
+// Checks that a section holds exactly Count elements of ElementSize bytes
+// and lies entirely within the image.
+//
+static
+BOOLEAN
+PifpIsValidSection(
+    IN PCPIF_SNAPSHOT_HEADER Header,
+    IN UINT64 ImageSize,
+    IN UINT64 Offset,
+    IN UINT64 Size,
+    IN UINT64 Count,
+    IN UINT64 ElementSize
+)
+{
+    return (BOOLEAN)(Offset >= Header->HeaderSize &&
+                     (Offset & 7) == 0 &&
+                     Offset <= ImageSize &&
+                     Size <= ImageSize - Offset &&
+                     Count <= Size &&
+                     Count * ElementSize == Size);
+}
+
+static
+BOOLEAN
+PifpIsValidTopology(
+    IN PCPIF_TOPOLOGY Topology
+)
+{
+    UINT32 Index;
+
+    for (Index = 0; Index < Topology->LogicalCpuCount; ++Index)
+    {
+        if (Topology->CpuList[Index] >= Topology->CpuCount)
+        {
+            return FALSE;
+        }
+    }
+
+    for (Index = 0; Index < Topology->CoreCount; ++Index)
+    {
+        if (Topology->Cores[Index].FirstCpu > Topology->LogicalCpuCount ||
+            Topology->Cores[Index].CpuCount > Topology->LogicalCpuCount - Topology->Cores[Index].FirstCpu)
+        {
+            return FALSE;
+        }
+    }
+
+    for (Index = 0; Index < Topology->DieCount; ++Index)
+    {
+        if (Topology->Dies[Index].FirstCpu > Topology->LogicalCpuCount ||
+            Topology->Dies[Index].CpuCount > Topology->LogicalCpuCount - Topology->Dies[Index].FirstCpu ||
+            Topology->Dies[Index].FirstCore > Topology->CoreCount ||
+            Topology->Dies[Index].CoreCount > Topology->CoreCount - Topology->Dies[Index].FirstCore)
+        {
+            return FALSE;
+        }
+    }
+
+    for (Index = 0; Index < Topology->PackageCount; ++Index)
+    {
+        if (Topology->Packages[Index].FirstCpu > Topology->LogicalCpuCount ||
+            Topology->Packages[Index].CpuCount > Topology->LogicalCpuCount - Topology->Packages[Index].FirstCpu ||
+            Topology->Packages[Index].FirstDie > Topology->DieCount ||
+            Topology->Packages[Index].DieCount > Topology->DieCount - Topology->Packages[Index].FirstDie ||
+            Topology->Packages[Index].FirstCore > Topology->CoreCount ||
+            Topology->Packages[Index].CoreCount > Topology->CoreCount - Topology->Packages[Index].FirstCore)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+//
+// Points the tables of Context into a validated image.
+//
+static
+STATUS
+PifpAttachSnapshot(
+    IN OUT PPIF_CONTEXT Context,
+    IN CONST UINT8 *Image,
+    IN UINT64 ImageSize
+)
+{
+    PCPIF_SNAPSHOT_HEADER Header = (PCPIF_SNAPSHOT_HEADER)Image;
+    PCPIF_SNAPSHOT_TOPOLOGY SnapshotTopology;
+    PPIF_TOPOLOGY Topology;
+    CONST CPUID_LEAF *Leaves;
+    UINT64 LeafCount;
+    UINT64 Index;
+
+    if (ImageSize < sizeof( PIF_SNAPSHOT_HEADER ) ||
+        Header->Magic != PIF_SNAPSHOT_MAGIC ||
+        Header->ByteOrder != PIF_SNAPSHOT_BYTE_ORDER)
+    {
+        return E_BADDATA;
+    }
+
+    if (Header->Version != PIF_SNAPSHOT_VERSION)
+    {
+        return E_UNSUPPORTED;
+    }
+
+    if (Header->HeaderSize < sizeof( PIF_SNAPSHOT_HEADER ) || Header->ImageSize > ImageSize)
+    {
+        return E_BADDATA;
+    }
+
+    ImageSize = Header->ImageSize;
+
+    //
+    // The basic range is always present, every range must lie within its own
+    // quarter of the leaf space, and every leaf must reference sub-leaves
+    // within Info.
+    //
+    LeafCount = 0;
+    for (Index = 0; Index < CPUID_RANGE_COUNT; ++Index)
+    {
+        if (Header->RangeLeafCount[Index] != 0 &&
+            ((Header->RangeBase[Index] >> CPUID_RANGE_SHIFT) != Index ||
+             Header->RangeLeafCount[Index] > (1u << CPUID_RANGE_SHIFT) - (Header->RangeBase[Index] & ((1u << CPUID_RANGE_SHIFT) - 1)) ||
+             Header->RangeLeafOffset[Index] != LeafCount))
+        {
+            return E_BADDATA;
+        }
+
+        LeafCount += Header->RangeLeafCount[Index];
+    }
+
+    if (Header->RangeLeafCount[0] == 0 || Header->InfoCount == 0 ||
+        !PifpIsValidSection( Header, ImageSize, Header->Leaves.Offset, Header->Leaves.Size, LeafCount, sizeof( CPUID_LEAF ) ) ||
+        !PifpIsValidSection( Header, ImageSize, Header->Info.Offset, Header->Info.Size, Header->InfoCount, sizeof( CPUID_INFO ) ))
+    {
+        return E_BADDATA;
+    }
+
+    Leaves = (CONST CPUID_LEAF *)(Image + Header->Leaves.Offset);
+    for (Index = 0; Index < LeafCount; ++Index)
+    {
+        if ((UINT64)Leaves[Index].Offset + MAX( Leaves[Index].SubLeafCount, 1 ) > Header->InfoCount)
+        {
+            return E_BADDATA;
+        }
+    }
+
+    for (Index = 0; Index < CPUID_RANGE_COUNT; ++Index)
+    {
+        if (Header->RangeLeafCount[Index] != 0)
+        {
+            Context->Ranges[Index].Leaves = (PCPUID_LEAF)&Leaves[Header->RangeLeafOffset[Index]];
+            Context->Ranges[Index].Base = Header->RangeBase[Index];
+            Context->Ranges[Index].Max = Context->Ranges[Index].Base + Header->RangeLeafCount[Index] - 1;
+        }
+    }
+
+    Context->Info = (PCPUID_INFO)(Image + Header->Info.Offset);
+    Context->InfoCount = Header->InfoCount;
+    Context->InfoCapacity = Header->InfoCount;
+
+    if (Header->Flags & PIF_SNAPSHOT_FLAG_PER_CPU)
+    {
+        if (Header->CpuCount == 0 || Header->PerCpuStride < Header->InfoCount ||
+            !PifpIsValidSection( Header, ImageSize, Header->PerCpuInfo.Offset, Header->PerCpuInfo.Size,
+                                 (UINT64)Header->CpuCount * Header->PerCpuStride, sizeof( CPUID_INFO ) ) ||
+            !PifpIsValidSection( Header, ImageSize, Header->PerCpuPresent.Offset, Header->PerCpuPresent.Size,
+                                 Header->CpuCount, sizeof( BOOLEAN ) ))
+        {
+            return E_BADDATA;
+        }
+
+        Context->PerCpuInfo = (PCPUID_INFO)(Image + Header->PerCpuInfo.Offset);
+        Context->PerCpuPresent = (PBOOLEAN)(Image + Header->PerCpuPresent.Offset);
+        Context->PerCpuStride = Header->PerCpuStride;
+        Context->CpuCount = Header->CpuCount;
+    }
+
+    if (Header->Flags & PIF_SNAPSHOT_FLAG_TOPOLOGY)
+    {
+        if (!PifpIsValidSection( Header, ImageSize, Header->Topology.Offset, sizeof( PIF_SNAPSHOT_TOPOLOGY ), 1,
+                                 sizeof( PIF_SNAPSHOT_TOPOLOGY ) ) ||
+            Header->Topology.Size > ImageSize - Header->Topology.Offset)
+        {
+            return E_BADDATA;
+        }
+
+        SnapshotTopology = (PCPIF_SNAPSHOT_TOPOLOGY)(Image + Header->Topology.Offset);
+        if (!PifpIsValidSection( Header, ImageSize, SnapshotTopology->Cpus, (UINT64)SnapshotTopology->CpuCount * sizeof( PIF_CPU_TOPOLOGY ),
+                                 SnapshotTopology->CpuCount, sizeof( PIF_CPU_TOPOLOGY ) ) ||
+            !PifpIsValidSection( Header, ImageSize, SnapshotTopology->Cores, (UINT64)SnapshotTopology->CoreCount * sizeof( PIF_TOPOLOGY_CORE ),
+                                 SnapshotTopology->CoreCount, sizeof( PIF_TOPOLOGY_CORE ) ) ||
+            !PifpIsValidSection( Header, ImageSize, SnapshotTopology->Dies, (UINT64)SnapshotTopology->DieCount * sizeof( PIF_TOPOLOGY_DIE ),
+                                 SnapshotTopology->DieCount, sizeof( PIF_TOPOLOGY_DIE ) ) ||
+            !PifpIsValidSection( Header, ImageSize, SnapshotTopology->Packages, (UINT64)SnapshotTopology->PackageCount * sizeof( PIF_TOPOLOGY_PACKAGE ),
+                                 SnapshotTopology->PackageCount, sizeof( PIF_TOPOLOGY_PACKAGE ) ) ||
+            !PifpIsValidSection( Header, ImageSize, SnapshotTopology->CpuList, (UINT64)SnapshotTopology->LogicalCpuCount * sizeof( UINT32 ),
+                                 SnapshotTopology->LogicalCpuCount, sizeof( UINT32 ) ))
+        {
+            return E_BADDATA;
+        }
+
+        Topology = &Context->SnapshotTopology;
+        Topology->CpuCount = SnapshotTopology->CpuCount;
+        Topology->LogicalCpuCount = SnapshotTopology->LogicalCpuCount;
+        Topology->CoreCount = SnapshotTopology->CoreCount;
+        Topology->DieCount = SnapshotTopology->DieCount;
+        Topology->PackageCount = SnapshotTopology->PackageCount;
+        Topology->SmtShift = SnapshotTopology->SmtShift;
+        Topology->DieShift = SnapshotTopology->DieShift;
+        Topology->PackageShift = SnapshotTopology->PackageShift;
+        Topology->Cpus = (PPIF_CPU_TOPOLOGY)(Image + SnapshotTopology->Cpus);
+        Topology->Cores = (PPIF_TOPOLOGY_CORE)(Image + SnapshotTopology->Cores);
+        Topology->Dies = (PPIF_TOPOLOGY_DIE)(Image + SnapshotTopology->Dies);
+        Topology->Packages = (PPIF_TOPOLOGY_PACKAGE)(Image + SnapshotTopology->Packages);
+        Topology->CpuList = (PUINT32)(Image + SnapshotTopology->CpuList);
+
+        if (!PifpIsValidTopology( Topology ))
+        {
+            return E_BADDATA;
+        }
+
+        Context->Topology = Topology;
+    }
+
+    Context->XfeatureEnabledMask = Header->XfeatureEnabledMask;
+    Context->Vendor = (Header->Vendor < PifCpuVendorMax) ? (PIF_CPU_VENDOR)Header->Vendor :
+                                                          PifCpuVendorUnknown;
+    memcpy( &Context->Features, Header->Features, sizeof( PIF_FEATURES ) );
+    memcpy( &Context->UsableFeatures, Header->UsableFeatures, sizeof( PIF_FEATURES ) );
+    memcpy( Context->VendorString, Header->VendorString, sizeof( Context->VendorString ) );
+    memcpy( Context->BrandString, Header->BrandString, sizeof( Context->BrandString ) );
+    Context->VendorString[sizeof( Context->VendorString ) - 1] = '\0';
+    Context->BrandString[sizeof( Context->BrandString ) - 1] = '\0';
+    return STATUS_OK;
+}
+
+static
+STATUS
+PifpCreateSnapshotContext(
+    IN CONST VOID *Image,
+    IN SIZE_T ImageSize,
+    IN BOOLEAN Mapped,
+    OUT PPIF_CONTEXT *Context
+)
+{
+    PPIF_CONTEXT NewContext;
+    STATUS Status;
+
+    if (((UINT_PTR)Image & 7) != 0)
+    {
+        return E_ALIGN;
+    }
+
+    NewContext = PifpAllocateContext( );
+    if (!NewContext)
+    {
+        return E_NOMEM;
+    }
+
+    //
+    // The context does not own the image until it has been validated, so a
+    // failed load leaves unmapping to the caller.
+    //
+    NewContext->Snapshot = Image;
+    NewContext->SnapshotSize = ImageSize;
+
+    Status = PifpAttachSnapshot( NewContext, (CONST UINT8 *)Image, ImageSize );
+    if (SUCCESS( Status ))
+    {
+        Status = PifpPrepareContext( NewContext );
+    }
+
+    if (!SUCCESS( Status ))
+    {
+        PifDestroyContext( NewContext );
+        return Status;
+    }
+
+    NewContext->SnapshotMapped = Mapped;
+    *Context = NewContext;
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifLoadSnapshot(
+    IN CONST VOID *Image,
+    IN SIZE_T ImageSize,
+    OUT PPIF_CONTEXT *Context
+)
+{
+    if (Image == NULL || Context == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Context = NULL;
+    return PifpCreateSnapshotContext( Image, ImageSize, FALSE, Context );
+}
+
+#if defined(_WIN32)
+
+//
+// The Win32 headers cannot be combined with types.h, so the image is read
+// into an aligned buffer instead of being mapped.
+//
+STATUS
+PIFAPI
+PifMapSnapshot(
+    IN PCSTR Path,
+    OUT PPIF_CONTEXT *Context
+)
+{
+    FILE *File;
+    VOID *Image;
+    long ImageSize;
+    STATUS Status;
+
+    if (Path == NULL || Context == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Context = NULL;
+
+    File = fopen( Path, "rb" );
+    if (File == NULL)
+    {
+        return E_NOSUCHFILE;
+    }
+
+    if (fseek( File, 0, SEEK_END ) != 0 || (ImageSize = ftell( File )) < 0 || fseek( File, 0, SEEK_SET ) != 0)
+    {
+        fclose( File );
+        return E_IO;
+    }
+
+    if ((SIZE_T)ImageSize < sizeof( PIF_SNAPSHOT_HEADER ))
+    {
+        fclose( File );
+        return E_BADDATA;
+    }
+
+    Image = _aligned_malloc( (SIZE_T)ImageSize, PIF_SNAPSHOT_ALIGNMENT );
+    if (!Image)
+    {
+        fclose( File );
+        return E_NOMEM;
+    }
+
+    Status = (fread( Image, 1, (SIZE_T)ImageSize, File ) == (SIZE_T)ImageSize) ? STATUS_OK : E_IO;
+    fclose( File );
+
+    if (SUCCESS( Status ))
+    {
+        Status = PifpCreateSnapshotContext( Image, (SIZE_T)ImageSize, TRUE, Context );
+    }
+
+    if (!SUCCESS( Status ))
+    {
+        _aligned_free( Image );
+    }
+
+    return Status;
+}
+
+VOID
+PifpUnmapSnapshot(
+    IN CONST VOID *Image,
+    IN SIZE_T ImageSize
+)
+{
+    (VOID)ImageSize;
+    _aligned_free( (VOID *)Image );
+}
+
+#else
+
+STATUS
+PIFAPI
+PifMapSnapshot(
+    IN PCSTR Path,
+    OUT PPIF_CONTEXT *Context
+)
+{
+    struct stat FileStat;
+    VOID *Image;
+    int Fd;
+    STATUS Status;
+
+    if (Path == NULL || Context == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    *Context = NULL;
+
+    Fd = open( Path, O_RDONLY | O_CLOEXEC );
+    if (Fd < 0)
+    {
+        return E_NOSUCHFILE;
+    }
+
+    if (fstat( Fd, &FileStat ) != 0)
+    {
+        close( Fd );
+        return E_IO;
+    }
+
+    if (!S_ISREG( FileStat.st_mode ))
+    {
+        close( Fd );
+        return E_NOTFILE;
+    }
+
+    if ((UINT64)FileStat.st_size < sizeof( PIF_SNAPSHOT_HEADER ) || (UINT64)FileStat.st_size > (SIZE_T)-1)
+    {
+        close( Fd );
+        return E_BADDATA;
+    }
+
+    //
+    // The mapping stays valid after the descriptor is closed. Pages are only
+    // faulted in as the leaves are looked up.
+    //
+    Image = mmap( NULL, (SIZE_T)FileStat.st_size, PROT_READ, MAP_PRIVATE, Fd, 0 );
+    close( Fd );
+    if (Image == MAP_FAILED)
+    {
+        return E_NOVIRTUAL;
+    }
+
+    Status = PifpCreateSnapshotContext( Image, (SIZE_T)FileStat.st_size, TRUE, Context );
+    if (!SUCCESS( Status ))
+    {
+        munmap( Image, (SIZE_T)FileStat.st_size );
+    }
+
+    return Status;
+}
+
+VOID
+PifpUnmapSnapshot(
+    IN CONST VOID *Image,
+    IN SIZE_T ImageSize
+)
+{
+    munmap( (VOID *)Image, ImageSize );
+}
+
+#endif // _WIN32
@@ -0,0 +1,568 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file topology.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+#include "pifp.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Sort key of a processor. The comparator has no context parameter, so the
+// IDs are copied next to the processor index instead of being looked up.
+//
+typedef struct _PIF_CPU_SORT_KEY {
+    UINT32 PackageId;
+    UINT32 DieId;
+    UINT32 CoreId;
+    UINT32 SmtId;
+    UINT32 Cpu;
+} PIF_CPU_SORT_KEY, *PPIF_CPU_SORT_KEY;
+
+
+FORCEINLINE
+UINT32
+PifpCountBits(
+    IN UINT32 Count
+)
+{
+    UINT32 Bits = 0;
+
+    //
+    // Number of APIC ID bits needed to encode Count distinct values.
+    //
+    while (Bits < 32 && (1u << Bits) < Count)
+    {
+        ++Bits;
+    }
+
+    return Bits;
+}
+
+FORCEINLINE
+UINT32
+PifpExtractBits(
+    IN UINT32 Value,
+    IN UINT32 Low,
+    IN UINT32 High
+)
+{
+    if (Low >= 32 || High <= Low)
+    {
+        return 0;
+    }
+
+    Value >>= Low;
+    return (High - Low >= 32) ? Value : (Value & ((1u << (High - Low)) - 1));
+}
+
+static
+VOID
+PifpDecodeCpuTopology(
+    IN PCPIF_CONTEXT Context,
+    IN UINT32 Cpu,
+    OUT PPIF_CPU_TOPOLOGY CpuTopology,
+    OUT PUINT32 SmtShiftOut,
+    OUT PUINT32 DieShiftOut,
+    OUT PUINT32 PackageShiftOut
+)
+{
+    CPUID_INFO Signature;
+    CPUID_INFO CpuInfo;
+    UINT32 TopologyLeaf;
+    UINT32 SubLeaf;
+    UINT32 LevelType;
+    UINT32 ApicId;
+    UINT32 SmtShift;
+    UINT32 DieShift;
+    UINT32 PackageShift;
+    UINT32 LogicalCount;
+    UINT32 CoreCount;
+    UINT32 NodeId;
+    UINT32 NodesPerPackage;
+    BOOLEAN IsAmd;
+    BOOLEAN HasNode;
+
+    ApicId = 0;
+    SmtShift = 0;
+    DieShift = PIF_INVALID_INDEX;
+    PackageShift = 0;
+    HasNode = FALSE;
+    NodeId = 0;
+    NodesPerPackage = 1;
+
+    PifpContextQueryLeafOnCpu( Context, Cpu, CPUID_SIGNATURE, 0, &Signature );
+    IsAmd = (BOOLEAN)PIF_VENDOR_IS_AMD_COMPATIBLE( PifClassifyVendor( Signature.Ebx, Signature.Edx, Signature.Ecx ) );
+
+    //
+    // Prefer V2 extended topology (0x1F), then extended topology (0x0B).
+    // A leaf is only valid if sub-leaf 0 reports a non-zero processor count.
+    //
+    TopologyLeaf = 0;
+    if (Signature.Eax >= CPUID_V2_EXTENDED_TOPOLOGY &&
+        SUCCESS( PifpContextQueryLeafOnCpu( Context, Cpu, CPUID_V2_EXTENDED_TOPOLOGY, 0, &CpuInfo ) ) &&
+        (CpuInfo.Ebx & 0xFFFF) != 0)
+    {
+        TopologyLeaf = CPUID_V2_EXTENDED_TOPOLOGY;
+    }
+    else if (Signature.Eax >= CPUID_EXTENDED_TOPOLOGY &&
+             SUCCESS( PifpContextQueryLeafOnCpu( Context, Cpu, CPUID_EXTENDED_TOPOLOGY, 0, &CpuInfo ) ) &&
+             (CpuInfo.Ebx & 0xFFFF) != 0)
+    {
+        TopologyLeaf = CPUID_EXTENDED_TOPOLOGY;
+    }
+
+    if (TopologyLeaf != 0)
+    {
+        //
+        // EAX[4:0] of each level is the shift to the next level's ID, so a
+        // level's own ID starts at the shift of the level below it. Module
+        // and tile levels are folded into the core ID. The last valid level
+        // gives the package shift.
+        //
+        for (SubLeaf = 0;
+             SUCCESS( PifpContextQueryLeafOnCpu( Context, Cpu, TopologyLeaf, SubLeaf, &CpuInfo ) );
+             ++SubLeaf)
+        {
+            LevelType = (CpuInfo.Ecx >> 8) & 0xFF;
+            if (LevelType == CPUID_EXTENDED_TOPOLOGY_LEVEL_TYPE_INVALID)
+            {
+                break;
+            }
+
+            if (LevelType == CPUID_EXTENDED_TOPOLOGY_LEVEL_TYPE_SMT)
+            {
+                SmtShift = CpuInfo.Eax & 0x1F;
+            }
+            else if (LevelType == CPUID_EXTENDED_TOPOLOGY_LEVEL_TYPE_DIE)
+            {
+                DieShift = PackageShift;
+            }
+
+            PackageShift = CpuInfo.Eax & 0x1F;
+            ApicId = CpuInfo.Edx;
+        }
+    }
+    else
+    {
+        //
+        // Legacy enumeration from the initial APIC ID and the logical/core
+        // counts of leaf 0x01 and leaf 0x04 (Intel) or 0x80000008 (AMD).
+        //
+        PifpContextQueryLeafOnCpu( Context, Cpu, CPUID_FEATURES, 0, &CpuInfo );
+        ApicId = CpuInfo.Ebx >> 24;
+        LogicalCount = (CpuInfo.Edx & X86_FEATURE_HTT) ? ((CpuInfo.Ebx >> 16) & 0xFF) : 1;
+        CoreCount = 1;
+
+        if (IsAmd)
+        {
+            if (SUCCESS( PifpContextQueryLeafOnCpu( Context, Cpu, CPUID_VIR_PHY_ADDRESS_SIZE, 0, &CpuInfo ) ))
+            {
+                CoreCount = ((CpuInfo.Ecx >> 12) & 0xF) != 0 ?
+                    (1u << ((CpuInfo.Ecx >> 12) & 0xF)) : ((CpuInfo.Ecx & 0xFF) + 1);
+            }
+        }
+        else if (Signature.Eax >= CPUID_CACHE_PARAMS &&
+                 SUCCESS( PifpContextQueryLeafOnCpu( Context, Cpu, CPUID_CACHE_PARAMS, 0, &CpuInfo ) ) &&
+                 (CpuInfo.Eax & 0x1F) != 0)
+        {
+            CoreCount = (CpuInfo.Eax >> 26) + 1;
+        }
+
+        if (LogicalCount < CoreCount)
+        {
+            LogicalCount = CoreCount;
+        }
+
+        PackageShift = PifpCountBits( LogicalCount );
+        SmtShift = PifpCountBits( LogicalCount / CoreCount );
+    }
+
+    //
+    // AMD reports the node (die) and, without leaf 0x0B, the threads per
+    // core through the extended APIC ID leaf when TOPOEXT is supported.
+    //
+    if (IsAmd &&
+        SUCCESS( PifpContextQueryLeafOnCpu( Context, Cpu, CPUID_EXTENDED_FEATURES, 0, &CpuInfo ) ) &&
+        (CpuInfo.Ecx & X86_FEATURE_TOPOEXT) != 0 &&
+        SUCCESS( PifpContextQueryLeafOnCpu( Context, Cpu, CPUID_AMD_PROCESSOR_TOPOLOGY, 0, &CpuInfo ) ))
+    {
+        HasNode = TRUE;
+        NodeId = CpuInfo.Ecx & 0xFF;
+        NodesPerPackage = ((CpuInfo.Ecx >> 8) & 0x7) + 1;
+
+        if (TopologyLeaf == 0)
+        {
+            SmtShift = PifpCountBits( ((CpuInfo.Ebx >> 8) & 0xFF) + 1 );
+        }
+    }
+
+    if (DieShift == PIF_INVALID_INDEX || DieShift < SmtShift || DieShift > PackageShift)
+    {
+        DieShift = PackageShift;
+    }
+
+    CpuTopology->ApicId = ApicId;
+    CpuTopology->SmtId = PifpExtractBits( ApicId, 0, SmtShift );
+    CpuTopology->CoreId = PifpExtractBits( ApicId, SmtShift, DieShift );
+    CpuTopology->DieId = HasNode ? (NodeId % NodesPerPackage) :
+                                   PifpExtractBits( ApicId, DieShift, PackageShift );
+    CpuTopology->PackageId = (PackageShift >= 32) ? 0 : (ApicId >> PackageShift);
+
+    *SmtShiftOut = SmtShift;
+    *DieShiftOut = DieShift;
+    *PackageShiftOut = PackageShift;
+}
+
+static
+int
+PifpCompareCpus(
+    IN CONST VOID *Left,
+    IN CONST VOID *Right
+)
+{
+    CONST PIF_CPU_SORT_KEY *A = (CONST PIF_CPU_SORT_KEY *)Left;
+    CONST PIF_CPU_SORT_KEY *B = (CONST PIF_CPU_SORT_KEY *)Right;
+
+    if (A->PackageId != B->PackageId)
+    {
+        return (A->PackageId < B->PackageId) ? -1 : 1;
+    }
+    if (A->DieId != B->DieId)
+    {
+        return (A->DieId < B->DieId) ? -1 : 1;
+    }
+    if (A->CoreId != B->CoreId)
+    {
+        return (A->CoreId < B->CoreId) ? -1 : 1;
+    }
+    if (A->SmtId != B->SmtId)
+    {
+        return (A->SmtId < B->SmtId) ? -1 : 1;
+    }
+
+    return (A->Cpu < B->Cpu) ? -1 : 1;
+}
+
+VOID
+PifpDestroyTopology(
+    IN PPIF_TOPOLOGY Topology OPTIONAL
+)
+{
+    if (Topology == NULL)
+    {
+        return;
+    }
+
+    free( Topology->Cpus );
+    free( Topology->Cores );
+    free( Topology->Dies );
+    free( Topology->Packages );
+    free( Topology->CpuList );
+    free( Topology );
+}
+
+STATUS
+PifpCreateTopology(
+    IN PCPIF_CONTEXT Context,
+    OUT PPIF_TOPOLOGY *TopologyOut
+)
+{
+    PPIF_TOPOLOGY Topology;
+    PPIF_CPU_TOPOLOGY Cpu;
+    PPIF_CPU_TOPOLOGY Previous;
+    PPIF_TOPOLOGY_PACKAGE Package;
+    PPIF_TOPOLOGY_DIE Die;
+    PPIF_TOPOLOGY_CORE Core;
+    PPIF_CPU_SORT_KEY Keys;
+    UINT32 SmtShift;
+    UINT32 DieShift;
+    UINT32 PackageShift;
+    UINT32 CpuCount;
+    UINT32 Count;
+    UINT32 Index;
+
+    CpuCount = Context->CpuCount;
+    if (CpuCount == 0 || Context->PerCpuInfo == NULL)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    Topology = calloc( 1, sizeof( PIF_TOPOLOGY ) );
+    if (!Topology)
+    {
+        return E_NOMEM;
+    }
+
+    Topology->Cpus = calloc( CpuCount, sizeof( PIF_CPU_TOPOLOGY ) );
+    Topology->CpuList = calloc( CpuCount, sizeof( UINT32 ) );
+    Topology->Cores = calloc( CpuCount, sizeof( PIF_TOPOLOGY_CORE ) );
+    Topology->Dies = calloc( CpuCount, sizeof( PIF_TOPOLOGY_DIE ) );
+    Topology->Packages = calloc( CpuCount, sizeof( PIF_TOPOLOGY_PACKAGE ) );
+    if (!Topology->Cpus || !Topology->CpuList || !Topology->Cores || !Topology->Dies || !Topology->Packages)
+    {
+        PifpDestroyTopology( Topology );
+        return E_NOMEM;
+    }
+
+    Topology->CpuCount = CpuCount;
+
+    //
+    // Decode the APIC ID fields of every present processor.
+    //
+    Count = 0;
+    for (Index = 0; Index < CpuCount; ++Index)
+    {
+        Cpu = &Topology->Cpus[Index];
+        Cpu->PackageIndex = PIF_INVALID_INDEX;
+        Cpu->DieIndex = PIF_INVALID_INDEX;
+        Cpu->CoreIndex = PIF_INVALID_INDEX;
+
+        if (!Context->PerCpuPresent[Index])
+        {
+            continue;
+        }
+
+        PifpDecodeCpuTopology( Context, Index, Cpu, &SmtShift, &DieShift, &PackageShift );
+        if (Count == 0)
+        {
+            Topology->SmtShift = SmtShift;
+            Topology->DieShift = DieShift;
+            Topology->PackageShift = PackageShift;
+        }
+
+        Topology->CpuList[Count++] = Index;
+    }
+
+    Topology->LogicalCpuCount = Count;
+
+    //
+    // Order the processors by (package, die, core, thread) and build the tree
+    // from the runs of equal IDs.
+    //
+    Keys = malloc( (SIZE_T)CpuCount * sizeof( PIF_CPU_SORT_KEY ) );
+    if (!Keys)
+    {
+        PifpDestroyTopology( Topology );
+        return E_NOMEM;
+    }
+
+    for (Index = 0; Index < Count; ++Index)
+    {
+        Cpu = &Topology->Cpus[Topology->CpuList[Index]];
+        Keys[Index].PackageId = Cpu->PackageId;
+        Keys[Index].DieId = Cpu->DieId;
+        Keys[Index].CoreId = Cpu->CoreId;
+        Keys[Index].SmtId = Cpu->SmtId;
+        Keys[Index].Cpu = Topology->CpuList[Index];
+    }
+
+    qsort( Keys, Count, sizeof( PIF_CPU_SORT_KEY ), PifpCompareCpus );
+
+    for (Index = 0; Index < Count; ++Index)
+    {
+        Topology->CpuList[Index] = Keys[Index].Cpu;
+    }
+
+    free( Keys );
+
+    Package = NULL;
+    Die = NULL;
+    Core = NULL;
+    Previous = NULL;
+
+    for (Index = 0; Index < Count; ++Index)
+    {
+        Cpu = &Topology->Cpus[Topology->CpuList[Index]];
+
+        if (Previous == NULL || Cpu->PackageId != Previous->PackageId)
+        {
+            Package = &Topology->Packages[Topology->PackageCount++];
+            Package->PackageId = Cpu->PackageId;
+            Package->FirstDie = Topology->DieCount;
+            Package->FirstCore = Topology->CoreCount;
+            Package->FirstCpu = Index;
+            Previous = NULL;
+        }
+
+        if (Previous == NULL || Cpu->DieId != Previous->DieId)
+        {
+            Die = &Topology->Dies[Topology->DieCount++];
+            Die->PackageIndex = Topology->PackageCount - 1;
+            Die->DieId = Cpu->DieId;
+            Die->FirstCore = Topology->CoreCount;
+            Die->FirstCpu = Index;
+            Package->DieCount++;
+            Previous = NULL;
+        }
+
+        if (Previous == NULL || Cpu->CoreId != Previous->CoreId)
+        {
+            Core = &Topology->Cores[Topology->CoreCount++];
+            Core->PackageIndex = Topology->PackageCount - 1;
+            Core->DieIndex = Topology->DieCount - 1;
+            Core->CoreId = Cpu->CoreId;
+            Core->FirstCpu = Index;
+            Die->CoreCount++;
+            Package->CoreCount++;
+        }
+
+        Core->CpuCount++;
+        Die->CpuCount++;
+        Package->CpuCount++;
+
+        Cpu->PackageIndex = Topology->PackageCount - 1;
+        Cpu->DieIndex = Topology->DieCount - 1;
+        Cpu->CoreIndex = Topology->CoreCount - 1;
+        Previous = Cpu;
+    }
+
+    *TopologyOut = Topology;
+    return STATUS_OK;
+}
+
+//
+// Topology of the default context. Contexts replaced as the default are only
+// destroyed by PifDestroy, so it stays valid while the caller uses it.
+//
+FORCEINLINE
+PCPIF_TOPOLOGY
+PifpGetDefaultTopology(
+    VOID
+)
+{
+    PCPIF_CONTEXT Context = PifGetDefaultContext( );
+
+    return (Context != NULL) ? Context->Topology : NULL;
+}
+
+STATUS
+PIFAPI
+PifGetTopology(
+    OUT CONST PIF_TOPOLOGY **TopologyOut
+)
+{
+    PCPIF_TOPOLOGY Topology;
+
+    if (TopologyOut == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    Topology = PifpGetDefaultTopology( );
+    if (Topology == NULL || Topology->LogicalCpuCount == 0)
+    {
+        return E_NOTINITIALIZED;
+    }
+
+    *TopologyOut = Topology;
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifContextGetTopology(
+    IN PCPIF_CONTEXT Context,
+    OUT PCPIF_TOPOLOGY *TopologyOut
+)
+{
+    if (Context == NULL || TopologyOut == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    //
+    // Loaded from a snapshot image, or built when the context was created
+    // from the snapshots of all its processors.
+    //
+    if (Context->Topology == NULL)
+    {
+        return E_NOTFOUND;
+    }
+
+    *TopologyOut = Context->Topology;
+    return STATUS_OK;
+}
+
+UINT32
+PIFAPI
+PifGetCpuCore(
+    IN UINT32 Cpu
+)
+{
+    PCPIF_TOPOLOGY Topology = PifpGetDefaultTopology( );
+
+    if (Topology == NULL || Cpu >= Topology->CpuCount)
+    {
+        return PIF_INVALID_INDEX;
+    }
+
+    return Topology->Cpus[Cpu].CoreIndex;
+}
+
+STATUS
+PIFAPI
+PifGetCoreSiblings(
+    IN UINT32 CoreIndex,
+    OUT CONST UINT32 **Cpus,
+    OUT UINT32 *CpuCount
+)
+{
+    PCPIF_TOPOLOGY Topology = PifpGetDefaultTopology( );
+
+    if (Cpus == NULL || CpuCount == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if (Topology == NULL || CoreIndex >= Topology->CoreCount)
+    {
+        return E_BOUNDS;
+    }
+
+    *Cpus = &Topology->CpuList[Topology->Cores[CoreIndex].FirstCpu];
+    *CpuCount = Topology->Cores[CoreIndex].CpuCount;
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifGetPackageCpus(
+    IN UINT32 PackageIndex,
+    OUT CONST UINT32 **Cpus,
+    OUT UINT32 *CpuCount
+)
+{
+    PCPIF_TOPOLOGY Topology = PifpGetDefaultTopology( );
+
+    if (Cpus == NULL || CpuCount == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    if (Topology == NULL || PackageIndex >= Topology->PackageCount)
+    {
+        return E_BOUNDS;
+    }
+
+    *Cpus = &Topology->CpuList[Topology->Packages[PackageIndex].FirstCpu];
+    *CpuCount = Topology->Packages[PackageIndex].CpuCount;
+    return STATUS_OK;
+}
@@ -0,0 +1,508 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file uarch.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#include "pifp.h"
+
+typedef struct _PIF_VENDOR_SIGNATURE {
+    UINT32 Ebx;
+    UINT32 Edx;
+    UINT32 Ecx;
+    PIF_CPU_VENDOR Vendor;
+} PIF_VENDOR_SIGNATURE;
+
+#define VENDOR_SIGNATURE(Name, Vendor) \
+    { CPUID_SIGNATURE_##Name##_EBX, CPUID_SIGNATURE_##Name##_EDX, CPUID_SIGNATURE_##Name##_ECX, (Vendor) }
+
+//
+// Leaf 0x00 vendor signatures, most common first.
+//
+static CONST PIF_VENDOR_SIGNATURE PifVendorSignatures[] = {
+    VENDOR_SIGNATURE( INTEL, PifCpuVendorIntel ),
+    VENDOR_SIGNATURE( AMD, PifCpuVendorAmd ),
+    VENDOR_SIGNATURE( HYGON, PifCpuVendorHygon ),
+    VENDOR_SIGNATURE( ZHAOXIN, PifCpuVendorZhaoxin ),
+    VENDOR_SIGNATURE( CENTAUR, PifCpuVendorCentaur ),
+    VENDOR_SIGNATURE( VIA, PifCpuVendorVia ),
+    VENDOR_SIGNATURE( CYRIX, PifCpuVendorCyrix ),
+    VENDOR_SIGNATURE( TM1, PifCpuVendorTransmeta ),
+    VENDOR_SIGNATURE( TM2, PifCpuVendorTransmeta ),
+    VENDOR_SIGNATURE( NSC, PifCpuVendorNsc ),
+    VENDOR_SIGNATURE( NEXGEN, PifCpuVendorNexGen ),
+    VENDOR_SIGNATURE( RISE, PifCpuVendorRise ),
+    VENDOR_SIGNATURE( SIS, PifCpuVendorSis ),
+    VENDOR_SIGNATURE( UMC, PifCpuVendorUmc ),
+    VENDOR_SIGNATURE( VORTEX, PifCpuVendorVortex ),
+};
+
+static CONST CHAR *CONST PifVendorNames[PifCpuVendorMax] = {
+    [PifCpuVendorUnknown]   = "unknown",
+    [PifCpuVendorIntel]     = "Intel",
+    [PifCpuVendorAmd]       = "AMD",
+    [PifCpuVendorHygon]     = "Hygon",
+    [PifCpuVendorZhaoxin]   = "Zhaoxin",
+    [PifCpuVendorCentaur]   = "Centaur",
+    [PifCpuVendorVia]       = "VIA",
+    [PifCpuVendorCyrix]     = "Cyrix",
+    [PifCpuVendorTransmeta] = "Transmeta",
+    [PifCpuVendorNsc]       = "NSC",
+    [PifCpuVendorNexGen]    = "NexGen",
+    [PifCpuVendorRise]      = "Rise",
+    [PifCpuVendorSis]       = "SiS",
+    [PifCpuVendorUmc]       = "UMC",
+    [PifCpuVendorVortex]    = "Vortex",
+};
+
+//
+// Lookup keys pack the vendor, display family, display model and stepping so
+// that keys of one family sort by model, then stepping.
+//
+#define UARCH_KEY(Vendor, Family, Model, Stepping) \
+    (((UINT32)(Vendor) << 28) | ((UINT32)(Family) << 12) | ((UINT32)(Model) << 4) | (UINT32)(Stepping))
+
+#define UARCH_MODELS(Vendor, Family, FirstModel, LastModel, Uarch) \
+    { UARCH_KEY( Vendor, Family, FirstModel, 0 ), UARCH_KEY( Vendor, Family, LastModel, 0xF ), (Uarch) }
+
+#define UARCH_MODEL(Vendor, Family, Model, Uarch) \
+    UARCH_MODELS( Vendor, Family, Model, Model, Uarch )
+
+#define UARCH_STEPPINGS(Vendor, Family, Model, FirstStepping, LastStepping, Uarch) \
+    { UARCH_KEY( Vendor, Family, Model, FirstStepping ), UARCH_KEY( Vendor, Family, Model, LastStepping ), (Uarch) }
+
+#define INTEL_MODEL(Model, Uarch) \
+    UARCH_MODEL( PifCpuVendorIntel, 0x6, Model, Uarch )
+
+#define INTEL_STEPPINGS(Model, FirstStepping, LastStepping, Uarch) \
+    UARCH_STEPPINGS( PifCpuVendorIntel, 0x6, Model, FirstStepping, LastStepping, Uarch )
+
+#define AMD_MODELS(Family, FirstModel, LastModel, Uarch) \
+    UARCH_MODELS( PifCpuVendorAmd, Family, FirstModel, LastModel, Uarch )
+
+#define HYGON_MODELS(Family, FirstModel, LastModel, Uarch) \
+    UARCH_MODELS( PifCpuVendorHygon, Family, FirstModel, LastModel, Uarch )
+
+#define ZHAOXIN_MODEL(Family, Model, Uarch) \
+    UARCH_MODEL( PifCpuVendorZhaoxin, Family, Model, Uarch )
+
+#define CENTAUR_MODEL(Family, Model, Uarch) \
+    UARCH_MODEL( PifCpuVendorCentaur, Family, Model, Uarch )
+
+typedef struct _PIF_UARCH_RANGE {
+    UINT32 First;
+    UINT32 Last;
+    PIF_UARCH Uarch;
+} PIF_UARCH_RANGE;
+
+//
+// Sorted by First, ranges do not overlap.
+//
+static CONST PIF_UARCH_RANGE PifUarchRanges[] = {
+    INTEL_MODEL( 0x1A, PifUarchNehalem ),
+    INTEL_MODEL( 0x1E, PifUarchNehalem ),
+    INTEL_MODEL( 0x1F, PifUarchNehalem ),
+    INTEL_MODEL( 0x25, PifUarchWestmere ),
+    INTEL_MODEL( 0x2A, PifUarchSandyBridge ),
+    INTEL_MODEL( 0x2C, PifUarchWestmere ),
+    INTEL_MODEL( 0x2D, PifUarchSandyBridge ),
+    INTEL_MODEL( 0x2E, PifUarchNehalem ),
+    INTEL_MODEL( 0x2F, PifUarchWestmere ),
+    INTEL_MODEL( 0x37, PifUarchSilvermont ),
+    INTEL_MODEL( 0x3A, PifUarchIvyBridge ),
+    INTEL_MODEL( 0x3C, PifUarchHaswell ),
+    INTEL_MODEL( 0x3D, PifUarchBroadwell ),
+    INTEL_MODEL( 0x3E, PifUarchIvyBridge ),
+    INTEL_MODEL( 0x3F, PifUarchHaswell ),
+    INTEL_MODEL( 0x45, PifUarchHaswell ),
+    INTEL_MODEL( 0x46, PifUarchHaswell ),
+    INTEL_MODEL( 0x47, PifUarchBroadwell ),
+    INTEL_MODEL( 0x4A, PifUarchSilvermont ),
+    INTEL_MODEL( 0x4C, PifUarchAirmont ),
+    INTEL_MODEL( 0x4D, PifUarchSilvermont ),
+    INTEL_MODEL( 0x4E, PifUarchSkylake ),
+    INTEL_MODEL( 0x4F, PifUarchBroadwell ),
+    INTEL_STEPPINGS( 0x55, 0x0, 0x4, PifUarchSkylakeX ),
+    INTEL_STEPPINGS( 0x55, 0x5, 0x7, PifUarchCascadeLake ),
+    INTEL_STEPPINGS( 0x55, 0x8, 0xF, PifUarchCooperLake ),
+    INTEL_MODEL( 0x56, PifUarchBroadwell ),
+    INTEL_MODEL( 0x57, PifUarchKnightsLanding ),
+    INTEL_MODEL( 0x5A, PifUarchSilvermont ),
+    INTEL_MODEL( 0x5C, PifUarchGoldmont ),
+    INTEL_MODEL( 0x5D, PifUarchSilvermont ),
+    INTEL_MODEL( 0x5E, PifUarchSkylake ),
+    INTEL_MODEL( 0x5F, PifUarchGoldmont ),
+    INTEL_MODEL( 0x66, PifUarchCannonLake ),
+    INTEL_MODEL( 0x6A, PifUarchIceLakeX ),
+    INTEL_MODEL( 0x6C, PifUarchIceLakeX ),
+    INTEL_MODEL( 0x7A, PifUarchGoldmontPlus ),
+    INTEL_MODEL( 0x7D, PifUarchIceLake ),
+    INTEL_MODEL( 0x7E, PifUarchIceLake ),
+    INTEL_MODEL( 0x85, PifUarchKnightsMill ),
+    INTEL_MODEL( 0x86, PifUarchTremont ),
+    INTEL_MODEL( 0x8C, PifUarchTigerLake ),
+    INTEL_MODEL( 0x8D, PifUarchTigerLake ),
+    INTEL_STEPPINGS( 0x8E, 0x0, 0x9, PifUarchKabyLake ),
+    INTEL_STEPPINGS( 0x8E, 0xA, 0xB, PifUarchCoffeeLake ),
+    INTEL_STEPPINGS( 0x8E, 0xC, 0xF, PifUarchCometLake ),
+    INTEL_MODEL( 0x8F, PifUarchSapphireRapids ),
+    INTEL_MODEL( 0x96, PifUarchTremont ),
+    INTEL_MODEL( 0x97, PifUarchAlderLake ),
+    INTEL_MODEL( 0x9A, PifUarchAlderLake ),
+    INTEL_MODEL( 0x9C, PifUarchTremont ),
+    INTEL_STEPPINGS( 0x9E, 0x0, 0x9, PifUarchKabyLake ),
+    INTEL_STEPPINGS( 0x9E, 0xA, 0xF, PifUarchCoffeeLake ),
+    INTEL_MODEL( 0xA5, PifUarchCometLake ),
+    INTEL_MODEL( 0xA6, PifUarchCometLake ),
+    INTEL_MODEL( 0xA7, PifUarchRocketLake ),
+    INTEL_MODEL( 0xAA, PifUarchMeteorLake ),
+    INTEL_MODEL( 0xAC, PifUarchMeteorLake ),
+    INTEL_MODEL( 0xAD, PifUarchGraniteRapids ),
+    INTEL_MODEL( 0xAE, PifUarchGraniteRapids ),
+    INTEL_MODEL( 0xAF, PifUarchCrestmont ),
+    INTEL_MODEL( 0xB6, PifUarchCrestmont ),
+    INTEL_MODEL( 0xB7, PifUarchRaptorLake ),
+    INTEL_MODEL( 0xBA, PifUarchRaptorLake ),
+    INTEL_MODEL( 0xBD, PifUarchLunarLake ),
+    INTEL_MODEL( 0xBE, PifUarchGracemont ),     // Alder Lake-N, E-cores only
+    INTEL_MODEL( 0xBF, PifUarchRaptorLake ),
+    INTEL_MODEL( 0xC5, PifUarchArrowLake ),
+    INTEL_MODEL( 0xC6, PifUarchArrowLake ),
+    INTEL_MODEL( 0xCF, PifUarchEmeraldRapids ),
+
+    AMD_MODELS( 0x0F, 0x00, 0xFF, PifUarchK8 ),
+    AMD_MODELS( 0x10, 0x00, 0xFF, PifUarchK10 ),
+    AMD_MODELS( 0x11, 0x00, 0xFF, PifUarchK8 ),
+    AMD_MODELS( 0x12, 0x00, 0xFF, PifUarchK10 ),
+    AMD_MODELS( 0x14, 0x00, 0xFF, PifUarchBobcat ),
+    AMD_MODELS( 0x15, 0x00, 0x01, PifUarchBulldozer ),
+    AMD_MODELS( 0x15, 0x02, 0x02, PifUarchPiledriver ),
+    AMD_MODELS( 0x15, 0x10, 0x1F, PifUarchPiledriver ),
+    AMD_MODELS( 0x15, 0x30, 0x3F, PifUarchSteamroller ),
+    AMD_MODELS( 0x15, 0x60, 0x7F, PifUarchExcavator ),
+    AMD_MODELS( 0x16, 0x00, 0x0F, PifUarchJaguar ),
+    AMD_MODELS( 0x16, 0x30, 0x3F, PifUarchPuma ),
+    AMD_MODELS( 0x17, 0x00, 0x07, PifUarchZen ),
+    AMD_MODELS( 0x17, 0x08, 0x08, PifUarchZenPlus ),
+    AMD_MODELS( 0x17, 0x09, 0x17, PifUarchZen ),
+    AMD_MODELS( 0x17, 0x18, 0x18, PifUarchZenPlus ),
+    AMD_MODELS( 0x17, 0x19, 0x2F, PifUarchZen ),
+    AMD_MODELS( 0x17, 0x30, 0xFF, PifUarchZen2 ),
+    AMD_MODELS( 0x19, 0x00, 0x0F, PifUarchZen3 ),
+    AMD_MODELS( 0x19, 0x10, 0x1F, PifUarchZen4 ),
+    AMD_MODELS( 0x19, 0x20, 0x5F, PifUarchZen3 ),
+    AMD_MODELS( 0x19, 0x60, 0x7F, PifUarchZen4 ),
+    AMD_MODELS( 0x19, 0xA0, 0xAF, PifUarchZen4 ),
+    AMD_MODELS( 0x1A, 0x00, 0xFF, PifUarchZen5 ),
+
+    HYGON_MODELS( 0x18, 0x00, 0xFF, PifUarchDhyana ),
+
+    ZHAOXIN_MODEL( 0x06, 0x0F, PifUarchIsaiah ),
+    ZHAOXIN_MODEL( 0x07, 0x1B, PifUarchZhangJiang ),
+    ZHAOXIN_MODEL( 0x07, 0x3B, PifUarchLuJiaZui ),
+    ZHAOXIN_MODEL( 0x07, 0x5B, PifUarchYongFeng ),
+
+    CENTAUR_MODEL( 0x06, 0x0F, PifUarchIsaiah ),
+    CENTAUR_MODEL( 0x07, 0x1B, PifUarchZhangJiang ),
+    CENTAUR_MODEL( 0x07, 0x3B, PifUarchLuJiaZui ),
+};
+
+#define FAST_REP_MOVSB  (PIF_UARCH_FAST_REP_MOVSB)
+#define FSRM            (PIF_UARCH_FAST_REP_MOVSB | PIF_UARCH_FAST_SHORT_REP_MOVSB)
+
+//
+// Tuning hints. The AVX-512 server cores before Sapphire Rapids prefer 256
+// bit vectors because of the license-based clock drop, and Zen 4 because it
+// splits 512 bit operations in two.
+//
+static CONST PIF_UARCH_INFO PifUarchInfo[PifUarchMax] = {
+    [PifUarchUnknown]           = { PifUarchUnknown,        "unknown",          128, 0 },
+
+    [PifUarchNehalem]           = { PifUarchNehalem,        "Nehalem",          128, 0 },
+    [PifUarchWestmere]          = { PifUarchWestmere,       "Westmere",         128, 0 },
+    [PifUarchSandyBridge]       = { PifUarchSandyBridge,    "Sandy Bridge",     256, 0 },
+    [PifUarchIvyBridge]         = { PifUarchIvyBridge,      "Ivy Bridge",       256, FAST_REP_MOVSB },
+    [PifUarchHaswell]           = { PifUarchHaswell,        "Haswell",          256, FAST_REP_MOVSB | PIF_UARCH_SLOW_GATHER },
+    [PifUarchBroadwell]         = { PifUarchBroadwell,      "Broadwell",        256, FAST_REP_MOVSB },
+    [PifUarchSkylake]           = { PifUarchSkylake,        "Skylake",          256, FAST_REP_MOVSB },
+    [PifUarchSkylakeX]          = { PifUarchSkylakeX,       "Skylake-X",        256, FAST_REP_MOVSB | PIF_UARCH_AVX512_DOWNCLOCK },
+    [PifUarchCascadeLake]       = { PifUarchCascadeLake,    "Cascade Lake",     256, FAST_REP_MOVSB | PIF_UARCH_AVX512_DOWNCLOCK },
+    [PifUarchCooperLake]        = { PifUarchCooperLake,     "Cooper Lake",      256, FAST_REP_MOVSB | PIF_UARCH_AVX512_DOWNCLOCK },
+    [PifUarchKabyLake]          = { PifUarchKabyLake,       "Kaby Lake",        256, FAST_REP_MOVSB },
+    [PifUarchCoffeeLake]        = { PifUarchCoffeeLake,     "Coffee Lake",      256, FAST_REP_MOVSB },
+    [PifUarchCometLake]         = { PifUarchCometLake,      "Comet Lake",       256, FAST_REP_MOVSB },
+    [PifUarchCannonLake]        = { PifUarchCannonLake,     "Cannon Lake",      256, FAST_REP_MOVSB | PIF_UARCH_AVX512_DOWNCLOCK },
+    [PifUarchIceLake]           = { PifUarchIceLake,        "Ice Lake",         256, FSRM | PIF_UARCH_AVX512_DOWNCLOCK },
+    [PifUarchIceLakeX]          = { PifUarchIceLakeX,       "Ice Lake-SP",      256, FSRM | PIF_UARCH_AVX512_DOWNCLOCK },
+    [PifUarchTigerLake]         = { PifUarchTigerLake,      "Tiger Lake",       256, FSRM | PIF_UARCH_AVX512_DOWNCLOCK },
+    [PifUarchRocketLake]        = { PifUarchRocketLake,     "Rocket Lake",      256, FSRM | PIF_UARCH_AVX512_DOWNCLOCK },
+    [PifUarchAlderLake]         = { PifUarchAlderLake,      "Alder Lake",       256, FSRM | PIF_UARCH_HYBRID },
+    [PifUarchRaptorLake]        = { PifUarchRaptorLake,     "Raptor Lake",      256, FSRM | PIF_UARCH_HYBRID },
+    [PifUarchMeteorLake]        = { PifUarchMeteorLake,     "Meteor Lake",      256, FSRM | PIF_UARCH_HYBRID },
+    [PifUarchArrowLake]         = { PifUarchArrowLake,      "Arrow Lake",       256, FSRM | PIF_UARCH_HYBRID },
+    [PifUarchLunarLake]         = { PifUarchLunarLake,      "Lunar Lake",       256, FSRM | PIF_UARCH_HYBRID },
+    [PifUarchSapphireRapids]    = { PifUarchSapphireRapids, "Sapphire Rapids",  512, FSRM },
+    [PifUarchEmeraldRapids]     = { PifUarchEmeraldRapids,  "Emerald Rapids",   512, FSRM },
+    [PifUarchGraniteRapids]     = { PifUarchGraniteRapids,  "Granite Rapids",   512, FSRM },
+    [PifUarchSilvermont]        = { PifUarchSilvermont,     "Silvermont",       128, 0 },
+    [PifUarchAirmont]           = { PifUarchAirmont,        "Airmont",          128, 0 },
+    [PifUarchGoldmont]          = { PifUarchGoldmont,       "Goldmont",         128, FAST_REP_MOVSB },
+    [PifUarchGoldmontPlus]      = { PifUarchGoldmontPlus,   "Goldmont Plus",    128, FAST_REP_MOVSB },
+    [PifUarchTremont]           = { PifUarchTremont,        "Tremont",          128, FAST_REP_MOVSB },
+    [PifUarchGracemont]         = { PifUarchGracemont,      "Gracemont",        256, FSRM },
+    [PifUarchCrestmont]         = { PifUarchCrestmont,      "Crestmont",        256, FSRM },
+    [PifUarchKnightsLanding]    = { PifUarchKnightsLanding, "Knights Landing",  512, PIF_UARCH_SLOW_GATHER },
+    [PifUarchKnightsMill]       = { PifUarchKnightsMill,    "Knights Mill",     512, PIF_UARCH_SLOW_GATHER },
+
+    [PifUarchK8]                = { PifUarchK8,             "K8",               128, 0 },
+    [PifUarchK10]               = { PifUarchK10,            "K10",              128, 0 },
+    [PifUarchBobcat]            = { PifUarchBobcat,         "Bobcat",           128, 0 },
+    [PifUarchBulldozer]         = { PifUarchBulldozer,      "Bulldozer",        128, 0 },
+    [PifUarchPiledriver]        = { PifUarchPiledriver,     "Piledriver",       128, 0 },
+    [PifUarchSteamroller]       = { PifUarchSteamroller,    "Steamroller",      128, 0 },
+    [PifUarchExcavator]         = { PifUarchExcavator,      "Excavator",        128, PIF_UARCH_SLOW_GATHER },
+    [PifUarchJaguar]            = { PifUarchJaguar,         "Jaguar",           128, 0 },
+    [PifUarchPuma]              = { PifUarchPuma,           "Puma",             128, 0 },
+    [PifUarchZen]               = { PifUarchZen,            "Zen",              128, PIF_UARCH_SLOW_GATHER },
+    [PifUarchZenPlus]           = { PifUarchZenPlus,        "Zen+",             128, PIF_UARCH_SLOW_GATHER },
+    [PifUarchZen2]              = { PifUarchZen2,           "Zen 2",            256, PIF_UARCH_SLOW_GATHER },
+    [PifUarchZen3]              = { PifUarchZen3,           "Zen 3",            256, FSRM | PIF_UARCH_SLOW_GATHER },
+    [PifUarchZen4]              = { PifUarchZen4,           "Zen 4",            256, FSRM | PIF_UARCH_AVX512_SPLIT },
+    [PifUarchZen5]              = { PifUarchZen5,           "Zen 5",            512, FSRM },
+
+    [PifUarchDhyana]            = { PifUarchDhyana,         "Dhyana",           128, PIF_UARCH_SLOW_GATHER },
+
+    [PifUarchIsaiah]            = { PifUarchIsaiah,         "Isaiah",           128, 0 },
+    [PifUarchZhangJiang]        = { PifUarchZhangJiang,     "ZhangJiang",       128, 0 },
+    [PifUarchLuJiaZui]          = { PifUarchLuJiaZui,       "LuJiaZui",         128, 0 },
+    [PifUarchYongFeng]          = { PifUarchYongFeng,       "YongFeng",         256, FAST_REP_MOVSB },
+};
+
+PIF_CPU_VENDOR
+PIFAPI
+PifContextGetVendor(
+    IN PCPIF_CONTEXT Context
+)
+{
+    return (Context != NULL) ? Context->Vendor : PifCpuVendorUnknown;
+}
+
+PIF_CPU_VENDOR
+PIFAPI
+PifGetVendor(
+    VOID
+)
+{
+    return PifContextGetVendor( PifGetDefaultContext( ) );
+}
+
+PIF_CPU_VENDOR
+PIFAPI
+PifClassifyVendor(
+    IN UINT32 Ebx,
+    IN UINT32 Edx,
+    IN UINT32 Ecx
+)
+{
+    UINT32 Index;
+
+    //
+    // The signature is compared as the three registers CPUID returned it in,
+    // without assembling the vendor string.
+    //
+    for (Index = 0; Index < RTL_NUMBER_OF_V1( PifVendorSignatures ); ++Index)
+    {
+        if (((Ebx ^ PifVendorSignatures[Index].Ebx) |
+             (Edx ^ PifVendorSignatures[Index].Edx) |
+             (Ecx ^ PifVendorSignatures[Index].Ecx)) == 0)
+        {
+            return PifVendorSignatures[Index].Vendor;
+        }
+    }
+
+    return PifCpuVendorUnknown;
+}
+
+PCSTR
+PIFAPI
+PifGetVendorName(
+    IN PIF_CPU_VENDOR Vendor
+)
+{
+    if ((UINT32)Vendor >= PifCpuVendorMax)
+    {
+        return NULL;
+    }
+
+    return PifVendorNames[Vendor];
+}
+
+VOID
+PIFAPI
+PifDecodeSignature(
+    IN UINT32 Eax,
+    OUT PPIF_CPU_SIGNATURE Signature
+)
+{
+    Signature->Stepping = Eax & 0xF;
+    Signature->BaseModel = (Eax >> 4) & 0xF;
+    Signature->BaseFamily = (Eax >> 8) & 0xF;
+    Signature->ProcessorType = (Eax >> 12) & 0x3;
+    Signature->ExtendedModel = (Eax >> 16) & 0xF;
+    Signature->ExtendedFamily = (Eax >> 20) & 0xFF;
+
+    //
+    // The extended family only applies to base family 0xF. The SDM applies the
+    // extended model to families 0x6 and 0xF and the APM to 0xF only, but
+    // Zhaoxin family 0x7 uses it too, and older processors report it as zero.
+    //
+    Signature->Family = Signature->BaseFamily;
+    if (Signature->BaseFamily == 0xF)
+    {
+        Signature->Family += Signature->ExtendedFamily;
+    }
+
+    Signature->Model = Signature->BaseModel;
+    if (Signature->BaseFamily >= 0x6)
+    {
+        Signature->Model |= Signature->ExtendedModel << 4;
+    }
+}
+
+STATUS
+PIFAPI
+PifContextGetSignature(
+    IN PCPIF_CONTEXT Context,
+    OUT PPIF_CPU_SIGNATURE Signature
+)
+{
+    CPUID_INFO CpuInfo;
+    STATUS Status;
+
+    if (Signature == NULL)
+    {
+        return E_NULLPARAM;
+    }
+
+    Status = PifContextQueryLeaf( Context, CPUID_FEATURES, 0, &CpuInfo );
+    if (!SUCCESS( Status ))
+    {
+        return Status;
+    }
+
+    PifDecodeSignature( CpuInfo.Eax, Signature );
+    return STATUS_OK;
+}
+
+STATUS
+PIFAPI
+PifGetSignature(
+    OUT PPIF_CPU_SIGNATURE Signature
+)
+{
+    return PifContextGetSignature( PifGetDefaultContext( ), Signature );
+}
+
+PCPIF_UARCH_INFO
+PIFAPI
+PifLookupMicroarchitecture(
+    IN PIF_CPU_VENDOR Vendor,
+    IN UINT32 Family,
+    IN UINT32 Model,
+    IN UINT32 Stepping
+)
+{
+    UINT32 Key;
+    UINT32 Low;
+    UINT32 High;
+    UINT32 Middle;
+
+    if ((UINT32)Vendor >= 0x10 || Family > 0xFFFF || Model > 0xFF || Stepping > 0xF)
+    {
+        return &PifUarchInfo[PifUarchUnknown];
+    }
+
+    //
+    // Find the last range starting at or below the key.
+    //
+    Key = UARCH_KEY( Vendor, Family, Model, Stepping );
+    Low = 0;
+    High = RTL_NUMBER_OF_V1( PifUarchRanges );
+    while (Low < High)
+    {
+        Middle = Low + (High - Low) / 2;
+        if (PifUarchRanges[Middle].First <= Key)
+        {
+            Low = Middle + 1;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    if (Low == 0 || Key > PifUarchRanges[Low - 1].Last)
+    {
+        return &PifUarchInfo[PifUarchUnknown];
+    }
+
+    return &PifUarchInfo[PifUarchRanges[Low - 1].Uarch];
+}
+
+PCPIF_UARCH_INFO
+PIFAPI
+PifContextGetMicroarchitecture(
+    IN PCPIF_CONTEXT Context
+)
+{
+    PIF_CPU_SIGNATURE Signature;
+
+    if (!SUCCESS( PifContextGetSignature( Context, &Signature ) ))
+    {
+        return &PifUarchInfo[PifUarchUnknown];
+    }
+
+    return PifLookupMicroarchitecture( PifContextGetVendor( Context ),
+                                       Signature.Family,
+                                       Signature.Model,
+                                       Signature.Stepping );
+}
+
+PCPIF_UARCH_INFO
+PIFAPI
+PifGetMicroarchitecture(
+    VOID
+)
+{
+    return PifContextGetMicroarchitecture( PifGetDefaultContext( ) );
+}
+
+PCPIF_UARCH_INFO
+PIFAPI
+PifGetMicroarchitectureInfo(
+    IN PIF_UARCH Uarch
+)
+{
+    if ((UINT32)Uarch >= PifUarchMax)
+    {
+        return NULL;
+    }
+
+    return &PifUarchInfo[Uarch];
+}
@@ -0,0 +1,214 @@
+/**
+ * CpuInfo
+ * Copyright (c) 2017-2018, Aidan Khoury. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file worker.c
+ * @author Aidan Khoury (ajkhoury)
+ * @date 11/16/2018
+ */
+
+
+#include "pifp.h"
+
+#if !defined(_WIN32)
+
+#include <errno.h>
+#include <time.h>
+
+//
+// Condition variables can only wait on the monotonic clock where
+// pthread_condattr_setclock is available; elsewhere (macOS) the deadline is
+// kept on the realtime clock, which a wall clock step can shift.
+//
+#if defined(__linux__)
+#define PIF_WORKER_CLOCK    CLOCK_MONOTONIC
+#else
+#define PIF_WORKER_CLOCK    CLOCK_REALTIME
+#endif
+
+static
+VOID *
+PifpPeriodicWorkerThread(
+    IN VOID *Parameter
+)
+{
+    PPIF_PERIODIC_WORKER Worker = (PPIF_PERIODIC_WORKER)Parameter;
+    struct timespec Deadline;
+    struct timespec Now;
+
+    clock_gettime( PIF_WORKER_CLOCK, &Deadline );
+
+    pthread_mutex_lock( &Worker->Lock );
+    while (!Worker->StopRequested)
+    {
+        pthread_mutex_unlock( &Worker->Lock );
+        Worker->Routine( Worker->Parameter );
+        pthread_mutex_lock( &Worker->Lock );
+
+        //
+        // Keep a fixed cadence, unless a pass overran the interval.
+        //
+        Deadline.tv_sec += Worker->IntervalMs / 1000;
+        Deadline.tv_nsec += (long)(Worker->IntervalMs % 1000) * 1000000;
+        if (Deadline.tv_nsec >= 1000000000)
+        {
+            Deadline.tv_sec++;
+            Deadline.tv_nsec -= 1000000000;
+        }
+
+        clock_gettime( PIF_WORKER_CLOCK, &Now );
+        if (Now.tv_sec > Deadline.tv_sec || (Now.tv_sec == Deadline.tv_sec && Now.tv_nsec > Deadline.tv_nsec))
+        {
+            Deadline = Now;
+            continue;
+        }
+
+        while (!Worker->StopRequested &&
+               pthread_cond_timedwait( &Worker->Wake, &Worker->Lock, &Deadline ) != ETIMEDOUT)
+        {
+        }
+    }
+    pthread_mutex_unlock( &Worker->Lock );
+
+    return NULL;
+}
+
+VOID
+PifpInitializePeriodicWorker(
+    OUT PPIF_PERIODIC_WORKER Worker,
+    IN PPIF_PERIODIC_ROUTINE Routine,
+    IN PVOID Parameter
+)
+{
+    pthread_condattr_t ConditionAttributes;
+
+    Worker->Routine = Routine;
+    Worker->Parameter = Parameter;
+    Worker->IntervalMs = 0;
+    Worker->Running = FALSE;
+    Worker->StopRequested = FALSE;
+
+    pthread_mutex_init( &Worker->Lock, NULL );
+    pthread_condattr_init( &ConditionAttributes );
+#if defined(__linux__)
+    pthread_condattr_setclock( &ConditionAttributes, PIF_WORKER_CLOCK );
+#endif
+    pthread_cond_init( &Worker->Wake, &ConditionAttributes );
+    pthread_condattr_destroy( &ConditionAttributes );
+}
+
+VOID
+PifpDestroyPeriodicWorker(
+    IN PPIF_PERIODIC_WORKER Worker
+)
+{
+    PifpStopPeriodicWorker( Worker );
+
+    pthread_cond_destroy( &Worker->Wake );
+    pthread_mutex_destroy( &Worker->Lock );
+}
+
+STATUS
+PifpStartPeriodicWorker(
+    IN PPIF_PERIODIC_WORKER Worker,
+    IN UINT32 IntervalMs
+)
+{
+    STATUS Status = STATUS_OK;
+
+    if (IntervalMs == 0)
+    {
+        return E_INVALID;
+    }
+
+    //
+    // A stop still joining the previous thread keeps StopRequested set until
+    // the thread is gone.
+    //
+    pthread_mutex_lock( &Worker->Lock );
+    if (Worker->Running)
+    {
+        Status = E_ALREADY;
+    }
+    else if (Worker->StopRequested)
+    {
+        Status = E_BUSY;
+    }
+    else
+    {
+        Worker->IntervalMs = IntervalMs;
+        if (pthread_create( &Worker->Thread, NULL, PifpPeriodicWorkerThread, Worker ) == 0)
+        {
+            Worker->Running = TRUE;
+        }
+        else
+        {
+            Status = E_NOCREATE;
+        }
+    }
+    pthread_mutex_unlock( &Worker->Lock );
+
+    return Status;
+}
+
+VOID
+PifpStopPeriodicWorker(
+    IN PPIF_PERIODIC_WORKER Worker
+)
+{
+    pthread_t Thread;
+
+    //
+    // Claim the stop under the lock, so that only one caller joins the
+    // thread.
+    //
+    pthread_mutex_lock( &Worker->Lock );
+    if (!Worker->Running)
+    {
+        pthread_mutex_unlock( &Worker->Lock );
+        return;
+    }
+
+    Thread = Worker->Thread;
+    Worker->Running = FALSE;
+    Worker->StopRequested = TRUE;
+    pthread_cond_signal( &Worker->Wake );
+    pthread_mutex_unlock( &Worker->Lock );
+
+    pthread_join( Thread, NULL );
+
+    pthread_mutex_lock( &Worker->Lock );
+    Worker->StopRequested = FALSE;
+    pthread_mutex_unlock( &Worker->Lock );
+}
+
+BOOLEAN
+PifpIsPeriodicWorkerRunning(
+    IN PPIF_PERIODIC_WORKER Worker
+)
+{
+    BOOLEAN Running;
+
+    //
+    // The thread may still be running a pass until a stop has joined it.
+    //
+    pthread_mutex_lock( &Worker->Lock );
+    Running = (BOOLEAN)(Worker->Running || Worker->StopRequested);
+    pthread_mutex_unlock( &Worker->Lock );
+
+    return Running;
+}
+
+#endif
@@ -33,8 +33,8 @@ global ASM_PFX(__cpuid)
 ASM_PFX(__cpuid):
     push    rbx
     push    rbp
-    mov     rbp, rcx
-    mov     rax, rdx
+    mov     rbp, ARG1
+    mov     rax, ARG2
     xor     rcx, rcx
     cpuid
     mov     dword [rbp + 0], eax
@@ -52,9 +52,9 @@ global ASM_PFX(__cpuidex)
 ASM_PFX(__cpuidex):
     push    rbx
     push    rbp
-    mov     rbp, rcx
-    mov     rax, rdx
-    mov     rcx, r8
+    mov     rbp, ARG1
+    mov     rax, ARG2
+    mov     rcx, ARG3
     cpuid
     mov     dword [rbp + 0], eax
     mov     dword [rbp + 4], ebx
@@ -63,3 +63,55 @@ ASM_PFX(__cpuidex):
     pop     rbp
     pop     rbx
     ret
+
+;
+; unsigned __int64 _xgetbv( unsigned int _Xcr );
+;
+global ASM_PFX(_xgetbv)
+ASM_PFX(_xgetbv):
+    mov     rcx, ARG1
+    xgetbv
+    shl     rdx, 32
+    or      rax, rdx
+    ret
+
+;
+; unsigned __int64 __rdtsc( void );
+;
+global ASM_PFX(__rdtsc)
+ASM_PFX(__rdtsc):
+    rdtsc
+    shl     rdx, 32
+    or      rax, rdx
+    ret
+
+;
+; unsigned __int64 __rdtscp( unsigned int *_Aux );
+;
+global ASM_PFX(__rdtscp)
+ASM_PFX(__rdtscp):
+    mov     r11, ARG1
+    rdtscp
+    mov     dword [r11], ecx
+    shl     rdx, 32
+    or      rax, rdx
+    ret
+
+;
+; unsigned __int64 __readpmc( unsigned long _Counter );
+;
+global ASM_PFX(__readpmc)
+ASM_PFX(__readpmc):
+    mov     rcx, ARG1
+    rdpmc
+    shl     rdx, 32
+    or      rax, rdx
+    ret
+
+;
+; void _mm_lfence( void );
+;
+global ASM_PFX(_mm_lfence)
+ASM_PFX(_mm_lfence):
+    lfence
+    ret